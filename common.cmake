@@ -20,3 +20,6 @@ set(_CURL_LIBCURL CURL::libcurl)
 find_package(RapidJSON CONFIG REQUIRED)
 message(STATUS "Using RapidJSON ${RapidJSON_VERSION}")
 set(_RAPIDJSON rapidjson)
+
+find_package(GTest CONFIG REQUIRED)
+message(STATUS "Using GTest ${GTest_VERSION}")
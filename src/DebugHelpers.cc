@@ -1,6 +1,7 @@
 #include "DebugHelpers.h"
 
 #include "ProtoTypes.h"
+#include "search/AdminIndex.h"
 #include "search/SearchEngine.h"
 #include "search/SearchEngineItf.h"
 #include "utils/ConfigConstants.h"
@@ -10,6 +11,7 @@
 #include <absl/log/log.h>
 
 #include <format>
+#include <memory>
 #include <string>
 
 namespace geo::debug
@@ -51,7 +53,8 @@ void Search(const std::string& name, const std::string& configFilePath)
    Configuration configuration(configFilePath.c_str());
    geo::WebClient overpassApiClient(configuration.GetString(sz_overpassEndpointKey));
    geo::WebClient nominatimApiClient(configuration.GetString(sz_nominatimEndpointKey));
-   geo::SearchEngine engine(overpassApiClient, nominatimApiClient);
+   geo::WebClient openMeteoApiClient(configuration.GetString(sz_openMeteoEndpointKey));
+   geo::SearchEngine engine(overpassApiClient, nominatimApiClient, openMeteoApiClient);
    auto cities = engine.FindCitiesByName(name, true);
    printDetails(cities);
 }
@@ -61,7 +64,8 @@ void Search(double latitude, double longitude, const std::string& configFilePath
    Configuration configuration(configFilePath.c_str());
    geo::WebClient overpassApiClient(configuration.GetString(sz_overpassEndpointKey));
    geo::WebClient nominatimApiClient(configuration.GetString(sz_nominatimEndpointKey));
-   geo::SearchEngine engine(overpassApiClient, nominatimApiClient);
+   geo::WebClient openMeteoApiClient(configuration.GetString(sz_openMeteoEndpointKey));
+   geo::SearchEngine engine(overpassApiClient, nominatimApiClient, openMeteoApiClient);
    auto cities = engine.FindCitiesByPosition(latitude, longitude, true);
    printDetails(cities);
 }
@@ -76,7 +80,8 @@ void Search(
    Configuration configuration(configFilePath.c_str());
    geo::WebClient overpassApiClient(configuration.GetString(sz_overpassEndpointKey));
    geo::WebClient nominatimApiClient(configuration.GetString(sz_nominatimEndpointKey));
-   geo::SearchEngine engine(overpassApiClient, nominatimApiClient);
+   geo::WebClient openMeteoApiClient(configuration.GetString(sz_openMeteoEndpointKey));
+   geo::SearchEngine engine(overpassApiClient, nominatimApiClient, openMeteoApiClient);
    auto handler = engine.StartFindRegions();
 
    GeoProtoPlaces regions;
@@ -96,10 +101,22 @@ void RequestWeather(double latitude, double longitude, const std::string& fromDa
    Configuration configuration(configFilePath.c_str());
    geo::WebClient overpassApiClient(configuration.GetString(sz_overpassEndpointKey));
    geo::WebClient nominatimApiClient(configuration.GetString(sz_nominatimEndpointKey));
-   geo::SearchEngine engine(overpassApiClient, nominatimApiClient);
+   geo::WebClient openMeteoApiClient(configuration.GetString(sz_openMeteoEndpointKey));
+   geo::SearchEngine engine(overpassApiClient, nominatimApiClient, openMeteoApiClient);
 
    const auto weather = engine.GetWeather(latitude, longitude, {StringToDate(fromDate), StringToDate(toDate)});
    printDetails(weather);
 }
 
+void Complete(const std::string& prefix, std::uint32_t maxPlaces, const std::string& configFilePath)
+{
+   Configuration configuration(configFilePath.c_str());
+   const AdminIndex index(std::make_shared<const Snapshot>(configuration.GetString(sz_snapshotFileKey)));
+   for (const auto& place : index.FindPlacesByPrefix(prefix, maxPlaces))
+   {
+      LOG(INFO) << std::format("Found {} {} ({}), country {} ({}), ({},{})", place.addressType, place.info.name,
+         place.info.nameEn, place.info.country, place.info.countryEn, place.info.latitude, place.info.longitude);
+   }
+}
+
 }  // namespace geo::debug
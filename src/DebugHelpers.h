@@ -20,4 +20,7 @@ void Search(double latitude, double longitude, std::uint32_t rangeMeters, std::u
 void RequestWeather(double latitude, double longitude, const std::string& fromDate, const std::string& toDate,
    const std::string& configFilePath);
 
+// Find places of the local administrative boundary index whose names begin with a prefix.
+void Complete(const std::string& prefix, std::uint32_t maxPlaces, const std::string& configFilePath);
+
 }  // namespace geo::debug
@@ -2,43 +2,111 @@
 
 #include "reactors/GetCitiesReactor.h"
 #include "reactors/GetRegionsReactor.h"
+#include "reactors/GetWeatherReactor.h"
+#include "search/AdminIndex.h"
+#include "search/LocalSearchEngine.h"
 #include "search/SearchEngine.h"
 #include "utils/ConfigConstants.h"
 #include "utils/Configuration.h"
 
+#include <absl/log/log.h>
+
+#include <format>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+
+using namespace geo;
+
+// Parses the relation resolution mode of the Overpass endpoint, see SearchEngineSettings::relationResolution
+RelationResolution parseRelationResolution(const std::string& value)
+{
+   if (value == "nominatim")
+      return RelationResolution::Nominatim;
+   if (value == "overpass")
+      return RelationResolution::Overpass;
+
+   LOG(ERROR) << std::format("Unknown relation resolution: {}", value);
+   throw std::runtime_error("Unknown relation resolution: " + value);
+}
+
+// Creates the search engine which uses remote APIs. If the index of administrative boundaries is configured,
+// searches of cities and regions are answered from it, and the remote engine is used for the rest.
+std::unique_ptr<ISearchEngine> createSearchEngine(const Configuration& configuration, WebClient& overpassApiClient,
+   WebClient& nominatimApiClient, WebClient& openMeteoApiClient)
+{
+   auto remoteEngine = std::make_unique<SearchEngine>(overpassApiClient, nominatimApiClient, openMeteoApiClient,
+      SearchEngineSettings{static_cast<std::size_t>(configuration.GetInt64(sz_relationCacheSizeMbKey)) * 1024 * 1024,
+         std::chrono::seconds(configuration.GetInt64(sz_relationCacheTtlSecondsKey)),
+         static_cast<std::uint32_t>(configuration.GetInt64(sz_regionTileSizeKey)),
+         static_cast<std::size_t>(configuration.GetInt64(sz_regionCacheSizeMbKey)) * 1024 * 1024,
+         std::chrono::seconds(configuration.GetInt64(sz_regionCacheTtlSecondsKey)),
+         configuration.GetString(sz_cacheDirectoryKey),
+         static_cast<std::uint64_t>(configuration.GetInt64(sz_diskCacheSizeMbKey)) * 1024 * 1024,
+         static_cast<std::uint32_t>(configuration.GetInt64(sz_weatherCellsPerDegreeKey)),
+         static_cast<std::size_t>(configuration.GetInt64(sz_weatherStoreSizeMbKey)) * 1024 * 1024,
+         std::chrono::seconds(configuration.GetInt64(sz_weatherCacheTtlSecondsKey)),
+         static_cast<std::size_t>(configuration.GetInt64(sz_maxWeatherLocationsPerRequestKey)),
+         parseRelationResolution(configuration.GetString(sz_relationResolutionKey))});
+
+   const std::string snapshotFile = configuration.GetString(sz_snapshotFileKey);
+   if (snapshotFile.empty())
+      return remoteEngine;
+
+   // A missing or damaged snapshot is logged, and the server runs with remote APIs only.
+   auto index = std::make_unique<AdminIndex>(std::make_shared<const Snapshot>(snapshotFile));
+   if (!index->IsOpen())
+      return remoteEngine;
+   return std::make_unique<LocalSearchEngine>(std::move(index), std::move(remoteEngine),
+      static_cast<std::uint32_t>(configuration.GetInt64(sz_nameSearchMaxEditsKey)));
+}
+
+}  // namespace
+
 namespace geo
 {
 
 GeoServiceImpl::GeoServiceImpl(const Configuration& configuration)
-   : m_overpassApiClient(configuration.GetString(sz_overpassEndpointKey))    // Initialize Overpass API client
-   , m_nominatimApiClient(configuration.GetString(sz_nominatimEndpointKey))  // Initialize Nominatim API client
-   , m_searchEngine(
-        std::make_unique<SearchEngine>(m_overpassApiClient, m_nominatimApiClient))  // Initialize search engine
+   : m_overpassApiClient(configuration.GetString(sz_overpassEndpointKey), WebClient::sc_defaultTimeoutMs,
+        configuration.GetInt64(sz_maxOngoingOverpassRequestsKey))  // Initialize Overpass API client
+   , m_nominatimApiClient(configuration.GetString(sz_nominatimEndpointKey), WebClient::sc_defaultTimeoutMs,
+        configuration.GetInt64(sz_maxOngoingNominatimRequestsKey))  // Initialize Nominatim API client
+   , m_openMeteoApiClient(configuration.GetString(sz_openMeteoEndpointKey), WebClient::sc_defaultTimeoutMs,
+        configuration.GetInt64(sz_maxOngoingWeatherRequestsKey))  // Initialize Open Meteo API client
+   , m_searchEngine(createSearchEngine(configuration, m_overpassApiClient, m_nominatimApiClient,
+        m_openMeteoApiClient))  // Initialize search engine
+   , m_regionsStreamLimits{static_cast<std::uint32_t>(configuration.GetInt64(sz_maxBoxWidthKey)),
+        static_cast<std::uint32_t>(configuration.GetInt64(sz_maxBoxHeightKey)),
+        static_cast<std::size_t>(configuration.GetInt64(sz_maxOngoingTileRequestsKey))}
+   , m_executor(configuration.GetInt64(sz_workerThreadsKey),
+        configuration.GetInt64(sz_workerQueueSizeKey))  // Initialize request processing workers
 {
 }
 
 grpc::ServerUnaryReactor* GeoServiceImpl::GetCities(
    grpc::CallbackServerContext* context, const geoproto::CitiesRequest* request, geoproto::CitiesResponse* response)
 {
-   return new GetCitiesReactor(context, *request, *response, *m_searchEngine);
+   return new GetCitiesReactor(context, *request, *response, *m_searchEngine, m_executor);
 }
 
 grpc::ServerUnaryReactor* GeoServiceImpl::GetRegions(
    grpc::CallbackServerContext* context, const geoproto::RegionsRequest* request, geoproto::RegionsResponse* response)
 {
-   return new GetRegionsReactor(context, *request, *response, *m_searchEngine);
+   return new GetRegionsReactor(context, *request, *response, *m_searchEngine, m_executor);
 }
 
 grpc::ServerWriteReactor<geoproto::RegionsResponse>* GeoServiceImpl::GetRegionsStream(
    grpc::CallbackServerContext* context, const geoproto::RegionsRequest* request)
 {
-   return nullptr;  // gRPC sends grpc::StatusCode::UNIMPLEMENTED to Client
+   return new GetRegionsStreamReactor(context, *request, *m_searchEngine, m_executor, m_regionsStreamLimits);
 }
 
 grpc::ServerUnaryReactor* GeoServiceImpl::GetWeather(
    grpc::CallbackServerContext* context, const geoproto::WeatherRequest* request, ::geoproto::WeatherResponse* response)
 {
-   return nullptr;  // gRPC sends grpc::StatusCode::UNIMPLEMENTED to Client
+   return new GetWeatherReactor(context, *request, *response, *m_searchEngine, m_executor);
 }
 
 }  // namespace geo
@@ -2,7 +2,9 @@
 
 #include "geo.grpc.pb.h"
 #include "geo.pb.h"
+#include "reactors/GetRegionsStreamReactor.h"
 #include "search/SearchEngineItf.h"
+#include "utils/Executor.h"
 #include "utils/WebClient.h"
 
 #include <memory>
@@ -54,12 +56,21 @@ public:
       ::geoproto::WeatherResponse* response) override;
 
 private:
-   // WebClient instances to interact with the Overpass API and Nominatim API for geographic data.
+   // WebClient instances to interact with the Overpass API and Nominatim API for geographic data,
+   // and with the Open Meteo API for historical weather.
    WebClient m_overpassApiClient;
    WebClient m_nominatimApiClient;
+   WebClient m_openMeteoApiClient;
 
-   // A search engine for handling location-based queries, uses Overpass and Nominatim APIs.
+   // A search engine for handling location-based queries, uses Overpass, Nominatim and Open Meteo APIs.
    std::unique_ptr<ISearchEngine> m_searchEngine;
+
+   // Tiling and concurrency settings of GetRegionsStream.
+   GetRegionsStreamReactor::Limits m_regionsStreamLimits;
+
+   // Worker threads which process requests, so gRPC callback threads are never blocked by slow upstream APIs.
+   // Declared last to be destroyed first, as queued tasks use the search engine.
+   Executor m_executor;
 };
 
 }  // namespace geo
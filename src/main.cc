@@ -24,9 +24,14 @@ namespace geo
 
 void RunServer(const std::string& configFilePath)
 {
+   // Startup is timed up to the moment the server accepts requests, the snapshot is mapped by the service.
+   using Milliseconds = std::chrono::duration<double, std::milli>;
+   const auto startTime = std::chrono::steady_clock::now();
+
    std::string server_address("0.0.0.0:50051");
    Configuration configuration(configFilePath.c_str());
    GeoServiceImpl service(configuration);
+   const auto serviceTime = std::chrono::steady_clock::now();
 
    grpc::EnableDefaultHealthCheckService(true);
 
@@ -34,6 +39,10 @@ void RunServer(const std::string& configFilePath)
    builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
    builder.RegisterService(&service);
    std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
+   const auto readyTime = std::chrono::steady_clock::now();
+   LOG(INFO) << std::format("Server is ready in {:.1f} ms: service {:.1f} ms, gRPC {:.1f} ms",
+      Milliseconds(readyTime - startTime).count(), Milliseconds(serviceTime - startTime).count(),
+      Milliseconds(readyTime - serviceTime).count());
 
    const int lifetimeSeconds = 300;
    LOG(INFO) << std::format("Server listening on {} for {} seconds", server_address, lifetimeSeconds);
@@ -53,6 +62,7 @@ ABSL_FLAG(double, lon, NAN, "[Debug] Search for cities near this geographical po
 ABSL_FLAG(std::uint32_t, dist, 0, "[Debug] Half width (and height) of the square box in kilometers");
 ABSL_FLAG(std::uint32_t, filter, 0, "[Debug] Bitmask to specify which features to include ");
 ABSL_FLAG(std::string, name, "", "[Debug] Search for cities by name");
+ABSL_FLAG(std::string, prefix, "", "[Debug] Search the local index for places whose names begin with this prefix");
 ABSL_FLAG(std::string, fromDate, "", "[Debug] Start date for weather request");
 ABSL_FLAG(std::string, toDate, "", "[Debug] End date for weather request");
 
@@ -75,10 +85,13 @@ int main(int argc, char** argv)
       std::uint32_t dist = absl::GetFlag(FLAGS_dist);
       std::uint32_t filter = absl::GetFlag(FLAGS_filter);
       std::string name = absl::GetFlag(FLAGS_name);
+      std::string prefix = absl::GetFlag(FLAGS_prefix);
       std::string fromDate = absl::GetFlag(FLAGS_fromDate);
       std::string toDate = absl::GetFlag(FLAGS_toDate);
 
-      if (!name.empty())
+      if (!prefix.empty())
+         geo::debug::Complete(prefix, 20, configFilePath);
+      else if (!name.empty())
          geo::debug::Search(name, configFilePath);
       else if (lat != NAN && lon != NAN && !fromDate.empty() && !toDate.empty())
          geo::debug::RequestWeather(lat, lon, fromDate, toDate, configFilePath);
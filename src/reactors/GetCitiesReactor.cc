@@ -1,6 +1,7 @@
 #include "GetCitiesReactor.h"
 
 #include "../search/SearchEngineItf.h"
+#include "../utils/Executor.h"
 #include "../utils/GeoUtils.h"
 #include "../utils/grpcUtils.h"
 #include "RequestValidators.h"
@@ -13,7 +14,7 @@ namespace geo
 {
 
 GetCitiesReactor::GetCitiesReactor(grpc::CallbackServerContext* context, const geoproto::CitiesRequest& request,
-   geoproto::CitiesResponse& response, ISearchEngine& searchEngine)
+   geoproto::CitiesResponse& response, ISearchEngine& searchEngine, Executor& executor)
 {
    if (auto errorString = ValidateCitiesRequest(request))
    {
@@ -22,27 +23,45 @@ GetCitiesReactor::GetCitiesReactor(grpc::CallbackServerContext* context, const g
       return;
    }
 
-   GeoProtoPlaces cities;  // Container to hold the search results.
+   // The search takes a long time, so it is done on a worker thread and the RPC is finished from there.
+   // Request and response stay valid until Finish() is called.
+   const bool accepted = executor.TrySubmit(
+      [this, context, &request, &response, &searchEngine]
+      {
+         if (context->IsCancelled())
+         {
+            Finish(grpc::Status::CANCELLED);
+            return;
+         }
 
-   // Check if the request includes a position (latitude/longitude) for the search.
-   if (request.has_position())
-   {
-      // Find cities by their geographic position.
-      cities = searchEngine.FindCitiesByPosition(
-         request.position().latitude(), request.position().longitude(), request.include_details());
-   }
-   // Check if the request includes a city name for the search.
-   else if (request.has_name())
-   {
-      // Find cities by their name.
-      cities = searchEngine.FindCitiesByName(request.name(), request.include_details());
-   }
+         GeoProtoPlaces cities;  // Container to hold the search results.
 
-   // Populate the response with the found cities.
-   *response.mutable_cities() = {std::make_move_iterator(cities.begin()), std::make_move_iterator(cities.end())};
+         // Check if the request includes a position (latitude/longitude) for the search.
+         if (request.has_position())
+         {
+            // Find cities by their geographic position.
+            cities = searchEngine.FindCitiesByPosition(
+               request.position().latitude(), request.position().longitude(), request.include_details());
+         }
+         // Check if the request includes a city name for the search.
+         else if (request.has_name())
+         {
+            // Find cities by their name.
+            cities = searchEngine.FindCitiesByName(request.name(), request.include_details());
+         }
 
-   // Finish the RPC with a success status.
-   Finish(grpc::Status::OK);
+         // Populate the response with the found cities.
+         *response.mutable_cities() = {std::make_move_iterator(cities.begin()), std::make_move_iterator(cities.end())};
+
+         // Finish the RPC with a success status.
+         Finish(grpc::Status::OK);
+      });
+
+   if (!accepted)
+   {
+      LOG(ERROR) << std::format("Server is busy, GetCities is rejected, client-id={}", geo::ExtractClientId(*context));
+      Finish(grpc::Status{grpc::StatusCode::RESOURCE_EXHAUSTED, "Server is busy"});
+   }
 }
 
 }  // namespace geo
@@ -13,6 +13,7 @@ namespace geo
 
 class WebClient;
 class ISearchEngine;
+class Executor;
 
 // Reactor class for handling unary (non-streaming) responses for the GetCities RPC.
 // This class is responsible for processing a single request and returning a single response
@@ -25,8 +26,9 @@ public:
    // @param request: The incoming CitiesRequest from the client.
    // @param response: The CitiesResponse to be populated and sent back to the client.
    // @param searchEngine: Reference to the search engine used to find cities.
+   // @param executor: Executor which runs the search, so the gRPC callback thread is not blocked.
    GetCitiesReactor(grpc::CallbackServerContext* context, const geoproto::CitiesRequest& request,
-      geoproto::CitiesResponse& response, ISearchEngine& searchEngine);
+      geoproto::CitiesResponse& response, ISearchEngine& searchEngine, Executor& executor);
 
 private:
    // Called when the RPC is completed. Logs the completion and cleans up the reactor.
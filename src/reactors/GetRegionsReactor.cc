@@ -1,6 +1,7 @@
 #include "GetRegionsReactor.h"
 
 #include "../search/SearchEngineItf.h"
+#include "../utils/Executor.h"
 #include "../utils/GeoUtils.h"
 #include "../utils/grpcUtils.h"
 #include "RequestValidators.h"
@@ -12,7 +13,7 @@ namespace geo
 {
 
 GetRegionsReactor::GetRegionsReactor(grpc::CallbackServerContext* context, const geoproto::RegionsRequest& request,
-   geoproto::RegionsResponse& response, ISearchEngine& searchEngine)
+   geoproto::RegionsResponse& response, ISearchEngine& searchEngine, Executor& executor)
 {
    if (auto errorString = ValidateRegionsRequest(request))
    {
@@ -21,21 +22,40 @@ GetRegionsReactor::GetRegionsReactor(grpc::CallbackServerContext* context, const
       return;
    }
 
-   // Convert protocol buffer properties to search engine preferences
-   const ISearchEngine::RegionPreferences::Properties props = {
-      request.prefs().properties().begin(), request.prefs().properties().end()};
-   ISearchEngine::RegionPreferences prefs{request.prefs().mask(), std::move(props)};
-
-   // Create bounding box around requested position (converting km to meters)
-   const auto box =
-      CreateBoundingBox(request.position().latitude(), request.position().longitude(), request.distance_km() * 1000);
-
-   // Execute region search and populate response
-   auto regions = searchEngine.StartFindRegions()(box, prefs);
-   *response.mutable_regions() = {std::make_move_iterator(regions.begin()), std::make_move_iterator(regions.end())};
-
-   // Complete the RPC successfully
-   Finish(grpc::Status::OK);
+   // The search takes a long time, so it is done on a worker thread and the RPC is finished from there.
+   // Request and response stay valid until Finish() is called.
+   const bool accepted = executor.TrySubmit(
+      [this, context, &request, &response, &searchEngine]
+      {
+         if (context->IsCancelled())
+         {
+            Finish(grpc::Status::CANCELLED);
+            return;
+         }
+
+         // Convert protocol buffer properties to search engine preferences
+         const ISearchEngine::RegionPreferences::Properties props = {
+            request.prefs().properties().begin(), request.prefs().properties().end()};
+         ISearchEngine::RegionPreferences prefs{request.prefs().mask(), std::move(props)};
+
+         // Create bounding box around requested position (converting km to meters)
+         const auto box = CreateBoundingBox(
+            request.position().latitude(), request.position().longitude(), request.distance_km() * 1000);
+
+         // Execute region search and populate response
+         auto regions = searchEngine.StartFindRegions()(box, prefs);
+         *response.mutable_regions() = {
+            std::make_move_iterator(regions.begin()), std::make_move_iterator(regions.end())};
+
+         // Complete the RPC successfully
+         Finish(grpc::Status::OK);
+      });
+
+   if (!accepted)
+   {
+      LOG(ERROR) << std::format("Server is busy, GetRegions is rejected, client-id={}", geo::ExtractClientId(*context));
+      Finish(grpc::Status{grpc::StatusCode::RESOURCE_EXHAUSTED, "Server is busy"});
+   }
 }
 
 }  // namespace geo
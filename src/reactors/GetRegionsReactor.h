@@ -13,6 +13,7 @@ namespace geo
 
 class WebClient;
 class ISearchEngine;
+class Executor;
 
 // Reactor class for handling unary (non-streaming) responses for the GetRegions RPC.
 // This class processes a single request and returns region data matching the query.
@@ -24,8 +25,9 @@ public:
    // @param request: The incoming RegionsRequest containing search parameters.
    // @param response: The RegionsResponse to be populated with results.
    // @param searchEngine: Reference to the search engine used to find regions.
+   // @param executor: Executor which runs the search, so the gRPC callback thread is not blocked.
    GetRegionsReactor(grpc::CallbackServerContext* context, const geoproto::RegionsRequest& request,
-      geoproto::RegionsResponse& response, ISearchEngine& searchEngine);
+      geoproto::RegionsResponse& response, ISearchEngine& searchEngine, Executor& executor);
 
 private:
    // Called when the RPC is completed. Logs completion and cleans up the reactor.
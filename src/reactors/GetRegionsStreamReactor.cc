@@ -0,0 +1,193 @@
+#include "GetRegionsStreamReactor.h"
+
+#include "../utils/Executor.h"
+#include "../utils/grpcUtils.h"
+#include "RequestValidators.h"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+
+namespace
+{
+
+using namespace geo;
+
+// Converts protocol buffer preferences to search engine preferences
+ISearchEngine::RegionPreferences toRegionPreferences(const geoproto::RegionsRequest& request)
+{
+   ISearchEngine::RegionPreferences::Properties props = {
+      request.prefs().properties().begin(), request.prefs().properties().end()};
+   return {request.prefs().mask(), std::move(props)};
+}
+
+// Splits the requested square box into tiles and orders them by distance from the center,
+// so regions closest to the requested position are streamed first.
+std::vector<BoundingBox> createTiles(
+   const geoproto::RegionsRequest& request, const GetRegionsStreamReactor::Limits& limits)
+{
+   const double latitude = request.position().latitude();
+   const double longitude = request.position().longitude();
+   auto tiles = CreateBoundingBoxes(
+      latitude, longitude, request.distance_km() * 1000, limits.maxBoxWidth, limits.maxBoxHeight);
+
+   auto distanceToCenter = [latitude, longitude](const BoundingBox& box)
+   {
+      const double dLat = (box[0] + box[2]) / 2 - latitude;
+      const double dLon = (box[1] + box[3]) / 2 - longitude;
+      return dLat * dLat + dLon * dLon;
+   };
+   std::stable_sort(tiles.begin(), tiles.end(),
+      [&distanceToCenter](const BoundingBox& a, const BoundingBox& b)
+      {
+         return distanceToCenter(a) < distanceToCenter(b);
+      });
+   return tiles;
+}
+
+}  // namespace
+
+namespace geo
+{
+
+GetRegionsStreamReactor::GetRegionsStreamReactor(grpc::CallbackServerContext* context,
+   const geoproto::RegionsRequest& request, ISearchEngine& searchEngine, Executor& executor, const Limits& limits)
+   : m_executor(executor)
+   , m_maxOngoingTiles(std::max<std::size_t>(limits.maxOngoingTiles, 1))
+   , m_prefs(toRegionPreferences(request))
+   , m_handler(searchEngine.StartFindRegions())
+{
+   if (auto errorString = ValidateRegionsRequest(request))
+   {
+      LOG(ERROR) << std::format("Bad request, client-id={}", geo::ExtractClientId(*context));
+      m_finished = true;
+      Finish(grpc::Status{grpc::StatusCode::INVALID_ARGUMENT, errorString});
+      return;
+   }
+
+   m_tiles = createTiles(request, limits);
+   LOG(INFO) << std::format(
+      "GetRegionsStream() searches {} tiles, up to {} at once", m_tiles.size(), m_maxOngoingTiles);
+
+   proceed();
+}
+
+void GetRegionsStreamReactor::OnWriteDone(bool ok)
+{
+   {
+      std::lock_guard lock(m_mutex);
+      m_writing.reset();
+      if (!ok)
+      {
+         LOG(ERROR) << "GetRegionsStream() write failed";
+         m_cancelled = true;
+      }
+   }
+   proceed();
+}
+
+void GetRegionsStreamReactor::OnCancel()
+{
+   LOG(ERROR) << "GetRegionsStream() RPC cancelled";
+   {
+      std::lock_guard lock(m_mutex);
+      m_cancelled = true;
+   }
+   proceed();
+}
+
+void GetRegionsStreamReactor::onTileDone(GeoProtoPlaces regions)
+{
+   {
+      std::lock_guard lock(m_mutex);
+      --m_ongoingTiles;
+      if (!regions.empty() && !m_cancelled)
+      {
+         geoproto::RegionsResponse response;
+         *response.mutable_regions() = {
+            std::make_move_iterator(regions.begin()), std::make_move_iterator(regions.end())};
+         m_pending.emplace_back(std::move(response));
+      }
+   }
+   proceed();
+}
+
+void GetRegionsStreamReactor::proceed(std::size_t rejectedTiles)
+{
+   std::vector<BoundingBox> tilesToStart;
+   const geoproto::RegionsResponse* responseToWrite = nullptr;
+   std::optional<grpc::Status> finishStatus;
+   {
+      std::lock_guard lock(m_mutex);
+
+      // Rejected tiles are accounted here and not right after rejection, so no other thread can finish the RPC
+      // (and delete the reactor) before this call does.
+      if (rejectedTiles)
+      {
+         m_ongoingTiles -= rejectedTiles;
+         m_error = grpc::Status{grpc::StatusCode::RESOURCE_EXHAUSTED, "Server is busy"};
+      }
+
+      if (m_finished)
+         return;
+
+      // Responses waiting to be written count against the limit too, this is what makes a slow client
+      // slow down the search.
+      while (!m_cancelled && !m_error && m_nextTile < m_tiles.size() &&
+             m_ongoingTiles + m_pending.size() < m_maxOngoingTiles)
+      {
+         tilesToStart.push_back(m_tiles[m_nextTile++]);
+         ++m_ongoingTiles;
+      }
+
+      const bool noMoreResponses = m_cancelled || (m_pending.empty() && (m_error || m_nextTile == m_tiles.size()));
+      if (!m_writing && !m_cancelled && !m_pending.empty())
+      {
+         m_writing = std::move(m_pending.front());
+         m_pending.pop_front();
+         responseToWrite = &*m_writing;
+      }
+      else if (!m_writing && m_ongoingTiles == 0 && noMoreResponses)
+      {
+         m_finished = true;
+         finishStatus = m_cancelled ? grpc::Status::CANCELLED : m_error.value_or(grpc::Status::OK);
+      }
+   }
+
+   std::size_t rejected = 0;
+   for (const auto& tile : tilesToStart)
+   {
+      const bool accepted = m_executor.TrySubmit(
+         [this, tile]
+         {
+            GeoProtoPlaces regions;
+            try
+            {
+               regions = m_handler(tile, m_prefs);
+            }
+            catch (const std::exception& e)
+            {
+               LOG(ERROR) << std::format("GetRegionsStream() tile search failed: {}", e.what());
+            }
+            onTileDone(std::move(regions));
+         });
+
+      if (!accepted)
+         ++rejected;
+   }
+
+   // Only one of these actions is taken, and it is the last one, as the reactor may be deleted right after it.
+   if (responseToWrite)
+   {
+      // The RPC cannot be finished while a write is pending, so rejected tiles can be accounted before the write.
+      if (rejected)
+         proceed(rejected);
+      StartWrite(responseToWrite);
+   }
+   else if (finishStatus)
+      Finish(*finishStatus);
+   else if (rejected)
+      proceed(rejected);
+}
+
+}  // namespace geo
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../search/SearchEngineItf.h"
+#include "../utils/GeoUtils.h"
+#include "geo.grpc.pb.h"
+
+#include <absl/log/log.h>
+#include <grpc/grpc.h>
+#include <grpcpp/support/server_callback.h>
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace geo
+{
+
+class Executor;
+
+// Reactor class for handling server-streaming responses for the GetRegionsStream RPC.
+// The requested square box is split into tiles which are searched concurrently on the executor.
+// Regions of every tile are written to the client as soon as the tile is processed.
+// The number of tiles being searched plus the number of responses waiting to be written is limited,
+// so a slow client slows down the search instead of making the server buffer results without limit.
+class GetRegionsStreamReactor : public grpc::ServerWriteReactor<geoproto::RegionsResponse>
+{
+public:
+   // Tiling and concurrency settings of the stream.
+   struct Limits
+   {
+      std::uint32_t maxBoxWidth = 0;    // Maximum width of a tile in degrees
+      std::uint32_t maxBoxHeight = 0;   // Maximum height of a tile in degrees
+      std::size_t maxOngoingTiles = 1;  // Maximum number of tiles being searched or waiting to be written
+   };
+
+public:
+   // Constructor for the GetRegionsStreamReactor. Starts the search right away.
+   // @param context: Server context.
+   // @param request: The incoming RegionsRequest containing search parameters.
+   // @param searchEngine: Reference to the search engine used to find regions.
+   // @param executor: Executor which runs tile searches, so the gRPC callback thread is not blocked.
+   // @param limits: Tiling and concurrency settings.
+   GetRegionsStreamReactor(grpc::CallbackServerContext* context, const geoproto::RegionsRequest& request,
+      ISearchEngine& searchEngine, Executor& executor, const Limits& limits);
+
+private:
+   // Called when a write is completed. Starts the next write and allows more tiles to be searched.
+   void OnWriteDone(bool ok) override;
+
+   // Called when the RPC is completed. Logs the completion and cleans up the reactor.
+   void OnDone() override
+   {
+      LOG(INFO) << "GetRegionsStream() RPC completed";
+      delete this;
+   }
+
+   // Called when the RPC is cancelled. Stops searching new tiles.
+   void OnCancel() override;
+
+   // Called on a worker thread when a tile search is finished.
+   void onTileDone(GeoProtoPlaces regions);
+
+   // Submits tiles to the executor while limits allow, then starts a write or finishes the RPC if possible.
+   // Must be called without m_mutex held, as it may call gRPC methods.
+   // @param rejectedTiles: Number of tiles the executor rejected during the previous call.
+   void proceed(std::size_t rejectedTiles = 0);
+
+private:
+   Executor& m_executor;                                     // Executor which runs tile searches
+   const std::size_t m_maxOngoingTiles;                      // See Limits::maxOngoingTiles
+   const ISearchEngine::RegionPreferences m_prefs;           // Search preferences from the request
+   const ISearchEngine::IncrementalSearchHandler m_handler;  // Handler shared by all tiles to deduplicate regions
+
+   std::mutex m_mutex;                                   // Protects all fields below
+   std::vector<BoundingBox> m_tiles;                     // Tiles to search, nearest to the center first
+   std::size_t m_nextTile = 0;                           // Index of the next tile to search
+   std::size_t m_ongoingTiles = 0;                       // Number of tiles being searched
+   std::deque<geoproto::RegionsResponse> m_pending;      // Responses waiting to be written
+   std::optional<geoproto::RegionsResponse> m_writing;   // Response being written, must be alive until OnWriteDone
+   std::optional<grpc::Status> m_error;                  // Error to finish the RPC with
+   bool m_cancelled = false;                             // Set when the RPC is cancelled or a write fails
+   bool m_finished = false;                              // Set when Finish() is called
+};
+
+}  // namespace geo
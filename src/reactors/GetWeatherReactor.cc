@@ -0,0 +1,75 @@
+#include "GetWeatherReactor.h"
+
+#include "../search/OpenMeteoApiUtils.h"
+#include "../search/SearchEngineItf.h"
+#include "../utils/Executor.h"
+#include "../utils/TimeUtils.h"
+#include "../utils/grpcUtils.h"
+#include "RequestValidators.h"
+
+#include <absl/log/log.h>
+
+#include <chrono>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace geo
+{
+
+GetWeatherReactor::GetWeatherReactor(grpc::CallbackServerContext* context, const geoproto::WeatherRequest& request,
+   geoproto::WeatherResponse& response, ISearchEngine& searchEngine, Executor& executor)
+{
+   if (auto errorString = ValidateWeatherRequest(request))
+   {
+      LOG(ERROR) << std::format("Bad request, client-id={}", geo::ExtractClientId(*context));
+      Finish(grpc::Status{grpc::StatusCode::INVALID_ARGUMENT, errorString});
+      return;
+   }
+
+   // Loading takes a long time, so it is done on a worker thread and the RPC is finished from there.
+   // Request and response stay valid until Finish() is called.
+   const bool accepted = executor.TrySubmit(
+      [this, context, &request, &response, &searchEngine]
+      {
+         if (context->IsCancelled())
+         {
+            Finish(grpc::Status::CANCELLED);
+            return;
+         }
+
+         // Requested dates are mapped to the same dates of N most recent years.
+         const DateRange dateRange{TimePointToDate(TimestampToTimePoint(request.from_date())),
+            TimePointToDate(TimestampToTimePoint(request.to_date()))};
+         const auto historicalRanges =
+            openmeteo::CollectHistoricalRanges(dateRange, std::chrono::system_clock::now(), request.num_years());
+
+         std::vector<std::pair<double, double>> locations;
+         locations.reserve(request.locations_size());
+         for (const auto& location : request.locations())
+            locations.emplace_back(location.latitude(), location.longitude());
+
+         // Populate the response with aggregated weather, one entry per requested location.
+         for (const auto& aggregate : searchEngine.GetHistoricalWeather(locations, historicalRanges))
+         {
+            geoproto::Weather& weather = *response.add_historical_weather();
+            if (!aggregate.numDays)
+               continue;
+
+            weather.set_min_temperature(aggregate.temperatureMin);
+            weather.set_max_temperature(aggregate.temperatureMax);
+            weather.set_average_temperature(aggregate.GetAverage());
+         }
+
+         // Finish the RPC with a success status.
+         Finish(grpc::Status::OK);
+      });
+
+   if (!accepted)
+   {
+      LOG(ERROR) << std::format("Server is busy, GetWeather is rejected, client-id={}", geo::ExtractClientId(*context));
+      Finish(grpc::Status{grpc::StatusCode::RESOURCE_EXHAUSTED, "Server is busy"});
+   }
+}
+
+}  // namespace geo
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "geo.grpc.pb.h"
+
+#include <absl/log/log.h>
+#include <grpc/grpc.h>
+#include <grpcpp/support/server_callback.h>
+
+#include <format>
+
+namespace geo
+{
+
+class ISearchEngine;
+class Executor;
+
+// Reactor class for handling unary (non-streaming) responses for the GetWeather RPC.
+// This class processes a single request and returns aggregated historical weather for every requested location.
+class GetWeatherReactor : public grpc::ServerUnaryReactor
+{
+public:
+   // Constructor for the GetWeatherReactor.
+   // @param context: Server context.
+   // @param request: The incoming WeatherRequest from the client.
+   // @param response: The WeatherResponse to be populated and sent back to the client.
+   // @param searchEngine: Reference to the search engine used to load historical weather.
+   // @param executor: Executor which runs the search, so the gRPC callback thread is not blocked.
+   GetWeatherReactor(grpc::CallbackServerContext* context, const geoproto::WeatherRequest& request,
+      geoproto::WeatherResponse& response, ISearchEngine& searchEngine, Executor& executor);
+
+private:
+   // Called when the RPC is completed. Logs the completion and cleans up the reactor.
+   void OnDone() override
+   {
+      LOG(INFO) << std::format("GetWeather() RPC completed");
+      delete this;
+   }
+
+   // Called when the RPC is cancelled by the client. Logs the cancellation.
+   void OnCancel() override { LOG(ERROR) << std::format("GetWeather() RPC cancelled"); }
+};
+
+}  // namespace geo
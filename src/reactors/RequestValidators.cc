@@ -1,8 +1,12 @@
 #include "RequestValidators.h"
 
 #include "../utils/GeoUtils.h"
+#include "../utils/TimeUtils.h"
 #include "geo.pb.h"
 
+#include <chrono>
+#include <cstdint>
+
 namespace geo
 {
 
@@ -55,4 +59,43 @@ const char* ValidateRegionsRequest(const geoproto::RegionsRequest& request)
    return nullptr;
 }
 
+const char* ValidateWeatherRequest(const geoproto::WeatherRequest& request)
+{
+   static const int sc_maxLocations = 100;  // Every location costs at least one upstream request per year
+   static const std::uint32_t sc_maxYears = 50;
+   static const auto sc_maxRange = std::chrono::days{366};
+
+   if (request.locations().empty())
+      return "At least one location must be set in WeatherRequest";
+
+   if (request.locations_size() > sc_maxLocations)
+      return "Too many locations in WeatherRequest";
+
+   // Validate the latitude and longitude of every location.
+   for (const auto& location : request.locations())
+   {
+      if (!geo::IsValidLatitude(location.latitude()))
+         return "Wrong latitude in WeatherRequest";
+
+      if (!geo::IsValidLongitude(location.longitude()))
+         return "Wrong longitude in WeatherRequest";
+   }
+
+   if (!request.has_from_date() || !request.has_to_date())
+      return "Both from_date and to_date must be set in WeatherRequest";
+
+   const auto fromTime = TimestampToTimePoint(request.from_date());
+   const auto toTime = TimestampToTimePoint(request.to_date());
+   if (fromTime > toTime)
+      return "from_date must not be later than to_date";
+
+   if (toTime - fromTime > sc_maxRange)
+      return "Range of dates is too long";
+
+   if (request.num_years() > sc_maxYears)
+      return "num_years is out-of-range";
+
+   return nullptr;
+}
+
 }  // namespace geo
@@ -0,0 +1,508 @@
+#include "AdminIndex.h"
+
+#include "../utils/TextUtils.h"
+
+#include <absl/log/log.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <utility>
+
+namespace geo
+{
+
+struct AdminIndex::NameSearch
+{
+   std::vector<char32_t> query;                                 // Characters of the folded name
+   std::vector<std::uint32_t> rows;                             // Rows of the edit distance matrix by depth
+   std::uint32_t limit = 0;                                     // Maximum distance, lowered to the closest name
+   std::vector<std::pair<std::uint32_t, std::uint32_t>> found;  // Distances and indexes of found places
+};
+
+AdminIndex::AdminIndex(std::shared_ptr<const Snapshot> snapshot)
+{
+   if (!snapshot || !snapshot->IsOpen() || !open(*snapshot))
+   {
+      LOG(ERROR) << "Administrative boundary index is disabled";
+      return;
+   }
+
+   m_snapshot = std::move(snapshot);
+   const auto stats = GetStats();
+   LOG(INFO) << std::format("Administrative boundary index opened: {} places, {} rings, {} vertices, "
+                            "{} name nodes, {} regions with {} features, {} bytes",
+      stats.places, stats.rings, stats.vertices, stats.nameNodes, stats.regions, stats.features, stats.bytes);
+}
+
+std::vector<nominatim::CachedRelation> AdminIndex::FindPlaces(double latitude, double longitude) const
+{
+   std::vector<nominatim::CachedRelation> result;
+   if (!m_snapshot || m_places.empty())
+      return result;
+
+   const float pointLongitude = static_cast<float>(longitude);
+   const float pointLatitude = static_cast<float>(latitude);
+   const std::uint64_t numPlaces = m_places.size();
+
+   // Nodes are visited depth first, starting from the root, which is the last box.
+   std::vector<std::uint64_t> nodes;
+   std::uint64_t node = m_boxes.size() - 1;
+   for (;;)
+   {
+      // Children of a node are consecutive boxes up to the end of their level.
+      const std::uint64_t levelEnd = *std::upper_bound(m_levels.begin(), m_levels.end() - 1, node);
+      const std::uint64_t end = std::min<std::uint64_t>(node + m_info.nodeSize, levelEnd);
+      for (std::uint64_t i = node; i < end; ++i)
+      {
+         const auto& box = m_boxes[i];
+         if (pointLongitude < box.minLongitude || pointLongitude > box.maxLongitude ||
+             pointLatitude < box.minLatitude || pointLatitude > box.maxLatitude)
+            continue;
+
+         if (i >= numPlaces)
+            nodes.push_back(m_children[i - numPlaces]);
+         else if (containsPoint(m_places[i], pointLongitude, pointLatitude))
+            result.push_back(getPlace(static_cast<std::uint32_t>(i)));
+      }
+
+      if (nodes.empty())
+         break;
+      node = nodes.back();
+      nodes.pop_back();
+   }
+
+   std::sort(result.begin(), result.end(),
+      [](const nominatim::CachedRelation& a, const nominatim::CachedRelation& b)
+      {
+         return a.info.osmId < b.info.osmId;
+      });
+   return result;
+}
+
+std::vector<nominatim::CachedRelation> AdminIndex::FindPlacesByName(std::string_view name, std::uint32_t maxEdits) const
+{
+   std::vector<nominatim::CachedRelation> result;
+   if (!m_snapshot || m_nameNodes.empty())
+      return result;
+
+   NameSearch search;
+   const std::string folded = FoldName(name);
+   for (std::size_t position = 0; position < folded.size();)
+      search.query.push_back(DecodeUtf8(folded, position));
+   if (search.query.empty())
+      return result;
+
+   // The first row is the distance from the beginning of the name to the empty name at the root.
+   const std::size_t width = search.query.size() + 1;
+   search.limit = std::min<std::uint32_t>(maxEdits, static_cast<std::uint32_t>(search.query.size() / 4));
+   search.rows.resize(width);
+   for (std::size_t i = 0; i < width; ++i)
+      search.rows[i] = static_cast<std::uint32_t>(i);
+   findSimilarNames(0, 0, search);
+
+   // Places of names found before the limit was lowered may be farther than the closest name.
+   std::sort(search.found.begin(), search.found.end());
+   for (const auto& [distance, place] : search.found)
+   {
+      if (distance > search.found.front().first)
+         break;
+      result.push_back(getPlace(place));
+   }
+
+   std::sort(result.begin(), result.end(),
+      [](const nominatim::CachedRelation& a, const nominatim::CachedRelation& b)
+      {
+         return a.info.osmId < b.info.osmId;
+      });
+   result.erase(std::unique(result.begin(), result.end(),
+                   [](const nominatim::CachedRelation& a, const nominatim::CachedRelation& b)
+                   {
+                      return a.info.osmId == b.info.osmId;
+                   }),
+      result.end());
+   return result;
+}
+
+std::vector<nominatim::CachedRelation> AdminIndex::FindPlacesByPrefix(
+   std::string_view prefix, std::size_t maxPlaces) const
+{
+   std::vector<nominatim::CachedRelation> result;
+   const std::string folded = FoldName(prefix);
+   if (!m_snapshot || m_nameNodes.empty() || folded.empty())
+      return result;
+
+   // Descend to the node of the prefix, which may end inside of the label of the edge to the node.
+   std::uint32_t node = 0;
+   for (std::size_t position = 0; position < folded.size();)
+   {
+      const std::string_view rest = std::string_view(folded).substr(position);
+      const auto& parent = m_nameNodes[node];
+      const AdminIndexNameEdge* next = nullptr;
+      for (std::uint32_t i = parent.firstEdge; i < parent.firstEdge + parent.numEdges && !next; ++i)
+      {
+         const auto& edge = m_nameEdges[i];
+         const std::size_t length = std::min<std::size_t>(edge.labelLength, rest.size());
+         if (std::string_view(m_nameLabels.data() + edge.label, length) == rest.substr(0, length))
+            next = &edge;
+      }
+      if (!next)
+         return result;
+      position += std::min<std::size_t>(next->labelLength, rest.size());
+      node = next->node;
+   }
+
+   // Nodes below are visited breadth first, so places of shorter names come first.
+   std::vector<std::uint32_t> nodes{node};
+   std::vector<std::uint32_t> places;
+   for (std::size_t i = 0; i < nodes.size() && places.size() < maxPlaces; ++i)
+   {
+      const auto& current = m_nameNodes[nodes[i]];
+      for (std::uint32_t j = current.firstPlace; j < current.firstPlace + current.numPlaces; ++j)
+      {
+         // A place is found once, by the shortest of its names.
+         if (places.size() < maxPlaces && std::find(places.begin(), places.end(), m_namePlaces[j]) == places.end())
+            places.push_back(m_namePlaces[j]);
+      }
+      for (std::uint32_t j = current.firstEdge; j < current.firstEdge + current.numEdges; ++j)
+         nodes.push_back(m_nameEdges[j].node);
+   }
+
+   for (const auto place : places)
+      result.push_back(getPlace(place));
+   return result;
+}
+
+bool AdminIndex::CoversRegions(const BoundingBox& bbox) const
+{
+   if (!m_snapshot || m_features.empty() || m_coverage.empty() || !(bbox[0] <= bbox[2] && bbox[1] <= bbox[3]))
+      return false;
+
+   const auto getCell = [](double degrees)
+   {
+      const double cell = std::floor(std::clamp(degrees, -180.0, 180.0) * sc_adminIndexCoverageCellsPerDegree);
+      return static_cast<std::int32_t>(cell);
+   };
+
+   // Every row of cells which the box touches needs a run of covered cells which spans the box.
+   // Runs are sorted and do not overlap, so only the last run which starts before the box can span it.
+   const std::int32_t firstColumn = getCell(bbox[1]);
+   const std::int32_t endColumn = getCell(bbox[3]) + 1;
+   for (std::int32_t row = getCell(bbox[0]); row <= getCell(bbox[2]); ++row)
+   {
+      const auto run = std::upper_bound(m_coverage.begin(), m_coverage.end(), std::pair(row, firstColumn),
+         [](const std::pair<std::int32_t, std::int32_t>& cell, const AdminIndexCoverageRun& run)
+         {
+            return cell < std::pair(run.row, run.firstColumn);
+         });
+      if (run == m_coverage.begin() || std::prev(run)->row != row || std::prev(run)->endColumn < endColumn)
+         return false;
+   }
+   return true;
+}
+
+std::vector<nominatim::CachedRelation> AdminIndex::FindRegions(
+   const BoundingBox& bbox, std::uint32_t types, double minElevation) const
+{
+   std::vector<nominatim::CachedRelation> result;
+   if (!m_snapshot || m_regions.empty())
+      return result;
+
+   const float minLatitude = static_cast<float>(bbox[0]);
+   const float minLongitude = static_cast<float>(bbox[1]);
+   const float maxLatitude = static_cast<float>(bbox[2]);
+   const float maxLongitude = static_cast<float>(bbox[3]);
+
+   // Every type sets bits of the regions of its features, and the sets of all types are intersected.
+   const std::size_t numWords = (m_regions.size() + 63) / 64;
+   std::vector<std::uint64_t> regions;
+   std::vector<std::uint64_t> typeRegions(numWords);
+   for (std::uint32_t type = 0; type < sc_adminIndexFeatureTypes; ++type)
+   {
+      if (!(types & (1u << type)))
+         continue;
+
+      // Features of other types have zero elevation, which is higher than any minimum for them.
+      const float minFeatureElevation =
+         type == sc_adminIndexPeaks ? static_cast<float>(minElevation) : -std::numeric_limits<float>::infinity();
+      const auto& featureType = m_featureTypes[type];
+      std::fill(typeRegions.begin(), typeRegions.end(), 0);
+      for (std::uint32_t i = 0; i < featureType.numBlocks; ++i)
+      {
+         const auto& block = m_featureBlocks[featureType.firstBlock + i];
+         if (block.box.maxLongitude < minLongitude || block.box.minLongitude > maxLongitude ||
+             block.box.maxLatitude < minLatitude || block.box.minLatitude > maxLatitude ||
+             block.maxElevation <= minFeatureElevation)
+            continue;
+
+         // The scan of a block has no branches.
+         const std::uint32_t first = featureType.firstFeature + i * sc_adminIndexFeatureBlockSize;
+         const std::uint32_t end =
+            std::min(first + sc_adminIndexFeatureBlockSize, featureType.firstFeature + featureType.numFeatures);
+         for (std::uint32_t j = first; j < end; ++j)
+         {
+            const auto& feature = m_features[j];
+            const bool isFound = (feature.longitude >= minLongitude) & (feature.longitude <= maxLongitude) &
+                                 (feature.latitude >= minLatitude) & (feature.latitude <= maxLatitude) &
+                                 (feature.elevation > minFeatureElevation);
+            typeRegions[feature.region / 64] |= std::uint64_t{isFound} << (feature.region % 64);
+         }
+      }
+
+      if (regions.empty())
+         regions = typeRegions;
+      else
+      {
+         for (std::size_t i = 0; i < numWords; ++i)
+            regions[i] &= typeRegions[i];
+      }
+   }
+
+   for (std::size_t i = 0; i < regions.size(); ++i)
+   {
+      for (std::uint64_t word = regions[i]; word; word &= word - 1)
+         result.push_back(getPlace(m_regions[i * 64 + std::countr_zero(word)]));
+   }
+
+   std::sort(result.begin(), result.end(),
+      [](const nominatim::CachedRelation& a, const nominatim::CachedRelation& b)
+      {
+         return a.info.osmId < b.info.osmId;
+      });
+   return result;
+}
+
+AdminIndex::Stats AdminIndex::GetStats() const
+{
+   if (!m_snapshot)
+      return {};
+
+   std::uint64_t bytes = 0;
+   for (const auto& section : m_snapshot->GetSections())
+   {
+      if (std::string_view(section.name).starts_with("admin/"))
+         bytes += section.count * section.recordSize;
+   }
+   return {m_places.size(), m_rings.size(), m_longitudes.size(), m_nameNodes.size(), m_regions.size(),
+      m_features.size(), bytes};
+}
+
+std::uint32_t AdminIndex::CountCrossings(const float* longitudes, const float* latitudes, std::size_t numVertices,
+   float longitude, float latitude)
+{
+   // An edge is crossed if it spans the latitude of the point, and the point is on the west of it.
+   // The side of the point is the sign of the cross product, which is compared with the direction of the edge,
+   // instead of computing the longitude of the crossing. A point on an edge is not on the west of it
+   // in either direction, so a point on an edge shared by two places is inside of exactly one of them.
+   std::uint32_t crossings = 0;
+   for (std::size_t i = 0; i + 1 < numVertices; ++i)
+   {
+      const float x1 = longitudes[i];
+      const float y1 = latitudes[i];
+      const float x2 = longitudes[i + 1];
+      const float y2 = latitudes[i + 1];
+      const bool spans = (y1 > latitude) != (y2 > latitude);
+      const float cross = (x2 - x1) * (latitude - y1) - (longitude - x1) * (y2 - y1);
+      crossings += spans & (cross != 0) & ((cross > 0) == (y2 > y1));
+   }
+   return crossings;
+}
+
+bool AdminIndex::open(const Snapshot& snapshot)
+{
+   std::span<const AdminIndexInfo> info;
+   if (!getSection(snapshot, sz_adminIndexInfo, info) || info.size() != 1)
+   {
+      LOG(ERROR) << "Snapshot has no administrative boundary index";
+      return false;
+   }
+   m_info = info.front();
+   if (m_info.version != sc_adminIndexVersion || m_info.nodeSize < 2)
+   {
+      LOG(ERROR) << "Administrative boundary index is of another version";
+      return false;
+   }
+
+   const bool isComplete = getSection(snapshot, sz_adminIndexLevels, m_levels) &&
+                           getSection(snapshot, sz_adminIndexBoxes, m_boxes) &&
+                           getSection(snapshot, sz_adminIndexChildren, m_children) &&
+                           getSection(snapshot, sz_adminIndexPlaces, m_places) &&
+                           getSection(snapshot, sz_adminIndexRings, m_rings) &&
+                           getSection(snapshot, sz_adminIndexLongitudes, m_longitudes) &&
+                           getSection(snapshot, sz_adminIndexLatitudes, m_latitudes) &&
+                           getSection(snapshot, sz_adminIndexStrings, m_strings) &&
+                           getSection(snapshot, sz_adminIndexNameNodes, m_nameNodes) &&
+                           getSection(snapshot, sz_adminIndexNameEdges, m_nameEdges) &&
+                           getSection(snapshot, sz_adminIndexNameLabels, m_nameLabels) &&
+                           getSection(snapshot, sz_adminIndexNamePlaces, m_namePlaces) &&
+                           getSection(snapshot, sz_adminIndexRegions, m_regions) &&
+                           getSection(snapshot, sz_adminIndexFeatureTypes, m_featureTypes) &&
+                           getSection(snapshot, sz_adminIndexFeatures, m_features) &&
+                           getSection(snapshot, sz_adminIndexFeatureBlocks, m_featureBlocks) &&
+                           getSection(snapshot, sz_adminIndexCoverage, m_coverage);
+   if (!isComplete)
+   {
+      LOG(ERROR) << "Administrative boundary index is incomplete";
+      return false;
+   }
+
+   // The trees and the places are checked, so queries never read outside of the mapping.
+   // Vertices are not touched, so their pages are read on first access.
+   bool valid = !m_strings.empty() && m_strings.back() == '\0' &&
+                m_featureTypes.size() == sc_adminIndexFeatureTypes && m_longitudes.size() == m_latitudes.size() &&
+                m_children.size() + m_places.size() == m_boxes.size();
+   if (valid && !m_places.empty())
+   {
+      valid = !m_levels.empty() && m_levels.front() == m_places.size() && m_levels.back() == m_boxes.size() &&
+              std::is_sorted(m_levels.begin(), m_levels.end());
+   }
+   for (std::uint64_t i = 0; valid && i < m_children.size(); ++i)
+      valid = m_children[i] < m_places.size() + i;
+   for (std::uint64_t i = 0; valid && i < m_places.size(); ++i)
+   {
+      const auto& place = m_places[i];
+      valid = std::uint64_t{place.firstRing} + place.numRings <= m_rings.size() &&
+              std::max({place.addressType, place.name, place.nameEn, place.country, place.countryEn,
+                 place.countryCode}) < m_strings.size();
+   }
+   for (std::uint64_t i = 0; valid && i < m_rings.size(); ++i)
+      valid = std::uint64_t{m_rings[i].firstVertex} + m_rings[i].numVertices <= m_longitudes.size();
+
+   // Children of a node of the name tree are stored after it, so searches always end.
+   for (std::uint64_t i = 0; valid && i < m_nameNodes.size(); ++i)
+   {
+      const auto& node = m_nameNodes[i];
+      valid = std::uint64_t{node.firstEdge} + node.numEdges <= m_nameEdges.size() &&
+              std::uint64_t{node.firstPlace} + node.numPlaces <= m_namePlaces.size();
+      for (std::uint32_t j = node.firstEdge; valid && j < node.firstEdge + node.numEdges; ++j)
+      {
+         const auto& edge = m_nameEdges[j];
+         valid = edge.labelLength && std::uint64_t{edge.label} + edge.labelLength <= m_nameLabels.size() &&
+                 edge.node > i && edge.node < m_nameNodes.size();
+      }
+   }
+   for (std::uint64_t i = 0; valid && i < m_namePlaces.size(); ++i)
+      valid = m_namePlaces[i] < m_places.size();
+
+   // Blocks of a type cover its features.
+   for (std::uint64_t i = 0; valid && i < m_featureTypes.size(); ++i)
+   {
+      const auto& type = m_featureTypes[i];
+      valid = std::uint64_t{type.firstFeature} + type.numFeatures <= m_features.size() &&
+              std::uint64_t{type.firstBlock} + type.numBlocks <= m_featureBlocks.size() &&
+              type.numBlocks == (std::uint64_t{type.numFeatures} + sc_adminIndexFeatureBlockSize - 1) /
+                                   sc_adminIndexFeatureBlockSize;
+   }
+   for (std::uint64_t i = 0; valid && i < m_features.size(); ++i)
+      valid = m_features[i].region < m_regions.size();
+   for (std::uint64_t i = 0; valid && i < m_regions.size(); ++i)
+      valid = m_regions[i] < m_places.size();
+
+   // Runs of the coverage are sorted and apart, as CoversRegions() expects.
+   for (std::uint64_t i = 0; valid && i < m_coverage.size(); ++i)
+   {
+      const auto& run = m_coverage[i];
+      const auto* previous = i ? &m_coverage[i - 1] : nullptr;
+      valid = run.firstColumn < run.endColumn &&
+              (!previous || std::pair(previous->row, previous->endColumn) < std::pair(run.row, run.firstColumn));
+   }
+
+   if (!valid)
+      LOG(ERROR) << "Administrative boundary index is damaged";
+   return valid;
+}
+
+template <typename T>
+bool AdminIndex::getSection(const Snapshot& snapshot, const char* name, std::span<const T>& records)
+{
+   const auto section = snapshot.GetSection<T>(name);
+   if (section)
+      records = *section;
+   return section.has_value();
+}
+
+bool AdminIndex::containsPoint(const AdminIndexPlace& place, float longitude, float latitude) const
+{
+   // Even-odd rule over all rings: a point in a hole crosses both the outer and the inner ring.
+   std::uint32_t crossings = 0;
+   for (std::uint32_t i = place.firstRing; i < place.firstRing + place.numRings; ++i)
+   {
+      const auto& ring = m_rings[i];
+      crossings += CountCrossings(m_longitudes.data() + ring.firstVertex, m_latitudes.data() + ring.firstVertex,
+         ring.numVertices, longitude, latitude);
+   }
+   return crossings % 2 == 1;
+}
+
+std::string_view AdminIndex::getString(std::uint32_t offset) const
+{
+   return m_strings.data() + offset;
+}
+
+nominatim::CachedRelation AdminIndex::getPlace(std::uint32_t index) const
+{
+   const auto& place = m_places[index];
+   nominatim::CachedRelation relation;
+   relation.addressType = getString(place.addressType);
+   relation.info.osmId = place.osmId;
+   relation.info.name = getString(place.name);
+   relation.info.nameEn = getString(place.nameEn);
+   relation.info.country = getString(place.country);
+   relation.info.countryEn = getString(place.countryEn);
+   relation.info.countryCode = getString(place.countryCode);
+   relation.info.latitude = place.latitude;
+   relation.info.longitude = place.longitude;
+   return relation;
+}
+
+void AdminIndex::findSimilarNames(std::uint32_t node, std::size_t depth, NameSearch& search) const
+{
+   const std::size_t length = search.query.size();
+   const std::size_t width = length + 1;
+
+   // The last value of the row is the distance between the whole name and the name which ends at the node.
+   const auto& current = m_nameNodes[node];
+   const std::uint32_t distance = search.rows[depth * width + length];
+   if (current.numPlaces && distance <= search.limit)
+   {
+      search.limit = distance;
+      for (std::uint32_t i = current.firstPlace; i < current.firstPlace + current.numPlaces; ++i)
+         search.found.emplace_back(distance, m_namePlaces[i]);
+   }
+
+   for (std::uint32_t i = current.firstEdge; i < current.firstEdge + current.numEdges; ++i)
+   {
+      const auto& edge = m_nameEdges[i];
+      const std::string_view label(m_nameLabels.data() + edge.label, edge.labelLength);
+
+      // Every character of the label adds a row of the Levenshtein matrix. Names below are skipped
+      // once all values of a row exceed the limit, as the distance never decreases along a path.
+      std::size_t childDepth = depth;
+      bool withinLimit = true;
+      for (std::size_t position = 0; position < label.size() && withinLimit;)
+      {
+         const char32_t c = DecodeUtf8(label, position);
+         ++childDepth;
+         if (search.rows.size() < (childDepth + 1) * width)
+            search.rows.resize((childDepth + 1) * width);
+
+         const std::uint32_t* previous = search.rows.data() + (childDepth - 1) * width;
+         std::uint32_t* row = search.rows.data() + childDepth * width;
+         row[0] = previous[0] + 1;
+         std::uint32_t minimum = row[0];
+         for (std::size_t j = 1; j < width; ++j)
+         {
+            row[j] = std::min({previous[j] + 1, row[j - 1] + 1, previous[j - 1] + (search.query[j - 1] != c)});
+            minimum = std::min(minimum, row[j]);
+         }
+         withinLimit = minimum <= search.limit;
+      }
+
+      if (withinLimit)
+         findSimilarNames(edge.node, childDepth, search);
+   }
+}
+
+}  // namespace geo
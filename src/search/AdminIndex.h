@@ -0,0 +1,161 @@
+#pragma once
+
+#include "../utils/GeoUtils.h"
+#include "../utils/Snapshot.h"
+#include "AdminIndexFormat.h"
+#include "NominatimApiUtils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace geo
+{
+
+// AdminIndex finds places (cities, towns, states) whose administrative boundaries contain a point, without network.
+// Boundaries are simplified polygons built from an OSM extract by the geo-snapshot tool, see AdminIndexFormat.h.
+// The index is a set of sections of a memory-mapped snapshot, so nothing is loaded at startup besides validation
+// of the place records: pages of the R-tree and of the polygons are read by the OS on first access.
+// A query descends the packed R-tree to the places whose bounding boxes contain the point, and tests the point
+// against their rings with even-odd ray casting, so holes and multipolygons need no special handling.
+// Places are also found by names in any language, which are folded with FoldName() and stored in a radix tree,
+// by exact names, names with typos, or beginnings of names.
+// Regions of admin level 4 are found by features inside of them (airports, peaks, beaches, lakes), which are
+// stored by type in blocks of points, so a search scans only blocks which intersect the box, and intersects
+// sets of regions of every type as bitmasks.
+class AdminIndex
+{
+public:
+   // Size of the index, see GetStats()
+   struct Stats
+   {
+      std::uint64_t places = 0;     // Number of places
+      std::uint64_t rings = 0;      // Number of rings of all boundaries
+      std::uint64_t vertices = 0;   // Number of vertices of all rings
+      std::uint64_t nameNodes = 0;  // Number of nodes of the name tree
+      std::uint64_t regions = 0;    // Number of regions with features
+      std::uint64_t features = 0;   // Number of points of features
+      std::uint64_t bytes = 0;      // Size of the sections of the index
+   };
+
+public:
+   // Takes and validates the sections of the index.
+   // The index is disabled (see IsOpen()) if the snapshot has no index, or it is damaged or of another version.
+   // @param snapshot Open snapshot, kept mapped while the index is alive
+   explicit AdminIndex(std::shared_ptr<const Snapshot> snapshot);
+
+   AdminIndex(const AdminIndex&) = delete;
+   AdminIndex& operator=(const AdminIndex&) = delete;
+
+   // Returns true if the index is usable
+   bool IsOpen() const { return m_snapshot != nullptr; }
+
+   // Finds places whose boundaries contain a point
+   // @param latitude Latitude of the point
+   // @param longitude Longitude of the point
+   // @return Places in ascending order of OSM IDs, as Overpass returns them
+   std::vector<nominatim::CachedRelation> FindPlaces(double latitude, double longitude) const;
+
+   // Finds places by name. Names are compared folded, and the number of edits (insertions, deletions and
+   // substitutions of characters) which turn the name into a name of a place is limited, e.g. "Muenchen" finds
+   // "München" with one edit. Only places of the closest names are returned, so exact matches hide similar names.
+   // @param name Name in any language
+   // @param maxEdits Maximum number of edits, further limited to a quarter of the number of characters of the name,
+   //    so short names match only exactly
+   // @return Places in ascending order of OSM IDs
+   std::vector<nominatim::CachedRelation> FindPlacesByName(std::string_view name, std::uint32_t maxEdits) const;
+
+   // Finds places whose folded names begin with a folded prefix, e.g. for autocompletion
+   // @param prefix Beginning of a name in any language
+   // @param maxPlaces Maximum number of places to return
+   // @return Places in order of the lengths of their names, shortest first
+   std::vector<nominatim::CachedRelation> FindPlacesByPrefix(std::string_view prefix, std::size_t maxPlaces) const;
+
+   // Checks if the extract covers the whole world, so names which FindPlacesByName() does not find exactly
+   // are of no place at all. Regional extracts miss places of the same names in other countries.
+   bool CoversWorld() const { return m_info.world != 0; }
+
+   // Checks if regions of a box can be searched with FindRegions(): the index has features, and all cells
+   // of the coverage grid which the box touches are inside of the countries of the extract, so regions outside
+   // of the extract are not missed.
+   // @param bbox Bounding box as [minLat, minLon, maxLat, maxLon]
+   bool CoversRegions(const BoundingBox& bbox) const;
+
+   // Finds regions which contain features of all given types inside of a box, as the Overpass query
+   // of SearchEngine does. A region is found if features of every type are inside of both the box and the region.
+   // @param bbox Bounding box as [minLat, minLon, maxLat, maxLon]
+   // @param types Bitmask of types of features, bit i is type i, as in RegionsRequest
+   // @param minElevation Peaks count only if they are higher, in meters
+   // @return Regions in ascending order of OSM IDs
+   std::vector<nominatim::CachedRelation> FindRegions(
+      const BoundingBox& bbox, std::uint32_t types, double minElevation) const;
+
+   // Returns the size of the index
+   Stats GetStats() const;
+
+   // Counts crossings of a ray from a point to the east with edges of a closed ring.
+   // The point is inside the ring if the number is odd. The loop has no branches and no divisions,
+   // so the compiler vectorizes it.
+   // @param longitudes Longitudes of the ring vertices, the last vertex repeats the first one
+   // @param latitudes Latitudes of the ring vertices
+   // @param numVertices Number of vertices
+   // @param longitude Longitude of the point
+   // @param latitude Latitude of the point
+   static std::uint32_t CountCrossings(const float* longitudes, const float* latitudes, std::size_t numVertices,
+      float longitude, float latitude);
+
+private:
+   // Takes the sections of the snapshot and validates their records
+   bool open(const Snapshot& snapshot);
+
+   // Takes the records of a section, or returns false if there is no such section
+   template <typename T>
+   static bool getSection(const Snapshot& snapshot, const char* name, std::span<const T>& records);
+
+   // Checks if the boundary of a place contains a point
+   bool containsPoint(const AdminIndexPlace& place, float longitude, float latitude) const;
+
+   // Returns a string of the strings section
+   std::string_view getString(std::uint32_t offset) const;
+
+   // Returns a place of the index as a Nominatim lookup result
+   nominatim::CachedRelation getPlace(std::uint32_t index) const;
+
+   // State of a search by name, see FindPlacesByName()
+   struct NameSearch;
+
+   // Visits a node of the name tree and its children while the edit distance can stay within the limit
+   // @param node Node of the name tree
+   // @param depth Number of characters of the names above the node
+   // @param search State of the search
+   void findSimilarNames(std::uint32_t node, std::size_t depth, NameSearch& search) const;
+
+private:
+   std::shared_ptr<const Snapshot> m_snapshot;  // Snapshot of the sections, nullptr if the index is disabled
+   AdminIndexInfo m_info{};                     // Parameters of the index
+
+   std::span<const std::uint64_t> m_levels;    // See sz_adminIndexLevels
+   std::span<const AdminIndexBox> m_boxes;     // See sz_adminIndexBoxes
+   std::span<const std::uint32_t> m_children;  // See sz_adminIndexChildren
+   std::span<const AdminIndexPlace> m_places;  // See sz_adminIndexPlaces
+   std::span<const AdminIndexRing> m_rings;    // See sz_adminIndexRings
+   std::span<const float> m_longitudes;        // See sz_adminIndexLongitudes
+   std::span<const float> m_latitudes;         // See sz_adminIndexLatitudes
+   std::span<const char> m_strings;            // See sz_adminIndexStrings
+
+   std::span<const AdminIndexNameNode> m_nameNodes;  // See sz_adminIndexNameNodes
+   std::span<const AdminIndexNameEdge> m_nameEdges;  // See sz_adminIndexNameEdges
+   std::span<const char> m_nameLabels;               // See sz_adminIndexNameLabels
+   std::span<const std::uint32_t> m_namePlaces;      // See sz_adminIndexNamePlaces
+
+   std::span<const std::uint32_t> m_regions;                 // See sz_adminIndexRegions
+   std::span<const AdminIndexFeatureType> m_featureTypes;    // See sz_adminIndexFeatureTypes
+   std::span<const AdminIndexFeature> m_features;            // See sz_adminIndexFeatures
+   std::span<const AdminIndexFeatureBlock> m_featureBlocks;  // See sz_adminIndexFeatureBlocks
+   std::span<const AdminIndexCoverageRun> m_coverage;        // See sz_adminIndexCoverage
+};
+
+}  // namespace geo
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+
+namespace geo
+{
+
+// Layout of the administrative boundary index, written by the geo-snapshot tool and used by AdminIndex.
+// The index is a set of sections of a snapshot (see SnapshotFormat.h), arrays of fixed-size records
+// which are used in place without parsing. Numbers are stored in the byte order of the host.
+
+inline constexpr std::uint32_t sc_adminIndexVersion = 6;                 // Changed on any change of the layout
+inline constexpr std::uint32_t sc_adminIndexNodeSize = 16;               // Maximum number of children of a node
+inline constexpr std::uint32_t sc_adminIndexFeatureBlockSize = 64;       // Number of features of a block
+inline constexpr std::int32_t sc_adminIndexCoverageCellsPerDegree = 10;  // Cells of the coverage grid per degree
+
+// Types of features, type i is bit i of RegionsRequest masks
+inline constexpr std::uint32_t sc_adminIndexAirports = 0;      // International airports
+inline constexpr std::uint32_t sc_adminIndexPeaks = 1;         // Peaks, the only features with elevations
+inline constexpr std::uint32_t sc_adminIndexSeaBeaches = 2;    // Sea beaches
+inline constexpr std::uint32_t sc_adminIndexSaltLakes = 3;     // Salt lakes
+inline constexpr std::uint32_t sc_adminIndexFeatureTypes = 4;  // Number of types
+
+// Sections of the index in the snapshot.
+// The R-tree is packed: its boxes are stored level by level, leaves first, and leaf i is the box of place i.
+// Children of a node are consecutive boxes of the level below, at most nodeSize of them.
+// Names of places, folded with FoldName(), are stored in a radix tree whose edges are labeled with strings,
+// so chains of nodes with a single child are merged into one edge. Nodes are stored in depth-first order,
+// the root first, and edges split names only between characters, never inside of a UTF-8 sequence.
+// Features of all types are points which belong to regions of admin level 4. Points of a type are consecutive
+// and sorted along the Hilbert curve, and every sc_adminIndexFeatureBlockSize of them are summarized by a block,
+// so a search by a box reads only blocks which intersect it.
+// The coverage is the area of the countries of the extract on a grid of sc_adminIndexCoverageCellsPerDegree cells
+// per degree: row i and column j cover latitudes from i to i + 1 and longitudes from j to j + 1, divided by the number
+// of cells per degree. Cells entirely inside of the countries are covered, and runs of covered cells of a row
+// are sorted by rows and columns.
+inline constexpr auto sz_adminIndexInfo = "admin/info";                    // AdminIndexInfo, one record
+inline constexpr auto sz_adminIndexLevels = "admin/levels";                // std::uint64_t, end of each level
+inline constexpr auto sz_adminIndexBoxes = "admin/boxes";                  // AdminIndexBox, boxes of the R-tree
+inline constexpr auto sz_adminIndexChildren = "admin/children";            // std::uint32_t, first child of nodes
+inline constexpr auto sz_adminIndexPlaces = "admin/places";                // AdminIndexPlace, in the order of leaves
+inline constexpr auto sz_adminIndexRings = "admin/rings";                  // AdminIndexRing
+inline constexpr auto sz_adminIndexLongitudes = "admin/longitudes";        // float, longitudes of ring vertices
+inline constexpr auto sz_adminIndexLatitudes = "admin/latitudes";          // float, latitudes of ring vertices
+inline constexpr auto sz_adminIndexStrings = "admin/strings";              // char, NUL-terminated, first one empty
+inline constexpr auto sz_adminIndexNameNodes = "admin/nameNodes";          // AdminIndexNameNode, the name tree
+inline constexpr auto sz_adminIndexNameEdges = "admin/nameEdges";          // AdminIndexNameEdge, the name tree
+inline constexpr auto sz_adminIndexNameLabels = "admin/nameLabels";        // char, labels of edges, not terminated
+inline constexpr auto sz_adminIndexNamePlaces = "admin/namePlaces";        // std::uint32_t, places of names
+inline constexpr auto sz_adminIndexRegions = "admin/regions";              // std::uint32_t, places of regions
+inline constexpr auto sz_adminIndexFeatureTypes = "admin/featureTypes";    // AdminIndexFeatureType
+inline constexpr auto sz_adminIndexFeatures = "admin/features";            // AdminIndexFeature
+inline constexpr auto sz_adminIndexFeatureBlocks = "admin/featureBlocks";  // AdminIndexFeatureBlock
+inline constexpr auto sz_adminIndexCoverage = "admin/coverage";            // AdminIndexCoverageRun
+
+// Parameters of the index
+struct AdminIndexInfo
+{
+   std::uint32_t version;   // sc_adminIndexVersion
+   std::uint32_t nodeSize;  // Maximum number of children of a node
+   std::uint32_t world;     // 1 if the extract covers the whole world, so no other places have its names
+};
+
+// Bounding box of an R-tree node
+struct AdminIndexBox
+{
+   float minLongitude;
+   float minLatitude;
+   float maxLongitude;
+   float maxLatitude;
+};
+
+// Place with a boundary, strings are offsets in the strings section
+struct AdminIndexPlace
+{
+   std::int64_t osmId;         // OSM ID of the relation
+   double latitude;            // Latitude of the center
+   double longitude;           // Longitude of the center
+   std::uint32_t firstRing;    // First ring of the boundary
+   std::uint32_t numRings;     // Number of rings of the boundary, outer and inner ones
+   std::uint32_t addressType;  // Address type as in Nominatim, e.g. "city"
+   std::uint32_t name;         // Name in the native language
+   std::uint32_t nameEn;       // Name in English
+   std::uint32_t country;      // Country name in the native language
+   std::uint32_t countryEn;    // Country name in English
+   std::uint32_t countryCode;  // ISO 3166-1 alpha-2 code of the country in lower case
+};
+
+// Closed ring of a boundary, its last vertex repeats the first one
+struct AdminIndexRing
+{
+   std::uint32_t firstVertex;  // First vertex in the longitude and latitude sections
+   std::uint32_t numVertices;  // Number of vertices, including the repeated one
+};
+
+// Node of the name tree
+struct AdminIndexNameNode
+{
+   std::uint32_t firstEdge;   // First edge to a child, edges are sorted by the first bytes of their labels
+   std::uint32_t numEdges;    // Number of children
+   std::uint32_t firstPlace;  // First place of the name which ends at the node, in the name places section
+   std::uint32_t numPlaces;   // Number of places of the name which ends at the node
+};
+
+// Edge of the name tree
+struct AdminIndexNameEdge
+{
+   std::uint32_t label;        // Offset of the label in the name labels section
+   std::uint32_t labelLength;  // Length of the label in bytes, not zero
+   std::uint32_t node;         // Child node, stored after the parent
+};
+
+// Features of a type
+struct AdminIndexFeatureType
+{
+   std::uint32_t firstFeature;  // First feature of the type
+   std::uint32_t numFeatures;   // Number of features of the type
+   std::uint32_t firstBlock;    // Block of the first feature
+   std::uint32_t numBlocks;     // Number of blocks of the type, the last one may be incomplete
+};
+
+// Point of a feature in a region. A feature is stored once for every region which it belongs to.
+struct AdminIndexFeature
+{
+   float longitude;       // Longitude of the point
+   float latitude;        // Latitude of the point
+   float elevation;       // Elevation of a peak in meters, zero for other types
+   std::uint32_t region;  // Region of the point, in the regions section
+};
+
+// Summary of consecutive features of a type
+struct AdminIndexFeatureBlock
+{
+   AdminIndexBox box;   // Bounding box of the points
+   float maxElevation;  // Maximum elevation of the features
+};
+
+// Consecutive covered cells of a row of the coverage grid, runs of a row neither overlap nor touch
+struct AdminIndexCoverageRun
+{
+   std::int32_t row;          // Row of the cells
+   std::int32_t firstColumn;  // Column of the first cell
+   std::int32_t endColumn;    // Column after the last cell
+};
+
+}  // namespace geo
@@ -0,0 +1,115 @@
+#include "ClimatologyIndex.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <limits>
+
+namespace geo
+{
+
+ClimatologyIndex::ClimatologyIndex(std::int32_t firstYear, std::uint32_t numYears)
+   : m_firstYear(firstYear)
+   , m_numYears(numYears)
+{
+}
+
+void ClimatologyIndex::Build(const DayValues& valueOf)
+{
+   const float infinity = std::numeric_limits<float>::infinity();
+
+   std::vector<double> sum(sc_numSlots, 0);
+   std::vector<std::uint32_t> count(sc_numSlots, 0);
+   std::vector<std::uint32_t> expected(sc_numSlots, 0);
+   std::vector<float> min(sc_numSlots, infinity);
+   std::vector<float> max(sc_numSlots, -infinity);
+
+   for (std::uint32_t i = 0; i < m_numYears; ++i)
+   {
+      const std::chrono::year year{m_firstYear + static_cast<int>(i)};
+      const std::chrono::sys_days first{year / std::chrono::January / 1};
+      const std::chrono::sys_days last{year / std::chrono::December / 31};
+      for (auto day = first; day <= last; day += std::chrono::days{1})
+      {
+         const Date date{day};
+         const int slot = SlotOf(date);
+         ++expected[slot];
+         if (const auto values = valueOf(date))
+         {
+            const auto [dayMin, dayMax] = *values;
+            sum[slot] += (static_cast<double>(dayMin) + dayMax) / 2;
+            ++count[slot];
+            min[slot] = std::min(min[slot], dayMin);
+            max[slot] = std::max(max[slot], dayMax);
+         }
+      }
+   }
+
+   m_sumPrefix.assign(sc_numSlots + 1, 0);
+   m_countPrefix.assign(sc_numSlots + 1, 0);
+   m_expectedPrefix.assign(sc_numSlots + 1, 0);
+   for (int slot = 0; slot < sc_numSlots; ++slot)
+   {
+      m_sumPrefix[slot + 1] = m_sumPrefix[slot] + sum[slot];
+      m_countPrefix[slot + 1] = m_countPrefix[slot] + count[slot];
+      m_expectedPrefix[slot + 1] = m_expectedPrefix[slot] + expected[slot];
+   }
+
+   // Level k is built from two halves of level k - 1.
+   m_min.assign(1, std::move(min));
+   m_max.assign(1, std::move(max));
+   for (int width = 2; width <= sc_numSlots; width *= 2)
+   {
+      const auto& prevMin = m_min.back();
+      const auto& prevMax = m_max.back();
+      std::vector<float> levelMin(sc_numSlots - width + 1);
+      std::vector<float> levelMax(sc_numSlots - width + 1);
+      for (std::size_t slot = 0; slot < levelMin.size(); ++slot)
+      {
+         levelMin[slot] = std::min(prevMin[slot], prevMin[slot + width / 2]);
+         levelMax[slot] = std::max(prevMax[slot], prevMax[slot + width / 2]);
+      }
+      m_min.push_back(std::move(levelMin));
+      m_max.push_back(std::move(levelMax));
+   }
+}
+
+std::optional<WeatherAggregate> ClimatologyIndex::Query(int firstSlot, int lastSlot) const
+{
+   if (m_sumPrefix.empty() || firstSlot < 0 || lastSlot >= sc_numSlots || firstSlot > lastSlot)
+      return std::nullopt;
+
+   const std::uint32_t count = m_countPrefix[lastSlot + 1] - m_countPrefix[firstSlot];
+   if (count != m_expectedPrefix[lastSlot + 1] - m_expectedPrefix[firstSlot])
+      return std::nullopt;
+
+   // Two overlapping blocks of the largest power of two cover the window.
+   const int level = std::bit_width(static_cast<unsigned>(lastSlot - firstSlot + 1)) - 1;
+   const int secondBlock = lastSlot - (1 << level) + 1;
+
+   WeatherAggregate aggregate;
+   aggregate.temperatureMin = std::min(m_min[level][firstSlot], m_min[level][secondBlock]);
+   aggregate.temperatureMax = std::max(m_max[level][firstSlot], m_max[level][secondBlock]);
+   aggregate.temperatureSum = m_sumPrefix[lastSlot + 1] - m_sumPrefix[firstSlot];
+   aggregate.numDays = count;
+   return aggregate;
+}
+
+std::size_t ClimatologyIndex::GetBytes() const
+{
+   std::size_t bytes = sizeof(*this) + m_sumPrefix.capacity() * sizeof(double) +
+                       (m_countPrefix.capacity() + m_expectedPrefix.capacity()) * sizeof(std::uint32_t);
+   for (std::size_t level = 0; level < m_min.size(); ++level)
+      bytes += (m_min[level].capacity() + m_max[level].capacity()) * sizeof(float);
+   return bytes;
+}
+
+int ClimatologyIndex::SlotOf(const Date& date)
+{
+   // Slots are days of a leap year, 2000 is one.
+   const Date leapDate{std::chrono::year{2000}, date.month(), date.day()};
+   const std::chrono::sys_days yearStart{std::chrono::year{2000} / std::chrono::January / 1};
+   return static_cast<int>((std::chrono::sys_days(leapDate) - yearStart).count());
+}
+
+}  // namespace geo
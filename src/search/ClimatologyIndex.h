@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../utils/TimeUtils.h"
+#include "../utils/WeatherInfo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace geo
+{
+
+// ClimatologyIndex aggregates daily weather of one location over a number of consecutive years by day of year,
+// so the N-year aggregate of any window of days is answered in constant time.
+// Days of year are slots of a leap year: slot 0 is January 1, slot 59 is February 29, slot 365 is December 31.
+// The index keeps prefix sums of average temperatures and of numbers of days, and sparse tables
+// of minimum and maximum temperatures, over slots. It also counts days which are expected in the years,
+// so a window with missing days is detected and answered from the raw series instead.
+class ClimatologyIndex
+{
+public:
+   static const int sc_numSlots = 366;
+
+   // Minimum and maximum temperatures of a day, or std::nullopt if the day has no values
+   using DayValues = std::function<std::optional<std::pair<float, float>>(const Date&)>;
+
+public:
+   // @param firstYear First year of the index
+   // @param numYears Number of consecutive years of the index
+   ClimatologyIndex(std::int32_t firstYear, std::uint32_t numYears);
+
+   // Returns the first year of the index
+   std::int32_t GetFirstYear() const { return m_firstYear; }
+
+   // Returns the number of years of the index
+   std::uint32_t GetNumYears() const { return m_numYears; }
+
+   // Rebuilds the index from daily values of its years
+   // @param valueOf Returns values of a day
+   void Build(const DayValues& valueOf);
+
+   // Aggregates a window of days of all years of the index
+   // @param firstSlot First day of the window as a slot
+   // @param lastSlot Last day of the window as a slot, not less than firstSlot
+   // @return Aggregated weather, or std::nullopt if some days of the window have no values
+   std::optional<WeatherAggregate> Query(int firstSlot, int lastSlot) const;
+
+   // Returns memory used by the index
+   std::size_t GetBytes() const;
+
+   // Returns the slot of a date
+   static int SlotOf(const Date& date);
+
+private:
+   std::int32_t m_firstYear;  // First year of the index
+   std::uint32_t m_numYears;  // Number of consecutive years of the index
+
+   std::vector<double> m_sumPrefix;              // Sums of average temperatures of slots before each slot
+   std::vector<std::uint32_t> m_countPrefix;     // Numbers of days with values in slots before each slot
+   std::vector<std::uint32_t> m_expectedPrefix;  // Numbers of days of the years in slots before each slot
+   std::vector<std::vector<float>> m_min;        // Level k holds minimums of 2^k slots starting at each slot
+   std::vector<std::vector<float>> m_max;        // Level k holds maximums of 2^k slots starting at each slot
+};
+
+}  // namespace geo
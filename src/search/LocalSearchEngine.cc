@@ -0,0 +1,133 @@
+#include "LocalSearchEngine.h"
+
+#include "NominatimApiUtils.h"
+#include "PlaceUtils.h"
+
+#include <absl/log/log.h>
+
+#include <cstdlib>
+#include <format>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+
+using namespace geo;
+
+// Converts selected cities to the protobuf format
+GeoProtoPlaces toGeoProtoCities(const nominatim::RelationInfos& infos)
+{
+   GeoProtoPlaces result;
+   for (const auto& info : infos)
+      result.emplace_back(ToGeoProtoPlace(info));
+   return result;
+}
+
+}  // namespace
+
+namespace geo
+{
+
+LocalSearchEngine::LocalSearchEngine(
+   std::unique_ptr<AdminIndex> index, std::unique_ptr<ISearchEngine> remoteEngine, std::uint32_t maxNameEdits)
+   : m_index(std::move(index))
+   , m_remoteEngine(std::move(remoteEngine))
+   , m_maxNameEdits(maxNameEdits)
+{
+}
+
+LocalSearchEngine::~LocalSearchEngine()
+{
+   LOG(INFO) << std::format("City searches by position: {} answered by the local index, {} passed to remote APIs",
+      m_localSearches.load(), m_remoteSearches.load());
+   LOG(INFO) << std::format("City searches by name: {} answered by the local index, {} passed to remote APIs",
+      m_localNameSearches.load(), m_remoteNameSearches.load());
+   LOG(INFO) << std::format("Region searches: {} boxes answered by the local index, {} passed to remote APIs",
+      m_localBoxSearches.load(), m_remoteBoxSearches.load());
+}
+
+GeoProtoPlaces LocalSearchEngine::FindCitiesByName(const std::string& name, bool includeDetails)
+{
+   // Places of the same name in different countries are all returned, as by Overpass and Nominatim.
+   // Exact matches answer only if the extract covers the whole world: a regional extract misses places
+   // of the same name elsewhere, e.g. Boston in the USA for an extract of Great Britain.
+   if (m_index->CoversWorld())
+   {
+      const auto infos = nominatim::SelectCities(m_index->FindPlacesByName(name, 0), nominatim::Match::Any);
+      if (!infos.empty())
+      {
+         ++m_localNameSearches;
+         return toGeoProtoCities(infos);
+      }
+   }
+
+   // Similar names are returned only if the remote engine finds nothing, as they may be typos of other places.
+   ++m_remoteNameSearches;
+   auto result = m_remoteEngine->FindCitiesByName(name, includeDetails);
+   if (result.empty())
+      result = toGeoProtoCities(
+         nominatim::SelectCities(m_index->FindPlacesByName(name, m_maxNameEdits), nominatim::Match::Any));
+   return result;
+}
+
+GeoProtoPlaces LocalSearchEngine::FindCitiesByPosition(double latitude, double longitude, bool includeDetails)
+{
+   // Places are selected the same way as places found by Overpass and looked up in Nominatim.
+   const auto infos = nominatim::SelectCities(m_index->FindPlaces(latitude, longitude), nominatim::Match::Best);
+   if (infos.empty())
+   {
+      ++m_remoteSearches;
+      return m_remoteEngine->FindCitiesByPosition(latitude, longitude, includeDetails);
+   }
+
+   ++m_localSearches;
+   return toGeoProtoCities(infos);
+}
+
+ISearchEngine::IncrementalSearchHandler LocalSearchEngine::StartFindRegions(
+   std::shared_ptr<ProcessedRegionIds> processed)
+{
+   // Boxes outside of the index are searched by the remote engine with the same returned ids,
+   // so regions on the border of the index are returned once.
+   return IncrementalSearchHandler(
+      [this, processed, remoteHandler = m_remoteEngine->StartFindRegions(processed)](
+         const BoundingBox& bbox, const RegionPreferences& prefs)
+      {
+         if (!m_index->CoversRegions(bbox))
+         {
+            ++m_remoteBoxSearches;
+            return remoteHandler(bbox, prefs);
+         }
+         ++m_localBoxSearches;
+
+         // Peaks of any elevation count if the minimum is not given.
+         double minElevation = -std::numeric_limits<double>::infinity();
+         if (auto it = prefs.properties.find("minPeakHeight"); it != prefs.properties.end())
+            minElevation = std::atoi(it->second.c_str());
+
+         GeoProtoPlaces result;
+         const auto regions = m_index->FindRegions(bbox, prefs.objects, minElevation);
+         std::lock_guard lock(processed->mutex);
+         for (const auto& region : regions)
+         {
+            if (processed->ids.insert(region.info.osmId).second)
+               result.emplace_back(ToGeoProtoPlace(region.info));
+         }
+         return result;
+      });
+}
+
+WeatherInfoVector LocalSearchEngine::GetWeather(double latitude, double longitude, const DateRange& dateRange)
+{
+   return m_remoteEngine->GetWeather(latitude, longitude, dateRange);
+}
+
+std::vector<WeatherAggregate> LocalSearchEngine::GetHistoricalWeather(
+   const std::vector<std::pair<double, double>>& locations, const std::vector<DateRange>& dateRanges)
+{
+   return m_remoteEngine->GetHistoricalWeather(locations, dateRanges);
+}
+
+}  // namespace geo
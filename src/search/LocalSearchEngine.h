@@ -0,0 +1,61 @@
+#pragma once
+
+#include "AdminIndex.h"
+#include "SearchEngineItf.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace geo
+{
+
+// LocalSearchEngine answers searches of cities by position and by name, and searches of regions, from a local
+// index of administrative boundaries, without network. Positions outside of the places of the index, boxes
+// outside of the index, and weather are passed to another search engine, e.g. SearchEngine which uses remote APIs.
+// Names are answered by the index only if it covers the whole world and has places of exactly the name,
+// otherwise they are passed to the other engine, and similar names of the index are returned if it finds nothing.
+class LocalSearchEngine : public ISearchEngine
+{
+public:
+   // @param index Index of administrative boundaries, must be open
+   // @param remoteEngine Search engine for searches which the index cannot answer
+   // @param maxNameEdits Maximum number of typos in names, see AdminIndex::FindPlacesByName()
+   LocalSearchEngine(
+      std::unique_ptr<AdminIndex> index, std::unique_ptr<ISearchEngine> remoteEngine, std::uint32_t maxNameEdits);
+
+   // Logs counters of searches answered by the index
+   ~LocalSearchEngine() override;
+
+   // See ISearchEngine::FindCitiesByName for documentation
+   GeoProtoPlaces FindCitiesByName(const std::string& name, bool includeDetails) override;
+
+   // See ISearchEngine::FindCitiesByPosition for documentation
+   GeoProtoPlaces FindCitiesByPosition(double latitude, double longitude, bool includeDetails) override;
+
+   // See ISearchEngine::StartFindRegions for documentation
+   using ISearchEngine::StartFindRegions;
+   IncrementalSearchHandler StartFindRegions(std::shared_ptr<ProcessedRegionIds> processed) override;
+
+   // See ISearchEngine::GetWeather for documentation
+   WeatherInfoVector GetWeather(double latitude, double longitude, const DateRange& dateRange) override;
+
+   // See ISearchEngine::GetHistoricalWeather for documentation
+   std::vector<WeatherAggregate> GetHistoricalWeather(
+      const std::vector<std::pair<double, double>>& locations, const std::vector<DateRange>& dateRanges) override;
+
+private:
+   std::unique_ptr<AdminIndex> m_index;            // Index of administrative boundaries
+   std::unique_ptr<ISearchEngine> m_remoteEngine;  // Search engine for other searches
+   const std::uint32_t m_maxNameEdits;             // See the constructor
+
+   std::atomic<std::uint64_t> m_localSearches{0};       // Searches by position answered by the index
+   std::atomic<std::uint64_t> m_remoteSearches{0};      // Searches by position passed to the remote engine
+   std::atomic<std::uint64_t> m_localNameSearches{0};   // Searches by name answered by the index
+   std::atomic<std::uint64_t> m_remoteNameSearches{0};  // Searches by name passed to the remote engine
+   std::atomic<std::uint64_t> m_localBoxSearches{0};    // Searches of regions in boxes answered by the index
+   std::atomic<std::uint64_t> m_remoteBoxSearches{0};   // Searches of regions in boxes passed to the remote engine
+};
+
+}  // namespace geo
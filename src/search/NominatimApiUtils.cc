@@ -2,17 +2,29 @@
 
 #include "NominatimApiUtils.h"
 
-#include "../utils/JsonUtils.h"
+#include "../utils/BinaryCodec.h"
+#include "../utils/SingleFlight.h"
 #include "../utils/WebClient.h"
 
 #include <absl/log/log.h>
 #include <rapidjson/document.h>
 #include <rapidjson/rapidjson.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <charconv>
 #include <cmath>
 #include <format>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace
 {
@@ -20,10 +32,103 @@ namespace
 using namespace geo;
 using namespace geo::nominatim;
 
+// Concurrent identical city lookups share upstream transfers and one parsed result.
+SingleFlight<RelationInfos> s_citiesFlights;
+
+const std::uint8_t sc_cachedRelationVersion = 2;  // Changed on any change of the CachedRelation encoding
+
 const auto sc_chunkSize = 50u;  // Maximum number of OSM IDs to process in a single API request.
                                 // from https://nominatim.org/release-docs/latest/api/Lookup/#endpoint
 
+// A response of sc_chunkSize objects takes about 60 KB of JSON values, parsing takes about 2 KB of stack.
+const std::size_t sc_arenaValuesBytes = 128 * 1024;  // Preallocated size of the arena of JSON values
+const std::size_t sc_arenaStackBytes = 16 * 1024;    // Preallocated size of the arena of the parser stack
+const std::size_t sc_parserStackBytes = 4 * 1024;    // Initial capacity of the parser stack
+const std::size_t sc_arenaChunkBytes = 64 * 1024;    // Size of heap chunks of the arena which outgrows the buffers
+
+std::atomic<std::uint64_t> s_parsedResponses = 0;   // See ParseStats::responses
+std::atomic<std::uint64_t> s_parseAllocations = 0;  // See ParseStats::allocations
+
+// Heap allocator of JSON parsers, counts allocations for ParseStats.
+class CountingAllocator : public rapidjson::CrtAllocator
+{
+public:
+   void* Malloc(size_t size)
+   {
+      if (size)
+         ++s_parseAllocations;
+      return CrtAllocator::Malloc(size);
+   }
+
+   void* Realloc(void* originalPtr, size_t originalSize, size_t newSize)
+   {
+      if (newSize > originalSize)
+         ++s_parseAllocations;
+      return CrtAllocator::Realloc(originalPtr, originalSize, newSize);
+   }
+};
+
+using PoolAllocator = rapidjson::MemoryPoolAllocator<CountingAllocator>;
+using ArenaDocument = rapidjson::GenericDocument<rapidjson::UTF8<>, PoolAllocator, PoolAllocator>;
+
+// Arena of JSON parsers of one thread. Values and the parser stack are allocated in preallocated buffers,
+// which are reused by all responses parsed on the thread. The arena grows on the heap only if a response
+// does not fit the buffers.
+class ParseArena
+{
+public:
+   ParseArena()
+      : m_valuesBuffer(std::make_unique<char[]>(sc_arenaValuesBytes))
+      , m_stackBuffer(std::make_unique<char[]>(sc_arenaStackBytes))
+      , m_values(m_valuesBuffer.get(), sc_arenaValuesBytes, sc_arenaChunkBytes, &m_heap)
+      , m_stack(m_stackBuffer.get(), sc_arenaStackBytes, sc_arenaChunkBytes, &m_heap)
+   {
+   }
+
+   ParseArena(const ParseArena&) = delete;
+   ParseArena& operator=(const ParseArena&) = delete;
+
+   // Returns the arena of the calling thread
+   static ParseArena& Instance()
+   {
+      thread_local ParseArena s_arena;
+      return s_arena;
+   }
+
+   // Parses JSON in place, values of the previously parsed document become invalid.
+   // @param json Null-terminated JSON, modified by parsing
+   // @param handler Handler to call with the parsed document
+   template <typename THandler>
+   void ParseInsitu(char* json, THandler handler)
+   {
+      // Memory of the previous document is released, the preallocated buffers are kept.
+      m_values.Clear();
+      m_stack.Clear();
+
+      ArenaDocument document(&m_values, sc_parserStackBytes, &m_stack);
+      document.ParseInsitu(json);
+      handler(document);
+   }
+
+private:
+   CountingAllocator m_heap;                // Allocator of chunks which do not fit the buffers
+   std::unique_ptr<char[]> m_valuesBuffer;  // Preallocated memory of JSON values
+   std::unique_ptr<char[]> m_stackBuffer;   // Preallocated memory of the parser stack
+   PoolAllocator m_values;                  // Allocator of JSON values
+   PoolAllocator m_stack;                   // Allocator of the parser stack
+};
+
+std::atomic<std::uint64_t> s_lookups = 0;          // See LookupStats::lookups
+std::atomic<std::uint64_t> s_lookupRequests = 0;   // See LookupStats::requests
+std::atomic<std::uint64_t> s_englishRequests = 0;  // See LookupStats::englishRequests
+
+// English names of countries by country codes, learned from English lookups.
+// Country names are not in "namedetails" of a relation, so they are requested in English once per country.
+std::mutex s_countryNamesEnMutex;
+std::unordered_map<std::string, std::string> s_countryNamesEn;
+
 // Formats a request string for the Nominatim API lookup endpoint.
+// Names of the objects in all languages ("namedetails") are requested too.
 // @param itBegin: Iterator to the start of the OSM IDs list.
 // @param itEnd: Iterator to the end of the OSM IDs list.
 // @param language: Optional language parameter for the request.
@@ -31,7 +136,7 @@ const auto sc_chunkSize = 50u;  // Maximum number of OSM IDs to process in a sin
 std::string formatRelationLookupRequest(
    const OsmIds::const_iterator& itBegin, const OsmIds::const_iterator& itEnd, const char* language = nullptr)
 {
-   std::string request = "format=json&osm_ids=";
+   std::string request = "format=json&namedetails=1&osm_ids=";
    for (auto itID = itBegin; itID != itEnd; ++itID)
    {
       if (itID != itBegin)
@@ -51,19 +156,68 @@ double getDoubleFromString(const std::string_view& s)
    return result.ec == std::errc{} ? value : NAN;
 }
 
-// Converts a JSON value to a RelationInfo object.
+// Finds a member of a JSON object.
+// @param object: JSON value, may be null.
+// @param name: Name of the member.
+// @return: Value of the member, or nullptr if the value is not an object or has no such member.
+template <typename TJsonValue>
+const TJsonValue* findMember(const TJsonValue* object, std::string_view name)
+{
+   if (!object || !object->IsObject())
+      return nullptr;
+   const TJsonValue key(rapidjson::StringRef(name.data(), name.size()));
+   const auto it = object->FindMember(key);
+   return it != object->MemberEnd() ? &it->value : nullptr;
+}
+
+// Returns a view of a JSON string, which is valid while the parsed document is alive.
+// @param value: JSON value, may be null.
+// @return: The string, or empty string if the value is not a string.
+template <typename TJsonValue>
+std::string_view getStringView(const TJsonValue* value)
+{
+   return value && value->IsString() ? std::string_view(value->GetString(), value->GetStringLength()) : "";
+}
+
+// Converts a JSON value to a looked up object, strings are copied from views into the parsed document.
+// The name is taken from the address part named by "addresstype" (e.g., "city", "town", "state"),
+// the English name is "name:en" of "namedetails" if it is there.
 // @param value: JSON value representing a relation.
-// @param addressType: The type of address (e.g., "city", "town", "state").
-// @return: A RelationInfo object populated with data from the JSON value.
-template <typename TObject, typename TJsonValue>
-TObject jsonToObject(TJsonValue& value, const std::string& addressType)
-{
-   TObject result;
-   result.osmId = json::GetInt64(json::Get(value, "osm_id"));
-   result.name = json::GetString(json::Get(value, "address", addressType.c_str()));
-   result.country = json::GetString(json::Get(value, "address", "country"));
-   result.latitude = getDoubleFromString(json::GetString(json::Get(value, "lat")));
-   result.longitude = getDoubleFromString(json::GetString(json::Get(value, "lon")));
+// @return: A CachedRelation object populated with data from the JSON value.
+template <typename TJsonValue>
+CachedRelation jsonToObject(const TJsonValue& value)
+{
+   const std::string_view addressType = getStringView(findMember(&value, "addresstype"));
+   const TJsonValue* address = findMember(&value, "address");
+   const TJsonValue* nameDetails = findMember(&value, "namedetails");
+   const TJsonValue* osmId = findMember(&value, "osm_id");
+
+   CachedRelation result;
+   result.addressType = addressType;
+   result.info.osmId = osmId && osmId->IsInt64() ? osmId->GetInt64() : 0;
+   result.info.name = getStringView(findMember(address, addressType));
+   result.info.nameEn = getStringView(findMember(nameDetails, "name:en"));
+   result.info.country = getStringView(findMember(address, "country"));
+   result.info.countryCode = getStringView(findMember(address, "country_code"));
+   result.info.latitude = getDoubleFromString(getStringView(findMember(&value, "lat")));
+   result.info.longitude = getDoubleFromString(getStringView(findMember(&value, "lon")));
+   return result;
+}
+
+// Converts a parsed lookup response to looked up objects.
+// @param document: Parsed JSON document.
+// @return: Objects of the response, or std::nullopt if the document is not a JSON array.
+template <typename TDocument>
+std::optional<std::vector<CachedRelation>> documentToObjects(const TDocument& document)
+{
+   ++s_parsedResponses;
+   if (document.HasParseError() || !document.IsArray())
+      return std::nullopt;
+
+   std::vector<CachedRelation> result;
+   result.reserve(document.Size());
+   for (const auto& item : document.GetArray())
+      result.emplace_back(jsonToObject(item));
    return result;
 }
 
@@ -81,108 +235,408 @@ void forEachChunk(const OsmIds& relationIds, THandler fn)
 }
 
 // Splits the list of OSM IDs into chunks, sends requests to the Nominatim API, and processes the responses.
+// Requests for all chunks are started at once, and WebClient limits how many of them are in flight.
+// Responses are parsed in the original chunk order while later chunks are still being downloaded.
+// Chunks whose request failed are skipped.
 // @param relationIds: List of OSM IDs to process.
 // @param client: WebClient instance to interact with the Nominatim API.
-// @param responseHandler: Handler function to process each API response.
+// @param language: Optional language of the responses.
+// @param responseHandler: Handler function to process each API response, called with the chunk and its objects.
 template <typename THandler>
-void splitInChunksAndParseResponses(const OsmIds& relationIds, WebClient& client, THandler responseHandler)
+void splitInChunksAndParseResponses(
+   const OsmIds& relationIds, WebClient& client, const char* language, THandler responseHandler)
 {
+   std::vector<std::pair<OsmIds::const_iterator, OsmIds::const_iterator>> chunks;
+   std::vector<std::future<std::string>> responses;
    forEachChunk(relationIds,
-      [&client, responseHandler](const auto& itBegin, const auto& itEnd)
+      [&client, language, &chunks, &responses](const auto& itBegin, const auto& itEnd)
+      {
+         ++(language ? s_englishRequests : s_lookupRequests);
+         chunks.emplace_back(itBegin, itEnd);
+         responses.emplace_back(client.GetAsync(formatRelationLookupRequest(itBegin, itEnd, language)));
+      });
+
+   for (std::size_t i = 0; i < responses.size(); ++i)
+   {
+      std::string response = responses[i].get();
+      if (response.empty())
+         continue;
+
+      auto objects = ParseLookupResponse(response);
+      if (!objects)
+         continue;
+
+      responseHandler(chunks[i].first, chunks[i].second, std::move(*objects));
+   }
+}
+
+// Returns the English name of a country learned from previous English lookups
+// @param countryCode: Code of the country.
+// @return: English name, or std::nullopt if it is not known.
+std::optional<std::string> findCountryNameEn(const std::string& countryCode)
+{
+   std::lock_guard lock(s_countryNamesEnMutex);
+   const auto it = s_countryNamesEn.find(countryCode);
+   return it != s_countryNamesEn.end() ? std::optional(it->second) : std::nullopt;
+}
+
+// Remembers the English name of a country
+// @param countryCode: Code of the country.
+// @param nameEn: English name of the country.
+void rememberCountryNameEn(const std::string& countryCode, const std::string& nameEn)
+{
+   if (countryCode.empty() || nameEn.empty())
+      return;
+   std::lock_guard lock(s_countryNamesEnMutex);
+   s_countryNamesEn.try_emplace(countryCode, nameEn);
+}
+
+// Selects relations to request in English: those without English name, and one relation of every country
+// whose English name is not known yet.
+// @param relations: Looked up relations by ids.
+// @param ids: Ids of relations to check.
+// @return: Ids to request in English.
+OsmIds selectEnglishLookupIds(const std::unordered_map<OsmId, CachedRelation>& relations, const OsmIds& ids)
+{
+   OsmIds result;
+   std::vector<std::string_view> requestedCountries;
+   for (const auto id : ids)
+   {
+      const auto& relation = relations.at(id);
+      if (relation.addressType.empty())
+         continue;
+
+      const auto& info = relation.info;
+      bool isNeeded = info.nameEn.empty();
+      if (!isNeeded && !info.country.empty() && !info.countryCode.empty())
       {
-         const std::string request = formatRelationLookupRequest(itBegin, itEnd);
-         const std::string response = client.Get(request);
-         if (response.empty())
-            return;
+         const bool isRequested = std::find(requestedCountries.begin(), requestedCountries.end(), info.countryCode) !=
+                                  requestedCountries.end();
+         isNeeded = !isRequested && !findCountryNameEn(info.countryCode);
+      }
 
-         rapidjson::Document document;
-         document.Parse(response.c_str());
+      if (isNeeded)
+      {
+         result.push_back(id);
+         if (!info.countryCode.empty())
+            requestedCountries.push_back(info.countryCode);
+      }
+   }
+   return result;
+}
 
-         responseHandler(document);
+// Looks up objects with the given OSM IDs, taking them from the cache when possible.
+// Only ids missing in the cache are requested. Results of successful requests are cached,
+// including ids Nominatim returned nothing for.
+// @param relationIds: List of OSM IDs to look up.
+// @param client: WebClient instance to interact with the Nominatim API.
+// @param cache: Optional cache of lookup results.
+// @return: Objects known to Nominatim, in the order of relationIds.
+std::vector<CachedRelation> lookupRelations(const OsmIds& relationIds, WebClient& client, RelationCache* cache)
+{
+   ++s_lookups;
+
+   std::unordered_map<OsmId, CachedRelation> relations;
+   std::unordered_set<OsmId> checkedIds;  // Ids taken from the cache or added to missingIds
+   OsmIds missingIds;
+   for (const auto id : relationIds)
+   {
+      if (!checkedIds.insert(id).second)
+         continue;
+
+      auto cached = cache ? cache->Get(id) : std::nullopt;
+      if (cached)
+         relations.emplace(id, std::move(*cached));
+      else
+         missingIds.push_back(id);
+   }
+
+   OsmIds foundIds;  // Ids of successful requests
+   splitInChunksAndParseResponses(missingIds, client, nullptr,
+      [&relations, &foundIds](const auto& itBegin, const auto& itEnd, std::vector<CachedRelation> objects)
+      {
+         for (auto& object : objects)
+         {
+            const OsmId id = object.info.osmId;
+            relations.insert_or_assign(id, std::move(object));
+         }
+
+         for (auto itID = itBegin; itID != itEnd; ++itID)
+         {
+            // Remember ids Nominatim returned nothing for, so they are not requested again.
+            auto [it, inserted] = relations.try_emplace(*itID);
+            if (inserted)
+               it->second.info.osmId = *itID;
+            foundIds.push_back(*itID);
+         }
+      });
+
+   // Names which are missing in "namedetails" are requested in English.
+   const OsmIds englishIds = selectEnglishLookupIds(relations, foundIds);
+   OsmIds translatedIds;  // Ids of successful English requests
+   splitInChunksAndParseResponses(englishIds, client, "en",
+      [&relations, &translatedIds](const auto& itBegin, const auto& itEnd, std::vector<CachedRelation> objects)
+      {
+         for (const auto& object : objects)
+         {
+            const auto it = relations.find(object.info.osmId);
+            if (it == relations.end())
+               continue;
+            auto& info = it->second.info;
+            if (info.nameEn.empty())
+               info.nameEn = object.info.name;
+            rememberCountryNameEn(info.countryCode, object.info.country);
+         }
+         translatedIds.insert(translatedIds.end(), itBegin, itEnd);
       });
+
+   for (auto& [id, relation] : relations)
+   {
+      if (relation.info.countryEn.empty() && !relation.info.countryCode.empty())
+         relation.info.countryEn = findCountryNameEn(relation.info.countryCode).value_or("");
+   }
+
+   // Relations whose English request failed are not cached, so they are requested again.
+   if (cache)
+   {
+      std::unordered_set<OsmId> untranslatedIds(englishIds.begin(), englishIds.end());
+      for (const auto id : translatedIds)
+         untranslatedIds.erase(id);
+
+      for (const auto id : foundIds)
+      {
+         if (!untranslatedIds.contains(id))
+            cache->Put(id, relations.at(id));
+      }
+   }
+
+   std::vector<CachedRelation> result;
+   for (const auto id : relationIds)
+   {
+      auto it = relations.find(id);
+      if (it == relations.end() || it->second.addressType.empty())
+         continue;
+      result.emplace_back(std::move(it->second));
+      relations.erase(it);
+   }
+
+#ifndef NDEBUG
+   LOG(INFO) << std::format("Nominatim lookup: {} relation ids, {} requested, {} requested in English",
+      relationIds.size(), missingIds.size(), englishIds.size());
+#endif
+
+   return result;
+}
+
+// Checks if two places are close, so only one of them is returned by a city search with Match::Any.
+bool areCloseCoordinates(const RelationInfo& c1, const RelationInfo& c2)
+{
+   return std::abs(c1.latitude - c2.latitude) < 1 && std::abs(c1.longitude - c2.longitude) < 1;
 }
 
+// Spatial hash of places by cells of 1x1 degree. Places close to a given one (see areCloseCoordinates())
+// are found in its cell and the adjacent cells only, instead of comparing it to all places.
+class PlaceGrid
+{
+public:
+   // Checks if any added place is close to the given one
+   bool HasClose(const RelationInfo& place) const
+   {
+      const auto cell = cellOf(place);
+      if (!cell)
+         return std::any_of(m_unhashed.begin(), m_unhashed.end(),
+            [&place](const RelationInfo& other)
+            {
+               return areCloseCoordinates(other, place);
+            });
+
+      for (std::int64_t lat = cell->first - 1; lat <= cell->first + 1; ++lat)
+      {
+         for (std::int64_t lon = cell->second - 1; lon <= cell->second + 1; ++lon)
+         {
+            const auto it = m_cells.find({lat, lon});
+            if (it == m_cells.end())
+               continue;
+            for (const auto& other : it->second)
+            {
+               if (areCloseCoordinates(other, place))
+                  return true;
+            }
+         }
+      }
+      return false;
+   }
+
+   // Adds a place
+   void Add(const RelationInfo& place)
+   {
+      if (const auto cell = cellOf(place))
+         m_cells[*cell].push_back(place);
+      else
+         m_unhashed.push_back(place);
+   }
+
+private:
+   using Cell = std::pair<std::int64_t, std::int64_t>;  // Indexes of a cell by latitude and longitude
+
+   struct CellHash
+   {
+      std::size_t operator()(const Cell& cell) const
+      {
+         return std::hash<std::int64_t>()(cell.first * 0x9E3779B97F4A7C15ull ^ cell.second);
+      }
+   };
+
+   // Returns the cell of a place, or std::nullopt if its coordinates are not finite or too large for a cell index.
+   // Such places are never close to hashed ones: NaN and infinity are not close to anything, and doubles
+   // at or above 2^53 differ from smaller ones by at least 1.
+   static std::optional<Cell> cellOf(const RelationInfo& place)
+   {
+      const double sc_maxCoordinate = 9007199254740992.0;  // 2^53
+      if (!(std::abs(place.latitude) < sc_maxCoordinate && std::abs(place.longitude) < sc_maxCoordinate))
+         return std::nullopt;
+      return Cell(static_cast<std::int64_t>(std::floor(place.latitude)),
+         static_cast<std::int64_t>(std::floor(place.longitude)));
+   }
+
+private:
+   std::unordered_map<Cell, RelationInfos, CellHash> m_cells;  // Places by cells
+   RelationInfos m_unhashed;                                    // Places without a cell, see cellOf()
+};
+
 }  // namespace
 
 namespace geo::nominatim
 {
 
-RelationInfos LookupRelationInformation(const OsmIds& relationIds, WebClient& nominatimApiClient)
+std::string CachedRelationCodec::Encode(const CachedRelation& relation)
 {
-   RelationInfos regions;
-   splitInChunksAndParseResponses(relationIds, nominatimApiClient,
-      [&regions](const rapidjson::Document& document)
+   BinaryWriter writer;
+   writer.Write(sc_cachedRelationVersion);
+   writer.Write(relation.addressType);
+   writer.Write(relation.info.osmId);
+   writer.Write(relation.info.name);
+   writer.Write(relation.info.nameEn);
+   writer.Write(relation.info.country);
+   writer.Write(relation.info.countryEn);
+   writer.Write(relation.info.countryCode);
+   writer.Write(relation.info.latitude);
+   writer.Write(relation.info.longitude);
+   return writer.Take();
+}
+
+std::optional<CachedRelation> CachedRelationCodec::Decode(std::string_view data)
+{
+   BinaryReader reader(data);
+   std::uint8_t version = 0;
+   CachedRelation relation;
+   if (!reader.Read(version) || version != sc_cachedRelationVersion || !reader.Read(relation.addressType) ||
+       !reader.Read(relation.info.osmId) || !reader.Read(relation.info.name) || !reader.Read(relation.info.nameEn) ||
+       !reader.Read(relation.info.country) || !reader.Read(relation.info.countryEn) ||
+       !reader.Read(relation.info.countryCode) || !reader.Read(relation.info.latitude) ||
+       !reader.Read(relation.info.longitude) || !reader.AtEnd())
+      return std::nullopt;
+   return relation;
+}
+
+std::optional<std::vector<CachedRelation>> ParseLookupResponse(std::string& response)
+{
+   std::optional<std::vector<CachedRelation>> result;
+   ParseArena::Instance().ParseInsitu(response.data(),
+      [&result](const ArenaDocument& document)
       {
-         RelationInfos regions;
-         for (const auto& item : document.GetArray())
-            regions.emplace_back(
-               jsonToObject<RelationInfo>(item, json::GetString(json::Get(item, "address_type")).data()));
+         result = documentToObjects(document);
       });
+   return result;
+}
+
+LookupStats GetLookupStats()
+{
+   return {s_lookups.load(), s_lookupRequests.load(), s_englishRequests.load()};
+}
+
+ParseStats GetParseStats()
+{
+   return {s_parsedResponses.load(), s_parseAllocations.load()};
+}
+
+RelationInfos LookupRelationInformation(const OsmIds& relationIds, WebClient& nominatimApiClient, RelationCache* cache)
+{
+   RelationInfos regions;
+   for (auto& relation : lookupRelations(relationIds, nominatimApiClient, cache))
+      regions.emplace_back(std::move(relation.info));
    return regions;
 }
 
-RelationInfos LookupRelationInformationForCities(const OsmIds& relationIds, Match match, WebClient& nominatimApiClient)
+std::vector<CachedRelation> LookupRelations(
+   const OsmIds& relationIds, WebClient& nominatimApiClient, RelationCache* cache)
 {
+   return lookupRelations(relationIds, nominatimApiClient, cache);
+}
+
+RelationInfos SelectCities(const std::vector<CachedRelation>& relations, Match match)
+{
+   // Order is important when CitySearch.Match.Best is used.
+   // For example, latitude=41.1172364, longitude=1.2546057 is Tarragona "city",
+   // but it is also Catalonia "state". And "city" is the best match here.
+   // However, latitude=11.5730391, longitude=104.857807 is Phnom Penh "state",
+   // and there is no "city" at this point at all.
+   //
+   // When CitySearch.Match.Any is used we need to collect all matching things.
+   // But it is worth to apply some heuristic too - if "city" is already found then
+   // "state" with same (or close) coordinates is not needed.
+   //
+   // The list is probably incomplete as there is no any documentation on this API tricks.
+   constexpr std::array<const char*, 3> sc_types = {"city", "town", "state"};
+
+   // Objects are bucketed by type in a single pass, keeping their order within a type.
+   std::array<std::vector<const RelationInfo*>, sc_types.size()> byType;
+   for (const auto& relation : relations)
+   {
+      const auto it = std::find(sc_types.begin(), sc_types.end(), std::string_view(relation.addressType));
+      if (it != sc_types.end())
+         byType[it - sc_types.begin()].push_back(&relation.info);
+   }
+
    RelationInfos cities;
-   splitInChunksAndParseResponses(relationIds, nominatimApiClient,
-      [&cities, match](const rapidjson::Document& document)
+   PlaceGrid grid;
+   for (std::size_t i = 0; i < sc_types.size(); ++i)
+   {
+      for (const auto* info : byType[i])
       {
-         auto areCloseCoordinates = [](const RelationInfo& c1, const RelationInfo& c2)
-         {
-            return std::abs(c1.latitude - c2.latitude) < 1 && std::abs(c1.longitude - c2.longitude) < 1;
-         };
-
-         // Order is important when CitySearch.Match.Best is used.
-         // For example, latitude=41.1172364, longitude=1.2546057 is Tarragona "city",
-         // but it is also Catalonia "state". And "city" is the best match here.
-         // However, latitude=11.5730391, longitude=104.857807 is Phnom Penh "state",
-         // and there is no "city" at this point at all.
-         //
-         // When CitySearch.Match.Any is used we need to collect all matching things.
-         // But it is worth to apply some heuristic too - if "city" is already found then
-         // "state" with same (or close) coordinates is not needed.
-         //
-         // The list is probably incomplete as there is no any documentation on this API tricks.
-         constexpr std::array<const char*, 3> sc_types = {"city", "town", "state"};
-
-         for (auto type : sc_types)
-         {
-            for (const auto& item : document.GetArray())
-            {
-               if (json::GetString(json::Get(item, "addresstype")) == type)
-               {
-                  auto newObject = jsonToObject<RelationInfo>(item, type);
-                  bool needAdd = true;
-                  if (match == Match::Any)
-                  {
-                     for (auto& c : cities)
-                     {
-                        if (areCloseCoordinates(c, newObject))
-                        {
-                           needAdd = false;
-                           break;
-                        }
-                     }
-                  }
-
-                  if (needAdd)
-                  {
-                     cities.emplace_back(std::move(newObject));
+         if (match == Match::Any && grid.HasClose(*info))
+            continue;
+
+         cities.push_back(*info);
+         grid.Add(*info);
 #ifndef NDEBUG
-                     LOG(INFO) << std::format("addresstype {}, osm_id {}, lat {}, lon {}", type,
-                        json::GetInt64(json::Get(item, "osm_id")), json::GetString(json::Get(item, "lat")),
-                        json::GetString(json::Get(item, "lon")));
+         LOG(INFO) << std::format("addresstype {}, osm_id {}, lat {}, lon {}", sc_types[i], info->osmId,
+            info->latitude, info->longitude);
 #endif
-                  }
-               }
-               if (match == Match::Best && !cities.empty())
-                  break;
-            }
-            if (match == Match::Best && !cities.empty())
-               break;
-         }
-      });
+         if (match == Match::Best)
+            return cities;
+      }
+   }
    return cities;
 }
 
-}  // namespace geo::nominatim
\ No newline at end of file
+RelationInfos LookupRelationInformationForCities(
+   const OsmIds& relationIds, Match match, WebClient& nominatimApiClient, RelationCache* cache)
+{
+   std::string key = std::format("{}\n{}", nominatimApiClient.GetUrl(), static_cast<int>(match));
+   for (const auto id : relationIds)
+      key += std::format(",{}", id);
+
+   return s_citiesFlights.Do(key,
+      [&relationIds, match, &nominatimApiClient, cache]
+      {
+         return SelectCities(lookupRelations(relationIds, nominatimApiClient, cache), match);
+      });
+}
+
+SingleFlightStats GetCoalescingStats()
+{
+   return s_citiesFlights.GetStats();
+}
+
+}  // namespace geo::nominatim
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "../utils/SingleFlight.h"
+#include "../utils/TieredCache.h"
+
+#include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace geo
@@ -25,34 +31,125 @@ enum Match
 // Structure to hold information about a geographic relation (e.g., city, town, state).
 struct RelationInfo
 {
-   std::int64_t osmId = 0;  // OSM ID of the relation.
-   std::string name;        // Name of the relation in the native language.
-   std::string country;     // Country name in the native language.
-   double latitude = 0;     // Latitude of the relation's center.
-   double longitude = 0;    // Longitude of the relation's center.
+   std::int64_t osmId = 0;   // OSM ID of the relation.
+   std::string name;         // Name of the relation in the native language.
+   std::string nameEn;       // Name of the relation in English.
+   std::string country;      // Country name in the native language.
+   std::string countryEn;    // Country name in English.
+   std::string countryCode;  // ISO 3166-1 alpha-2 code of the country in lower case, e.g. "gb".
+   double latitude = 0;      // Latitude of the relation's center.
+   double longitude = 0;     // Longitude of the relation's center.
 };
 
 using RelationInfos = std::vector<RelationInfo>;  // Type alias for a list of RelationInfo objects.
 
+// Result of a lookup of one OSM ID, as kept in RelationCache.
+// Relations of any "addresstype" are kept, so ids which turned out not to be cities are not requested again.
+struct CachedRelation
+{
+   std::string addressType;  // "addresstype" of the relation, empty if Nominatim returned nothing for the id.
+   RelationInfo info;        // Relation information, the name is taken from the address part named by addressType.
+};
+
+// Estimates dynamic memory used by a CachedRelation, see ShardedLruCache.
+struct CachedRelationSize
+{
+   std::size_t operator()(const CachedRelation& relation) const
+   {
+      return relation.addressType.capacity() + relation.info.name.capacity() + relation.info.nameEn.capacity() +
+             relation.info.country.capacity() + relation.info.countryEn.capacity() +
+             relation.info.countryCode.capacity();
+   }
+};
+
+// Converts a CachedRelation to bytes and back, see TieredCache.
+struct CachedRelationCodec
+{
+   static std::string Encode(const CachedRelation& relation);
+   static std::optional<CachedRelation> Decode(std::string_view data);
+};
+
+// Cache of lookup results by OSM ID, shared by all lookups of one search engine.
+using RelationCache = TieredCache<OsmId, CachedRelation, CachedRelationSize, CachedRelationCodec>;
+
+// Counters of heap allocations made by parsing of lookup responses, see GetParseStats().
+struct ParseStats
+{
+   std::uint64_t responses = 0;    // Number of parsed responses.
+   std::uint64_t allocations = 0;  // Number of heap allocations made by the JSON parser.
+};
+
+// Parses a response of the Nominatim Address Lookup API in place, so the response is modified.
+// JSON values are allocated in an arena reused by all responses parsed on the calling thread, and strings
+// are referenced in the response until they are copied to the result, so a typical response is parsed
+// without heap allocations besides the result itself.
+// @param response: The JSON response, an array of objects.
+// @return: Objects of the response, or std::nullopt if the response is not a valid JSON array.
+std::optional<std::vector<CachedRelation>> ParseLookupResponse(std::string& response);
+
+// Counters of requests to the Nominatim Address Lookup API, see GetLookupStats().
+struct LookupStats
+{
+   std::uint64_t lookups = 0;          // Number of lookups of relation information.
+   std::uint64_t requests = 0;         // Number of requests in the native language.
+   std::uint64_t englishRequests = 0;  // Number of requests in English, made for names missing in the former.
+};
+
+// Returns counters of requests to the Nominatim Address Lookup API.
+// @return: Counters of LookupRelationInformation() and LookupRelationInformationForCities() together.
+LookupStats GetLookupStats();
+
+// Returns counters of heap allocations made by parsing of lookup responses.
+// @return: Counters of ParseLookupResponse().
+ParseStats GetParseStats();
+
 // Requests the Nominatim Address Lookup API for objects with the given OSM IDs.
 // See https://nominatim.org/release-docs/latest/api/Lookup/
+// Native and English names are taken from one request with "namedetails". Only objects without "name:en",
+// or in a country whose English name is not known yet, are requested once more in English, in batches.
 // @param relationIds: List of OSM IDs to look up.
 // @param nominatimApiClient: WebClient instance to interact with the Nominatim API.
+// @param cache: Optional cache of lookup results, only ids missing in it are requested.
 // @return: A list of RelationInfo objects containing details about the requested relations.
-RelationInfos LookupRelationInformation(const OsmIds& relationIds, WebClient& nominatimApiClient);
+RelationInfos LookupRelationInformation(
+   const OsmIds& relationIds, WebClient& nominatimApiClient, RelationCache* cache = nullptr);
+
+// Requests the Nominatim Address Lookup API for objects with the given OSM IDs, like LookupRelationInformation(),
+// but keeps "addresstype" of the objects, so they can be passed to SelectCities().
+// @param relationIds: List of OSM IDs to look up.
+// @param nominatimApiClient: WebClient instance to interact with the Nominatim API.
+// @param cache: Optional cache of lookup results, only ids missing in it are requested.
+// @return: Objects known to Nominatim, in the order of relationIds.
+std::vector<CachedRelation> LookupRelations(
+   const OsmIds& relationIds, WebClient& nominatimApiClient, RelationCache* cache = nullptr);
 
 // Requests the Nominatim Address Lookup API for objects with the given OSM IDs,
 // filtering results to include only those with "addresstype" relevant for cities.
 // @param relationIds: List of OSM IDs to look up.
 // @param match: Matching strategy (Best or Any).
 // @param nominatimApiClient: WebClient instance to interact with the Nominatim API.
+// @param cache: Optional cache of lookup results, only ids missing in it are requested.
 // @return: A list of RelationInfo objects containing details about the requested cities.
-RelationInfos LookupRelationInformationForCities(const OsmIds& relationIds, Match match, WebClient& nominatimApiClient);
+RelationInfos LookupRelationInformationForCities(
+   const OsmIds& relationIds, Match match, WebClient& nominatimApiClient, RelationCache* cache = nullptr);
+
+// Selects cities among looked up objects, see LookupRelationInformationForCities().
+// With Match::Any, places close to an already selected one are skipped. Selected places are kept
+// in a spatial hash, so the selection takes linear time in the number of objects.
+// @param relations: Looked up objects.
+// @param match: Matching strategy (Best or Any).
+// @return: A list of RelationInfo objects of the selected cities.
+RelationInfos SelectCities(const std::vector<CachedRelation>& relations, Match match);
+
+// Returns counters of coalescing of identical concurrent city lookups.
+// Identical lookups in flight share upstream transfers and one parsed result.
+// @return: Coalescing counters of LookupRelationInformationForCities().
+SingleFlightStats GetCoalescingStats();
 
 }  // namespace geo::nominatim
 
 // Examples:
-// https://nominatim.openstreetmap.org/lookup?osm_ids=R146656&format=json
+// https://nominatim.openstreetmap.org/lookup?osm_ids=R146656&format=json&namedetails=1
 // Returns this:
 // [
 //   {
@@ -69,6 +166,11 @@ RelationInfos LookupRelationInformationForCities(const OsmIds& relationIds, Matc
 //     "addresstype": "city",
 //     "name": "Manchester",
 //     "display_name": "Manchester, Greater Manchester, England, United Kingdom",
+//     "namedetails": {
+//       "name": "Manchester",
+//       "name:en": "Manchester",
+//       "name:ru": "Манчестер"
+//     },
 //     "address": {
 //       "city": "Manchester",
 //       "ISO3166-2-lvl8": "GB-MAN",
@@ -87,4 +189,5 @@ RelationInfos LookupRelationInformationForCities(const OsmIds& relationIds, Matc
 //   }
 // ]
 // We expect that "addresstype" value (city in this case) is always found under "address".
-// RelationInfo.name is address.city in native language
+// RelationInfo.name is address.city in native language, RelationInfo.nameEn is namedetails."name:en".
+// English country names are not in "namedetails", they are learned from lookups with accept-language=en.
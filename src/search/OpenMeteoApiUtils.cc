@@ -5,8 +5,25 @@
 
 #include <absl/log/log.h>
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <iomanip>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
 
 namespace geo::openmeteo
 {
@@ -14,9 +31,14 @@ namespace geo::openmeteo
 namespace
 {
 
-// Formats an Open Meteo API request string based on request parameters.
+// Maximum length of a request URL, longer URLs are rejected by some servers and proxies
+const std::size_t sc_maxUrlLength = 2048;
+
+using Location = std::pair<double, double>;  // Latitude and longitude
+
+// Formats an Open Meteo API request string for a number of locations and the same range of dates.
 std::string formatHistoricalWeatherRequest(
-   double latitude, double longitude, const Date& startDate, const Date& endDate)
+   const std::vector<Location>& locations, const Date& startDate, const Date& endDate)
 {
    const char* sz_latitudeParam = "latitude";
    const char* sz_longitudeParam = "longitude";
@@ -24,24 +46,36 @@ std::string formatHistoricalWeatherRequest(
    const char* sz_endDateParam = "end_date";
    const char* sz_commonParams = "daily=temperature_2m_max,temperature_2m_min";
 
+   std::string latitudes;
+   std::string longitudes;
+   for (const auto& [latitude, longitude] : locations)
+   {
+      latitudes += std::format("{}{}", latitudes.empty() ? "" : ",", latitude);
+      longitudes += std::format("{}{}", longitudes.empty() ? "" : ",", longitude);
+   }
+
    std::string request;
-   request += std::format("{}={}", sz_latitudeParam, latitude);
-   request += std::format("&{}={}", sz_longitudeParam, longitude);
+   request += std::format("{}={}", sz_latitudeParam, latitudes);
+   request += std::format("&{}={}", sz_longitudeParam, longitudes);
    request += std::format("&{}={:%F}", sz_startDateParam, startDate);
    request += std::format("&{}={:%F}", sz_endDateParam, endDate);
    request += std::format("&{}", sz_commonParams);
    return request;
 }
 
-// Parse Open Meteo API response.
-WeatherInfoVector parseWeatherResponse(const std::string& response)
+// Parses daily values of one location. Days without values (e.g. too recent for the archive) are skipped.
+WeatherInfoVector parseDailyValues(const rapidjson::Value& value)
 {
-   rapidjson::Document document;
-   document.Parse(response.c_str());
+   if (!json::Has(value, "daily", "time") || !json::Has(value, "daily", "temperature_2m_max") ||
+       !json::Has(value, "daily", "temperature_2m_min"))
+   {
+      LOG(ERROR) << "Historical Weather response has no daily values";
+      return WeatherInfoVector{};
+   }
 
-   const auto& timeValues = json::Get(document, "daily", "time").GetArray();
-   const auto& temperatureMaxValues = json::Get(document, "daily", "temperature_2m_max").GetArray();
-   const auto& temperatureMinValues = json::Get(document, "daily", "temperature_2m_min").GetArray();
+   const auto& timeValues = json::Get(value, "daily", "time").GetArray();
+   const auto& temperatureMaxValues = json::Get(value, "daily", "temperature_2m_max").GetArray();
+   const auto& temperatureMinValues = json::Get(value, "daily", "temperature_2m_min").GetArray();
 
    const std::size_t numValues = timeValues.Size();
    if (temperatureMaxValues.Size() != numValues || temperatureMinValues.Size() != numValues)
@@ -51,11 +85,14 @@ WeatherInfoVector parseWeatherResponse(const std::string& response)
    }
 
    WeatherInfoVector result;
-   result.resize(numValues);
+   result.reserve(numValues);
 
    for (std::size_t i = 0; i < numValues; ++i)
    {
-      WeatherInfo& info = result[i];
+      if (temperatureMaxValues[i].IsNull() || temperatureMinValues[i].IsNull())
+         continue;
+
+      WeatherInfo& info = result.emplace_back();
       info.time = StringToDate(json::GetString(timeValues[i]));
       info.temperatureMax = json::GetDouble(temperatureMaxValues[i]);
       info.temperatureMin = json::GetDouble(temperatureMinValues[i]);
@@ -65,6 +102,222 @@ WeatherInfoVector parseWeatherResponse(const std::string& response)
    return result;
 }
 
+const char* sz_whitespace = " \t\r\n";  // Whitespace characters of JSON
+const char* sz_whitespaceOrColon = " \t\r\n:";
+
+// Cursor over elements of a JSON array without nested values, e.g. numbers, nulls or dates.
+class ArrayCursor
+{
+public:
+   // @param elements: Text between the brackets of the array.
+   explicit ArrayCursor(std::string_view elements)
+      : m_elements(elements)
+   {
+   }
+
+   // Returns true if there are no more elements
+   bool AtEnd() const { return m_pos >= m_elements.size(); }
+
+   // Returns the next element without surrounding whitespace, elements must not contain commas
+   std::string_view Next()
+   {
+      auto isSpace = [](char c)
+      {
+         return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+      };
+
+      const std::size_t size = m_elements.size();
+      while (m_pos < size && isSpace(m_elements[m_pos]))
+         ++m_pos;
+      const std::size_t begin = m_pos;
+      while (m_pos < size && m_elements[m_pos] != ',')
+         ++m_pos;
+      std::size_t end = m_pos;
+      while (end > begin && isSpace(m_elements[end - 1]))
+         --end;
+      ++m_pos;  // Skip the comma
+      return m_elements.substr(begin, end - begin);
+   }
+
+   // Returns the number of elements
+   std::size_t Count() const
+   {
+      return m_elements.find_first_not_of(sz_whitespace) == std::string_view::npos
+                ? 0
+                : std::count(m_elements.begin(), m_elements.end(), ',') + 1;
+   }
+
+private:
+   std::string_view m_elements;  // Text between the brackets of the array
+   std::size_t m_pos = 0;        // Position of the next element
+};
+
+// Returns the text between the brackets of an array member of a JSON object, or std::nullopt if there is none.
+std::optional<std::string_view> findArray(std::string_view object, std::string_view key)
+{
+   const std::size_t keyPos = object.find(std::format("\"{}\"", key));
+   if (keyPos == std::string_view::npos)
+      return std::nullopt;
+
+   const std::size_t begin = object.find_first_not_of(sz_whitespaceOrColon, keyPos + key.size() + 2);
+   if (begin == std::string_view::npos || object[begin] != '[')
+      return std::nullopt;
+
+   const std::size_t end = object.find(']', begin);
+   if (end == std::string_view::npos)
+      return std::nullopt;
+   return object.substr(begin + 1, end - begin - 1);
+}
+
+// Decodes a quoted "YYYY-MM-DD" date.
+std::optional<Date> parseDate(std::string_view value)
+{
+   if (value.size() != 12 || value.front() != '"' || value.back() != '"' || value[5] != '-' || value[8] != '-')
+      return std::nullopt;
+
+   auto digits = [value](std::size_t pos, std::size_t count)
+   {
+      int result = 0;
+      for (std::size_t i = pos; i < pos + count; ++i)
+      {
+         const int digit = value[i] - '0';
+         if (digit < 0 || digit > 9)
+            return -1;
+         result = result * 10 + digit;
+      }
+      return result;
+   };
+
+   const int year = digits(1, 4);
+   const int month = digits(6, 2);
+   const int day = digits(9, 2);
+   const Date date{std::chrono::year{year}, std::chrono::month(month), std::chrono::day(day)};
+   if (year < 0 || month < 0 || day < 0 || !date.ok())
+      return std::nullopt;
+   return date;
+}
+
+// Decodes a number, or a null which is returned as NaN.
+std::optional<double> parseNumber(std::string_view value)
+{
+   if (value == "null")
+      return std::numeric_limits<double>::quiet_NaN();
+
+   // Temperatures are short decimals: digits are accumulated into an integer mantissa, and a single division
+   // by an exact power of ten gives the correctly rounded value, the same as a full conversion does.
+   static const double sc_powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+      1e14, 1e15};
+   const bool negative = !value.empty() && value.front() == '-';
+   std::uint64_t mantissa = 0;
+   int numDigits = 0;
+   int numFractionDigits = -1;
+   for (std::size_t i = negative ? 1 : 0; i < value.size(); ++i)
+   {
+      const char c = value[i];
+      if (c >= '0' && c <= '9')
+      {
+         mantissa = mantissa * 10 + (c - '0');
+         ++numDigits;
+         if (numFractionDigits >= 0)
+            ++numFractionDigits;
+      }
+      else if (c == '.' && numFractionDigits < 0)
+         numFractionDigits = 0;
+      else
+      {
+         numDigits = 0;  // E.g. an exponent, left to the full conversion
+         break;
+      }
+   }
+   if (numDigits > 0 && numDigits <= 15 && numFractionDigits != 0)
+   {
+      const double result = static_cast<double>(mantissa) / sc_powersOf10[std::max(numFractionDigits, 0)];
+      return negative ? -result : result;
+   }
+
+   double result = 0;
+   const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+   if (error != std::errc{} || end != value.data() + value.size())
+      return std::nullopt;
+   return result;
+}
+
+// Parses daily values of one location from the text of its "daily" object without building a DOM.
+// Days without values are skipped like in parseDailyValues().
+std::optional<WeatherInfoVector> parseDailyValuesFast(std::string_view daily)
+{
+   const auto timeValues = findArray(daily, "time");
+   const auto temperatureMaxValues = findArray(daily, "temperature_2m_max");
+   const auto temperatureMinValues = findArray(daily, "temperature_2m_min");
+   if (!timeValues || !temperatureMaxValues || !temperatureMinValues)
+      return std::nullopt;
+
+   ArrayCursor times(*timeValues);
+   ArrayCursor maxValues(*temperatureMaxValues);
+   ArrayCursor minValues(*temperatureMinValues);
+
+   WeatherInfoVector result;
+   result.reserve(times.Count());
+   while (!times.AtEnd())
+   {
+      if (maxValues.AtEnd() || minValues.AtEnd())
+         return std::nullopt;
+
+      const auto date = parseDate(times.Next());
+      const auto temperatureMax = parseNumber(maxValues.Next());
+      const auto temperatureMin = parseNumber(minValues.Next());
+      if (!date || !temperatureMax || !temperatureMin)
+         return std::nullopt;
+
+      if (std::isnan(*temperatureMax) || std::isnan(*temperatureMin))
+         continue;
+
+      WeatherInfo& info = result.emplace_back();
+      info.time = *date;
+      info.temperatureMax = *temperatureMax;
+      info.temperatureMin = *temperatureMin;
+      info.temperatureAverage = (info.temperatureMax + info.temperatureMin) / 2.0f;
+   }
+
+   if (!maxValues.AtEnd() || !minValues.AtEnd())
+      return std::nullopt;
+   return result;
+}
+
+// Parses the fixed layout of Open Meteo daily responses without building a DOM.
+// Every location has a "daily" object which holds flat arrays only, so its end is the first closing brace.
+// Returns std::nullopt if the response does not match the expected layout.
+std::optional<std::vector<WeatherInfoVector>> parseWeatherResponseFast(
+   std::string_view response, std::size_t numLocations)
+{
+   static const std::string_view sc_dailyKey = "\"daily\"";
+
+   std::vector<WeatherInfoVector> result;
+   result.reserve(numLocations);
+   for (std::size_t pos = response.find(sc_dailyKey); pos != std::string_view::npos;
+        pos = response.find(sc_dailyKey, pos))
+   {
+      const std::size_t begin = response.find_first_not_of(sz_whitespaceOrColon, pos + sc_dailyKey.size());
+      if (begin == std::string_view::npos || response[begin] != '{')
+         return std::nullopt;
+
+      const std::size_t end = response.find('}', begin);
+      if (end == std::string_view::npos)
+         return std::nullopt;
+
+      auto weather = parseDailyValuesFast(response.substr(begin + 1, end - begin - 1));
+      if (!weather)
+         return std::nullopt;
+
+      result.emplace_back(std::move(*weather));
+      pos = end;
+   }
+
+   if (result.size() != numLocations)
+      return std::nullopt;
+   return result;
+}
+
 }  // namespace
 
 std::vector<DateRange> CollectHistoricalRanges(
@@ -98,12 +351,159 @@ std::vector<DateRange> CollectHistoricalRanges(
    return result;
 }
 
+std::vector<WeatherInfoVector> ParseWeatherResponseWithDom(const std::string& response, std::size_t numLocations)
+{
+   std::vector<WeatherInfoVector> result;
+   if (response.empty())
+   {
+      result.resize(numLocations);
+      return result;
+   }
+
+   rapidjson::Document document;
+   document.Parse(response.c_str());
+   if (document.IsArray())
+   {
+      for (const auto& value : document.GetArray())
+         result.emplace_back(parseDailyValues(value));
+   }
+   else if (document.IsObject())
+      result.emplace_back(parseDailyValues(document));
+
+   if (result.size() != numLocations)
+   {
+      LOG(ERROR) << std::format(
+         "Historical Weather response has {} locations instead of {}", result.size(), numLocations);
+      result.assign(numLocations, WeatherInfoVector{});
+   }
+   return result;
+}
+
+std::vector<WeatherInfoVector> ParseWeatherResponse(const std::string& response, std::size_t numLocations)
+{
+   if (auto result = parseWeatherResponseFast(response, numLocations))
+      return std::move(*result);
+   return ParseWeatherResponseWithDom(response, numLocations);
+}
+
 WeatherInfoVector LoadHistoricalWeather(
    WebClient& client, double latitude, double longitude, const DateRange& dateRange)
 {
-   const std::string request = formatHistoricalWeatherRequest(latitude, longitude, dateRange.first, dateRange.second);
-   const std::string response = client.Get(request);
-   return !response.empty() ? parseWeatherResponse(response) : WeatherInfoVector{};
+   const std::string request =
+      formatHistoricalWeatherRequest({{latitude, longitude}}, dateRange.first, dateRange.second);
+   return ParseWeatherResponse(client.Get(request), 1).front();
+}
+
+std::vector<WeatherInfoVector> LoadHistoricalWeather(
+   WebClient& client, double latitude, double longitude, const std::vector<DateRange>& dateRanges)
+{
+   std::vector<WeatherJob> jobs;
+   jobs.reserve(dateRanges.size());
+   for (const auto& dateRange : dateRanges)
+      jobs.push_back({latitude, longitude, dateRange});
+
+   std::vector<WeatherInfoVector> result(jobs.size());
+   LoadHistoricalWeather(client, jobs, 1, nullptr,
+      [&result](std::size_t index, WeatherInfoVector weather)
+      {
+         result[index] = std::move(weather);
+      });
+   return result;
+}
+
+void LoadHistoricalWeather(WebClient& client, const std::vector<WeatherJob>& jobs,
+   std::size_t maxLocationsPerRequest, WeatherFetchPlanner* planner, const WeatherJobHandler& handler)
+{
+   // Jobs with the same range of dates are packed into batches, one request per batch.
+   std::map<DateRange, std::vector<std::size_t>> jobsByRange;
+   for (std::size_t i = 0; i < jobs.size(); ++i)
+      jobsByRange[jobs[i].dateRange].push_back(i);
+
+   std::vector<std::vector<std::size_t>> batches;  // Indexes of jobs of each batch
+   std::vector<std::string> requests;             // Request of each batch
+   for (const auto& [dateRange, rangeJobs] : jobsByRange)
+   {
+      std::vector<Location> locations;
+      std::vector<std::size_t> batch;
+      for (auto it = rangeJobs.begin(); it != rangeJobs.end(); ++it)
+      {
+         locations.emplace_back(jobs[*it].latitude, jobs[*it].longitude);
+         batch.push_back(*it);
+
+         // A batch is sent when the next location would exceed the limits.
+         const bool isLast = std::next(it) == rangeJobs.end();
+         std::string request = formatHistoricalWeatherRequest(locations, dateRange.first, dateRange.second);
+         if (!isLast && locations.size() < maxLocationsPerRequest)
+         {
+            const auto& next = jobs[*std::next(it)];
+            const std::size_t nextLength = std::format(",{},{}", next.latitude, next.longitude).size();
+            if (client.GetUrl().size() + 1 + request.size() + nextLength <= sc_maxUrlLength)
+               continue;
+         }
+
+         requests.emplace_back(std::move(request));
+         batches.emplace_back(std::move(batch));
+         locations.clear();
+         batch.clear();
+      }
+   }
+
+#ifndef NDEBUG
+   LOG(INFO) << std::format("Historical Weather loads {} locations in {} requests", jobs.size(), requests.size());
+#endif
+
+   // Responses are queued by handlers on the I/O thread, and parsed here, so the I/O thread is not blocked.
+   struct Completion
+   {
+      std::size_t batch;                                       // Index of the batch
+      std::string response;                                    // Response, empty on error
+      std::optional<std::chrono::microseconds> transferTime;  // Duration of the transfer, see GetTimedAsync()
+   };
+   struct Completions
+   {
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::deque<Completion> responses;
+   };
+   const auto completions = std::make_shared<Completions>();
+
+   for (std::size_t i = 0; i < requests.size(); ++i)
+   {
+      // Transfers are timed by WebClient, so requests waiting for a free slot do not inflate the latency,
+      // and requests coalesced with an identical one in flight are not observed twice.
+      client.GetTimedAsync(requests[i],
+         [completions, i](std::string response, std::optional<std::chrono::microseconds> transferTime)
+         {
+            std::lock_guard lock(completions->mutex);
+            completions->responses.push_back({i, std::move(response), transferTime});
+            completions->cv.notify_one();
+         });
+   }
+
+   for (std::size_t numDone = 0; numDone < requests.size(); ++numDone)
+   {
+      std::unique_lock lock(completions->mutex);
+      completions->cv.wait(lock,
+         [&completions]
+         {
+            return !completions->responses.empty();
+         });
+      auto [index, response, transferTime] = std::move(completions->responses.front());
+      completions->responses.pop_front();
+      lock.unlock();
+
+      if (planner && transferTime && !response.empty())
+      {
+         const DateRange& dateRange = jobs[batches[index].front()].dateRange;
+         const auto days = std::chrono::sys_days(dateRange.second) - std::chrono::sys_days(dateRange.first);
+         planner->Observe((days.count() + 1) * batches[index].size(), response.size(), *transferTime);
+      }
+
+      const auto& batch = batches[index];
+      auto weather = ParseWeatherResponse(response, batch.size());
+      for (std::size_t i = 0; i < batch.size(); ++i)
+         handler(batch[i], std::move(weather[i]));
+   }
 }
 
 }  // namespace geo::openmeteo
@@ -3,13 +3,27 @@
 #include "../utils/TimeUtils.h"
 #include "../utils/WeatherInfo.h"
 #include "../utils/WebClient.h"
+#include "WeatherFetchPlanner.h"
 
 #include <chrono>
+#include <cstddef>
+#include <functional>
 #include <vector>
 
 namespace geo::openmeteo
 {
 
+// Historical weather request for one location and date range
+struct WeatherJob
+{
+   double latitude = 0;
+   double longitude = 0;
+   DateRange dateRange;
+};
+
+// Handler of a finished WeatherJob, receives the index of the job and its weather (empty on error)
+using WeatherJobHandler = std::function<void(std::size_t, WeatherInfoVector)>;
+
 // Collect historical ranges for given date range for N most recent years.
 // @param dateRange: Controls "month and day" dates or resulting ranges.
 // @param latestTime: The latest time that is considered "historical".
@@ -19,6 +33,20 @@ namespace geo::openmeteo
 std::vector<DateRange> CollectHistoricalRanges(
    const DateRange& dateRange, const TimePoint& latestTime, std::uint32_t numYears);
 
+// Parses Open Meteo Historical API response for a number of locations.
+// The response is an object for a single location, and an array of objects in the order of locations otherwise.
+// The fixed layout of daily values is scanned directly, without building a DOM, and dates are decoded
+// arithmetically. Responses which do not match the layout are parsed with ParseWeatherResponseWithDom().
+// Days without values (e.g. too recent for the archive) are skipped.
+// @param response: The response of the Open Meteo Historical API, empty on error.
+// @param numLocations: Number of requested locations.
+// @return: Weather of each location, all empty if the response does not match the number of locations.
+std::vector<WeatherInfoVector> ParseWeatherResponse(const std::string& response, std::size_t numLocations);
+
+// Parses Open Meteo Historical API response with a DOM, see ParseWeatherResponse().
+// It is the reference implementation for the fast path, and is used for responses of unexpected layout.
+std::vector<WeatherInfoVector> ParseWeatherResponseWithDom(const std::string& response, std::size_t numLocations);
+
 // Requests Open Meteo Historical API for given location and date range.
 // @param client: WebClient instance to interact with the Open Meteo Historical API.
 // @param latitude: The latitude of the location.
@@ -28,4 +56,27 @@ std::vector<DateRange> CollectHistoricalRanges(
 WeatherInfoVector LoadHistoricalWeather(
    WebClient& client, double latitude, double longitude, const DateRange& dateRange);
 
+// Requests Open Meteo Historical API for given location and several date ranges at once.
+// Requests for all ranges are started concurrently, WebClient limits how many of them are in flight.
+// @param client: WebClient instance to interact with the Open Meteo Historical API.
+// @param latitude: The latitude of the location.
+// @param longitude: The longitude of the location.
+// @param dateRanges: The ranges of dates to request historical weather for.
+// @return: A list of weather information for each date range, in the order of dateRanges.
+std::vector<WeatherInfoVector> LoadHistoricalWeather(
+   WebClient& client, double latitude, double longitude, const std::vector<DateRange>& dateRanges);
+
+// Requests Open Meteo Historical API for a number of locations and date ranges at once.
+// Jobs with the same date range are packed into multi-location requests, limited by the number of locations
+// and by the length of the request URL. All requests are started concurrently, WebClient limits how many
+// of them are in flight. Responses are parsed on the calling thread in order of their arrival,
+// so results can be reduced while other requests are still in flight.
+// @param client: WebClient instance to interact with the Open Meteo Historical API.
+// @param jobs: Locations and date ranges to request.
+// @param maxLocationsPerRequest: Maximum number of locations in one request.
+// @param planner: Optional planner which learns its cost model from the finished requests.
+// @param handler: Called on the calling thread for every job as soon as its response arrives.
+void LoadHistoricalWeather(WebClient& client, const std::vector<WeatherJob>& jobs,
+   std::size_t maxLocationsPerRequest, WeatherFetchPlanner* planner, const WeatherJobHandler& handler);
+
 }  // namespace geo::openmeteo
@@ -1,72 +1,649 @@
 #include "OverpassApiUtils.h"
 
-#include "../utils/JsonUtils.h"
+#include "../utils/BinaryCodec.h"
+#include "../utils/SingleFlight.h"
 #include "../utils/WebClient.h"
 #include "ProtoTypes.h"
 
-#include <rapidjson/document.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <format>
+#include <memory>
+#include <unordered_map>
 
 namespace
 {
 
 using namespace geo;
 
-// Overpass API query format to find relations by name or English name.
+// Overpass API query format to find relations by name or English name, followed by an output statement.
 constexpr const char* sz_requestByNameFormat =  //
    "[out:json];"
    "rel[\"name\"=\"{0}\"][\"boundary\"=\"administrative\"];"
-   "out ids;";  // Return ids.
+   "{1}";
 
-// Overpass API query format to find relations by coordinates.
+// Overpass API query format to find relations by coordinates, followed by an output statement.
 constexpr const char* sz_requestByCoordinatesFormat =
    "[out:json];"
    "is_in({},{}) -> .areas;"  // Save "area" entities which contain a point with the given coordinates to .areas set.
    "("
    "rel(pivot.areas)[\"boundary\"=\"administrative\"];"
    "rel(pivot.areas)[\"place\"~\"^(city|town|state)$\"];"
-   ");"         // Save "relation" entities with administrative boundary type or with city|town|state place
-                // which define the outlines of the found "area" entities to the result set.
-   "out ids;";  // Return ids.
+   ");"  // Save "relation" entities with administrative boundary type or with city|town|state place
+         // which define the outlines of the found "area" entities to the result set.
+   "{}";
+
+// Overpass API query part which outputs ids of relations of the default set.
+constexpr const char* sz_outputRelationIds = "out ids;";
+
+// Overpass API query part which outputs details of every relation of the default set.
+// Countries are found by the nodes which represent the relation on a map, since "is_in" accepts only nodes.
+// They are converted to "country" entities with three tags instead of thousands of tags of their areas,
+// and output before their relation, see RelationDetailsExtractor.
+constexpr const char* sz_outputRelationDetails =
+   "foreach -> .r("
+   "(node(r.r:\"admin_centre\");node(r.r:\"label\"););"  // Nodes which represent the relation.
+   "is_in;"                                                 // Areas which contain the nodes.
+   "area._[\"admin_level\"=\"2\"][\"boundary\"=\"administrative\"];"
+   "convert country name=t[\"name\"],\"name:en\"=t[\"name:en\"],code=t[\"ISO3166-1:alpha2\"];"
+   "out;"
+   ".r out center tags;"  // Return the relation with its center and tags.
+   ");";
+
+const std::uint8_t sc_relationBoundsVersion = 1;  // Changed on any change of the RelationBoundsList encoding
+
+// Concurrent identical queries share one transfer and one parsed result.
+SingleFlight<overpass::RelationIdsResponse> s_relationIdsFlights;
+SingleFlight<overpass::RelationDetailsResponse> s_relationDetailsFlights;
+
+// Converts ASCII letters of a code to lower case, e.g. "GB" to "gb"
+std::string toLowerCase(std::string_view code)
+{
+   std::string result(code);
+   std::transform(result.begin(), result.end(), result.begin(),
+      [](unsigned char c)
+      {
+         return static_cast<char>(std::tolower(c));
+      });
+   return result;
+}
+
+// SAX handler which picks "type" and "id" of an entry of "elements", values of nested objects (e.g. tags) are skipped
+class ElementHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ElementHandler>
+{
+public:
+   bool StartObject() { return enter(); }
+   bool EndObject(rapidjson::SizeType) { return leave(); }
+   bool StartArray() { return enter(); }
+   bool EndArray(rapidjson::SizeType) { return leave(); }
+
+   bool Key(const char* str, rapidjson::SizeType length, bool)
+   {
+      if (m_depth == 1)
+      {
+         const std::string_view key(str, length);
+         m_field = key == "id" ? Field::Id : key == "type" ? Field::Type : Field::Other;
+      }
+      return true;
+   }
+
+   bool String(const char* str, rapidjson::SizeType length, bool)
+   {
+      if (m_depth == 1 && m_field == Field::Type)
+         m_isRelation = std::string_view(str, length) == "relation";
+      return true;
+   }
+
+   bool Int(int i) { return Int64(i); }
+   bool Uint(unsigned u) { return Int64(u); }
+   bool Uint64(std::uint64_t u) { return Int64(static_cast<std::int64_t>(u)); }
+   bool Int64(std::int64_t i)
+   {
+      if (m_depth == 1 && m_field == Field::Id)
+         m_id = i;
+      return true;
+   }
+
+   // Returns the ID of the entry if it is a relation
+   std::optional<overpass::OsmId> GetRelationId() const { return m_isRelation ? m_id : std::nullopt; }
+
+private:
+   bool enter()
+   {
+      ++m_depth;
+      return true;
+   }
+
+   bool leave()
+   {
+      --m_depth;
+      return true;
+   }
+
+private:
+   enum class Field
+   {
+      Other,
+      Id,
+      Type
+   };
+
+   int m_depth = 0;                       // Nesting level of objects and arrays
+   Field m_field = Field::Other;          // Key of the current value of the entry
+   bool m_isRelation = false;             // Whether the type of the entry is "relation"
+   std::optional<overpass::OsmId> m_id;  // ID of the entry
+};
+
+// SAX handler which picks details of a relation, or of a country derived by sz_outputRelationDetails,
+// from an entry of "elements": its type, id, center, bounds and tags which RelationDetails has fields for
+class DetailsHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, DetailsHandler>
+{
+public:
+   bool StartObject() { return enter(); }
+   bool EndObject(rapidjson::SizeType) { return leave(); }
+   bool StartArray() { return enter(); }
+   bool EndArray(rapidjson::SizeType) { return leave(); }
+
+   bool Key(const char* str, rapidjson::SizeType length, bool)
+   {
+      const std::string_view key(str, length);
+      if (m_depth == 1)
+      {
+         m_field = key == "id"       ? Field::Id
+                   : key == "type"   ? Field::Type
+                   : key == "center" ? Field::Center
+                   : key == "bounds" ? Field::Bounds
+                   : key == "tags"   ? Field::Tags
+                                     : Field::Other;
+      }
+      else if (m_depth == 2 && m_field == Field::Center)
+         m_value = key == "lat" ? Value::Latitude : key == "lon" ? Value::Longitude : Value::Other;
+      else if (m_depth == 2 && m_field == Field::Bounds)
+      {
+         m_value = key == "minlat"   ? Value::MinLatitude
+                   : key == "minlon" ? Value::MinLongitude
+                   : key == "maxlat" ? Value::MaxLatitude
+                   : key == "maxlon" ? Value::MaxLongitude
+                                     : Value::Other;
+      }
+      else if (m_depth == 2 && m_field == Field::Tags)
+      {
+         m_value = key == "name"          ? Value::Name
+                   : key == "name:en"     ? Value::NameEn
+                   : key == "place"       ? Value::Place
+                   : key == "admin_level" ? Value::AdminLevel
+                   : key == "ISO3166-2"   ? Value::RegionCode
+                   : key == "code"        ? Value::Code
+                                          : Value::Other;
+      }
+      return true;
+   }
+
+   bool String(const char* str, rapidjson::SizeType length, bool)
+   {
+      const std::string_view value(str, length);
+      if (m_depth == 1 && m_field == Field::Type)
+         m_type = value;
+      else if (m_depth == 2 && m_field == Field::Tags)
+      {
+         switch (m_value)
+         {
+         case Value::Name:
+            m_details.name = value;
+            break;
+         case Value::NameEn:
+            m_details.nameEn = value;
+            break;
+         case Value::Place:
+            m_details.place = value;
+            break;
+         case Value::AdminLevel:
+            std::from_chars(value.data(), value.data() + value.size(), m_details.adminLevel);
+            break;
+         case Value::RegionCode:
+            m_details.regionCode = value;
+            break;
+         case Value::Code:
+            m_details.countryCode = toLowerCase(value);
+            break;
+         default:
+            break;
+         }
+      }
+      return true;
+   }
+
+   bool Int(int i) { return Int64(i); }
+   bool Uint(unsigned u) { return Int64(u); }
+   bool Uint64(std::uint64_t u) { return Int64(static_cast<std::int64_t>(u)); }
+   bool Int64(std::int64_t i)
+   {
+      if (m_depth == 1 && m_field == Field::Id)
+         m_details.id = i;
+      else
+         Double(static_cast<double>(i));
+      return true;
+   }
+
+   bool Double(double d)
+   {
+      if (m_depth != 2)
+         return true;
+
+      if (m_field == Field::Center && m_value == Value::Latitude)
+      {
+         m_details.latitude = d;
+         m_hasLatitude = true;
+      }
+      else if (m_field == Field::Center && m_value == Value::Longitude)
+      {
+         m_details.longitude = d;
+         m_hasLongitude = true;
+      }
+      else if (m_field == Field::Bounds && m_value >= Value::MinLatitude && m_value <= Value::MaxLongitude)
+      {
+         const auto index = static_cast<std::size_t>(m_value) - static_cast<std::size_t>(Value::MinLatitude);
+         m_details.bounds[index] = d;
+         m_boundsMask |= 1u << index;
+      }
+      return true;
+   }
+
+   // Returns the type of the entry, e.g. "relation"
+   std::string_view GetType() const { return m_type; }
+
+   // Takes details of the entry, the name of a country is in the name fields
+   overpass::RelationDetails TakeDetails()
+   {
+      m_details.hasCenter = m_hasLatitude && m_hasLongitude;
+      m_details.hasBounds = m_boundsMask == 0xF;
+      if (!m_details.hasCenter && m_details.hasBounds)
+      {
+         m_details.hasCenter = true;
+         m_details.latitude = (m_details.bounds[0] + m_details.bounds[2]) / 2;
+         m_details.longitude = (m_details.bounds[1] + m_details.bounds[3]) / 2;
+      }
+      return std::move(m_details);
+   }
+
+private:
+   bool enter()
+   {
+      ++m_depth;
+      return true;
+   }
+
+   bool leave()
+   {
+      --m_depth;
+      return true;
+   }
+
+private:
+   enum class Field
+   {
+      Other,
+      Id,
+      Type,
+      Center,
+      Bounds,
+      Tags
+   };
+
+   enum class Value
+   {
+      Other,
+      Latitude,
+      Longitude,
+      MinLatitude,  // Bounds follow in the order of BoundingBox
+      MinLongitude,
+      MaxLatitude,
+      MaxLongitude,
+      Name,
+      NameEn,
+      Place,
+      AdminLevel,
+      RegionCode,
+      Code
+   };
+
+   int m_depth = 0;                      // Nesting level of objects and arrays
+   Field m_field = Field::Other;         // Key of the current value of the entry
+   Value m_value = Value::Other;         // Key of the current value of "center", "bounds" or "tags"
+   std::string m_type;                   // Type of the entry
+   overpass::RelationDetails m_details;  // Details of the entry
+   bool m_hasLatitude = false;           // Whether the center has a latitude
+   bool m_hasLongitude = false;          // Whether the center has a longitude
+   unsigned m_boundsMask = 0;            // Bits of the values of the bounds found, in the order of BoundingBox
+};
+
+// Sends the query to the Overpass API and extracts relation ids, coalescing identical concurrent queries.
+overpass::OsmIds loadRelationIds(WebClient& client, const std::string& request)
+{
+   return overpass::LoadRelationIdsAsync(client, request).get().ids;
+}
 
 }  // namespace
 
 namespace geo::overpass
 {
 
-OsmIds ExtractRelationIds(const std::string& json)
+bool ElementsExtractor::Feed(std::string_view chunk)
+{
+   if (m_failed)
+      return false;
+
+   // Entries of "elements" are parsed right from the chunk, unless they continue in the next one.
+   std::size_t elementBegin = 0;
+   for (std::size_t i = 0; i < chunk.size(); ++i)
+   {
+      const char c = chunk[i];
+      if (m_inString)
+      {
+         if (m_escape)
+            m_escape = false;
+         else if (c == '\\')
+            m_escape = true;
+         else if (c == '"')
+            m_inString = false;
+         else if (m_depth == 1 && m_string.size() < sc_maxKeyLength)
+            m_string += c;
+         continue;
+      }
+
+      switch (c)
+      {
+      case '"':
+         if (m_depth == 0)
+            return fail();
+         m_inString = true;
+         m_string.clear();
+         break;
+      case ':':
+         if (m_depth == 1)
+         {
+            m_key = m_string;
+            m_hasRemark = m_hasRemark || m_key == "remark";
+         }
+         break;
+      case '{':
+      case '[':
+         if (m_finished || (m_depth == 0 && c != '{'))
+            return fail();
+         ++m_depth;
+         if (m_depth == 2 && c == '[' && m_key == "elements")
+            m_inElements = true;
+         else if (m_depth == 3 && c == '{' && m_inElements)
+         {
+            m_inElement = true;
+            elementBegin = i;
+         }
+         break;
+      case '}':
+      case ']':
+         if (m_depth == 0)
+            return fail();
+         if (m_depth == 3 && m_inElement)
+         {
+            const std::string_view tail = chunk.substr(elementBegin, i + 1 - elementBegin);
+            const bool parsed = m_element.empty() ? parseElement(tail) : parseElement(m_element.append(tail));
+            m_element.clear();
+            m_inElement = false;
+            if (!parsed)
+               return fail();
+         }
+         else if (m_depth == 2)
+            m_inElements = false;
+         m_finished = --m_depth == 0;
+         break;
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+         break;
+      default:
+         if (m_depth == 0)
+            return fail();
+      }
+   }
+
+   if (m_inElement)
+      m_element.append(chunk.substr(elementBegin));
+   return true;
+}
+
+bool ElementsExtractor::IsComplete() const
+{
+   return m_finished && !m_failed && !m_hasRemark;
+}
+
+bool ElementsExtractor::fail()
+{
+   m_failed = true;
+   m_element.clear();
+   return false;
+}
+
+bool RelationIdsExtractor::parseElement(std::string_view element)
+{
+   rapidjson::MemoryStream stream(element.data(), element.size());
+   rapidjson::Reader reader;
+   ElementHandler handler;
+   if (reader.Parse<rapidjson::kParseStopWhenDoneFlag>(stream, handler).IsError())
+      return false;
+
+   if (const auto id = handler.GetRelationId())
+      m_ids.push_back(*id);
+   return true;
+}
+
+bool RelationDetailsExtractor::parseElement(std::string_view element)
+{
+   rapidjson::MemoryStream stream(element.data(), element.size());
+   rapidjson::Reader reader;
+   DetailsHandler handler;
+   if (reader.Parse<rapidjson::kParseStopWhenDoneFlag>(stream, handler).IsError())
+      return false;
+
+   if (handler.GetType() == "country")
+   {
+      // A relation may be represented by nodes in several countries, the first one is taken.
+      if (m_country.country.empty())
+      {
+         auto country = handler.TakeDetails();
+         m_country.country = std::move(country.name);
+         m_country.countryEn = std::move(country.nameEn);
+         m_country.countryCode = std::move(country.countryCode);
+      }
+   }
+   else if (handler.GetType() == "iso_country")
+   {
+      auto country = handler.TakeDetails();
+      if (!country.countryCode.empty())
+         m_countries.try_emplace(country.countryCode, std::move(country));
+   }
+   else if (handler.GetType() == "relation")
+   {
+      auto& relation = m_relations.emplace_back(handler.TakeDetails());
+      if (m_country.country.empty() && !m_countries.empty())
+      {
+         // "ISO3166-2" codes begin with the code of the country, e.g. "GB-ENG".
+         const std::string_view regionCode = relation.regionCode;
+         const auto it = m_countries.find(toLowerCase(regionCode.substr(0, regionCode.find('-'))));
+         if (it != m_countries.end())
+         {
+            m_country.country = it->second.name;
+            m_country.countryEn = it->second.nameEn;
+            m_country.countryCode = it->second.countryCode;
+         }
+      }
+      relation.country = std::move(m_country.country);
+      relation.countryEn = std::move(m_country.countryEn);
+      relation.countryCode = std::move(m_country.countryCode);
+      m_country = {};
+   }
+   return true;
+}
+
+std::string RelationBoundsListCodec::Encode(const RelationBoundsList& list)
+{
+   BinaryWriter writer;
+   writer.Write(sc_relationBoundsVersion);
+   writer.Write(static_cast<std::uint32_t>(list.size()));
+   for (const auto& relation : list)
+   {
+      writer.Write(relation.id);
+      for (const auto coordinate : relation.bounds)
+         writer.Write(coordinate);
+   }
+   return writer.Take();
+}
+
+std::optional<RelationBoundsList> RelationBoundsListCodec::Decode(std::string_view data)
 {
-   if (json.empty())
-      return {};
+   const std::size_t sc_recordSize = sizeof(OsmId) + sizeof(BoundingBox);  // Size of an encoded relation
 
-   rapidjson::Document document;
-   document.Parse(json.c_str());
-   if (!document.IsObject())
-      return {};
+   BinaryReader reader(data);
+   std::uint8_t version = 0;
+   std::uint32_t size = 0;
+   const std::size_t headerSize = sizeof(version) + sizeof(size);
+   if (!reader.Read(version) || version != sc_relationBoundsVersion || !reader.Read(size) ||
+       size != (data.size() - headerSize) / sc_recordSize)
+      return std::nullopt;
 
-   OsmIds result;
-   for (const auto& e : document["elements"].GetArray())
+   RelationBoundsList list(size);
+   for (auto& relation : list)
    {
-      const auto& id = json::Get(e, "id");
-      if (!id.IsNull() && json::GetString(json::Get(e, "type")) == "relation")
-         result.emplace_back(json::GetInt64(id));
+      reader.Read(relation.id);
+      for (auto& coordinate : relation.bounds)
+         reader.Read(coordinate);
    }
+   if (!reader.AtEnd())
+      return std::nullopt;
+   return list;
+}
+
+RelationDetailsList SelectTiledRegions(std::vector<RegionTile> tiles, std::uint32_t kinds, const BoundingBox& bbox)
+{
+   std::unordered_map<OsmId, std::uint32_t> foundKinds;  // Kinds of features found in every region
+   for (const auto& tile : tiles)
+      for (const auto& relation : tile.relations)
+         foundKinds[relation.id] |= tile.kind;
+
+   RelationDetailsList result;
+   for (auto& tile : tiles)
+      for (auto& relation : tile.relations)
+      {
+         const bool hasAllKinds = (foundKinds[relation.id] & kinds) == kinds;
+         if (hasAllKinds && (!relation.hasBounds || AreIntersecting(relation.bounds, bbox)))
+            result.push_back(std::move(relation));
+      }
    return result;
 }
 
+std::future<RelationIdsResponse> LoadRelationIdsAsync(WebClient& client, const std::string& request)
+{
+   auto promise = std::make_shared<std::promise<RelationIdsResponse>>();
+   auto future = promise->get_future();
+   const std::string key = client.GetUrl() + "\n" + request;
+   if (!s_relationIdsFlights.Join(key,
+          [promise](const RelationIdsResponse& response)
+          {
+             promise->set_value(response);
+          }))
+   {
+      return future;
+   }
+
+   // Ids are extracted on the I/O thread while the response arrives, chunks are not kept.
+   auto extractor = std::make_shared<RelationIdsExtractor>();
+   client.PostStreamAsync(
+      request,
+      [extractor](std::string_view chunk)
+      {
+         return extractor->Feed(chunk);
+      },
+      [extractor, key](bool succeeded)
+      {
+         RelationIdsResponse response;
+         if (succeeded)
+         {
+            response.complete = extractor->IsComplete();
+            response.ids = extractor->TakeIds();
+         }
+         s_relationIdsFlights.Complete(key, response);
+      });
+   return future;
+}
+
+std::future<RelationDetailsResponse> LoadRelationDetailsAsync(WebClient& client, const std::string& request)
+{
+   auto promise = std::make_shared<std::promise<RelationDetailsResponse>>();
+   auto future = promise->get_future();
+   const std::string key = client.GetUrl() + "\n" + request;
+   if (!s_relationDetailsFlights.Join(key,
+          [promise](const RelationDetailsResponse& response)
+          {
+             promise->set_value(response);
+          }))
+   {
+      return future;
+   }
+
+   auto extractor = std::make_shared<RelationDetailsExtractor>();
+   client.PostStreamAsync(
+      request,
+      [extractor](std::string_view chunk)
+      {
+         return extractor->Feed(chunk);
+      },
+      [extractor, key](bool succeeded)
+      {
+         RelationDetailsResponse response;
+         if (succeeded)
+         {
+            response.complete = extractor->IsComplete();
+            response.relations = extractor->TakeRelations();
+         }
+         s_relationDetailsFlights.Complete(key, response);
+      });
+   return future;
+}
+
+RelationDetailsList LoadRelationDetailsByName(WebClient& client, const std::string& name)
+{
+   const std::string request = std::format(sz_requestByNameFormat, name, sz_outputRelationDetails);
+   return LoadRelationDetailsAsync(client, request).get().relations;
+}
+
+RelationDetailsList LoadRelationDetailsByLocation(WebClient& client, double latitude, double longitude)
+{
+   const std::string request =
+      std::format(sz_requestByCoordinatesFormat, latitude, longitude, sz_outputRelationDetails);
+   return LoadRelationDetailsAsync(client, request).get().relations;
+}
+
 OsmIds LoadRelationIdsByName(WebClient& client, const std::string& name)
 {
-   const std::string request = std::format(sz_requestByNameFormat, name);
-   const std::string response = client.Post(request);
-   return ExtractRelationIds(response);
+   const std::string request = std::format(sz_requestByNameFormat, name, sz_outputRelationIds);
+   return loadRelationIds(client, request);
 }
 
 OsmIds LoadRelationIdsByLocation(WebClient& client, double latitude, double longitude)
 {
-   const std::string request = std::format(sz_requestByCoordinatesFormat, latitude, longitude);
-   const std::string response = client.Post(request);
-   return ExtractRelationIds(response);
+   const std::string request = std::format(sz_requestByCoordinatesFormat, latitude, longitude, sz_outputRelationIds);
+   return loadRelationIds(client, request);
+}
+
+SingleFlightStats GetCoalescingStats()
+{
+   const auto idsStats = s_relationIdsFlights.GetStats();
+   const auto detailsStats = s_relationDetailsFlights.GetStats();
+   return {idsStats.leaders + detailsStats.leaders, idsStats.followers + detailsStats.followers};
 }
 
 }  // namespace geo::overpass
\ No newline at end of file
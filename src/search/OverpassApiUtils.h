@@ -1,7 +1,15 @@
 #pragma once
 
+#include "../utils/GeoUtils.h"
+#include "../utils/SingleFlight.h"
+
+#include <cstddef>
 #include <cstdint>
+#include <future>
+#include <map>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace geo
@@ -15,10 +23,190 @@ namespace geo::overpass
 using OsmId = std::int64_t;         // Type alias for OpenStreetMap (OSM) IDs.
 using OsmIds = std::vector<OsmId>;  // Type alias for a list of OSM IDs.
 
-// Extracts all IDs of entities with type "relation" from a JSON response.
-// @param json: The JSON response from the Overpass API.
-// @return: A list of OSM IDs for the relations found.
-OsmIds ExtractRelationIds(const std::string& json);
+// Relation found by a query with "out bb", with its bounding box.
+struct RelationBounds
+{
+   OsmId id = 0;          // OSM ID of the relation.
+   BoundingBox bounds{};  // Bounding box of the relation as [minLat, minLon, maxLat, maxLon].
+};
+
+using RelationBoundsList = std::vector<RelationBounds>;  // Type alias for a list of RelationBounds objects.
+
+// Estimates dynamic memory used by a list of relation bounds, see ShardedLruCache.
+struct RelationBoundsListSize
+{
+   std::size_t operator()(const RelationBoundsList& list) const { return list.capacity() * sizeof(RelationBounds); }
+};
+
+// Converts a list of relation bounds to bytes and back, see TieredCache.
+struct RelationBoundsListCodec
+{
+   static std::string Encode(const RelationBoundsList& list);
+   static std::optional<RelationBoundsList> Decode(std::string_view data);
+};
+
+// Relation IDs extracted from a response, see LoadRelationIdsAsync().
+struct RelationIdsResponse
+{
+   OsmIds ids;             // IDs of the relations found.
+   bool complete = false;  // Whether the response is a complete result of the query, so it may be cached.
+};
+
+// ElementsExtractor parses a JSON response of the Overpass API while it is received, so the response is never kept
+// in memory as a whole. The envelope of the response is scanned byte by byte, and every entry of "elements"
+// is buffered only until it is closed and then passed to parseElement().
+class ElementsExtractor
+{
+public:
+   virtual ~ElementsExtractor() = default;
+
+   // Parses the next chunk of the response.
+   // @param chunk: Bytes which follow the previous chunk.
+   // @return: false if the response is not valid JSON, further chunks are ignored then.
+   bool Feed(std::string_view chunk);
+
+   // Checks if the whole response was parsed and it is a complete result of a query.
+   // Responses of queries which Overpass aborted (e.g. on timeout) have a "remark" and are not complete.
+   bool IsComplete() const;
+
+protected:
+   // Parses a closed entry of "elements".
+   // @param element: JSON object of the entry.
+   // @return: false if the entry is not valid JSON.
+   virtual bool parseElement(std::string_view element) = 0;
+
+private:
+   // Marks the response as not valid JSON, always returns false.
+   bool fail();
+
+private:
+   static const std::size_t sc_maxKeyLength = 16;  // Keys of the root object which are longer are truncated
+
+   std::string m_element;  // Beginning of the entry of "elements" which continues in the next chunk
+   std::string m_string;   // String of the root object being scanned, truncated to sc_maxKeyLength
+   std::string m_key;      // Last key of the root object
+   int m_depth = 0;        // Nesting level of objects and arrays
+
+   bool m_inString = false;    // Whether a string is being scanned
+   bool m_escape = false;      // Whether the previous character of the string is an escaping backslash
+   bool m_inElements = false;  // Whether the "elements" array is being scanned
+   bool m_inElement = false;   // Whether an entry of "elements" is being scanned
+   bool m_hasRemark = false;   // Whether the root object has a "remark"
+   bool m_finished = false;    // Whether the root object is closed
+   bool m_failed = false;      // Whether the response is not valid JSON
+};
+
+// RelationIdsExtractor extracts IDs of entities with type "relation" from a JSON response while it is received.
+class RelationIdsExtractor : public ElementsExtractor
+{
+public:
+   // Takes the IDs found so far.
+   OsmIds TakeIds() { return std::move(m_ids); }
+
+private:
+   // Adds the ID of the entry if it is a relation.
+   bool parseElement(std::string_view element) override;
+
+private:
+   OsmIds m_ids;  // IDs found so far
+};
+
+// Details of a relation returned by a query with "out center tags", see LoadRelationDetailsAsync().
+// Queries with "out bb" return the bounding box of the relation instead of the center, the center of the box
+// is taken then, as Overpass does for "out center".
+struct RelationDetails
+{
+   OsmId id = 0;             // OSM ID of the relation.
+   std::string name;         // "name" tag of the relation.
+   std::string nameEn;       // "name:en" tag of the relation.
+   std::string place;        // "place" tag of the relation.
+   int adminLevel = 0;       // "admin_level" tag of the relation, 0 if it is missing.
+   std::string regionCode;   // "ISO3166-2" tag of the relation, e.g. "GB-ENG".
+   bool hasCenter = false;   // Whether Overpass returned the center of the relation.
+   double latitude = 0;      // Latitude of the center.
+   double longitude = 0;     // Longitude of the center.
+   bool hasBounds = false;   // Whether Overpass returned the bounding box of the relation.
+   BoundingBox bounds{};     // Bounding box as [minLat, minLon, maxLat, maxLon].
+   std::string country;      // "name" tag of the country which contains the relation, empty if it is not found.
+   std::string countryEn;    // "name:en" tag of the country.
+   std::string countryCode;  // "ISO3166-1:alpha2" tag of the country in lower case, e.g. "gb".
+};
+
+using RelationDetailsList = std::vector<RelationDetails>;  // Type alias for a list of RelationDetails objects.
+
+// Relation details extracted from a response, see LoadRelationDetailsAsync().
+struct RelationDetailsResponse
+{
+   RelationDetailsList relations;  // Details of the relations found, in the order of the response.
+   bool complete = false;          // Whether the response is a complete result of the query.
+};
+
+// Regions found in one tile of a tiled region search for one kind of features, see SelectTiledRegions().
+struct RegionTile
+{
+   std::uint32_t kind = 0;         // Bit of the kind of features the tile is searched for.
+   RelationDetailsList relations;  // Regions which contain features of the kind within the tile, with their bounds.
+};
+
+// Selects regions of a tiled region search. Tiles are searched for every kind of features separately,
+// and a region is selected if it is found for every requested kind in some of the tiles, and its bounds
+// intersect the box. Regions without bounds are not dropped by the box.
+// The result is approximate: it is a superset of the regions which a query for the box itself returns,
+// as features of a selected region may lie in the parts of the tiles outside the box.
+// @param tiles: Regions found in the tiles which cover the box, for every requested kind.
+// @param kinds: Bitmask of the requested kinds of features.
+// @param bbox: The box of the search.
+// @return: Selected regions in the order of the tiles, a region found in several tiles is repeated.
+RelationDetailsList SelectTiledRegions(std::vector<RegionTile> tiles, std::uint32_t kinds, const BoundingBox& bbox);
+
+// RelationDetailsExtractor extracts details of relations from a JSON response while it is received.
+// The response is expected to have every relation preceded by "country" entries derived from the country areas
+// which contain it, as queries made by LoadRelationDetailsAsync() do. The first such entry is the country
+// of the relation. Alternatively, the response may start with "iso_country" entries of all countries of the
+// relations, and a relation is then matched to the country whose code begins its "ISO3166-2" tag.
+// Relations which match neither are left without a country.
+class RelationDetailsExtractor : public ElementsExtractor
+{
+public:
+   // Takes the details found so far.
+   RelationDetailsList TakeRelations() { return std::move(m_relations); }
+
+private:
+   // Adds details of the entry if it is a relation, or remembers the country of the next relation or relations.
+   bool parseElement(std::string_view element) override;
+
+private:
+   RelationDetailsList m_relations;                     // Details found so far
+   RelationDetails m_country;                           // Country of the next relation, only country fields are used
+   std::map<std::string, RelationDetails> m_countries;  // "iso_country" entries by lower case codes
+};
+
+// Sends a query to the Overpass API and extracts relation IDs while the response is received.
+// Identical queries in flight share one transfer and one result.
+// @param client: WebClient instance to interact with the Overpass API.
+// @param request: The Overpass query.
+// @return: Future of the relation IDs, empty if the request failed.
+std::future<RelationIdsResponse> LoadRelationIdsAsync(WebClient& client, const std::string& request);
+
+// Sends a query to the Overpass API and extracts details of relations while the response is received.
+// Identical queries in flight share one transfer and one result.
+// @param client: WebClient instance to interact with the Overpass API.
+// @param request: The Overpass query, it must output relations as expected by RelationDetailsExtractor.
+// @return: Future of the relation details, empty if the request failed.
+std::future<RelationDetailsResponse> LoadRelationDetailsAsync(WebClient& client, const std::string& request);
+
+// Finds relations by name with their centers, tags and countries in one Overpass API query.
+// @param client: WebClient instance to interact with the Overpass API.
+// @param name: The name to search for.
+// @return: Details of the relations found.
+RelationDetailsList LoadRelationDetailsByName(WebClient& client, const std::string& name);
+
+// Finds relations by location with their centers, tags and countries in one Overpass API query.
+// @param client: WebClient instance to interact with the Overpass API.
+// @param latitude: The latitude of the location.
+// @param longitude: The longitude of the location.
+// @return: Details of the relations found.
+RelationDetailsList LoadRelationDetailsByLocation(WebClient& client, double latitude, double longitude);
 
 // Finds relation IDs by name using the Overpass API.
 // @param client: WebClient instance to interact with the Overpass API.
@@ -33,4 +221,9 @@ OsmIds LoadRelationIdsByName(WebClient& client, const std::string& name);
 // @return: A list of OSM IDs for the relations found.
 OsmIds LoadRelationIdsByLocation(WebClient& client, double latitude, double longitude);
 
+// Returns counters of coalescing of identical concurrent relation queries.
+// Identical queries in flight share one upstream transfer and one parsed result.
+// @return: Coalescing counters of all relation queries, see LoadRelationIdsAsync() and LoadRelationDetailsAsync().
+SingleFlightStats GetCoalescingStats();
+
 }  // namespace geo::overpass
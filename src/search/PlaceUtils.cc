@@ -0,0 +1,18 @@
+#include "PlaceUtils.h"
+
+namespace geo
+{
+
+GeoProtoPlace ToGeoProtoPlace(const nominatim::RelationInfo& info)
+{
+   GeoProtoPlace place;
+   place.set_name(info.name);
+   place.set_name_en(info.nameEn);
+   place.set_country(info.country);
+   place.set_country_en(info.countryEn);
+   place.mutable_center()->set_latitude(info.latitude);
+   place.mutable_center()->set_longitude(info.longitude);
+   return place;
+}
+
+}  // namespace geo
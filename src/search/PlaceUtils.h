@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../../proto/ProtoTypes.h"
+#include "NominatimApiUtils.h"
+
+namespace geo
+{
+
+// Converts relation information to a place of the protobuf format, as returned by all search engines
+// @param info Relation information found by remote APIs or in a local index
+// @return GeoProtoPlace with the names, the country and the center of the relation
+GeoProtoPlace ToGeoProtoPlace(const nominatim::RelationInfo& info);
+
+}  // namespace geo
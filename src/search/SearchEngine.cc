@@ -3,7 +3,9 @@
 #include "../utils/GeoUtils.h"
 #include "../utils/WebClient.h"
 #include "NominatimApiUtils.h"
+#include "OpenMeteoApiUtils.h"
 #include "OverpassApiUtils.h"
+#include "PlaceUtils.h"
 #include "ProtoTypes.h"
 #include "SearchEngineItf.h"
 
@@ -12,6 +14,14 @@
 
 #include <algorithm>
 #include <format>
+#include <future>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace
 {
@@ -21,7 +31,16 @@ using namespace geo;
 // See documentation at https://wiki.openstreetmap.org/wiki/Overpass_API/Overpass_QL
 
 constexpr const char* sz_requestHeader = "[out:json][timeout:180];";
-constexpr const char* sz_requestFooter = ";out tags;";
+constexpr const char* sz_requestFooter = ";out ids bb;";  // Bounds let tiled searches drop regions out of the box
+
+// Regions are output with their tags and bounds, and the center of the bounds is taken as their center,
+// as Overpass does for "out center". They are preceded by the countries of the areas which contain the features,
+// converted to "iso_country" entries with three tags, see overpass::RelationDetailsExtractor.
+constexpr const char* sz_requestDetailsFooter = ";out tags bb;";
+constexpr const char* sz_requestCountries =
+   "area{}[\"admin_level\"=\"2\"][\"boundary\"=\"administrative\"];"
+   "convert iso_country name=t[\"name\"],\"name:en\"=t[\"name:en\"],code=t[\"ISO3166-1:alpha2\"];"
+   "out;";
 
 constexpr const char* sz_requestRelationsByNodes =
    "{0} -> {1};"                // Save entities from a set or a statement into a named set.
@@ -51,42 +70,61 @@ constexpr const char* sz_nodeSaltLakesDef = "wr[natural=water][water=lake][salt=
                                             ".outL > -> .outL;"  // Recurse down (to ways and nodes).
                                             "node.outL({0})";    // Select only nodes.
 
+// Kinds of features which regions are searched by, as bits of RegionPreferences::objects.
+const std::uint32_t sc_regionFeatureKinds[] = {
+   geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_INTERNATIONAL_AIRPORTS,
+   geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_PEAKS,
+   geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_SEA_BEACHES,
+   geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_SALT_LAKES};
+
 // It heavily depends on a country, but normally a region with admin_level=4 is big enough to be well-known for its
 // name, but not such as big as a whole country.
 constexpr const char* sz_regionsTags = "[boundary=administrative][admin_level=4]";
 
-// Converts Nominatim relation info to a GeoProtoPlace object
-GeoProtoPlace toGeoProtoPlace(const nominatim::RelationInfo& info)
+// Converts details loaded from Overpass to a Nominatim lookup result.
+// Nominatim takes "addresstype" from the "place" tag, or derives it from the admin level of a boundary.
+// Only levels with the same meaning in all countries are derived here, others are left to Nominatim.
+// @return: The lookup result, or std::nullopt if the details are incomplete.
+std::optional<nominatim::CachedRelation> toCachedRelation(overpass::RelationDetails details)
 {
-   GeoProtoPlace location;
-   location.set_name(info.name);
-   location.set_country(info.country);
-   location.mutable_center()->set_latitude(info.latitude);
-   location.mutable_center()->set_longitude(info.longitude);
-   return location;
+   nominatim::CachedRelation relation;
+   relation.addressType = std::move(details.place);
+   if (relation.addressType.empty() && details.adminLevel == 2)
+      relation.addressType = "country";
+   else if (relation.addressType.empty() && details.adminLevel == 4)
+      relation.addressType = "state";
+
+   if (relation.addressType.empty() || details.name.empty() || !details.hasCenter || details.country.empty() ||
+       details.countryEn.empty())
+      return std::nullopt;
+
+   auto& info = relation.info;
+   info.osmId = details.id;
+   info.nameEn = details.nameEn.empty() ? details.name : std::move(details.nameEn);
+   info.name = std::move(details.name);
+   info.country = std::move(details.country);
+   info.countryEn = std::move(details.countryEn);
+   info.countryCode = std::move(details.countryCode);
+   info.latitude = details.latitude;
+   info.longitude = details.longitude;
+   return relation;
 }
 
-// Finds cities using Overpass and Nominatim APIs based on relation IDs
-GeoProtoPlaces findCities(const overpass::OsmIds& relationIds, nominatim::Match match, WebClient& nominatimApiClient,
-   WebClient& overpassApiClient, bool includeDetails)
+// Converts selected cities to GeoProtoPlace objects
+// @param infos: Selected cities.
+// @param numRelations: Number of relations the cities are selected from.
+// @param includeDetails: Whether to include details of the cities.
+GeoProtoPlaces toGeoProtoCities(const nominatim::RelationInfos& infos, std::size_t numRelations, bool includeDetails)
 {
-   if (relationIds.empty())
-      return {};
-
-   // Use Nominatim API to load some detailed information for all the found "relation" entities.
-   // However, `infos` contains information only for those entities which are considered "cities".
-   // There is no way to select cities from all the entities in advance.
-   const auto infos = nominatim::LookupRelationInformationForCities(relationIds, match, nominatimApiClient);
    if (infos.empty())
-      LOG(ERROR) << std::format("Cannot find cities in Nominatim (checked {} relation ids)", relationIds.size());
+      LOG(ERROR) << std::format("Cannot find cities (checked {} relations)", numRelations);
    else
-      LOG(INFO) << std::format(
-         "Found {} cities in Nominatim (checked {} relation ids)", infos.size(), relationIds.size());
+      LOG(INFO) << std::format("Found {} cities (checked {} relations)", infos.size(), numRelations);
 
    GeoProtoPlaces result;
    for (const auto& i : infos)
    {
-      GeoProtoPlace city = toGeoProtoPlace(i);
+      GeoProtoPlace city = ToGeoProtoPlace(i);
       if (includeDetails)
       {
          // TODO
@@ -96,8 +134,26 @@ GeoProtoPlaces findCities(const overpass::OsmIds& relationIds, nominatim::Match
    return result;
 }
 
+// Finds cities using Overpass and Nominatim APIs based on relation IDs
+GeoProtoPlaces findCities(const overpass::OsmIds& relationIds, nominatim::Match match, WebClient& nominatimApiClient,
+   nominatim::RelationCache* relationCache, bool includeDetails)
+{
+   if (relationIds.empty())
+      return {};
+
+   // Use Nominatim API to load some detailed information for all the found "relation" entities.
+   // However, `infos` contains information only for those entities which are considered "cities".
+   // There is no way to select cities from all the entities in advance.
+   const auto infos =
+      nominatim::LookupRelationInformationForCities(relationIds, match, nominatimApiClient, relationCache);
+   return toGeoProtoCities(infos, relationIds.size(), includeDetails);
+}
+
 // Formats an Overpass API request string based on region preferences and bounding box
-std::string formatRegionsRequest(const ISearchEngine::RegionPreferences& prefs, const BoundingBox& boundingBox)
+// @param resolution: How details of the regions are resolved, with RelationResolution::Overpass
+// the request outputs the details with the ids.
+std::string formatRegionsRequest(
+   const ISearchEngine::RegionPreferences& prefs, const BoundingBox& boundingBox, RelationResolution resolution)
 {
    const char* sz_relAirports = ".relA";
    const char* sz_relPeaks = ".relP";
@@ -108,10 +164,12 @@ std::string formatRegionsRequest(const ISearchEngine::RegionPreferences& prefs,
       std::format("{}, {}, {}, {}", boundingBox[0], boundingBox[2], boundingBox[1], boundingBox[3]);
 
    std::string request = sz_requestHeader;
+   std::string areaSets;  // Named sets of areas which contain the features
    if (prefs.objects & geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_INTERNATIONAL_AIRPORTS)
    {
       const auto nodes = std::format(sz_nodeAirportsDef, boundingBoxStr);
       request += std::format(sz_requestRelationsByNodes, nodes, ".nodesA", ".areasA", sz_regionsTags, sz_relAirports);
+      areaSets += ".areasA";
    }
 
    if (prefs.objects & geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_PEAKS)
@@ -122,6 +180,7 @@ std::string formatRegionsRequest(const ISearchEngine::RegionPreferences& prefs,
          const int heightMeters = std::atoi(itLength->second.c_str());
          const auto nodes = std::format(sz_nodePeaksDef, boundingBoxStr, heightMeters);
          request += std::format(sz_requestRelationsByNodes, nodes, ".nodesP", ".areasP", sz_regionsTags, sz_relPeaks);
+         areaSets += ".areasP";
       }
    }
 
@@ -129,17 +188,23 @@ std::string formatRegionsRequest(const ISearchEngine::RegionPreferences& prefs,
    {
       const auto nodes = std::format(sz_nodeSeaBeachesDef, boundingBoxStr);
       request += std::format(sz_requestRelationsByNodes, nodes, ".nodesS", ".areasS", sz_regionsTags, sz_relSeaBeaches);
+      areaSets += ".areasS";
    }
 
    if (prefs.objects & geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_SALT_LAKES)
    {
       const auto nodes = std::format(sz_nodeSaltLakesDef, boundingBoxStr);
-      request += std::format(sz_requestRelationsByNodes, nodes, ".nodesL", ".areasL", sz_regionsTags, sz_relSeaBeaches);
+      request += std::format(sz_requestRelationsByNodes, nodes, ".nodesL", ".areasL", sz_regionsTags, sz_relSaltLakes);
+      areaSets += ".areasL";
    }
 
    if (request == sz_requestHeader)
       return {};
 
+   // Countries of the regions contain the features of all requested kinds, as the regions do.
+   if (resolution == RelationResolution::Overpass)
+      request += std::format(sz_requestCountries, areaSets);
+
    // The result set is an intersection of multiple named sets.
    request += "rel";
    if (prefs.objects & geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_INTERNATIONAL_AIRPORTS)
@@ -150,11 +215,35 @@ std::string formatRegionsRequest(const ISearchEngine::RegionPreferences& prefs,
       request += sz_relSeaBeaches;
    if (prefs.objects & geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_SALT_LAKES)
       request += sz_relSaltLakes;
-   request += sz_requestFooter;
+   request += resolution == RelationResolution::Overpass ? sz_requestDetailsFooter : sz_requestFooter;
 
    return request;
 }
 
+// Formats the part of a region tile cache key which identifies search preferences.
+// Only preferences which affect the Overpass request are included, so equivalent searches share tiles.
+std::string formatRegionPreferencesKey(const ISearchEngine::RegionPreferences& prefs)
+{
+   std::string key = std::to_string(prefs.objects);
+   if (prefs.objects & geoproto::RegionsRequest::Preferences::GEOGRAPHICAL_FEATURE_PEAKS)
+   {
+      auto itLength = prefs.properties.find("minPeakHeight");
+      if (itLength != prefs.properties.end())
+         key += std::format("/{}", std::atoi(itLength->second.c_str()));
+   }
+   return key;
+}
+
+// Returns true if the date belongs to one of the ranges
+bool isInRanges(const Date& date, const std::vector<DateRange>& ranges)
+{
+   return std::any_of(ranges.begin(), ranges.end(),
+      [&date](const DateRange& range)
+      {
+         return range.first <= date && date <= range.second;
+      });
+}
+
 bool isValidBoundingBox(const BoundingBox& bbox)
 {
    static const auto sc_maxDimensionKm = 1000;  // A kind of safety check
@@ -168,48 +257,253 @@ bool isValidBoundingBox(const BoundingBox& bbox)
 namespace geo
 {
 
-SearchEngine::SearchEngine(WebClient& overpassApiClient, WebClient& nominatimApiClient)
+SearchEngine::SearchEngine(WebClient& overpassApiClient, WebClient& nominatimApiClient,
+   WebClient& openMeteoApiClient, const SearchEngineSettings& settings)
    : m_overpassApiClient(overpassApiClient)
    , m_nominatimApiClient(nominatimApiClient)
+   , m_openMeteoApiClient(openMeteoApiClient)
+   , m_relationResolution(settings.relationResolution)
+   , m_regionTileSize(settings.regionTileSize)
+   , m_weatherCellsPerDegree(settings.weatherCellsPerDegree)
+   , m_weatherLocationsPerRequest(settings.weatherLocationsPerRequest)
+   , m_weatherFetchPlanner(openMeteoApiClient.GetMaxOngoingRequests())
 {
+   // Results restored from disk are promoted to memory, so the persistent level is used only with memory caches.
+   if (!settings.cacheDirectory.empty() && settings.diskCacheBytes)
+      m_diskCache = std::make_unique<DiskCache>(settings.cacheDirectory, settings.diskCacheBytes);
+   if (settings.relationCacheBytes)
+      m_relationCache = std::make_unique<nominatim::RelationCache>(
+         settings.relationCacheBytes, settings.relationCacheTtl, m_diskCache.get(), "nominatim/relation/");
+   if (m_regionTileSize && settings.regionCacheBytes)
+      m_regionTileCache = std::make_unique<RegionTileCache>(
+         settings.regionCacheBytes, settings.regionCacheTtl, m_diskCache.get(), "overpass/regions/");
+   if (m_weatherCellsPerDegree && settings.weatherStoreBytes)
+      m_weatherStore = std::make_unique<WeatherStore>(m_weatherCellsPerDegree, settings.weatherStoreBytes,
+         m_diskCache.get(), settings.weatherCacheTtl);
+}
+
+SearchEngine::~SearchEngine()
+{
+   const auto overpassStats = overpass::GetCoalescingStats();
+   LOG(INFO) << std::format("Overpass relation queries: {} sent, {} coalesced", overpassStats.leaders,
+      overpassStats.followers);
+   if (m_relationResolution == RelationResolution::Overpass)
+      LOG(INFO) << std::format("Overpass relation details: {} resolved, {} looked up in Nominatim",
+         m_resolvedInOverpass.load(), m_resolvedInNominatim.load());
+   const auto nominatimStats = nominatim::GetCoalescingStats();
+   LOG(INFO) << std::format("Nominatim city lookups: {} sent, {} coalesced", nominatimStats.leaders,
+      nominatimStats.followers);
+   const auto lookupStats = nominatim::GetLookupStats();
+   LOG(INFO) << std::format("Nominatim relation lookups: {}, {} requests, {} English requests", lookupStats.lookups,
+      lookupStats.requests, lookupStats.englishRequests);
+   const auto parseStats = nominatim::GetParseStats();
+   LOG(INFO) << std::format("Nominatim responses: {} parsed, {} parser allocations", parseStats.responses,
+      parseStats.allocations);
+   if (m_relationCache)
+   {
+      const auto cacheStats = m_relationCache->GetStats();
+      LOG(INFO) << std::format("Nominatim relation cache: {} hits, {} misses, {} evictions, {} entries, {} bytes",
+         cacheStats.hits, cacheStats.misses, cacheStats.evictions, cacheStats.entries, cacheStats.bytes);
+   }
+   if (m_regionTileCache)
+   {
+      const auto cacheStats = m_regionTileCache->GetStats();
+      LOG(INFO) << std::format("Region tile cache: {} hits, {} misses, {} evictions, {} entries, {} bytes",
+         cacheStats.hits, cacheStats.misses, cacheStats.evictions, cacheStats.entries, cacheStats.bytes);
+   }
+   if (m_weatherStore)
+   {
+      const auto storeStats = m_weatherStore->GetStats();
+      LOG(INFO) << std::format(
+         "Weather store: {} cells, {} climatology indexes, {} of {} days stored, {} bytes, {:.0f} bytes per cell-year",
+         storeStats.cells, storeStats.indexes, storeStats.storedDays, storeStats.allocatedDays, storeStats.bytes,
+         storeStats.bytesPerCellYear);
+   }
+   const auto fetchModel = m_weatherFetchPlanner.GetModel();
+   LOG(INFO) << std::format("Weather fetch cost model: {:.0f} ms per request, {:.6f} ms per byte, {:.1f} bytes per day",
+      fetchModel.latencyMs, fetchModel.msPerByte, fetchModel.bytesPerDay);
 }
 
 GeoProtoPlaces SearchEngine::FindCitiesByName(const std::string& name, bool includeDetails)
 {
+   if (m_relationResolution == RelationResolution::Overpass)
+   {
+      // Find "relation" entities by name together with their details.
+      auto details = overpass::LoadRelationDetailsByName(m_overpassApiClient, name);
+      const std::size_t numRelations = details.size();
+      const auto infos = nominatim::SelectCities(resolveRelations(std::move(details)), nominatim::Match::Any);
+      return toGeoProtoCities(infos, numRelations, includeDetails);
+   }
+
    // First, find ids of "relation" entities by name.
    const overpass::OsmIds relationIds = overpass::LoadRelationIdsByName(m_overpassApiClient, name);
-   return findCities(relationIds, nominatim::Match::Any, m_nominatimApiClient, m_overpassApiClient, includeDetails);
+   return findCities(
+      relationIds, nominatim::Match::Any, m_nominatimApiClient, m_relationCache.get(), includeDetails);
 }
 
 GeoProtoPlaces SearchEngine::FindCitiesByPosition(double latitude, double longitude, bool includeDetails)
 {
+   if (m_relationResolution == RelationResolution::Overpass)
+   {
+      // Find "relation" entities by a coordinate of a point together with their details.
+      auto details = overpass::LoadRelationDetailsByLocation(m_overpassApiClient, latitude, longitude);
+      const std::size_t numRelations = details.size();
+      const auto infos = nominatim::SelectCities(resolveRelations(std::move(details)), nominatim::Match::Best);
+      return toGeoProtoCities(infos, numRelations, includeDetails);
+   }
+
    // First, find ids of "relation" entities by a coordinate of a point.
    const overpass::OsmIds relationIds = overpass::LoadRelationIdsByLocation(m_overpassApiClient, latitude, longitude);
-   return findCities(relationIds, nominatim::Match::Best, m_nominatimApiClient, m_overpassApiClient, includeDetails);
+   return findCities(
+      relationIds, nominatim::Match::Best, m_nominatimApiClient, m_relationCache.get(), includeDetails);
 }
 
-ISearchEngine::IncrementalSearchHandler SearchEngine::StartFindRegions()
+ISearchEngine::IncrementalSearchHandler SearchEngine::StartFindRegions(std::shared_ptr<ProcessedRegionIds> processed)
 {
-   const auto processed = std::make_shared<std::set<overpass::OsmId>>();
    return IncrementalSearchHandler(
       [this, processed](const BoundingBox& bbox, const RegionPreferences& prefs)
       {
          GeoProtoPlaces result;
          const nominatim::RelationInfos iterationResult = findRegions(bbox, prefs, *processed);
          for (const auto& r : iterationResult)
-            result.emplace_back(toGeoProtoPlace(r));
+            result.emplace_back(ToGeoProtoPlace(r));
          return result;
       });
 }
 
 WeatherInfoVector SearchEngine::GetWeather(double latitude, double longitude, const DateRange& dateRange)
 {
-   return {};
+   if (!m_weatherStore)
+      return openmeteo::LoadHistoricalWeather(m_openMeteoApiClient, latitude, longitude, dateRange);
+
+   // Weather is requested for the grid point of the cell, so nearby locations share stored days,
+   // and only days which are not stored yet are requested.
+   const auto [cellLatitude, cellLongitude] = m_weatherStore->GetCellCenter(latitude, longitude);
+   const auto missingRanges = m_weatherStore->FindMissingRanges(latitude, longitude, dateRange);
+   if (!missingRanges.empty())
+   {
+#ifndef NDEBUG
+      LOG(INFO) << std::format("Weather request loads {} missing ranges from Open Meteo", missingRanges.size());
+#endif
+
+      for (const auto& weather :
+         openmeteo::LoadHistoricalWeather(m_openMeteoApiClient, cellLatitude, cellLongitude, missingRanges))
+         m_weatherStore->Store(latitude, longitude, weather);
+   }
+   return m_weatherStore->Load(latitude, longitude, dateRange);
+}
+
+std::vector<WeatherAggregate> SearchEngine::GetHistoricalWeather(
+   const std::vector<std::pair<double, double>>& requestedLocations, const std::vector<DateRange>& dateRanges)
+{
+   // Open Meteo data has grid cell resolution, so locations are snapped to the nearest points of the model grid
+   // and locations of the same point are loaded once. Grid points are the keys for the store and for coalescing
+   // of identical upstream requests, so nearby locations requested by different clients share them too.
+   std::vector<std::pair<double, double>> locations;  // Unique snapped locations
+   std::vector<std::size_t> uniqueIndexes;            // Index of the unique location of each requested one
+   std::map<std::pair<double, double>, std::size_t> indexByLocation;
+   for (const auto& [latitude, longitude] : requestedLocations)
+   {
+      const auto location = m_weatherCellsPerDegree ? SnapToGridCell(latitude, longitude, m_weatherCellsPerDegree)
+                                                    : std::make_pair(latitude, longitude);
+      const auto [it, inserted] = indexByLocation.try_emplace(location, locations.size());
+      if (inserted)
+         locations.push_back(location);
+      uniqueIndexes.push_back(it->second);
+   }
+
+   LOG(INFO) << std::format("Weather request for {} locations uses {} grid cells", requestedLocations.size(),
+      locations.size());
+
+   // Ranges of every location (with the store, only their missing spans) are turned into upstream jobs
+   // by the planner, which chooses between per-range, grouped and contiguous spans.
+   // Jobs with the same span are packed into multi-location requests, and all requests are started at once,
+   // the Open Meteo client limits how many requests are in flight process-wide.
+   std::vector<WeatherAggregate> result(locations.size());
+   std::vector<bool> aggregated(locations.size(), false);  // Locations with final results
+   std::vector<openmeteo::WeatherJob> jobs;
+   std::vector<std::size_t> jobLocations;  // Index of the location of each job
+   for (std::size_t i = 0; i < locations.size(); ++i)
+   {
+      const auto [latitude, longitude] = locations[i];
+      std::vector<DateRange> missingRanges = dateRanges;
+      if (m_weatherStore)
+      {
+         // Popular cells are answered by their climatology indexes without the network.
+         if (auto aggregate = m_weatherStore->Aggregate(latitude, longitude, dateRanges))
+         {
+            result[i] = *aggregate;
+            aggregated[i] = true;
+            continue;
+         }
+
+         missingRanges.clear();
+         for (const auto& dateRange : dateRanges)
+         {
+            const auto ranges = m_weatherStore->FindMissingRanges(latitude, longitude, dateRange);
+            missingRanges.insert(missingRanges.end(), ranges.begin(), ranges.end());
+         }
+      }
+      if (missingRanges.empty())
+         continue;
+
+      const auto plan = m_weatherFetchPlanner.Plan(missingRanges);
+      LOG(INFO) << std::format("Weather plan for ({}, {}): {}", latitude, longitude, plan.Describe());
+      for (const auto& span : plan.spans)
+      {
+         jobs.push_back({latitude, longitude, span});
+         jobLocations.push_back(i);
+      }
+   }
+
+#ifndef NDEBUG
+   LOG(INFO) << std::format("Weather request for {} locations and {} date ranges loads {} ranges from Open Meteo",
+      locations.size(), dateRanges.size(), jobs.size());
+#endif
+
+   // Without the store results are reduced as they arrive, with the store they are reduced from it at the end.
+   // Spans may cover days between requested ranges, these days are stored but not aggregated.
+   openmeteo::LoadHistoricalWeather(m_openMeteoApiClient, jobs, m_weatherLocationsPerRequest, &m_weatherFetchPlanner,
+      [&](std::size_t job, WeatherInfoVector weather)
+      {
+         const std::size_t location = jobLocations[job];
+         if (m_weatherStore)
+            m_weatherStore->Store(locations[location].first, locations[location].second, weather);
+         else
+            for (const auto& info : weather)
+               if (isInRanges(info.time, dateRanges))
+                  result[location].Add(info);
+      });
+
+   // Indexes are rebuilt with the new days, the raw series is used only if some days are still missing.
+   for (std::size_t i = 0; m_weatherStore && i < locations.size(); ++i)
+   {
+      if (aggregated[i])
+         continue;
+
+      const auto [latitude, longitude] = locations[i];
+      if (auto aggregate = m_weatherStore->Aggregate(latitude, longitude, dateRanges))
+      {
+         result[i] = *aggregate;
+         continue;
+      }
+
+      for (const auto& dateRange : dateRanges)
+         for (const auto& info : m_weatherStore->Load(latitude, longitude, dateRange))
+            result[i].Add(info);
+   }
+
+   // Results are fanned out to the requested locations in their order.
+   std::vector<WeatherAggregate> requestedResult;
+   requestedResult.reserve(requestedLocations.size());
+   for (const auto index : uniqueIndexes)
+      requestedResult.push_back(result[index]);
+   return requestedResult;
 }
 
 // Finds and returns region information within a bounding box, filtering by preferences and tracking processed IDs
 nominatim::RelationInfos SearchEngine::findRegions(
-   const BoundingBox& bbox, const RegionPreferences& prefs, std::set<overpass::OsmId>& processed)
+   const BoundingBox& bbox, const RegionPreferences& prefs, ProcessedRegionIds& processed)
 {
    if (!isValidBoundingBox(bbox))
    {
@@ -217,24 +511,29 @@ nominatim::RelationInfos SearchEngine::findRegions(
       return {};
    }
 
-   const std::string request = formatRegionsRequest(prefs, bbox);
-   if (request.empty())
-      return {};
-
    // Use Overpass API to load "relation" entities for regions found in the passed bounding box,
    // taking into account passed preferences.
-   const std::string response = m_overpassApiClient.Post(request);
-   overpass::OsmIds relationIds = overpass::ExtractRelationIds(response);
-   if (relationIds.size())
+   overpass::RelationDetailsList regions = loadRegions(bbox, prefs);
+   overpass::OsmIds relationIds;
+   for (const auto& relation : regions)
+      relationIds.push_back(relation.id);
+   if (relationIds.empty())
       return {};
 
    // Remove ids which have already been processed.
    // This is an optimization for cases when one "relation" entity (i.e. a geographic region)
    // belongs to more than one bounding box, and findRegions() is called in a loop.
+   // Remaining ids are marked as processed right away, so concurrent calls for neighbour boxes
+   // do not look up the same regions again, and ids which fail to resolve are released after the lookup.
    overpass::OsmIds relationIdsToProcess;
    std::sort(relationIds.begin(), relationIds.end());
-   std::set_difference(relationIds.begin(), relationIds.end(), processed.begin(), processed.end(),
-      std::back_inserter(relationIdsToProcess));
+   relationIds.erase(std::unique(relationIds.begin(), relationIds.end()), relationIds.end());
+   {
+      std::lock_guard lock(processed.mutex);
+      std::set_difference(relationIds.begin(), relationIds.end(), processed.ids.begin(), processed.ids.end(),
+         std::back_inserter(relationIdsToProcess));
+      processed.ids.insert(relationIdsToProcess.begin(), relationIdsToProcess.end());
+   }
 
 #ifndef NDEBUG
    if (relationIds.size() != relationIdsToProcess.size())
@@ -242,23 +541,175 @@ nominatim::RelationInfos SearchEngine::findRegions(
          "std::set_difference() filtered out {} relation ids", relationIds.size() - relationIdsToProcess.size());
 #endif
 
-   if (!relationIdsToProcess.empty())
+   if (relationIdsToProcess.empty())
       return {};
 
-   // Use Nominatim API to load some detailed information for all the found "relation" entities.
-   const auto infos = nominatim::LookupRelationInformation(relationIdsToProcess, m_overpassApiClient);
+   // Use Nominatim API, or Overpass API with Nominatim for incomplete details, to load some detailed information
+   // for all the found "relation" entities.
+   nominatim::RelationInfos infos;
+   if (m_relationResolution == RelationResolution::Overpass)
+   {
+      // Details come in the same response as the ids. A region found in several tiles is resolved once,
+      // and details from a response are preferred to ids and bounds from the tile cache.
+      std::unordered_map<overpass::OsmId, overpass::RelationDetails> detailsById;
+      for (auto& relation : regions)
+      {
+         const auto [it, inserted] = detailsById.try_emplace(relation.id, std::move(relation));
+         if (!inserted && it->second.name.empty())
+            it->second = std::move(relation);
+      }
+
+      overpass::RelationDetailsList details;
+      for (const auto id : relationIdsToProcess)
+         details.push_back(std::move(detailsById.at(id)));
+      for (auto& relation : resolveRelations(std::move(details)))
+         infos.emplace_back(std::move(relation.info));
+   }
+   else
+      infos = nominatim::LookupRelationInformation(relationIdsToProcess, m_nominatimApiClient, m_relationCache.get());
+
+   // Ids which were not resolved are released, so they are looked up again when they are found by later calls.
+   std::unordered_set<overpass::OsmId> resolvedIds;
+   for (const auto& info : infos)
+      resolvedIds.insert(info.osmId);
+   {
+      std::lock_guard lock(processed.mutex);
+      for (const auto id : relationIdsToProcess)
+      {
+         if (!resolvedIds.contains(id))
+            processed.ids.erase(id);
+      }
+   }
+
    if (infos.empty())
    {
-      LOG(ERROR) << std::format(
-         "Cannot find regions in Nominatim (checked {} relation ids)", relationIdsToProcess.size());
+      LOG(ERROR) << std::format("Cannot find regions (checked {} relation ids)", relationIdsToProcess.size());
       return {};
    }
 
-   LOG(INFO) << std::format(
-      "Found {} regions in Nominatim (checked {} relation ids)", infos.size(), relationIdsToProcess.size());
-   processed.insert(relationIdsToProcess.begin(), relationIdsToProcess.end());
+   LOG(INFO) << std::format("Found {} regions (checked {} relation ids)", infos.size(), relationIdsToProcess.size());
 
    return infos;
 }
 
+std::vector<nominatim::CachedRelation> SearchEngine::resolveRelations(overpass::RelationDetailsList details)
+{
+   std::vector<std::optional<nominatim::CachedRelation>> relations;
+   overpass::OsmIds ids;
+   overpass::OsmIds incompleteIds;
+   for (auto& relation : details)
+   {
+      ids.push_back(relation.id);
+      if (!relations.emplace_back(toCachedRelation(std::move(relation))))
+         incompleteIds.push_back(ids.back());
+   }
+   m_resolvedInOverpass += relations.size() - incompleteIds.size();
+   m_resolvedInNominatim += incompleteIds.size();
+
+   // Resolved relations are cached as Nominatim lookups are, so regions from cached tiles are resolved
+   // from the cache.
+   for (std::size_t i = 0; m_relationCache && i < relations.size(); ++i)
+   {
+      if (relations[i])
+         m_relationCache->Put(ids[i], *relations[i]);
+   }
+
+#ifndef NDEBUG
+   LOG(INFO) << std::format("Overpass returned details of {} relations, {} are looked up in Nominatim", ids.size(),
+      incompleteIds.size());
+#endif
+
+   std::unordered_map<overpass::OsmId, nominatim::CachedRelation> lookedUp;
+   if (!incompleteIds.empty())
+   {
+      for (auto& relation : nominatim::LookupRelations(incompleteIds, m_nominatimApiClient, m_relationCache.get()))
+         lookedUp.try_emplace(relation.info.osmId, std::move(relation));
+   }
+
+   std::vector<nominatim::CachedRelation> result;
+   for (std::size_t i = 0; i < relations.size(); ++i)
+   {
+      if (relations[i])
+         result.emplace_back(std::move(*relations[i]));
+      else if (auto it = lookedUp.find(ids[i]); it != lookedUp.end())
+         result.emplace_back(std::move(it->second));
+   }
+   return result;
+}
+
+overpass::RelationDetailsList SearchEngine::loadRegions(const BoundingBox& bbox, const RegionPreferences& prefs)
+{
+   const std::string request = formatRegionsRequest(prefs, bbox, m_relationResolution);
+   if (request.empty())
+      return {};
+
+   if (!m_regionTileSize)
+      return overpass::LoadRelationDetailsAsync(m_overpassApiClient, request).get().relations;
+
+   // Every tile is searched for every kind of features separately, so a region whose features of different kinds
+   // lie in different tiles is found, and searches for different combinations of kinds share tiles.
+   // Tiles are queried concurrently, WebClient limits how many requests are in flight,
+   // identical requests for the same tile from concurrent searches share one transfer.
+   // Relations are extracted while responses arrive, so large responses are never kept in memory.
+   std::uint32_t kinds = 0;  // Kinds of features which are searched for
+   std::vector<overpass::RegionTile> tiles;
+   std::vector<std::tuple<std::string, std::size_t, std::future<overpass::RelationDetailsResponse>>> responses;
+   for (const auto& tile : SnapToTiles(bbox, m_regionTileSize))
+   {
+      const BoundingBox tileBox = GetTileBoundingBox(tile, m_regionTileSize);
+      for (const auto kind : sc_regionFeatureKinds)
+      {
+         const RegionPreferences kindPrefs{prefs.objects & kind, prefs.properties};
+         const std::string kindRequest = formatRegionsRequest(kindPrefs, tileBox, m_relationResolution);
+         if (kindRequest.empty())
+            continue;
+
+         kinds |= kind;
+         auto& regionTile = tiles.emplace_back();
+         regionTile.kind = kind;
+
+         // Tile indexes depend on the tile size, so the size is a part of the key.
+         std::string key = std::format("{}:{},{}/{}", m_regionTileSize, tile.latIndex, tile.lonIndex,
+            formatRegionPreferencesKey(kindPrefs));
+         if (auto cached = m_regionTileCache ? m_regionTileCache->Get(key) : std::nullopt)
+         {
+            for (const auto& [id, bounds] : *cached)
+            {
+               auto& relation = regionTile.relations.emplace_back();
+               relation.id = id;
+               relation.hasBounds = true;
+               relation.bounds = bounds;
+            }
+            continue;
+         }
+
+         responses.emplace_back(std::move(key), tiles.size() - 1,
+            overpass::LoadRelationDetailsAsync(m_overpassApiClient, kindRequest));
+      }
+   }
+
+#ifndef NDEBUG
+   LOG(INFO) << std::format("Region search requests {} tiles of single kinds from Overpass", responses.size());
+#endif
+
+   for (auto& [key, index, futureResponse] : responses)
+   {
+      auto response = futureResponse.get();
+      if (m_regionTileCache && response.complete)
+      {
+         overpass::RelationBoundsList tileRelations;
+         for (const auto& relation : response.relations)
+         {
+            if (relation.hasBounds)
+               tileRelations.push_back({relation.id, relation.bounds});
+         }
+         m_regionTileCache->Put(key, std::move(tileRelations));
+      }
+      tiles[index].relations = std::move(response.relations);
+   }
+
+   // Tiles cover more than the box, so the result is approximate, see overpass::SelectTiledRegions().
+   return overpass::SelectTiledRegions(std::move(tiles), kinds, bbox);
+}
+
 }  // namespace geo
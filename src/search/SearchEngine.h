@@ -1,10 +1,19 @@
 #pragma once
 
 #include "../../proto/ProtoTypes.h"
+#include "../utils/DiskCache.h"
+#include "../utils/TieredCache.h"
 #include "NominatimApiUtils.h"
 #include "OverpassApiUtils.h"
 #include "SearchEngineItf.h"
+#include "WeatherFetchPlanner.h"
+#include "WeatherStore.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <set>
 #include <string>
 
@@ -13,11 +22,40 @@ namespace geo
 
 class WebClient;
 
+// How details of relations found by Overpass are resolved, see SearchEngineSettings::relationResolution.
+enum class RelationResolution
+{
+   Nominatim,  // Overpass returns ids, details of all of them are looked up in Nominatim
+   Overpass    // Overpass returns centers, tags and countries, only incomplete ones are looked up in Nominatim
+};
+
+// Caching and resolution settings of SearchEngine.
+struct SearchEngineSettings
+{
+   std::size_t relationCacheBytes = 0;             // Capacity of the Nominatim relation cache, 0 disables it
+   std::chrono::seconds relationCacheTtl{86400};   // Time after which a cached relation is requested again
+   std::uint32_t regionTileSize = 0;               // Size of region search tiles in degrees, 0 disables tiling.
+                                                   // Tiled results are approximate, see loadRegions()
+   std::size_t regionCacheBytes = 0;               // Capacity of the region tile cache, 0 disables it
+   std::chrono::seconds regionCacheTtl{86400};     // Time after which a cached tile is requested again
+   std::string cacheDirectory;                     // Directory of the persistent cache, empty disables it
+   std::uint64_t diskCacheBytes = 0;               // Capacity of the persistent cache
+   std::uint32_t weatherCellsPerDegree = 0;        // Open Meteo grid cells per degree, 0 disables snapping and store
+   std::size_t weatherStoreBytes = 0;              // Capacity of the weather store, 0 disables it
+   std::chrono::seconds weatherCacheTtl{2592000};  // Time after which persisted weather is requested again
+   std::size_t weatherLocationsPerRequest = 1;     // Maximum number of locations in one Open Meteo request
+   RelationResolution relationResolution = RelationResolution::Nominatim;  // How relation details are resolved
+};
+
 class SearchEngine : public ISearchEngine
 {
 public:
-   // Constructs a SearchEngine with references to Overpass and Nominatim API clients
-   SearchEngine(WebClient& overpassApiClient, WebClient& nominatimApiClient);
+   // Constructs a SearchEngine with references to Overpass, Nominatim and Open Meteo API clients
+   SearchEngine(WebClient& overpassApiClient, WebClient& nominatimApiClient, WebClient& openMeteoApiClient,
+      const SearchEngineSettings& settings = {});
+
+   // Logs counters of coalescing of identical concurrent upstream lookups and of cache usage
+   ~SearchEngine() override;
 
    // See ISearchEngine::FindCitiesByName for documentation
    GeoProtoPlaces FindCitiesByName(const std::string& name, bool includeDetails) override;
@@ -26,19 +64,54 @@ public:
    GeoProtoPlaces FindCitiesByPosition(double latitude, double longitude, bool includeDetails) override;
 
    // See ISearchEngine::StartFindRegions for documentation
-   IncrementalSearchHandler StartFindRegions() override;
+   using ISearchEngine::StartFindRegions;
+   IncrementalSearchHandler StartFindRegions(std::shared_ptr<ProcessedRegionIds> processed) override;
 
    // See ISearchEngine::GetWeather for documentation
    WeatherInfoVector GetWeather(double latitude, double longitude, const DateRange& dateRange) override;
 
+   // See ISearchEngine::GetHistoricalWeather for documentation
+   std::vector<WeatherAggregate> GetHistoricalWeather(
+      const std::vector<std::pair<double, double>>& locations, const std::vector<DateRange>& dateRanges) override;
+
 private:
+   // Regions found in one tile of the region grid for one kind of features with their bounds, keyed by the tile size,
+   // the tile and search preferences of the kind
+   using RegionTileCache = TieredCache<std::string, overpass::RelationBoundsList, overpass::RelationBoundsListSize,
+      overpass::RelationBoundsListCodec>;
+
    // Finds region information within a bounding box based on preferences
    nominatim::RelationInfos findRegions(
-      const BoundingBox& bbox, const RegionPreferences& prefs, std::set<overpass::OsmId>& processed);
+      const BoundingBox& bbox, const RegionPreferences& prefs, ProcessedRegionIds& processed);
+
+   // Converts details loaded from Overpass to lookup results, and looks up in the relation cache or Nominatim
+   // only relations whose details are incomplete. Converted relations are cached.
+   // Relations are returned in the order of details.
+   std::vector<nominatim::CachedRelation> resolveRelations(overpass::RelationDetailsList details);
+
+   // Loads regions which contain requested features within a bounding box, with their ids and bounds.
+   // With tiling enabled the box is snapped to the region grid, and regions are loaded per tile and kind of features,
+   // from the cache when possible, so overlapping searches share upstream queries. Tiled results are approximate:
+   // regions whose bounds reach the box are returned when their features lie in the tiles, but outside the box.
+   overpass::RelationDetailsList loadRegions(const BoundingBox& bbox, const RegionPreferences& prefs);
 
 private:
    WebClient& m_overpassApiClient;   // Client for Overpass API requests
    WebClient& m_nominatimApiClient;  // Client for Nominatim API requests
+   WebClient& m_openMeteoApiClient;  // Client for Open Meteo API requests
+
+   const RelationResolution m_relationResolution;              // See SearchEngineSettings::relationResolution
+   const std::uint32_t m_regionTileSize;                       // See SearchEngineSettings::regionTileSize
+   const std::uint32_t m_weatherCellsPerDegree;                // See SearchEngineSettings::weatherCellsPerDegree
+   const std::size_t m_weatherLocationsPerRequest;             // See SearchEngineSettings::weatherLocationsPerRequest
+   std::unique_ptr<DiskCache> m_diskCache;                     // Persistent level of the caches, null if disabled
+   std::unique_ptr<nominatim::RelationCache> m_relationCache;  // Nominatim lookup results, null if disabled
+   std::unique_ptr<RegionTileCache> m_regionTileCache;         // Overpass region ids by tile, null if disabled
+   std::unique_ptr<WeatherStore> m_weatherStore;               // Historical weather by grid cell, null if disabled
+   openmeteo::WeatherFetchPlanner m_weatherFetchPlanner;       // Chooses spans to request from Open Meteo
+
+   std::atomic<std::uint64_t> m_resolvedInOverpass{0};   // Relations resolved by Overpass details alone
+   std::atomic<std::uint64_t> m_resolvedInNominatim{0};  // Relations with incomplete details looked up in Nominatim
 };
 
 }  // namespace geo
\ No newline at end of file
@@ -8,9 +8,14 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace geo
 {
@@ -42,14 +47,35 @@ public:
       Properties properties;  // Additional key-value pairs for filtering region features (e.g., "minPeakHeight")
    };
 
+   // Ids of regions already returned by one incremental search.
+   // The search handler may be called concurrently for different bounding boxes, so access is synchronized.
+   struct ProcessedRegionIds
+   {
+      std::mutex mutex;
+      std::set<std::int64_t> ids;
+   };
+
    // Initiates an incremental search for regions within bounding boxes
    // @return A function handler that can be called repeatedly with different bounding boxes and preferences
    //         to find regions incrementally, optimizing for looped searches
    using IncrementalSearchHandler = std::function<GeoProtoPlaces(const BoundingBox&, const RegionPreferences&)>;
-   virtual IncrementalSearchHandler StartFindRegions() = 0;
+   IncrementalSearchHandler StartFindRegions() { return StartFindRegions(std::make_shared<ProcessedRegionIds>()); }
+
+   // Initiates an incremental search for regions which skips regions of the given set and adds returned ones to it,
+   // so an engine which passes some boxes to another engine returns every region once
+   // @param processed Ids of regions already returned by the search
+   // @return A function handler like the one of StartFindRegions()
+   virtual IncrementalSearchHandler StartFindRegions(std::shared_ptr<ProcessedRegionIds> processed) = 0;
 
    // Returns weather for given location.
    virtual WeatherInfoVector GetWeather(double latitude, double longitude, const DateRange& dateRange) = 0;
+
+   // Returns historical weather aggregated over all given date ranges, for each location
+   // @param locations Latitude and longitude of each location
+   // @param dateRanges Date ranges to aggregate, the same for all locations
+   // @return Aggregated weather in the order of locations, locations without any data have numDays == 0
+   virtual std::vector<WeatherAggregate> GetHistoricalWeather(
+      const std::vector<std::pair<double, double>>& locations, const std::vector<DateRange>& dateRanges) = 0;
 };
 
 }  // namespace geo
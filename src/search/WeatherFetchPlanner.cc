@@ -0,0 +1,125 @@
+#include "WeatherFetchPlanner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <limits>
+
+namespace
+{
+
+using namespace geo;
+
+// Cost model used until enough requests are observed
+const double sc_priorLatencyMs = 500;
+const double sc_priorMsPerByte = 0.001;  // 1 MB/s
+const double sc_priorBytesPerDay = 25;   // A date, two temperatures and separators
+
+const double sc_decay = 0.95;           // Weight of older observations is decreased with every new one
+const double sc_bytesPerDayRate = 0.1;  // Weight of a new observation in the average size of a day
+
+// Returns the number of days of a range, both ends included
+std::size_t daysOf(const DateRange& range)
+{
+   const auto days = std::chrono::sys_days(range.second) - std::chrono::sys_days(range.first);
+   return static_cast<std::size_t>(std::max<std::int64_t>(days.count() + 1, 0));
+}
+
+}  // namespace
+
+namespace geo::openmeteo
+{
+
+std::string WeatherFetchPlan::Describe() const
+{
+   return std::format("{} spans of {} ranges, {} days, estimated {:.0f} ms "
+                      "(per range {:.0f} ms, contiguous {:.0f} ms)",
+      spans.size(), rangesPerSpan, days, estimatedMs, perRangeEstimatedMs, contiguousEstimatedMs);
+}
+
+WeatherFetchPlanner::WeatherFetchPlanner(std::size_t parallelism)
+   : m_parallelism(parallelism)
+   , m_model{sc_priorLatencyMs, sc_priorMsPerByte, sc_priorBytesPerDay}
+{
+}
+
+WeatherFetchPlan WeatherFetchPlanner::Plan(const std::vector<DateRange>& ranges) const
+{
+   WeatherFetchPlan plan;
+   if (ranges.empty())
+      return plan;
+
+   std::vector<DateRange> sorted = ranges;
+   std::sort(sorted.begin(), sorted.end());
+   const Model model = GetModel();
+
+   // Every option groups k consecutive ranges into one span: k = 1 requests ranges separately,
+   // k = N requests a single contiguous span.
+   plan.estimatedMs = std::numeric_limits<double>::infinity();
+   for (std::size_t k = 1; k <= sorted.size(); ++k)
+   {
+      std::vector<DateRange> spans;
+      std::size_t days = 0;
+      for (std::size_t i = 0; i < sorted.size(); i += k)
+      {
+         const std::size_t last = std::min(i + k, sorted.size()) - 1;
+         days += daysOf(spans.emplace_back(sorted[i].first, sorted[last].second));
+      }
+
+      const double estimatedMs = estimate(model, m_parallelism, spans.size(), days);
+      if (k == 1)
+         plan.perRangeEstimatedMs = estimatedMs;
+      if (k == sorted.size())
+         plan.contiguousEstimatedMs = estimatedMs;
+      if (estimatedMs < plan.estimatedMs)
+      {
+         plan.spans = std::move(spans);
+         plan.rangesPerSpan = k;
+         plan.days = days;
+         plan.estimatedMs = estimatedMs;
+      }
+   }
+   return plan;
+}
+
+void WeatherFetchPlanner::Observe(std::size_t days, std::size_t bytes, std::chrono::steady_clock::duration elapsed)
+{
+   if (!days || !bytes)
+      return;
+
+   const double x = static_cast<double>(bytes);
+   const double y = std::chrono::duration<double, std::milli>(elapsed).count();
+
+   std::lock_guard lock(m_mutex);
+   m_model.bytesPerDay += sc_bytesPerDayRate * (x / days - m_model.bytesPerDay);
+
+   m_weight = m_weight * sc_decay + 1;
+   m_sumBytes = m_sumBytes * sc_decay + x;
+   m_sumMs = m_sumMs * sc_decay + y;
+   m_sumBytesMs = m_sumBytesMs * sc_decay + x * y;
+   m_sumBytesBytes = m_sumBytesBytes * sc_decay + x * x;
+
+   // Least squares fit of time = latency + bytes * msPerByte. Responses of similar size do not allow
+   // to separate the terms, then only the latency is updated and the transfer rate is kept.
+   const double denominator = m_weight * m_sumBytesBytes - m_sumBytes * m_sumBytes;
+   if (m_weight >= 2 && denominator > m_sumBytesBytes * 1e-6)
+      m_model.msPerByte = std::max((m_weight * m_sumBytesMs - m_sumBytes * m_sumMs) / denominator, 0.0);
+   m_model.latencyMs = std::max((m_sumMs - m_model.msPerByte * m_sumBytes) / m_weight, 0.0);
+}
+
+WeatherFetchPlanner::Model WeatherFetchPlanner::GetModel() const
+{
+   std::lock_guard lock(m_mutex);
+   return m_model;
+}
+
+double WeatherFetchPlanner::estimate(
+   const Model& model, std::size_t parallelism, std::size_t numSpans, std::size_t days)
+{
+   // Requests run concurrently, so latency is paid once per round of parallel requests,
+   // while all bytes go through the same connection bandwidth.
+   const std::size_t rounds = parallelism ? (numSpans + parallelism - 1) / parallelism : 1;
+   return rounds * model.latencyMs + days * model.bytesPerDay * model.msPerByte;
+}
+
+}  // namespace geo::openmeteo
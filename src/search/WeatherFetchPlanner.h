@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../utils/TimeUtils.h"
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace geo::openmeteo
+{
+
+// Spans of days to request from Open Meteo for one location, see WeatherFetchPlanner::Plan()
+struct WeatherFetchPlan
+{
+   std::vector<DateRange> spans;      // Spans to request, each covers one or more consecutive input ranges
+   std::size_t rangesPerSpan = 1;     // Number of input ranges covered by one span
+   std::size_t days = 0;              // Number of days requested by all spans
+   double estimatedMs = 0;            // Estimated time to load all spans
+   double perRangeEstimatedMs = 0;    // Estimated time to load every input range separately
+   double contiguousEstimatedMs = 0;  // Estimated time to load all input ranges in a single span
+
+   // Returns a human-readable description of the plan
+   std::string Describe() const;
+};
+
+// WeatherFetchPlanner chooses how to request a set of date ranges of one location (e.g. the same window
+// in N recent years). Every request has a fixed latency, and every requested day costs transfer time,
+// so short windows are cheaper to request separately, while long windows over many years are cheaper
+// to request as one contiguous span which is filtered locally. The planner also considers grouped spans
+// of several consecutive ranges, and picks the cheapest option.
+// The cost model is learned from finished requests: per-request latency and transfer time per byte
+// are fitted to observed times and response sizes, and the size of a day is averaged over responses.
+class WeatherFetchPlanner
+{
+public:
+   // Observed costs, see GetModel()
+   struct Model
+   {
+      double latencyMs = 0;    // Fixed time of a request
+      double msPerByte = 0;    // Transfer time of a byte of a response
+      double bytesPerDay = 0;  // Size of a day of one location in a response
+   };
+
+public:
+   // @param parallelism Number of requests which run concurrently, 0 means no limit
+   explicit WeatherFetchPlanner(std::size_t parallelism);
+
+   // Chooses spans to request for a location
+   // @param ranges Date ranges to load, in any order, must not overlap
+   // @return The cheapest plan, spans are in ascending order
+   WeatherFetchPlan Plan(const std::vector<DateRange>& ranges) const;
+
+   // Updates the cost model with a finished request
+   // @param days Number of days of all locations of the request
+   // @param bytes Size of the response
+   // @param elapsed Duration of the transfer, without the time the request waited for a free slot
+   void Observe(std::size_t days, std::size_t bytes, std::chrono::steady_clock::duration elapsed);
+
+   // Returns the current cost model
+   Model GetModel() const;
+
+private:
+   // Returns estimated time to load spans with the given total number of days
+   static double estimate(const Model& model, std::size_t parallelism, std::size_t numSpans, std::size_t days);
+
+private:
+   const std::size_t m_parallelism;  // Number of requests which run concurrently, 0 means no limit
+
+   mutable std::mutex m_mutex;  // Protects fields below
+   Model m_model;               // Current cost model
+   double m_weight = 0;         // Decayed number of observations
+   double m_sumBytes = 0;       // Decayed sums for the least squares fit of time by response size
+   double m_sumMs = 0;
+   double m_sumBytesMs = 0;
+   double m_sumBytesBytes = 0;
+};
+
+}  // namespace geo::openmeteo
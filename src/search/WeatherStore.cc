@@ -0,0 +1,402 @@
+#include "WeatherStore.h"
+
+#include "../utils/BinaryCodec.h"
+#include "../utils/DiskCache.h"
+#include "../utils/GeoUtils.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <map>
+#include <string>
+
+namespace
+{
+
+using namespace geo;
+
+const std::int32_t sc_blockDays = 64;       // Series grow by whole bitmap words
+const std::uint8_t sc_cellYearVersion = 2;  // Changed on any change of the persisted cell-year encoding or cells
+const double sc_daysPerYear = 365.25;       // Average number of days in a year, for statistics
+const std::size_t sc_maxIndexes = 4;        // Maximum number of climatology indexes of a cell
+
+// Returns the number of days since the epoch
+std::int32_t dayOf(const Date& date)
+{
+   return static_cast<std::int32_t>(std::chrono::sys_days(date).time_since_epoch().count());
+}
+
+// Returns the date of a day since the epoch
+Date dateOf(std::int32_t day)
+{
+   return Date{std::chrono::sys_days{std::chrono::days{day}}};
+}
+
+// Returns the year of a day since the epoch
+std::int32_t yearOf(std::int32_t day)
+{
+   return static_cast<int>(dateOf(day).year());
+}
+
+// Returns the first day of a year as a day since the epoch
+std::int32_t firstDayOf(std::int32_t year)
+{
+   return dayOf(std::chrono::year{year} / std::chrono::January / 1);
+}
+
+// Rounds a day down to the start of its bitmap word
+std::int32_t alignDown(std::int32_t day)
+{
+   return day & ~(sc_blockDays - 1);
+}
+
+}  // namespace
+
+namespace geo
+{
+
+WeatherStore::WeatherStore(
+   std::uint32_t cellsPerDegree, std::size_t capacityBytes, DiskCache* diskCache, std::chrono::seconds diskTtl)
+   : m_cellsPerDegree(std::max<std::uint32_t>(cellsPerDegree, 1))
+   , m_capacityBytes(capacityBytes)
+   , m_disk(diskCache && diskCache->IsOpen() ? diskCache : nullptr)
+   , m_diskTtl(diskTtl)
+{
+}
+
+std::pair<double, double> WeatherStore::GetCellCenter(double latitude, double longitude) const
+{
+   return SnapToGridCell(latitude, longitude, m_cellsPerDegree);
+}
+
+std::vector<DateRange> WeatherStore::FindMissingRanges(double latitude, double longitude, const DateRange& dateRange)
+{
+   const std::int32_t fromDay = dayOf(dateRange.first);
+   const std::int32_t toDay = dayOf(dateRange.second);
+
+   std::lock_guard lock(m_mutex);
+   const Series& series = getSeries(cellOf(latitude, longitude), fromDay, toDay);
+
+   auto isValid = [&series](std::int32_t day)
+   {
+      const std::int64_t index = std::int64_t{day} - series.firstDay;
+      if (index < 0 || index >= static_cast<std::int64_t>(series.min.size()))
+         return false;
+      return ((series.valid[index / sc_blockDays] >> (index % sc_blockDays)) & 1) != 0;
+   };
+
+   std::vector<DateRange> result;
+   for (std::int32_t day = fromDay; day <= toDay; ++day)
+   {
+      if (isValid(day))
+         continue;
+
+      const std::int32_t first = day;
+      while (day < toDay && !isValid(day + 1))
+         ++day;
+      result.emplace_back(dateOf(first), dateOf(day));
+   }
+   return result;
+}
+
+void WeatherStore::Store(double latitude, double longitude, const WeatherInfoVector& weather)
+{
+   if (weather.empty())
+      return;
+
+   auto [minIt, maxIt] = std::minmax_element(weather.begin(), weather.end(),
+      [](const WeatherInfo& a, const WeatherInfo& b)
+      {
+         return a.time < b.time;
+      });
+   const std::int32_t fromDay = dayOf(minIt->time);
+   const std::int32_t toDay = dayOf(maxIt->time);
+   const CellKey cell = cellOf(latitude, longitude);
+
+   std::lock_guard lock(m_mutex);
+   Series& series = getSeries(cell, fromDay, toDay);
+   reserve(series, fromDay, toDay);
+   for (const auto& info : weather)
+      set(series, dayOf(info.time), static_cast<float>(info.temperatureMin), static_cast<float>(info.temperatureMax));
+
+   if (m_disk)
+      persist(cell, series, fromDay, toDay);
+   evict(cell);
+}
+
+WeatherInfoVector WeatherStore::Load(double latitude, double longitude, const DateRange& dateRange)
+{
+   const std::int32_t fromDay = dayOf(dateRange.first);
+   const std::int32_t toDay = dayOf(dateRange.second);
+
+   std::lock_guard lock(m_mutex);
+   const Series& series = getSeries(cellOf(latitude, longitude), fromDay, toDay);
+
+   WeatherInfoVector result;
+   const std::int64_t first = std::max<std::int64_t>(std::int64_t{fromDay} - series.firstDay, 0);
+   const std::int64_t last = std::min<std::int64_t>(
+      std::int64_t{toDay} - series.firstDay, static_cast<std::int64_t>(series.min.size()) - 1);
+   for (std::int64_t index = first; index <= last; ++index)
+   {
+      if (!((series.valid[index / sc_blockDays] >> (index % sc_blockDays)) & 1))
+         continue;
+
+      WeatherInfo& info = result.emplace_back();
+      info.time = dateOf(static_cast<std::int32_t>(series.firstDay + index));
+      info.temperatureMin = series.min[index];
+      info.temperatureMax = series.max[index];
+      info.temperatureAverage = (info.temperatureMin + info.temperatureMax) / 2;
+   }
+   return result;
+}
+
+std::optional<WeatherAggregate> WeatherStore::Aggregate(
+   double latitude, double longitude, const std::vector<DateRange>& dateRanges)
+{
+   if (dateRanges.empty())
+      return std::nullopt;
+
+   // Split ranges into pieces within calendar years, and group years of pieces by their days of year.
+   std::map<std::pair<int, int>, std::vector<std::int32_t>> yearsBySlots;
+   std::int32_t fromDay = dayOf(dateRanges.front().first);
+   std::int32_t toDay = dayOf(dateRanges.front().second);
+   for (const auto& [first, last] : dateRanges)
+   {
+      fromDay = std::min(fromDay, dayOf(first));
+      toDay = std::max(toDay, dayOf(last));
+      for (std::int32_t day = dayOf(first); day <= dayOf(last);)
+      {
+         const std::int32_t year = yearOf(day);
+         const std::int32_t pieceEnd = std::min(dayOf(last), firstDayOf(year + 1) - 1);
+         const std::pair slots{ClimatologyIndex::SlotOf(dateOf(day)), ClimatologyIndex::SlotOf(dateOf(pieceEnd))};
+         yearsBySlots[slots].push_back(year);
+         day = pieceEnd + 1;
+      }
+   }
+
+   const CellKey cell = cellOf(latitude, longitude);
+   std::lock_guard lock(m_mutex);
+   Series& series = getSeries(cell, fromDay, toDay);
+
+   WeatherAggregate result;
+   for (auto& [slots, years] : yearsBySlots)
+   {
+      std::sort(years.begin(), years.end());
+      if (std::adjacent_find(years.begin(), years.end()) != years.end() ||
+          years.back() - years.front() + 1 != static_cast<std::int32_t>(years.size()))
+         return std::nullopt;
+
+      const auto& index = getIndex(series, years.front(), static_cast<std::uint32_t>(years.size()));
+      const auto aggregate = index.Query(slots.first, slots.second);
+      if (!aggregate)
+         return std::nullopt;
+      result.Merge(*aggregate);
+   }
+   evict(cell);
+   return result;
+}
+
+WeatherStore::Stats WeatherStore::GetStats() const
+{
+   std::lock_guard lock(m_mutex);
+   Stats stats;
+   stats.cells = m_series.size();
+   stats.bytes = m_bytes;
+   for (const auto& [cell, series] : m_series)
+   {
+      stats.indexes += series.indexes.size();
+      stats.allocatedDays += series.min.size();
+      for (const auto word : series.valid)
+         stats.storedDays += std::popcount(word);
+   }
+   if (stats.allocatedDays)
+      stats.bytesPerCellYear = stats.bytes / (stats.allocatedDays / sc_daysPerYear);
+   return stats;
+}
+
+WeatherStore::CellKey WeatherStore::cellOf(double latitude, double longitude) const
+{
+   // Cells are keyed by the indexes of their grid points, see SnapToGridCell().
+   const auto [pointLatitude, pointLongitude] = SnapToGridCell(latitude, longitude, m_cellsPerDegree);
+   const auto latIndex = static_cast<std::int32_t>(std::lround(pointLatitude * m_cellsPerDegree));
+   const auto lonIndex = static_cast<std::int32_t>(std::lround(pointLongitude * m_cellsPerDegree));
+   return (CellKey{static_cast<std::uint32_t>(latIndex)} << 32) | static_cast<std::uint32_t>(lonIndex);
+}
+
+WeatherStore::Series& WeatherStore::getSeries(CellKey cell, std::int32_t fromDay, std::int32_t toDay)
+{
+   auto [it, inserted] = m_series.try_emplace(cell);
+   Series& series = it->second;
+   if (inserted)
+   {
+      m_lru.push_front(cell);
+      series.lru = m_lru.begin();
+      m_bytes += bytesOf(series);
+   }
+   else
+      m_lru.splice(m_lru.begin(), m_lru, series.lru);
+
+   if (!m_disk)
+      return series;
+
+   for (std::int32_t year = yearOf(fromDay); year <= yearOf(toDay); ++year)
+   {
+      if (std::find(series.diskYears.begin(), series.diskYears.end(), year) != series.diskYears.end())
+         continue;
+
+      m_bytes -= bytesOf(series);
+      series.diskYears.push_back(year);
+      m_bytes += bytesOf(series);
+
+      const auto entry = m_disk->Get(std::format("openmeteo/weather/{}/{}/{}", m_cellsPerDegree, cell, year));
+      if (!entry)
+         continue;
+
+      BinaryReader reader(entry->value);
+      std::uint8_t version = 0;
+      std::int32_t firstDay = 0;
+      std::uint32_t count = 0;
+      if (!reader.Read(version) || version != sc_cellYearVersion || !reader.Read(firstDay) || !reader.Read(count) ||
+          count == 0 || entry->value.size() != sizeof(version) + sizeof(firstDay) + sizeof(count) + count * 8)
+         continue;
+
+      reserve(series, firstDay, static_cast<std::int32_t>(firstDay + count - 1));
+      for (std::uint32_t i = 0; i < count; ++i)
+      {
+         float min = NAN;
+         float max = NAN;
+         reader.Read(min);
+         reader.Read(max);
+         if (!std::isnan(min) && !std::isnan(max))
+            set(series, static_cast<std::int32_t>(firstDay + i), min, max);
+      }
+   }
+   return series;
+}
+
+void WeatherStore::reserve(Series& series, std::int32_t fromDay, std::int32_t toDay)
+{
+   const std::int32_t alignedFrom = alignDown(fromDay);
+   const std::int32_t alignedEnd = alignDown(toDay) + sc_blockDays;
+
+   m_bytes -= bytesOf(series);
+   if (series.min.empty())
+   {
+      const std::size_t size = alignedEnd - alignedFrom;
+      series.firstDay = alignedFrom;
+      series.min.assign(size, 0);
+      series.max.assign(size, 0);
+      series.valid.assign(size / sc_blockDays, 0);
+   }
+   else
+   {
+      if (alignedFrom < series.firstDay)
+      {
+         const std::size_t size = series.firstDay - alignedFrom;
+         series.min.insert(series.min.begin(), size, 0);
+         series.max.insert(series.max.begin(), size, 0);
+         series.valid.insert(series.valid.begin(), size / sc_blockDays, 0);
+         series.firstDay = alignedFrom;
+      }
+
+      const std::int64_t end = std::int64_t{series.firstDay} + series.min.size();
+      if (alignedEnd > end)
+      {
+         const std::size_t size = series.min.size() + (alignedEnd - end);
+         series.min.resize(size, 0);
+         series.max.resize(size, 0);
+         series.valid.resize(size / sc_blockDays, 0);
+      }
+   }
+   m_bytes += bytesOf(series);
+}
+
+void WeatherStore::set(Series& series, std::int32_t day, float min, float max)
+{
+   const std::size_t index = day - series.firstDay;
+   series.min[index] = min;
+   series.max[index] = max;
+   series.valid[index / sc_blockDays] |= std::uint64_t{1} << (index % sc_blockDays);
+   ++series.version;
+}
+
+const ClimatologyIndex& WeatherStore::getIndex(Series& series, std::int32_t firstYear, std::uint32_t numYears)
+{
+   auto it = std::find_if(series.indexes.begin(), series.indexes.end(),
+      [firstYear, numYears](const auto& entry)
+      {
+         return entry.first.GetFirstYear() == firstYear && entry.first.GetNumYears() == numYears;
+      });
+   if (it != series.indexes.end() && it->second == series.version)
+      return it->first;
+
+   m_bytes -= bytesOf(series);
+   if (it == series.indexes.end())
+   {
+      if (series.indexes.size() >= sc_maxIndexes)
+         series.indexes.erase(series.indexes.begin());
+      it = series.indexes.emplace(series.indexes.end(), ClimatologyIndex(firstYear, numYears), 0);
+   }
+
+   it->first.Build(
+      [&series](const Date& date) -> std::optional<std::pair<float, float>>
+      {
+         const std::int64_t index = std::int64_t{dayOf(date)} - series.firstDay;
+         if (index < 0 || index >= static_cast<std::int64_t>(series.min.size()) ||
+             !((series.valid[index / sc_blockDays] >> (index % sc_blockDays)) & 1))
+            return std::nullopt;
+         return std::make_pair(series.min[index], series.max[index]);
+      });
+   it->second = series.version;
+   m_bytes += bytesOf(series);
+   return it->first;
+}
+
+void WeatherStore::persist(CellKey cell, const Series& series, std::int32_t fromDay, std::int32_t toDay)
+{
+   const std::int64_t seriesEnd = std::int64_t{series.firstDay} + series.min.size();
+   for (std::int32_t year = yearOf(fromDay); year <= yearOf(toDay); ++year)
+   {
+      const std::int32_t first = std::max(firstDayOf(year), series.firstDay);
+      const std::int32_t end = static_cast<std::int32_t>(std::min<std::int64_t>(firstDayOf(year + 1), seriesEnd));
+      if (first >= end)
+         continue;
+
+      BinaryWriter writer;
+      writer.Write(sc_cellYearVersion);
+      writer.Write(first);
+      writer.Write(static_cast<std::uint32_t>(end - first));
+      for (std::int32_t day = first; day < end; ++day)
+      {
+         const std::size_t index = day - series.firstDay;
+         const bool valid = (series.valid[index / sc_blockDays] >> (index % sc_blockDays)) & 1;
+         writer.Write(valid ? series.min[index] : NAN);
+         writer.Write(valid ? series.max[index] : NAN);
+      }
+      m_disk->Put(std::format("openmeteo/weather/{}/{}/{}", m_cellsPerDegree, cell, year), writer.Take(), m_diskTtl);
+   }
+}
+
+void WeatherStore::evict(CellKey keep)
+{
+   while (m_bytes > m_capacityBytes && m_lru.size() > 1 && m_lru.back() != keep)
+   {
+      auto it = m_series.find(m_lru.back());
+      m_bytes -= bytesOf(it->second);
+      m_series.erase(it);
+      m_lru.pop_back();
+   }
+}
+
+std::size_t WeatherStore::bytesOf(const Series& series)
+{
+   std::size_t bytes = sizeof(Series) + (series.min.capacity() + series.max.capacity()) * sizeof(float) +
+                       series.valid.capacity() * sizeof(std::uint64_t) +
+                       series.diskYears.capacity() * sizeof(std::int32_t);
+   for (const auto& [index, version] : series.indexes)
+      bytes += index.GetBytes();
+   return bytes;
+}
+
+}  // namespace geo
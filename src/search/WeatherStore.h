@@ -0,0 +1,146 @@
+#pragma once
+
+#include "../utils/TimeUtils.h"
+#include "../utils/WeatherInfo.h"
+#include "ClimatologyIndex.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace geo
+{
+
+class DiskCache;
+
+// WeatherStore keeps daily historical weather locally, so overlapping requests for the same area
+// do not fetch the same days from Open-Meteo again.
+// Locations are snapped to cells of a fixed grid. Every cell keeps a columnar series: float32 minimum and maximum
+// temperatures in arrays indexed by day since the epoch, and a bitmap of days which have values.
+// Cells also keep climatology indexes of the year sets they are asked for, so repeated N-year aggregates
+// of any window are answered in constant time. Indexes are rebuilt lazily after new days are stored.
+// Least recently used cells are dropped when the store exceeds its capacity. With a disk cache the series are
+// also persisted per cell and year, and restored on first use of a cell-year after a restart.
+class WeatherStore
+{
+public:
+   // Counters of store usage, see GetStats()
+   struct Stats
+   {
+      std::size_t cells = 0;            // Number of cells in memory
+      std::size_t indexes = 0;          // Number of climatology indexes in all cells
+      std::uint64_t storedDays = 0;     // Number of days with values in all cells
+      std::uint64_t allocatedDays = 0;  // Number of days allocated in all cells
+      std::size_t bytes = 0;            // Memory used by the series
+      double bytesPerCellYear = 0;      // Memory used by a year of one cell's series
+   };
+
+public:
+   // @param cellsPerDegree Number of grid cells per degree of latitude and longitude
+   // @param capacityBytes Maximum memory used by the series
+   // @param diskCache Optional persistent level, must outlive the store
+   // @param diskTtl Time after which a persisted cell-year expires
+   WeatherStore(std::uint32_t cellsPerDegree, std::size_t capacityBytes, DiskCache* diskCache,
+      std::chrono::seconds diskTtl);
+
+   // Returns the grid point nearest to a location, weather for its cell is requested for this point
+   // @param latitude Latitude of the location
+   // @param longitude Longitude of the location
+   // @return Latitude and longitude of the grid point
+   std::pair<double, double> GetCellCenter(double latitude, double longitude) const;
+
+   // Returns spans of days in the range which have no values for the cell of a location
+   // @param latitude Latitude of the location
+   // @param longitude Longitude of the location
+   // @param dateRange Range of days, both ends included
+   // @return Contiguous spans of missing days in ascending order
+   std::vector<DateRange> FindMissingRanges(double latitude, double longitude, const DateRange& dateRange);
+
+   // Stores daily values for the cell of a location
+   // @param latitude Latitude of the location
+   // @param longitude Longitude of the location
+   // @param weather Daily values to store
+   void Store(double latitude, double longitude, const WeatherInfoVector& weather);
+
+   // Returns stored values for the cell of a location, days without values are skipped
+   // @param latitude Latitude of the location
+   // @param longitude Longitude of the location
+   // @param dateRange Range of days, both ends included
+   // @return Daily values in ascending order of days
+   WeatherInfoVector Load(double latitude, double longitude, const DateRange& dateRange);
+
+   // Aggregates stored values of a location over date ranges using climatology indexes.
+   // Ranges are split at year boundaries, and pieces with the same days of year must belong to consecutive years,
+   // e.g. the same window in N recent years, possibly wrapping the new year.
+   // @param latitude Latitude of the location
+   // @param longitude Longitude of the location
+   // @param dateRanges Ranges of days, both ends included, must not overlap
+   // @return Aggregated weather, or std::nullopt if some days have no values or ranges do not fit the indexes
+   std::optional<WeatherAggregate> Aggregate(
+      double latitude, double longitude, const std::vector<DateRange>& dateRanges);
+
+   // Returns counters of store usage
+   Stats GetStats() const;
+
+private:
+   using CellKey = std::uint64_t;
+
+   // Daily values of one cell
+   struct Series
+   {
+      std::int32_t firstDay = 0;            // Day since the epoch of the first element, a multiple of 64
+      std::vector<float> min;               // Minimum temperatures by day
+      std::vector<float> max;               // Maximum temperatures by day
+      std::vector<std::uint64_t> valid;     // Bitmap of days which have values
+      std::vector<std::int32_t> diskYears;  // Years already looked up in the disk cache
+      std::list<CellKey>::iterator lru;     // Position in m_lru
+      std::uint64_t version = 0;            // Incremented on every change of values
+
+      // Climatology indexes with versions of values they are built from, least recently added first
+      std::vector<std::pair<ClimatologyIndex, std::uint64_t>> indexes;
+   };
+
+   // Returns the cell of a location
+   CellKey cellOf(double latitude, double longitude) const;
+
+   // Returns the series of a cell, creating it if needed, and marks it as most recently used.
+   // Restores years of the range from the disk cache if they have not been looked up yet.
+   Series& getSeries(CellKey cell, std::int32_t fromDay, std::int32_t toDay);
+
+   // Grows the series, so it covers days from fromDay to toDay
+   void reserve(Series& series, std::int32_t fromDay, std::int32_t toDay);
+
+   // Sets values of a day
+   void set(Series& series, std::int32_t day, float min, float max);
+
+   // Returns the climatology index of the years, creating or rebuilding it if needed
+   const ClimatologyIndex& getIndex(Series& series, std::int32_t firstYear, std::uint32_t numYears);
+
+   // Writes years of the cell from fromDay to toDay to the disk cache
+   void persist(CellKey cell, const Series& series, std::int32_t fromDay, std::int32_t toDay);
+
+   // Drops least recently used cells while the capacity is exceeded, except the given one
+   void evict(CellKey keep);
+
+   // Returns memory used by a series
+   static std::size_t bytesOf(const Series& series);
+
+private:
+   const std::uint32_t m_cellsPerDegree;  // Number of grid cells per degree
+   const std::size_t m_capacityBytes;     // Maximum memory used by the series
+   DiskCache* const m_disk;               // Persistent level, null if disabled
+   const std::chrono::seconds m_diskTtl;  // Time after which a persisted cell-year expires
+
+   mutable std::mutex m_mutex;                     // Protects fields below
+   std::unordered_map<CellKey, Series> m_series;  // Series by cell
+   std::list<CellKey> m_lru;                      // Cells, most recently used first
+   std::size_t m_bytes = 0;                       // Memory used by the series
+};
+
+}  // namespace geo
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace geo
+{
+
+// Appends values to a byte string in the host byte order, for cache records read back by the same build.
+class BinaryWriter
+{
+public:
+   // Appends an arithmetic value
+   template <typename T>
+      requires std::is_arithmetic_v<T>
+   void Write(T value)
+   {
+      m_data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+   }
+
+   // Appends a string prefixed with its size
+   void Write(std::string_view s)
+   {
+      Write(static_cast<std::uint32_t>(s.size()));
+      m_data.append(s);
+   }
+
+   // Returns the written bytes
+   std::string Take() { return std::move(m_data); }
+
+private:
+   std::string m_data;  // Written bytes
+};
+
+// Reads values written by BinaryWriter. Every read fails once the data is exhausted.
+class BinaryReader
+{
+public:
+   // @param data Bytes to read, must stay alive while the reader is used
+   explicit BinaryReader(std::string_view data)
+      : m_data(data)
+   {
+   }
+
+   // Reads an arithmetic value
+   // @return false if there is not enough data
+   template <typename T>
+      requires std::is_arithmetic_v<T>
+   bool Read(T& value)
+   {
+      if (m_data.size() < sizeof(value))
+         return false;
+      std::memcpy(&value, m_data.data(), sizeof(value));
+      m_data.remove_prefix(sizeof(value));
+      return true;
+   }
+
+   // Reads a string prefixed with its size
+   // @return false if there is not enough data
+   bool Read(std::string& s)
+   {
+      std::uint32_t size = 0;
+      if (!Read(size) || m_data.size() < size)
+         return false;
+      s.assign(m_data.substr(0, size));
+      m_data.remove_prefix(size);
+      return true;
+   }
+
+   // Returns true if all data has been read
+   bool AtEnd() const { return m_data.empty(); }
+
+private:
+   std::string_view m_data;  // Data not read yet
+};
+
+}  // namespace geo
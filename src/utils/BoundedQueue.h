@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace geo
+{
+
+// Bounded multi-producer multi-consumer queue.
+// Producers never block: TryPush() fails when the queue is full, so callers can reject the work explicitly.
+// Consumers block in Pop() until an item is available or the queue is closed.
+template <typename T>
+class BoundedQueue
+{
+public:
+   // @param capacity Maximum number of items in the queue
+   explicit BoundedQueue(std::size_t capacity)
+      : m_capacity(capacity)
+   {
+   }
+
+   // Adds an item to the queue
+   // @param item Item to add, it is left untouched if the item is not added
+   // @return false if the queue is full or closed
+   bool TryPush(T&& item)
+   {
+      {
+         std::lock_guard lock(m_mutex);
+         if (m_closed || m_items.size() >= m_capacity)
+            return false;
+         m_items.push_back(std::move(item));
+      }
+      m_condition.notify_one();
+      return true;
+   }
+
+   // Takes an item from the queue, waiting for it if the queue is empty
+   // @return The item, or std::nullopt if the queue is closed and empty
+   std::optional<T> Pop()
+   {
+      std::unique_lock lock(m_mutex);
+      m_condition.wait(lock,
+         [this]
+         {
+            return m_closed || !m_items.empty();
+         });
+      if (m_items.empty())
+         return std::nullopt;
+
+      T item = std::move(m_items.front());
+      m_items.pop_front();
+      return item;
+   }
+
+   // Closes the queue. Remaining items can still be popped, new items are rejected.
+   void Close()
+   {
+      {
+         std::lock_guard lock(m_mutex);
+         m_closed = true;
+      }
+      m_condition.notify_all();
+   }
+
+   // Returns number of items in the queue
+   std::size_t Size() const
+   {
+      std::lock_guard lock(m_mutex);
+      return m_items.size();
+   }
+
+private:
+   const std::size_t m_capacity;         // Maximum number of items in the queue
+   mutable std::mutex m_mutex;           // Protects all fields below
+   std::condition_variable m_condition;  // Signalled when an item is added or the queue is closed
+   std::deque<T> m_items;                // Queued items
+   bool m_closed = false;                // Set by Close()
+};
+
+}  // namespace geo
@@ -8,5 +8,25 @@ inline constexpr auto sz_nominatimEndpointKey = "nominatim-endpoint";
 inline constexpr auto sz_openMeteoEndpointKey = "openmeteo-endpoint";
 inline constexpr auto sz_maxBoxWidthKey = "maxBoxWidth";
 inline constexpr auto sz_maxBoxHeightKey = "maxBoxHeight";
+inline constexpr auto sz_workerThreadsKey = "workerThreads";
+inline constexpr auto sz_workerQueueSizeKey = "workerQueueSize";
+inline constexpr auto sz_maxOngoingTileRequestsKey = "maxOngoingTileRequests";
+inline constexpr auto sz_maxOngoingNominatimRequestsKey = "maxOngoingNominatimRequests";
+inline constexpr auto sz_relationCacheSizeMbKey = "relationCacheSizeMb";
+inline constexpr auto sz_relationCacheTtlSecondsKey = "relationCacheTtlSeconds";
+inline constexpr auto sz_maxOngoingOverpassRequestsKey = "maxOngoingOverpassRequests";
+inline constexpr auto sz_relationResolutionKey = "relationResolution";
+inline constexpr auto sz_snapshotFileKey = "snapshotFile";
+inline constexpr auto sz_nameSearchMaxEditsKey = "nameSearchMaxEdits";
+inline constexpr auto sz_regionTileSizeKey = "regionTileSize";
+inline constexpr auto sz_regionCacheSizeMbKey = "regionCacheSizeMb";
+inline constexpr auto sz_regionCacheTtlSecondsKey = "regionCacheTtlSeconds";
+inline constexpr auto sz_cacheDirectoryKey = "cacheDirectory";
+inline constexpr auto sz_diskCacheSizeMbKey = "diskCacheSizeMb";
+inline constexpr auto sz_maxOngoingWeatherRequestsKey = "maxOngoingWeatherRequests";
+inline constexpr auto sz_weatherCellsPerDegreeKey = "weatherCellsPerDegree";
+inline constexpr auto sz_weatherStoreSizeMbKey = "weatherStoreSizeMb";
+inline constexpr auto sz_weatherCacheTtlSecondsKey = "weatherCacheTtlSeconds";
+inline constexpr auto sz_maxWeatherLocationsPerRequestKey = "maxWeatherLocationsPerRequest";
 
 }
\ No newline at end of file
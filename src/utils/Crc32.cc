@@ -0,0 +1,36 @@
+#include "Crc32.h"
+
+#include <array>
+
+namespace
+{
+
+// Table of the CRC-32 (IEEE 802.3) polynomial
+constexpr std::array<std::uint32_t, 256> sc_crcTable = []
+{
+   std::array<std::uint32_t, 256> table{};
+   for (std::uint32_t i = 0; i < table.size(); ++i)
+   {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+         c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+   }
+   return table;
+}();
+
+}  // namespace
+
+namespace geo
+{
+
+std::uint32_t Crc32(std::uint32_t crc, const void* data, std::size_t size)
+{
+   const auto* bytes = static_cast<const unsigned char*>(data);
+   crc = ~crc;
+   for (std::size_t i = 0; i < size; ++i)
+      crc = sc_crcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+   return ~crc;
+}
+
+}  // namespace geo
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace geo
+{
+
+// Continues CRC-32 (IEEE 802.3) calculation over the data
+// @param crc Checksum of the preceding data, 0 at the beginning
+// @param data Data to add to the checksum
+// @param size Size of the data in bytes
+// @return Checksum of the preceding data and the data
+std::uint32_t Crc32(std::uint32_t crc, const void* data, std::size_t size);
+
+}  // namespace geo
@@ -0,0 +1,339 @@
+#include "DiskCache.h"
+
+#include "Crc32.h"
+
+#include <absl/log/log.h>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <mutex>
+
+namespace
+{
+
+constexpr std::uint64_t sc_logMagic = 0x474F4C4F4547ull;    // Identifies the log file
+constexpr std::uint64_t sc_indexMagic = 0x5844494F4547ull;  // Identifies the index file
+constexpr std::uint32_t sc_formatVersion = 1;               // Changed on any change of the file layouts
+
+constexpr std::uint32_t sc_minSlots = 4096;     // Minimum number of index slots
+constexpr std::uint32_t sc_bytesPerSlot = 512;  // Expected log bytes per record, defines the number of index slots
+constexpr std::uint32_t sc_maxProbes = 16;      // Number of slots probed for a key before an older entry is replaced
+
+constexpr auto sz_logFileName = "cache.log";
+constexpr auto sz_indexFileName = "cache.idx";
+
+// Header of the log file and of the index file
+struct FileHeader
+{
+   std::uint64_t magic;
+   std::uint32_t version;
+   std::uint32_t slotCount;  // Number of index slots, 0 in the log file
+};
+
+// Header of a record in the log, followed by the key and the value
+struct RecordHeader
+{
+   std::uint32_t crc;        // CRC-32 of the rest of the header, the key and the value
+   std::uint32_t keySize;    // Size of the key in bytes
+   std::uint32_t valueSize;  // Size of the value in bytes
+   std::uint32_t reserved;   // Always 0
+   std::int64_t expiresAt;   // Expiration time in seconds since the epoch
+};
+
+static_assert(sizeof(FileHeader) == 16 && sizeof(RecordHeader) == 24, "Unexpected padding of file structures");
+
+// Returns the checksum of a record
+std::uint32_t recordCrc(const RecordHeader& header, const char* keyAndValue)
+{
+   const auto* headerTail = reinterpret_cast<const char*>(&header) + sizeof(header.crc);
+   const auto crc = geo::Crc32(0, headerTail, sizeof(RecordHeader) - sizeof(header.crc));
+   return geo::Crc32(crc, keyAndValue, std::size_t{header.keySize} + header.valueSize);
+}
+
+// Returns the FNV-1a hash of the key, which is stable between runs unlike std::hash
+std::uint64_t hashKey(std::string_view key)
+{
+   std::uint64_t hash = 0xCBF29CE484222325ull;
+   for (const unsigned char c : key)
+      hash = (hash ^ c) * 0x100000001B3ull;
+   return hash;
+}
+
+// Reads exactly size bytes at the offset
+bool readAt(int fd, void* data, std::size_t size, std::uint64_t offset)
+{
+   auto* bytes = static_cast<char*>(data);
+   while (size)
+   {
+      const auto n = pread(fd, bytes, size, static_cast<off_t>(offset));
+      if (n < 0 && errno == EINTR)
+         continue;
+      if (n <= 0)
+         return false;
+      bytes += n;
+      size -= n;
+      offset += n;
+   }
+   return true;
+}
+
+// Writes exactly size bytes at the offset
+bool writeAt(int fd, const void* data, std::size_t size, std::uint64_t offset)
+{
+   const auto* bytes = static_cast<const char*>(data);
+   while (size)
+   {
+      const auto n = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+      if (n < 0 && errno == EINTR)
+         continue;
+      if (n <= 0)
+         return false;
+      bytes += n;
+      size -= n;
+      offset += n;
+   }
+   return true;
+}
+
+// Returns the number of index slots for the log capacity
+std::uint32_t slotCountFor(std::uint64_t capacityBytes)
+{
+   const auto slots = std::max<std::uint64_t>(capacityBytes / sc_bytesPerSlot, sc_minSlots);
+   return static_cast<std::uint32_t>(std::bit_ceil(std::min<std::uint64_t>(slots, 1u << 30)));
+}
+
+}  // namespace
+
+namespace geo
+{
+
+DiskCache::DiskCache(const std::string& directory, std::uint64_t capacityBytes)
+   : m_capacityBytes(capacityBytes)
+   , m_slotCount(slotCountFor(capacityBytes))
+{
+   if (!open(directory))
+   {
+      close();
+      LOG(ERROR) << std::format("Disk cache in '{}' is disabled", directory);
+      return;
+   }
+
+   LOG(INFO) << std::format("Disk cache opened in '{}': {} bytes of records, {} index slots", directory, m_logBytes,
+      m_slotCount);
+}
+
+DiskCache::~DiskCache()
+{
+   if (IsOpen())
+   {
+      const auto stats = GetStats();
+      LOG(INFO) << std::format("Disk cache: {} hits, {} misses, {} writes, {} resets, {} bytes", stats.hits,
+         stats.misses, stats.writes, stats.resets, stats.logBytes);
+   }
+   close();
+}
+
+std::optional<DiskCache::Entry> DiskCache::Get(std::string_view key)
+{
+   if (!IsOpen())
+      return std::nullopt;
+
+   const std::uint64_t hash = hashKey(key);
+   std::shared_lock lock(m_mutex);
+   for (std::uint32_t probe = 0; probe < sc_maxProbes; ++probe)
+   {
+      const Slot& slot = m_slots[(hash + probe) & (m_slotCount - 1)];
+      if (!slot.offset)
+         break;
+      if (slot.hash != hash)
+         continue;
+
+      if (auto entry = readRecord(slot.offset, key))
+      {
+         ++m_hits;
+         return entry;
+      }
+      break;
+   }
+   ++m_misses;
+   return std::nullopt;
+}
+
+void DiskCache::Put(std::string_view key, std::string_view value, Clock::duration ttl)
+{
+   if (!IsOpen())
+      return;
+
+   RecordHeader header{};
+   header.keySize = static_cast<std::uint32_t>(key.size());
+   header.valueSize = static_cast<std::uint32_t>(value.size());
+   header.expiresAt =
+      std::chrono::duration_cast<std::chrono::seconds>((Clock::now() + ttl).time_since_epoch()).count();
+
+   std::string record(sizeof(RecordHeader), '\0');
+   record.append(key).append(value);
+   header.crc = recordCrc(header, record.data() + sizeof(RecordHeader));
+   std::memcpy(record.data(), &header, sizeof(RecordHeader));
+
+   if (sizeof(FileHeader) + record.size() > m_capacityBytes)
+      return;
+
+   const std::uint64_t hash = hashKey(key);
+   std::unique_lock lock(m_mutex);
+   if (m_logBytes + record.size() > m_capacityBytes)
+      reset();
+
+   const std::uint64_t offset = m_logBytes;
+   if (!writeAt(m_logFd, record.data(), record.size(), offset))
+   {
+      LOG(ERROR) << std::format("Cannot write to disk cache: {}", std::strerror(errno));
+      return;
+   }
+   m_logBytes += record.size();
+   ++m_writes;
+
+   // Reuse the slot of the key or an empty slot. If there is none, the entry of some other key is dropped,
+   // which is fine for a cache.
+   Slot* target = &m_slots[hash & (m_slotCount - 1)];
+   for (std::uint32_t probe = 0; probe < sc_maxProbes; ++probe)
+   {
+      Slot& slot = m_slots[(hash + probe) & (m_slotCount - 1)];
+      if (!slot.offset || slot.hash == hash)
+      {
+         target = &slot;
+         break;
+      }
+   }
+   target->hash = hash;
+   target->offset = offset;
+}
+
+DiskCache::Stats DiskCache::GetStats() const
+{
+   std::shared_lock lock(m_mutex);
+   return {m_hits.load(), m_misses.load(), m_writes.load(), m_resets.load(), m_logBytes};
+}
+
+bool DiskCache::open(const std::string& directory)
+{
+   std::error_code error;
+   std::filesystem::create_directories(directory, error);
+   if (error)
+   {
+      LOG(ERROR) << std::format("Cannot create disk cache directory '{}': {}", directory, error.message());
+      return false;
+   }
+
+   const auto logPath = std::filesystem::path(directory) / sz_logFileName;
+   const auto indexPath = std::filesystem::path(directory) / sz_indexFileName;
+   m_logFd = ::open(logPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   m_indexFd = ::open(indexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (m_logFd < 0 || m_indexFd < 0)
+   {
+      LOG(ERROR) << std::format("Cannot open disk cache files: {}", std::strerror(errno));
+      return false;
+   }
+
+   if (flock(m_logFd, LOCK_EX | LOCK_NB) != 0)
+   {
+      LOG(ERROR) << "Disk cache files are used by another process";
+      return false;
+   }
+
+   // Validate both files, any mismatch clears the whole store.
+   const std::uint64_t indexBytes = sizeof(FileHeader) + std::uint64_t{m_slotCount} * sizeof(Slot);
+   const FileHeader logHeader{sc_logMagic, sc_formatVersion, 0};
+   const FileHeader indexHeader{sc_indexMagic, sc_formatVersion, m_slotCount};
+   auto hasHeader = [](int fd, const FileHeader& expected)
+   {
+      FileHeader header{};
+      return readAt(fd, &header, sizeof(header), 0) && std::memcmp(&header, &expected, sizeof(header)) == 0;
+   };
+   const auto logBytes = lseek(m_logFd, 0, SEEK_END);
+   const bool valid = logBytes >= static_cast<off_t>(sizeof(FileHeader)) && hasHeader(m_logFd, logHeader) &&
+                      lseek(m_indexFd, 0, SEEK_END) == static_cast<off_t>(indexBytes) &&
+                      hasHeader(m_indexFd, indexHeader);
+
+   if (!valid)
+   {
+      if (ftruncate(m_logFd, 0) != 0 || ftruncate(m_indexFd, 0) != 0 ||
+          ftruncate(m_indexFd, static_cast<off_t>(indexBytes)) != 0 ||
+          !writeAt(m_logFd, &logHeader, sizeof(logHeader), 0) ||
+          !writeAt(m_indexFd, &indexHeader, sizeof(indexHeader), 0))
+      {
+         LOG(ERROR) << std::format("Cannot initialize disk cache files: {}", std::strerror(errno));
+         return false;
+      }
+   }
+   m_logBytes = valid ? static_cast<std::uint64_t>(logBytes) : sizeof(FileHeader);
+
+   m_indexMap = mmap(nullptr, indexBytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_indexFd, 0);
+   if (m_indexMap == MAP_FAILED)
+   {
+      m_indexMap = nullptr;
+      LOG(ERROR) << std::format("Cannot map disk cache index: {}", std::strerror(errno));
+      return false;
+   }
+   m_slots = reinterpret_cast<Slot*>(static_cast<char*>(m_indexMap) + sizeof(FileHeader));
+   return true;
+}
+
+void DiskCache::close()
+{
+   if (m_indexMap)
+      munmap(m_indexMap, sizeof(FileHeader) + std::uint64_t{m_slotCount} * sizeof(Slot));
+   if (m_indexFd >= 0)
+      ::close(m_indexFd);
+   if (m_logFd >= 0)
+      ::close(m_logFd);
+
+   m_indexMap = nullptr;
+   m_slots = nullptr;
+   m_indexFd = -1;
+   m_logFd = -1;
+}
+
+std::optional<DiskCache::Entry> DiskCache::readRecord(std::uint64_t offset, std::string_view key) const
+{
+   RecordHeader header{};
+   if (offset + sizeof(RecordHeader) > m_logBytes || !readAt(m_logFd, &header, sizeof(header), offset))
+      return std::nullopt;
+
+   // The index may point to a record which was not completely written before a crash.
+   const std::uint64_t dataSize = std::uint64_t{header.keySize} + header.valueSize;
+   if (header.keySize != key.size() || offset + sizeof(RecordHeader) + dataSize > m_logBytes)
+      return std::nullopt;
+
+   std::string data(dataSize, '\0');
+   if (!readAt(m_logFd, data.data(), data.size(), offset + sizeof(RecordHeader)) ||
+       recordCrc(header, data.data()) != header.crc || std::string_view(data).substr(0, key.size()) != key)
+      return std::nullopt;
+
+   const Clock::time_point expiresAt{std::chrono::seconds(header.expiresAt)};
+   if (expiresAt <= Clock::now())
+      return std::nullopt;
+
+   data.erase(0, key.size());
+   return Entry{std::move(data), expiresAt};
+}
+
+void DiskCache::reset()
+{
+   if (ftruncate(m_logFd, sizeof(FileHeader)) != 0)
+      LOG(ERROR) << std::format("Cannot truncate disk cache log: {}", std::strerror(errno));
+   std::memset(static_cast<void*>(m_slots), 0, std::size_t{m_slotCount} * sizeof(Slot));
+   m_logBytes = sizeof(FileHeader);
+   ++m_resets;
+   LOG(INFO) << "Disk cache is full and has been cleared";
+}
+
+}  // namespace geo
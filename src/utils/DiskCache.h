@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace geo
+{
+
+// DiskCache is a persistent key-value store for upstream results, so a restarted server starts with a hot cache.
+// Records are appended to a log file and found through a hash index in a memory-mapped file.
+// Nothing is loaded at startup: pages of the index and the log are read by the OS on first access.
+// Every record has a checksum and an expiration time, damaged or expired records are treated as missing.
+// When the log reaches its capacity the store is cleared, as it only holds data which can be loaded again.
+// A cache directory can be used by one process at a time, other processes run without the disk cache.
+class DiskCache
+{
+public:
+   using Clock = std::chrono::system_clock;
+
+   // Value found in the cache
+   struct Entry
+   {
+      std::string value;            // Value of the record
+      Clock::time_point expiresAt;  // Time when the record expires
+   };
+
+   // Counters of cache usage, see GetStats()
+   struct Stats
+   {
+      std::uint64_t hits = 0;      // Number of lookups which found a fresh record
+      std::uint64_t misses = 0;    // Number of lookups which found nothing, or an expired or damaged record
+      std::uint64_t writes = 0;    // Number of records appended to the log
+      std::uint64_t resets = 0;    // Number of times the store was cleared because the log was full
+      std::uint64_t logBytes = 0;  // Size of the log file
+   };
+
+public:
+   // Opens the store in the directory, creating the directory and the files if needed.
+   // The store is disabled (see IsOpen()) if the files cannot be opened or are locked by another process.
+   // @param directory Directory of the store files
+   // @param capacityBytes Maximum size of the log file
+   DiskCache(const std::string& directory, std::uint64_t capacityBytes);
+
+   // Logs counters of cache usage and closes the files
+   ~DiskCache();
+
+   DiskCache(const DiskCache&) = delete;
+   DiskCache& operator=(const DiskCache&) = delete;
+
+   // Returns true if the store is usable
+   bool IsOpen() const { return m_logFd >= 0; }
+
+   // Looks up a fresh record
+   // @param key Key of the record
+   // @return The record, or std::nullopt if there is no fresh valid record
+   std::optional<Entry> Get(std::string_view key);
+
+   // Appends a record, replacing a previous record with the same key
+   // @param key Key of the record
+   // @param value Value of the record
+   // @param ttl Time after which the record expires
+   void Put(std::string_view key, std::string_view value, Clock::duration ttl);
+
+   // Returns counters of cache usage
+   Stats GetStats() const;
+
+private:
+   // Slot of the hash index, offset 0 means the slot is empty (the log starts with its header)
+   struct Slot
+   {
+      std::uint64_t hash;
+      std::uint64_t offset;
+   };
+
+   // Opens and validates the files, clears them if they are damaged or created by an incompatible version
+   bool open(const std::string& directory);
+
+   // Unmaps the index and closes the files
+   void close();
+
+   // Reads the record at the offset and checks it
+   std::optional<Entry> readRecord(std::uint64_t offset, std::string_view key) const;
+
+   // Clears the log and the index, m_mutex must be locked exclusively
+   void reset();
+
+private:
+   const std::uint64_t m_capacityBytes;  // Maximum size of the log file
+   const std::uint32_t m_slotCount;      // Number of index slots, a power of two
+
+   mutable std::shared_mutex m_mutex;  // Readers share it, writers lock it exclusively
+   int m_logFd = -1;                   // Log file
+   int m_indexFd = -1;                 // Index file
+   void* m_indexMap = nullptr;         // Mapping of the index file
+   Slot* m_slots = nullptr;            // Index slots in the mapping
+   std::uint64_t m_logBytes = 0;       // Size of the log file
+
+   std::atomic<std::uint64_t> m_hits = 0;    // See Stats::hits
+   std::atomic<std::uint64_t> m_misses = 0;  // See Stats::misses
+   std::atomic<std::uint64_t> m_writes = 0;  // See Stats::writes
+   std::atomic<std::uint64_t> m_resets = 0;  // See Stats::resets
+};
+
+}  // namespace geo
@@ -0,0 +1,64 @@
+#include "Executor.h"
+
+#include <absl/log/log.h>
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+namespace geo
+{
+
+Executor::Executor(std::size_t numWorkers, std::size_t queueCapacity)
+   : m_queue(queueCapacity)
+{
+   numWorkers = std::max<std::size_t>(numWorkers, 1);
+   m_workers.reserve(numWorkers);
+   for (std::size_t i = 0; i < numWorkers; ++i)
+      m_workers.emplace_back(&Executor::run, this);
+
+   LOG(INFO) << std::format("Executor started {} workers, queue capacity {}", numWorkers, queueCapacity);
+}
+
+Executor::~Executor()
+{
+   m_queue.Close();
+   for (auto& worker : m_workers)
+      worker.join();
+
+   const auto stats = GetStats();
+   LOG(INFO) << std::format("Executor stopped: {} tasks accepted, {} rejected", stats.accepted, stats.rejected);
+}
+
+bool Executor::TrySubmit(Task task)
+{
+   if (!m_queue.TryPush(std::move(task)))
+   {
+      ++m_rejected;
+      return false;
+   }
+   ++m_accepted;
+   return true;
+}
+
+Executor::Stats Executor::GetStats() const
+{
+   return {m_accepted.load(), m_rejected.load(), m_queue.Size()};
+}
+
+void Executor::run()
+{
+   while (auto task = m_queue.Pop())
+   {
+      try
+      {
+         (*task)();
+      }
+      catch (const std::exception& e)
+      {
+         LOG(ERROR) << std::format("Unhandled exception in executor task: {}", e.what());
+      }
+   }
+}
+
+}  // namespace geo
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "BoundedQueue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace geo
+{
+
+// Executor runs tasks on a fixed pool of worker threads, fed from a bounded queue.
+// It is used to move long-running request processing (such as multi-second HTTP round trips)
+// off gRPC callback threads. When the queue is full new tasks are rejected instead of piling up.
+class Executor
+{
+public:
+   using Task = std::function<void()>;
+
+   // Counters of executor usage, see GetStats()
+   struct Stats
+   {
+      std::uint64_t accepted = 0;  // Number of tasks accepted by TrySubmit()
+      std::uint64_t rejected = 0;  // Number of tasks rejected by TrySubmit() because the queue was full
+      std::size_t queued = 0;      // Number of tasks waiting for a worker right now
+   };
+
+public:
+   // Starts worker threads
+   // @param numWorkers Number of worker threads (at least one is started)
+   // @param queueCapacity Maximum number of tasks waiting for a worker
+   Executor(std::size_t numWorkers, std::size_t queueCapacity);
+
+   // Stops accepting tasks, finishes already queued tasks and joins worker threads
+   ~Executor();
+
+   Executor(const Executor&) = delete;
+   Executor& operator=(const Executor&) = delete;
+
+   // Queues a task for execution on a worker thread
+   // @param task Task to run
+   // @return false if the executor is saturated and the task is rejected
+   bool TrySubmit(Task task);
+
+   // Returns counters of executor usage
+   Stats GetStats() const;
+
+private:
+   // Worker thread main function
+   void run();
+
+private:
+   BoundedQueue<Task> m_queue;                 // Tasks waiting for a worker
+   std::atomic<std::uint64_t> m_accepted = 0;  // See Stats::accepted
+   std::atomic<std::uint64_t> m_rejected = 0;  // See Stats::rejected
+   std::vector<std::thread> m_workers;         // Worker threads
+};
+
+}  // namespace geo
@@ -1,5 +1,6 @@
 #include "GeoUtils.h"
 
+#include <algorithm>
 #include <cmath>
 
 // From https://stackoverflow.com/a/74798098
@@ -111,6 +112,105 @@ std::vector<BoundingBox> CreateBoundingBoxes(
    return v;
 }
 
+std::vector<Tile> SnapToTiles(const BoundingBox& bbox, std::uint32_t tileSize)
+{
+   // A box edge lying exactly on a grid line does not pull in the next tile, but a box always gets at least one tile.
+   auto indexRange = [tileSize](double min, double max)
+   {
+      const auto first = static_cast<std::int32_t>(std::floor(min / tileSize));
+      const auto last = static_cast<std::int32_t>(std::ceil(max / tileSize)) - 1;
+      return std::make_pair(first, std::max(first, last));
+   };
+
+   const auto [firstLat, lastLat] = indexRange(bbox[0], bbox[2]);
+   const auto [firstLon, lastLon] = indexRange(bbox[1], bbox[3]);
+
+   std::vector<Tile> tiles;
+   for (auto latIndex = firstLat; latIndex <= lastLat; ++latIndex)
+      for (auto lonIndex = firstLon; lonIndex <= lastLon; ++lonIndex)
+         tiles.push_back({latIndex, lonIndex});
+   return tiles;
+}
+
+BoundingBox GetTileBoundingBox(const Tile& tile, std::uint32_t tileSize)
+{
+   const double minLat = static_cast<double>(tile.latIndex) * tileSize;
+   const double minLon = static_cast<double>(tile.lonIndex) * tileSize;
+   return {std::max(std::min(minLat, sc_maxLatitude), sc_minLatitude),
+      std::max(std::min(minLon, sc_maxLongitude), sc_minLongitude),
+      std::max(std::min(minLat + tileSize, sc_maxLatitude), sc_minLatitude),
+      std::max(std::min(minLon + tileSize, sc_maxLongitude), sc_minLongitude)};
+}
+
+std::pair<double, double> SnapToGridCell(double latitude, double longitude, std::uint32_t cellsPerDegree)
+{
+   // Adding zero turns -0 into 0, so positions on both sides of the equator and the prime meridian get the same key.
+   auto snap = [cellsPerDegree](double value, double min, double max)
+   {
+      const double index = std::round(std::clamp(value, min, max) * cellsPerDegree);
+      return index / cellsPerDegree + 0.0;
+   };
+   const double snappedLongitude = snap(longitude, sc_minLongitude, sc_maxLongitude);
+   return {snap(latitude, sc_minLatitude, sc_maxLatitude),
+      snappedLongitude == sc_maxLongitude ? sc_minLongitude : snappedLongitude};
+}
+
+std::uint32_t GetHilbertIndex(std::uint32_t x, std::uint32_t y)
+{
+   // Branchless computation of the curve position from "Hacker's Delight", as in the flatbush library.
+   // The first part finds the orientation of the curve in every level of the grid, the second part
+   // interleaves bits of the coordinates transformed by the orientations.
+   std::uint32_t a = x ^ y;
+   std::uint32_t b = 0xFFFF ^ a;
+   std::uint32_t c = 0xFFFF ^ (x | y);
+   std::uint32_t d = x & (y ^ 0xFFFF);
+
+   std::uint32_t A = a | (b >> 1);
+   std::uint32_t B = (a >> 1) ^ a;
+   std::uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+   std::uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+   a = A;
+   b = B;
+   c = C;
+   d = D;
+   A = (a & (a >> 2)) ^ (b & (b >> 2));
+   B = (a & (b >> 2)) ^ (b & ((a ^ b) >> 2));
+   C ^= (a & (c >> 2)) ^ (b & (d >> 2));
+   D ^= (b & (c >> 2)) ^ ((a ^ b) & (d >> 2));
+
+   a = A;
+   b = B;
+   c = C;
+   d = D;
+   A = (a & (a >> 4)) ^ (b & (b >> 4));
+   B = (a & (b >> 4)) ^ (b & ((a ^ b) >> 4));
+   C ^= (a & (c >> 4)) ^ (b & (d >> 4));
+   D ^= (b & (c >> 4)) ^ ((a ^ b) & (d >> 4));
+
+   a = A;
+   b = B;
+   c = C;
+   d = D;
+   C ^= (a & (c >> 8)) ^ (b & (d >> 8));
+   D ^= (b & (c >> 8)) ^ ((a ^ b) & (d >> 8));
+
+   a = C ^ (C >> 1);
+   b = D ^ (D >> 1);
+
+   std::uint32_t i0 = x ^ y;
+   std::uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+   auto spread = [](std::uint32_t v)
+   {
+      v = (v | (v << 8)) & 0x00FF00FF;
+      v = (v | (v << 4)) & 0x0F0F0F0F;
+      v = (v | (v << 2)) & 0x33333333;
+      return (v | (v << 1)) & 0x55555555;
+   };
+   return (spread(i1) << 1) | spread(i0);
+}
+
 std::pair<double, double> GetBoundingBoxDimensionsKm(const BoundingBox& bbox)
 {
    // Convert degrees to radians
@@ -150,4 +250,9 @@ std::pair<double, double> GetBoundingBoxDimensionsKm(const BoundingBox& bbox)
    return std::make_pair(widthKm, heightKm);
 }
 
+bool AreIntersecting(const BoundingBox& a, const BoundingBox& b)
+{
+   return a[0] <= b[2] && b[0] <= a[2] && a[1] <= b[3] && b[1] <= a[3];
+}
+
 }  // namespace geo
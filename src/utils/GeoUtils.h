@@ -37,9 +37,52 @@ BoundingBox CreateBoundingBox(double latitude, double longitude, std::uint32_t r
 std::vector<BoundingBox> CreateBoundingBoxes(
    double latitude, double longitude, std::uint32_t rangeMeters, std::uint32_t maxBoxWidth, std::uint32_t maxBoxHeight);
 
+// Index of a tile of a fixed grid which divides the globe into square cells of the same size in degrees.
+// Tiles do not depend on requested positions, so overlapping requests share tiles.
+struct Tile
+{
+   std::int32_t latIndex = 0;  // The tile starts at latitude latIndex * tileSize
+   std::int32_t lonIndex = 0;  // The tile starts at longitude lonIndex * tileSize
+};
+
+// Snaps a bounding box to the fixed tile grid
+// @param bbox Bounding box to cover, e.g. created by CreateBoundingBox() or CreateBoundingBoxes()
+// @param tileSize Size of a tile in degrees
+// @return Tiles of the grid which together cover the bounding box
+std::vector<Tile> SnapToTiles(const BoundingBox& bbox, std::uint32_t tileSize);
+
+// Returns the bounding box of a grid tile
+// @param tile Tile of the grid
+// @param tileSize Size of a tile in degrees
+// @return Bounding box as [minLat, minLon, maxLat, maxLon], clamped to valid coordinates
+BoundingBox GetTileBoundingBox(const Tile& tile, std::uint32_t tileSize);
+
+// Snaps a position to the nearest point of a fine grid, e.g. the grid of a weather model, whose points lie
+// on multiples of the cell size. Positions nearest to the same grid point get the same point, so it can be used
+// as a key of the cell around it. Both sides of the antimeridian are snapped to the longitude -180.
+// @param latitude Latitude of the position
+// @param longitude Longitude of the position
+// @param cellsPerDegree Number of grid cells per degree of latitude and longitude
+// @return Latitude and longitude of the grid point
+std::pair<double, double> SnapToGridCell(double latitude, double longitude, std::uint32_t cellsPerDegree);
+
+// Returns the position of a cell of a 65536 x 65536 grid along the Hilbert curve which fills the grid.
+// Cells which are close on the curve are close on the grid, so objects sorted by the positions of their cells
+// are stored close to their neighbours, e.g. in a packed R-tree.
+// @param x Column of the cell, less than 65536
+// @param y Row of the cell, less than 65536
+// @return Position of the cell on the curve
+std::uint32_t GetHilbertIndex(std::uint32_t x, std::uint32_t y);
+
 // Calculates the width and height of a bounding box in kilometers
 // @param bbox Bounding box with min/max latitudes and longitudes in degrees
 // @return Pair<double, double> containing width (longitude distance) and height (latitude distance) in kilometers
 std::pair<double, double> GetBoundingBoxDimensionsKm(const BoundingBox& bbox);
 
+// Checks if two bounding boxes have common points
+// @param a First bounding box
+// @param b Second bounding box
+// @return true if the boxes intersect or touch
+bool AreIntersecting(const BoundingBox& a, const BoundingBox& b);
+
 }  // namespace geo
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace geo
+{
+
+// Counters of cache usage, see ShardedLruCache::GetStats()
+struct CacheStats
+{
+   std::uint64_t hits = 0;       // Number of lookups which found a fresh entry
+   std::uint64_t misses = 0;     // Number of lookups which found nothing or an expired entry
+   std::uint64_t evictions = 0;  // Number of entries evicted to stay within the capacity
+   std::size_t entries = 0;      // Number of entries in the cache
+   std::size_t bytes = 0;        // Estimated memory used by the entries
+};
+
+// Thread-safe LRU cache with entry expiration and capacity bounded by estimated memory usage.
+// Keys are distributed over independent shards, each with its own lock and its own LRU list,
+// so concurrent lookups of different keys rarely contend.
+// @tparam TKey Key type
+// @tparam TValue Value type
+// @tparam TSizeOf Functor which returns estimated dynamic memory used by a value in bytes
+// @tparam THash Hash of the key
+template <typename TKey, typename TValue, typename TSizeOf, typename THash = std::hash<TKey>>
+class ShardedLruCache
+{
+public:
+   using Clock = std::chrono::steady_clock;
+
+   static const std::size_t sc_defaultShards = 16;
+
+public:
+   // @param capacityBytes Maximum estimated memory used by all entries
+   // @param ttl Time after which an entry expires
+   // @param numShards Number of independent shards
+   ShardedLruCache(std::size_t capacityBytes, Clock::duration ttl, std::size_t numShards = sc_defaultShards)
+      : m_ttl(ttl)
+      , m_numShards(std::max<std::size_t>(numShards, 1))
+      , m_shardCapacityBytes(capacityBytes / m_numShards)
+      , m_shards(std::make_unique<Shard[]>(m_numShards))
+   {
+   }
+
+   // Looks up a fresh entry and marks it as most recently used
+   // @param key Key to look up
+   // @return Copy of the value, or std::nullopt if there is no fresh entry
+   std::optional<TValue> Get(const TKey& key)
+   {
+      Shard& shard = shardFor(key);
+      std::lock_guard lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it == shard.index.end())
+      {
+         ++m_misses;
+         return std::nullopt;
+      }
+
+      if (it->second->expiresAt <= Clock::now())
+      {
+         erase(shard, it->second);
+         ++m_misses;
+         return std::nullopt;
+      }
+
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+      ++m_hits;
+      return it->second->value;
+   }
+
+   // Adds or replaces an entry, evicting least recently used entries if the capacity is exceeded
+   // @param key Key of the entry
+   // @param value Value of the entry
+   void Put(const TKey& key, TValue value) { Put(key, std::move(value), m_ttl); }
+
+   // Adds or replaces an entry with its own lifetime, e.g. for an entry restored from a persistent cache
+   // @param key Key of the entry
+   // @param value Value of the entry
+   // @param ttl Time after which the entry expires
+   template <typename TDuration>
+   void Put(const TKey& key, TValue value, TDuration ttl)
+   {
+      if (ttl <= TDuration::zero())
+         return;
+
+      const std::size_t bytes = sizeof(Entry) + sc_entryOverheadBytes + TSizeOf{}(value);
+      Shard& shard = shardFor(key);
+      std::lock_guard lock(shard.mutex);
+
+      auto it = shard.index.find(key);
+      if (it != shard.index.end())
+         erase(shard, it->second);
+
+      if (bytes > m_shardCapacityBytes)
+         return;
+
+      const auto expiresAt = Clock::now() + std::chrono::duration_cast<Clock::duration>(ttl);
+      shard.lru.push_front({key, std::move(value), expiresAt, bytes});
+      shard.index.emplace(key, shard.lru.begin());
+      shard.bytes += bytes;
+
+      while (shard.bytes > m_shardCapacityBytes)
+      {
+         erase(shard, std::prev(shard.lru.end()));
+         ++m_evictions;
+      }
+   }
+
+   // Returns counters of cache usage
+   CacheStats GetStats() const
+   {
+      CacheStats stats{m_hits.load(), m_misses.load(), m_evictions.load()};
+      for (std::size_t i = 0; i < m_numShards; ++i)
+      {
+         std::lock_guard lock(m_shards[i].mutex);
+         stats.entries += m_shards[i].index.size();
+         stats.bytes += m_shards[i].bytes;
+      }
+      return stats;
+   }
+
+private:
+   // Rough estimate of memory used by list and hash table nodes of an entry
+   static const std::size_t sc_entryOverheadBytes = 64;
+
+   struct Entry
+   {
+      TKey key;
+      TValue value;
+      Clock::time_point expiresAt;
+      std::size_t bytes;
+   };
+
+   using EntryList = std::list<Entry>;
+
+   struct Shard
+   {
+      mutable std::mutex mutex;                                             // Protects fields below
+      EntryList lru;                                                        // Most recently used entries first
+      std::unordered_map<TKey, typename EntryList::iterator, THash> index;  // Entries by key
+      std::size_t bytes = 0;                                                // Estimated memory used by entries
+   };
+
+private:
+   Shard& shardFor(const TKey& key)
+   {
+      // Mix the hash, as std::hash of integers is often the identity
+      const std::uint64_t hash = static_cast<std::uint64_t>(THash{}(key)) * 0x9E3779B97F4A7C15ull;
+      return m_shards[(hash >> 32) % m_numShards];
+   }
+
+   static void erase(Shard& shard, typename EntryList::iterator it)
+   {
+      shard.bytes -= it->bytes;
+      shard.index.erase(it->key);
+      shard.lru.erase(it);
+   }
+
+private:
+   const Clock::duration m_ttl;                 // Time after which an entry expires
+   const std::size_t m_numShards;               // Number of shards
+   const std::size_t m_shardCapacityBytes;      // Maximum estimated memory used by entries of a shard
+   std::unique_ptr<Shard[]> m_shards;           // Shards
+   std::atomic<std::uint64_t> m_hits = 0;       // See CacheStats::hits
+   std::atomic<std::uint64_t> m_misses = 0;     // See CacheStats::misses
+   std::atomic<std::uint64_t> m_evictions = 0;  // See CacheStats::evictions
+};
+
+}  // namespace geo
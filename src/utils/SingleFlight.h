@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace geo
+{
+
+// Counters of request coalescing, see SingleFlight::GetStats()
+struct SingleFlightStats
+{
+   std::uint64_t leaders = 0;    // Number of calls which actually did the work
+   std::uint64_t followers = 0;  // Number of calls which joined an identical call in flight and shared its result
+};
+
+// SingleFlight coalesces concurrent identical calls: while a call for a key is in flight,
+// other calls for the same key do not repeat the work, but wait for the result of the first one.
+// Results are not cached: as soon as a call is completed, the next call for the key does the work again.
+template <typename TValue>
+class SingleFlight
+{
+public:
+   using Callback = std::function<void(const TValue&)>;
+
+public:
+   // Joins the call for the key. The first caller becomes the leader, it must do the work and call Complete().
+   // @param key Key identifying identical calls
+   // @param callback Callback to call with the result of the call, on the thread which calls Complete()
+   // @return true if the caller is the leader
+   bool Join(const std::string& key, Callback callback)
+   {
+      std::lock_guard lock(m_mutex);
+      auto [it, inserted] = m_flights.try_emplace(key);
+      it->second.push_back(std::move(callback));
+      ++(inserted ? m_leaders : m_followers);
+      return inserted;
+   }
+
+   // Completes the call for the key and passes the result to all joined callers
+   // @param key Key identifying identical calls
+   // @param value Result of the call
+   void Complete(const std::string& key, const TValue& value)
+   {
+      std::vector<Callback> callbacks;
+      {
+         std::lock_guard lock(m_mutex);
+         auto it = m_flights.find(key);
+         if (it == m_flights.end())
+            return;
+         callbacks = std::move(it->second);
+         m_flights.erase(it);
+      }
+      for (const auto& callback : callbacks)
+         callback(value);
+   }
+
+   // Blocking version: the leader calls the function on the calling thread, followers wait for its result
+   // @param key Key identifying identical calls
+   // @param fn Function which does the work
+   // @return Result of the call, a default value if the leader failed with an exception
+   TValue Do(const std::string& key, const std::function<TValue()>& fn)
+   {
+      auto promise = std::make_shared<std::promise<TValue>>();
+      auto future = promise->get_future();
+      const bool isLeader = Join(key,
+         [promise](const TValue& value)
+         {
+            promise->set_value(value);
+         });
+
+      if (isLeader)
+      {
+         TValue value{};
+         try
+         {
+            value = fn();
+         }
+         catch (...)
+         {
+            Complete(key, value);
+            throw;
+         }
+         Complete(key, value);
+      }
+      return future.get();
+   }
+
+   // Returns counters of request coalescing
+   SingleFlightStats GetStats() const { return {m_leaders.load(), m_followers.load()}; }
+
+private:
+   std::mutex m_mutex;                                                // Protects m_flights
+   std::unordered_map<std::string, std::vector<Callback>> m_flights;  // Callers of calls in flight by key
+   std::atomic<std::uint64_t> m_leaders = 0;                          // See SingleFlightStats::leaders
+   std::atomic<std::uint64_t> m_followers = 0;                        // See SingleFlightStats::followers
+};
+
+}  // namespace geo
@@ -0,0 +1,235 @@
+#include "Snapshot.h"
+
+#include "Crc32.h"
+
+#include <absl/log/log.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <format>
+
+namespace
+{
+
+using namespace geo;
+
+// Returns the checksum of the header up to its own checksum
+std::uint32_t headerCrc(const SnapshotHeader& header)
+{
+   return Crc32(0, &header, offsetof(SnapshotHeader, headerCrc));
+}
+
+// Returns the offset of the first section, after the header and the section table
+std::uint64_t dataOffset(std::uint64_t numSections)
+{
+   const std::uint64_t tableEnd = sizeof(SnapshotHeader) + numSections * sizeof(SnapshotSection);
+   return (tableEnd + sc_snapshotAlignment - 1) / sc_snapshotAlignment * sc_snapshotAlignment;
+}
+
+}  // namespace
+
+namespace geo
+{
+
+Snapshot::Snapshot(const std::string& path)
+{
+   const auto start = std::chrono::steady_clock::now();
+   if (!open(path))
+   {
+      close();
+      LOG(ERROR) << std::format("Snapshot '{}' is disabled", path);
+      return;
+   }
+
+   const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+   LOG(INFO) << std::format("Snapshot opened from '{}' in {:.2f} ms: {} sections, {} bytes", path, elapsed.count(),
+      m_numSections, m_bytes);
+}
+
+Snapshot::~Snapshot()
+{
+   close();
+}
+
+std::vector<std::string> Snapshot::Verify() const
+{
+   std::vector<std::string> damaged;
+   for (const auto& section : GetSections())
+   {
+      const char* records = static_cast<const char*>(m_data) + section.offset;
+      if (Crc32(0, records, section.count * section.recordSize) != section.crc)
+         damaged.emplace_back(section.name);
+   }
+   return damaged;
+}
+
+bool Snapshot::open(const std::string& path)
+{
+   const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      LOG(ERROR) << std::format("Cannot open snapshot: {}", std::strerror(errno));
+      return false;
+   }
+
+   struct stat status{};
+   if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(SnapshotHeader)))
+   {
+      LOG(ERROR) << "Snapshot is too small";
+      ::close(fd);
+      return false;
+   }
+
+   // The mapping stays valid after the file is closed.
+   m_bytes = static_cast<std::size_t>(status.st_size);
+   m_data = mmap(nullptr, m_bytes, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (m_data == MAP_FAILED)
+   {
+      m_data = nullptr;
+      LOG(ERROR) << std::format("Cannot map snapshot: {}", std::strerror(errno));
+      return false;
+   }
+
+   SnapshotHeader header{};
+   std::memcpy(&header, m_data, sizeof(header));
+   if (header.magic != sc_snapshotMagic || header.version != sc_snapshotVersion)
+   {
+      LOG(ERROR) << "Snapshot is of another version";
+      return false;
+   }
+   if (header.headerCrc != headerCrc(header) || header.fileSize != m_bytes ||
+       dataOffset(header.numSections) > m_bytes)
+   {
+      LOG(ERROR) << "Snapshot is truncated or damaged";
+      return false;
+   }
+
+   m_sections = reinterpret_cast<const SnapshotSection*>(static_cast<const char*>(m_data) + sizeof(SnapshotHeader));
+   m_numSections = header.numSections;
+   bool valid = Crc32(0, m_sections, m_numSections * sizeof(SnapshotSection)) == header.tableCrc;
+
+   // Sections are checked to be inside of the file, so indexes never read outside of the mapping.
+   for (std::uint32_t i = 0; valid && i < m_numSections; ++i)
+   {
+      const auto& section = m_sections[i];
+      valid = std::memchr(section.name, '\0', sizeof(section.name)) && section.recordSize &&
+              section.offset % sc_snapshotAlignment == 0 && section.offset >= dataOffset(m_numSections) &&
+              section.offset <= m_bytes && section.count <= (m_bytes - section.offset) / section.recordSize &&
+              findSection(section.name) == &section;
+   }
+   if (!valid)
+      LOG(ERROR) << "Snapshot section table is damaged";
+   return valid;
+}
+
+void Snapshot::close()
+{
+   if (m_data)
+      munmap(m_data, m_bytes);
+   m_data = nullptr;
+   m_bytes = 0;
+   m_sections = nullptr;
+   m_numSections = 0;
+}
+
+const SnapshotSection* Snapshot::findSection(std::string_view name) const
+{
+   const auto sections = GetSections();
+   const auto section = std::find_if(sections.begin(), sections.end(),
+      [name](const SnapshotSection& s)
+      {
+         return name == s.name;
+      });
+   return section == sections.end() ? nullptr : &*section;
+}
+
+bool SnapshotWriter::Write(const std::string& path) const
+{
+   for (const auto& section : m_sections)
+   {
+      const bool isUnique = std::count_if(m_sections.begin(), m_sections.end(),
+                               [&section](const Section& s)
+                               {
+                                  return s.name == section.name;
+                               }) == 1;
+      if (section.name.empty() || section.name.size() >= sc_snapshotNameSize || !isUnique)
+      {
+         LOG(ERROR) << std::format("Invalid snapshot section name: '{}'", section.name);
+         return false;
+      }
+   }
+
+   // Sections follow the table in the order they were added, each one aligned.
+   std::vector<SnapshotSection> table(m_sections.size());
+   std::string image(dataOffset(table.size()), '\0');
+   for (std::size_t i = 0; i < m_sections.size(); ++i)
+   {
+      const auto& section = m_sections[i];
+      auto& entry = table[i];
+      std::memcpy(entry.name, section.name.data(), section.name.size());
+      entry.recordSize = section.recordSize;
+      entry.crc = Crc32(0, section.data.data(), section.data.size());
+      entry.offset = image.size();
+      entry.count = section.count;
+      image.append(section.data);
+      image.resize((image.size() + sc_snapshotAlignment - 1) / sc_snapshotAlignment * sc_snapshotAlignment, '\0');
+   }
+
+   SnapshotHeader header{};
+   header.magic = sc_snapshotMagic;
+   header.version = sc_snapshotVersion;
+   header.numSections = static_cast<std::uint32_t>(table.size());
+   header.fileSize = image.size();
+   header.tableCrc = Crc32(0, table.data(), table.size() * sizeof(SnapshotSection));
+   header.headerCrc = headerCrc(header);
+   std::memcpy(image.data(), &header, sizeof(header));
+   std::memcpy(image.data() + sizeof(header), table.data(), table.size() * sizeof(SnapshotSection));
+
+   // The image is written to a temporary file which then replaces the snapshot at once, so a server which maps
+   // the previous file keeps reading it intact, and never sees a partially written one.
+   const std::string tempPath = path + ".tmp";
+   auto fail = [&tempPath](int fd)
+   {
+      LOG(ERROR) << std::format("Cannot write snapshot {}: {}", tempPath, std::strerror(errno));
+      if (fd >= 0)
+         ::close(fd);
+      ::unlink(tempPath.c_str());
+      return false;
+   };
+
+   const int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd < 0)
+      return fail(fd);
+   for (std::size_t offset = 0; offset < image.size();)
+   {
+      const ssize_t written = ::write(fd, image.data() + offset, image.size() - offset);
+      if (written < 0 && errno == EINTR)
+         continue;
+      if (written <= 0)
+         return fail(fd);
+      offset += static_cast<std::size_t>(written);
+   }
+   if (fsync(fd) != 0)
+      return fail(fd);
+   if (::close(fd) != 0 || std::rename(tempPath.c_str(), path.c_str()) != 0)
+      return fail(-1);
+   return true;
+}
+
+void SnapshotWriter::addSection(std::string_view name, std::uint32_t recordSize, const void* data, std::uint64_t count)
+{
+   m_sections.push_back({std::string(name), recordSize, count,
+      std::string(static_cast<const char*>(data), static_cast<std::size_t>(count) * recordSize)});
+}
+
+}  // namespace geo
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "SnapshotFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace geo
+{
+
+// Snapshot maps a snapshot file with the local indexes of the server, see SnapshotFormat.h.
+// Opening checks the header and the section table only, so the server is ready as soon as the file is mapped:
+// sections are used in place, and their pages are read by the OS on first access.
+// Indexes take their sections by name and validate their own records.
+class Snapshot
+{
+public:
+   // Maps and validates the snapshot file.
+   // The snapshot is disabled (see IsOpen()) if the file cannot be mapped, or it is damaged or of another version.
+   // @param path Path of the snapshot file
+   explicit Snapshot(const std::string& path);
+
+   // Unmaps the snapshot file
+   ~Snapshot();
+
+   Snapshot(const Snapshot&) = delete;
+   Snapshot& operator=(const Snapshot&) = delete;
+
+   // Returns true if the snapshot is usable
+   bool IsOpen() const { return m_data != nullptr; }
+
+   // Returns the records of a section
+   // @param name Name of the section
+   // @return Records of the section, or std::nullopt if there is no such section or its records are of another size
+   template <typename T>
+   std::optional<std::span<const T>> GetSection(std::string_view name) const
+   {
+      static_assert(std::is_trivially_copyable_v<T>, "Records are used in place");
+      const SnapshotSection* section = findSection(name);
+      if (!section || section->recordSize != sizeof(T))
+         return std::nullopt;
+      return std::span<const T>(
+         reinterpret_cast<const T*>(static_cast<const char*>(m_data) + section->offset), section->count);
+   }
+
+   // Returns the section table
+   std::span<const SnapshotSection> GetSections() const { return {m_sections, m_numSections}; }
+
+   // Returns the size of the snapshot file in bytes
+   std::size_t GetSize() const { return m_bytes; }
+
+   // Checks the checksums of all sections, which reads the whole file
+   // @return Names of damaged sections, empty if the snapshot is intact
+   std::vector<std::string> Verify() const;
+
+private:
+   // Maps the file and validates its header and section table
+   bool open(const std::string& path);
+
+   // Unmaps the file
+   void close();
+
+   // Returns the entry of a section, or nullptr if there is no such section
+   const SnapshotSection* findSection(std::string_view name) const;
+
+private:
+   void* m_data = nullptr;                       // Mapping of the snapshot file
+   std::size_t m_bytes = 0;                      // Size of the mapping
+   const SnapshotSection* m_sections = nullptr;  // Section table
+   std::uint32_t m_numSections = 0;              // Number of sections
+};
+
+// SnapshotWriter collects sections of indexes and writes them as a snapshot file
+class SnapshotWriter
+{
+public:
+   // Adds a section
+   // @param name Name of the section, unique and shorter than sc_snapshotNameSize
+   // @param records Records of the section
+   template <typename T>
+   void AddSection(std::string_view name, const std::vector<T>& records)
+   {
+      static_assert(std::is_trivially_copyable_v<T>, "Records are used in place");
+      addSection(name, sizeof(T), records.data(), records.size());
+   }
+
+   // Writes the snapshot file. The file is written next to the previous one and renamed over it,
+   // so processes which map the previous file keep a complete image.
+   // @param path Path of the file
+   // @return false if a section name is invalid or the file cannot be written
+   bool Write(const std::string& path) const;
+
+private:
+   // Section with a copy of its records
+   struct Section
+   {
+      std::string name;          // Name of the section
+      std::uint32_t recordSize;  // Size of a record
+      std::uint64_t count;       // Number of records
+      std::string data;          // Records
+   };
+
+   // Adds a section of records of any type
+   void addSection(std::string_view name, std::uint32_t recordSize, const void* data, std::uint64_t count);
+
+private:
+   std::vector<Section> m_sections;  // Sections in the order of the file
+};
+
+}  // namespace geo
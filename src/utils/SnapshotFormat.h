@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+namespace geo
+{
+
+// Layout of a snapshot file, written by the geo-snapshot tool and mapped by Snapshot.
+// A snapshot is a single container for the local indexes of the server: a header, a table of sections,
+// and the sections themselves. Sections are arrays of fixed-size records, aligned to sc_snapshotAlignment bytes,
+// so the mapped file is used in place without parsing. Numbers are stored in the byte order of the host.
+// The header and the table have checksums which are checked on every start, the sections have checksums
+// which are checked by "geo-snapshot verify", as reading them all would defeat the lazy loading of pages.
+
+inline constexpr std::uint64_t sc_snapshotMagic = 0x5350414E534F4547ull;  // "GEOSNAPS"
+inline constexpr std::uint32_t sc_snapshotVersion = 1;                    // Changed on any change of the container
+inline constexpr std::uint64_t sc_snapshotAlignment = 64;                 // Alignment of sections, a cache line
+inline constexpr std::uint32_t sc_snapshotNameSize = 24;                  // Size of section names with the NUL
+
+// Header at the beginning of the file, followed by the table of sections
+struct SnapshotHeader
+{
+   std::uint64_t magic;        // sc_snapshotMagic
+   std::uint32_t version;      // sc_snapshotVersion
+   std::uint32_t numSections;  // Number of entries of the section table
+   std::uint64_t fileSize;     // Size of the file, so a truncated file is detected without reading it
+   std::uint32_t tableCrc;     // CRC-32 of the section table
+   std::uint32_t headerCrc;    // CRC-32 of the header up to this field
+};
+
+// Entry of the section table. Names are unique, e.g. "admin/places", and the prefix names the index.
+// Indexes keep the versions of their own layouts in sections of their own.
+struct SnapshotSection
+{
+   char name[sc_snapshotNameSize];  // NUL-terminated name of the section
+   std::uint32_t recordSize;        // Size of a record in bytes, checked against the type the reader expects
+   std::uint32_t crc;               // CRC-32 of the records
+   std::uint64_t offset;            // Offset of the first record in bytes, a multiple of sc_snapshotAlignment
+   std::uint64_t count;             // Number of records
+};
+
+static_assert(sizeof(SnapshotHeader) == 32 && sizeof(SnapshotSection) == 48, "Unexpected padding of records");
+
+}  // namespace geo
@@ -0,0 +1,227 @@
+#include "TextUtils.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+
+// Code point of invalid UTF-8 bytes
+constexpr char32_t sc_replacementCharacter = 0xFFFD;
+
+// Latin letters with diacritics and ligatures, in lower case without diacritics
+struct LatinRange
+{
+   char32_t first;       // First code point of the range
+   char32_t last;        // Last code point of the range
+   const char* folding;  // Folding of every letter of the range
+};
+
+// Latin-1 Supplement and Latin Extended-A, sorted by code points
+constexpr LatinRange sc_latinRanges[] = {
+   {0x00C0, 0x00C5, "a"}, {0x00C6, 0x00C6, "ae"}, {0x00C7, 0x00C7, "c"}, {0x00C8, 0x00CB, "e"},
+   {0x00CC, 0x00CF, "i"}, {0x00D0, 0x00D0, "d"}, {0x00D1, 0x00D1, "n"}, {0x00D2, 0x00D6, "o"},
+   {0x00D8, 0x00D8, "o"}, {0x00D9, 0x00DC, "u"}, {0x00DD, 0x00DD, "y"}, {0x00DE, 0x00DE, "th"},
+   {0x00DF, 0x00DF, "ss"}, {0x00E0, 0x00E5, "a"}, {0x00E6, 0x00E6, "ae"}, {0x00E7, 0x00E7, "c"},
+   {0x00E8, 0x00EB, "e"}, {0x00EC, 0x00EF, "i"}, {0x00F0, 0x00F0, "d"}, {0x00F1, 0x00F1, "n"},
+   {0x00F2, 0x00F6, "o"}, {0x00F8, 0x00F8, "o"}, {0x00F9, 0x00FC, "u"}, {0x00FD, 0x00FD, "y"},
+   {0x00FE, 0x00FE, "th"}, {0x00FF, 0x00FF, "y"}, {0x0100, 0x0105, "a"}, {0x0106, 0x010D, "c"},
+   {0x010E, 0x0111, "d"}, {0x0112, 0x011B, "e"}, {0x011C, 0x0123, "g"}, {0x0124, 0x0127, "h"},
+   {0x0128, 0x0131, "i"}, {0x0132, 0x0133, "ij"}, {0x0134, 0x0135, "j"}, {0x0136, 0x0138, "k"},
+   {0x0139, 0x0142, "l"}, {0x0143, 0x014B, "n"}, {0x014C, 0x0151, "o"}, {0x0152, 0x0153, "oe"},
+   {0x0154, 0x0159, "r"}, {0x015A, 0x0161, "s"}, {0x0162, 0x0167, "t"}, {0x0168, 0x0173, "u"},
+   {0x0174, 0x0175, "w"}, {0x0176, 0x0178, "y"}, {0x0179, 0x017E, "z"}, {0x017F, 0x017F, "s"}};
+
+// Checks if a character separates words of a name
+bool isSeparator(char32_t c)
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '-' || c == '.' || c == ',' || c == '/' ||
+          c == '(' || c == ')' || c == '_' || c == 0x00A0 || (c >= 0x2010 && c <= 0x2015);
+}
+
+// Checks if a character is removed from names
+bool isIgnored(char32_t c)
+{
+   return c == '\'' || c == 0x2019 || c == 0x02BC || (c >= 0x0300 && c <= 0x036F);
+}
+
+// Folds a Greek or Cyrillic letter to lower case without accents, returns other characters as they are
+char32_t foldLetter(char32_t c)
+{
+   // Greek
+   if (c >= 0x0391 && c <= 0x03A9 && c != 0x03A2)
+      return c + 0x20;
+
+   // Accented Greek letters, final sigma and Cyrillic "ё"
+   switch (c)
+   {
+   case 0x0386:
+   case 0x03AC:
+      return 0x03B1;
+   case 0x0388:
+   case 0x03AD:
+      return 0x03B5;
+   case 0x0389:
+   case 0x03AE:
+      return 0x03B7;
+   case 0x038A:
+   case 0x03AF:
+   case 0x0390:
+   case 0x03CA:
+      return 0x03B9;
+   case 0x038C:
+   case 0x03CC:
+      return 0x03BF;
+   case 0x038E:
+   case 0x03CD:
+   case 0x03B0:
+   case 0x03CB:
+      return 0x03C5;
+   case 0x038F:
+   case 0x03CE:
+      return 0x03C9;
+   case 0x03C2:
+      return 0x03C3;
+   case 0x0401:
+   case 0x0451:
+      return 0x0435;
+   default:
+      break;
+   }
+
+   // Cyrillic
+   if (c >= 0x0410 && c <= 0x042F)
+      return c + 0x20;
+   if (c >= 0x0400 && c <= 0x040F)
+      return c + 0x50;
+   if (((c >= 0x0460 && c <= 0x0481) || (c >= 0x048A && c <= 0x04BF) || (c >= 0x04D0 && c <= 0x052F)) && c % 2 == 0)
+      return c + 1;
+   if (c >= 0x04C1 && c <= 0x04CE && c % 2 == 1)
+      return c + 1;
+   if (c == 0x04C0)
+      return 0x04CF;
+   return c;
+}
+
+}  // namespace
+
+namespace geo
+{
+
+char32_t DecodeUtf8(std::string_view text, std::size_t& position)
+{
+   const auto lead = static_cast<unsigned char>(text[position++]);
+   if (lead < 0x80)
+      return lead;
+
+   std::size_t length = 0;
+   char32_t codePoint = 0;
+   char32_t minimum = 0;
+   if ((lead & 0xE0) == 0xC0)
+   {
+      length = 1;
+      codePoint = lead & 0x1F;
+      minimum = 0x80;
+   }
+   else if ((lead & 0xF0) == 0xE0)
+   {
+      length = 2;
+      codePoint = lead & 0x0F;
+      minimum = 0x800;
+   }
+   else if ((lead & 0xF8) == 0xF0)
+   {
+      length = 3;
+      codePoint = lead & 0x07;
+      minimum = 0x10000;
+   }
+   else
+      return sc_replacementCharacter;
+
+   if (text.size() - position < length)
+      return sc_replacementCharacter;
+   for (std::size_t i = 0; i < length; ++i)
+   {
+      const auto next = static_cast<unsigned char>(text[position + i]);
+      if ((next & 0xC0) != 0x80)
+         return sc_replacementCharacter;
+      codePoint = (codePoint << 6) | (next & 0x3F);
+   }
+
+   // Overlong encodings, surrogates and code points above U+10FFFF are invalid.
+   if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+      return sc_replacementCharacter;
+   position += length;
+   return codePoint;
+}
+
+void AppendUtf8(std::string& text, char32_t codePoint)
+{
+   if (codePoint < 0x80)
+      text += static_cast<char>(codePoint);
+   else if (codePoint < 0x800)
+   {
+      text += static_cast<char>(0xC0 | (codePoint >> 6));
+      text += static_cast<char>(0x80 | (codePoint & 0x3F));
+   }
+   else if (codePoint < 0x10000)
+   {
+      text += static_cast<char>(0xE0 | (codePoint >> 12));
+      text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      text += static_cast<char>(0x80 | (codePoint & 0x3F));
+   }
+   else
+   {
+      text += static_cast<char>(0xF0 | (codePoint >> 18));
+      text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+      text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      text += static_cast<char>(0x80 | (codePoint & 0x3F));
+   }
+}
+
+std::string FoldName(std::string_view name)
+{
+   std::string result;
+   result.reserve(name.size());
+
+   // A separator is written only before the next word, so there are no spaces at the ends.
+   bool needSeparator = false;
+   std::size_t position = 0;
+   while (position < name.size())
+   {
+      const char32_t c = DecodeUtf8(name, position);
+      if (isIgnored(c))
+         continue;
+      if (isSeparator(c))
+      {
+         needSeparator = !result.empty();
+         continue;
+      }
+
+      if (needSeparator)
+         result += ' ';
+      needSeparator = false;
+
+      if (c >= 'A' && c <= 'Z')
+         result += static_cast<char>(c + ('a' - 'A'));
+      else if (c < 0x80)
+         result += static_cast<char>(c);
+      else if (c >= sc_latinRanges[0].first && c <= std::prev(std::end(sc_latinRanges))->last)
+      {
+         const auto range = std::upper_bound(std::begin(sc_latinRanges), std::end(sc_latinRanges), c,
+            [](char32_t value, const LatinRange& r)
+            {
+               return value < r.first;
+            });
+         if (range != std::begin(sc_latinRanges) && c <= std::prev(range)->last)
+            result += std::prev(range)->folding;
+         else
+            AppendUtf8(result, c);  // Multiplication and division signs
+      }
+      else
+         AppendUtf8(result, foldLetter(c));
+   }
+   return result;
+}
+
+}  // namespace geo
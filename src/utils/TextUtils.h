@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace geo
+{
+
+// Decodes the UTF-8 character at a position of a text
+// @param text Text in UTF-8
+// @param position Position of the first byte of the character, moved past the character.
+//    An invalid byte is decoded as U+FFFD and skipped alone, so decoding always advances.
+// @return Code point of the character
+char32_t DecodeUtf8(std::string_view text, std::size_t& position);
+
+// Appends a character to a text in UTF-8
+// @param text Text to append to
+// @param codePoint Code point of the character
+void AppendUtf8(std::string& text, char32_t codePoint);
+
+// Folds a name for comparison, so names which differ only in case or accents are equal, e.g. "München",
+// "MUNCHEN" and "munchen". Letters are lower-cased (Latin, Greek, Cyrillic), Latin letters lose diacritics
+// and ligatures are spelled out ("ß" is "ss", "æ" is "ae"), Greek letters lose accents, "ё" is "е",
+// combining marks are removed, and runs of spaces, hyphens and punctuation become a single space.
+// Other characters are kept as they are.
+// @param name Name in UTF-8
+// @return Folded name in UTF-8
+std::string FoldName(std::string_view name);
+
+}  // namespace geo
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "DiskCache.h"
+#include "ShardedLruCache.h"
+
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <optional>
+#include <string>
+
+namespace geo
+{
+
+// Two-level cache: a ShardedLruCache in memory in front of an optional DiskCache, which is shared by all caches
+// of the server and survives restarts. Entries missing in memory are looked up on disk and promoted to memory
+// for the rest of their lifetime. New entries are written to both levels.
+// @tparam TKey Key type, must be formattable with std::format
+// @tparam TValue Value type
+// @tparam TSizeOf Functor which returns estimated dynamic memory used by a value in bytes
+// @tparam TCodec Converts values to bytes and back: static std::string Encode(const TValue&)
+//                and static std::optional<TValue> Decode(std::string_view)
+template <typename TKey, typename TValue, typename TSizeOf, typename TCodec>
+class TieredCache
+{
+public:
+   // @param capacityBytes Maximum estimated memory used by entries in memory
+   // @param ttl Time after which an entry expires
+   // @param diskCache Optional disk level, must outlive the cache
+   // @param diskKeyPrefix Prefix of disk keys, which separates entries of different caches sharing the disk level
+   TieredCache(std::size_t capacityBytes, std::chrono::seconds ttl, DiskCache* diskCache, std::string diskKeyPrefix)
+      : m_memory(capacityBytes, ttl)
+      , m_ttl(ttl)
+      , m_disk(diskCache && diskCache->IsOpen() ? diskCache : nullptr)
+      , m_diskKeyPrefix(std::move(diskKeyPrefix))
+   {
+   }
+
+   // Looks up a fresh entry in memory, then on disk
+   // @param key Key to look up
+   // @return Copy of the value, or std::nullopt if there is no fresh entry
+   std::optional<TValue> Get(const TKey& key)
+   {
+      if (auto value = m_memory.Get(key))
+         return value;
+      if (!m_disk)
+         return std::nullopt;
+
+      auto entry = m_disk->Get(diskKey(key));
+      if (!entry)
+         return std::nullopt;
+      auto value = TCodec::Decode(entry->value);
+      if (value)
+         m_memory.Put(key, *value, entry->expiresAt - DiskCache::Clock::now());
+      return value;
+   }
+
+   // Adds or replaces an entry on both levels
+   // @param key Key of the entry
+   // @param value Value of the entry
+   void Put(const TKey& key, const TValue& value)
+   {
+      if (m_disk)
+         m_disk->Put(diskKey(key), TCodec::Encode(value), m_ttl);
+      m_memory.Put(key, value);
+   }
+
+   // Returns counters of usage of the memory level, the disk level reports its own counters
+   CacheStats GetStats() const { return m_memory.GetStats(); }
+
+private:
+   std::string diskKey(const TKey& key) const { return std::format("{}{}", m_diskKeyPrefix, key); }
+
+private:
+   ShardedLruCache<TKey, TValue, TSizeOf> m_memory;  // Memory level
+   const std::chrono::seconds m_ttl;                  // Time after which an entry expires
+   DiskCache* const m_disk;                           // Disk level, null if disabled
+   const std::string m_diskKeyPrefix;                 // Prefix of disk keys
+};
+
+}  // namespace geo
@@ -2,6 +2,9 @@
 
 #include "TimeUtils.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <limits>
 #include <vector>
 
 namespace geo
@@ -17,4 +20,34 @@ struct WeatherInfo
 
 using WeatherInfoVector = std::vector<WeatherInfo>;
 
+// Weather aggregated over a number of days, see WeatherRequest in geo.proto
+struct WeatherAggregate
+{
+   double temperatureMin = std::numeric_limits<double>::infinity();
+   double temperatureMax = -std::numeric_limits<double>::infinity();
+   double temperatureSum = 0;  // Sum of daily average temperatures
+   std::size_t numDays = 0;    // Number of aggregated days
+
+   // Adds values of one day
+   void Add(const WeatherInfo& info)
+   {
+      temperatureMin = std::min(temperatureMin, info.temperatureMin);
+      temperatureMax = std::max(temperatureMax, info.temperatureMax);
+      temperatureSum += info.temperatureAverage;
+      ++numDays;
+   }
+
+   // Adds values of another aggregate
+   void Merge(const WeatherAggregate& other)
+   {
+      temperatureMin = std::min(temperatureMin, other.temperatureMin);
+      temperatureMax = std::max(temperatureMax, other.temperatureMax);
+      temperatureSum += other.temperatureSum;
+      numDays += other.numDays;
+   }
+
+   // Returns average temperature of aggregated days
+   double GetAverage() const { return numDays ? temperatureSum / numDays : 0; }
+};
+
 }  // namespace geo
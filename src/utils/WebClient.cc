@@ -1,15 +1,24 @@
 #include "WebClient.h"
 
+#include "WebEventLoop.h"
+
 #include <absl/log/log.h>
 #include <curl/curl.h>
 #include <curl/easy.h>
 
+#include <algorithm>
 #include <format>
+#include <future>
+#include <mutex>
 #include <stdexcept>
+#include <string_view>
+#include <vector>
 
 namespace
 {
 
+using namespace geo;
+
 // Callback function for CURL to write received data into string buffer
 // @param contents Pointer to the delivered data
 // @param size Always 1
@@ -22,6 +31,26 @@ size_t curlWriteFunction(void* contents, size_t size, size_t nmemb, void* userp)
    return size * nmemb;
 }
 
+// Callback function for CURL to pass received data to the consumer of a streamed response
+// @param contents Pointer to the delivered data
+// @param size Always 1
+// @param nmemb Size of the data
+// @param userp Pointer to user data (chunk handler in our case)
+// @return Number of bytes actually taken care of, anything else aborts the transfer
+size_t curlStreamFunction(void* contents, size_t size, size_t nmemb, void* userp)
+{
+   const std::string_view chunk(static_cast<const char*>(contents), size * nmemb);
+   try
+   {
+      return (*static_cast<WebClient::ChunkHandler*>(userp))(chunk) ? chunk.size() : 0;
+   }
+   catch (const std::exception& e)
+   {
+      LOG(ERROR) << std::format("Cannot consume response: {}", e.what());
+      return 0;
+   }
+}
+
 // Template helper function to set CURL options with error handling
 // @param curl CURL handle to set option on
 // @param opt CURL option to set
@@ -34,6 +63,79 @@ void setCurlOpt(TCurl curl, TOptionKey opt, TOptionValue val)
       throw std::runtime_error(std::format("cURL error: {0}", curl_easy_strerror(res)));
 }
 
+// Template helper function to set CURL share options with error handling
+// @param share CURL share handle to set option on
+// @param opt CURL share option to set
+// @param val Value to set for the option
+template <typename TOptionKey, typename TOptionValue>
+void setCurlShareOpt(CURLSH* share, TOptionKey opt, TOptionValue val)
+{
+   const auto res = curl_share_setopt(share, opt, val);
+   if (res != CURLSHE_OK)
+      throw std::runtime_error(std::format("cURL share error: {0}", curl_share_strerror(res)));
+}
+
+// Converts a response handler to a callback of a coalesced request, which receives a shared response
+// @param handler Handler to convert
+// @return Callback which passes a copy of the shared response to the handler
+SingleFlight<std::string>::Callback toFlightCallback(WebClient::ResponseHandler handler)
+{
+   return [handler = std::move(handler)](const std::string& response)
+   {
+      handler(response);
+   };
+}
+
+// Normalizes a GET query, so equivalent queries with different parameter order are coalesced
+// @param query Query string, i.e. parameters separated by '&'
+// @return Query string with sorted parameters
+std::string normalizeQuery(const std::string& query)
+{
+   std::vector<std::string_view> params;
+   for (std::size_t begin = 0; begin <= query.size();)
+   {
+      const std::size_t end = std::min(query.find('&', begin), query.size());
+      if (end > begin)
+         params.emplace_back(query.data() + begin, end - begin);
+      begin = end + 1;
+   }
+   std::sort(params.begin(), params.end());
+
+   std::string result;
+   result.reserve(query.size());
+   for (const auto& param : params)
+   {
+      if (!result.empty())
+         result += '&';
+      result += param;
+   }
+   return result;
+}
+
+// Normalizes a POST body, so bodies differing only in surrounding whitespace are coalesced
+// @param body Request body
+// @return Body without leading and trailing whitespace
+std::string normalizeBody(const std::string& body)
+{
+   const auto begin = body.find_first_not_of(" \t\r\n");
+   if (begin == std::string::npos)
+      return {};
+   const auto end = body.find_last_not_of(" \t\r\n");
+   return body.substr(begin, end - begin + 1);
+}
+
+// Initializes libcurl once per process.
+// curl_global_init() is not thread-safe, so it must not be called implicitly by concurrent curl_easy_init() calls.
+void initCurlOnce()
+{
+   static std::once_flag s_initFlag;
+   std::call_once(s_initFlag,
+      []
+      {
+         curl_global_init(CURL_GLOBAL_DEFAULT);
+      });
+}
+
 // Template helper function to safely execute a function and log errors
 // @param f Function to execute safely
 // @return true if function executed successfully, false if exception was caught
@@ -57,26 +159,293 @@ bool safeCall(TUnsafe f)
 namespace geo
 {
 
-WebClient::WebClient(std::string url, std::uint64_t writeTimeoutMs)
+WebClient::SharedCache::SharedCache()
+{
+   initCurlOnce();
+
+   m_share = curl_share_init();
+   if (!m_share)
+   {
+      LOG(ERROR) << "Cannot create cURL share instance. DNS and TLS sessions are not shared.";
+      return;
+   }
+
+   if (!safeCall(
+          [&]
+          {
+             setCurlShareOpt(m_share, CURLSHOPT_LOCKFUNC, lock);
+             setCurlShareOpt(m_share, CURLSHOPT_UNLOCKFUNC, unlock);
+             setCurlShareOpt(m_share, CURLSHOPT_USERDATA, this);
+             setCurlShareOpt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+             setCurlShareOpt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+          }))
+   {
+      curl_share_cleanup(m_share);
+      m_share = nullptr;
+   }
+}
+
+WebClient::SharedCache::~SharedCache()
+{
+   if (m_share)
+      curl_share_cleanup(m_share);
+}
+
+void WebClient::SharedCache::lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr)
+{
+   static_cast<SharedCache*>(userptr)->m_locks[data].lock();
+}
+
+void WebClient::SharedCache::unlock(CURL*, curl_lock_data data, void* userptr)
+{
+   static_cast<SharedCache*>(userptr)->m_locks[data].unlock();
+}
+
+WebClient::HandlePool::~HandlePool()
+{
+   for (auto* curl : m_idleHandles)
+      curl_easy_cleanup(curl);
+}
+
+CURL* WebClient::HandlePool::Take()
+{
+   std::lock_guard lock(m_mutex);
+   if (m_idleHandles.empty())
+      return nullptr;
+   CURL* curl = m_idleHandles.back();
+   m_idleHandles.pop_back();
+   return curl;
+}
+
+void WebClient::HandlePool::Release(CURL* curl)
+{
+   {
+      std::lock_guard lock(m_mutex);
+      if (m_idleHandles.size() < sc_maxIdleHandles)
+      {
+         m_idleHandles.push_back(curl);
+         return;
+      }
+   }
+   curl_easy_cleanup(curl);
+}
+
+WebClient::WebClient(std::string url, std::uint64_t writeTimeoutMs, std::size_t maxOngoingRequests)
    : m_url(std::move(url))
    , m_writeTimeoutMs(writeTimeoutMs)
+   , m_pool(std::make_shared<HandlePool>())
+   , m_maxOngoingRequests(maxOngoingRequests)
 {
 }
 
+WebClient::~WebClient()
+{
+   const auto stats = GetPoolStats();
+   LOG(INFO) << std::format("cURL pool of {}: {} hits, {} misses; {} transfers over reused connections, {} over new",
+      m_url, stats.hits, stats.misses, stats.reusedConnections, stats.newConnections);
+   const auto coalescing = GetCoalescingStats();
+   LOG(INFO) << std::format("Requests to {}: {} sent, {} coalesced with identical requests in flight", m_url,
+      coalescing.leaders, coalescing.followers);
+}
+
+WebClient::PoolStats WebClient::GetPoolStats() const
+{
+   return {m_poolHits.load(), m_poolMisses.load(), m_reusedConnections.load(), m_newConnections.load()};
+}
+
 std::string WebClient::Get(const std::string& request)
+{
+   return GetAsync(request).get();
+}
+
+std::string WebClient::Post(const std::string& data)
+{
+   return PostAsync(data).get();
+}
+
+std::future<std::string> WebClient::GetAsync(const std::string& request)
+{
+   auto promise = std::make_shared<std::promise<std::string>>();
+   auto future = promise->get_future();
+   GetAsync(request,
+      [promise](std::string response)
+      {
+         promise->set_value(std::move(response));
+      });
+   return future;
+}
+
+std::future<std::string> WebClient::PostAsync(const std::string& data)
+{
+   auto promise = std::make_shared<std::promise<std::string>>();
+   auto future = promise->get_future();
+   PostAsync(data,
+      [promise](std::string response)
+      {
+         promise->set_value(std::move(response));
+      });
+   return future;
+}
+
+void WebClient::GetAsync(const std::string& request, ResponseHandler handler)
+{
+   // Identical requests in flight share one transfer
+   const std::string key = "GET " + normalizeQuery(request);
+   if (!m_flights.Join(key, toFlightCallback(std::move(handler))))
+      return;
+
+   schedule(
+      [this, request, key]
+      {
+         auto buffers = std::make_shared<TransferBuffers>();
+         startGet(request, buffers, releaseSlotBefore(respondWith(buffers, completeFlight(key))));
+      });
+}
+
+void WebClient::PostAsync(const std::string& data, ResponseHandler handler)
+{
+   // Identical requests in flight share one transfer
+   const std::string key = "POST " + normalizeBody(data);
+   if (!m_flights.Join(key, toFlightCallback(std::move(handler))))
+      return;
+
+   schedule(
+      [this, data, key]
+      {
+         auto buffers = std::make_shared<TransferBuffers>();
+         buffers->data = data;
+         startPost(buffers, releaseSlotBefore(respondWith(buffers, completeFlight(key))));
+      });
+}
+
+void WebClient::GetTimedAsync(const std::string& request, TimedResponseHandler handler)
+{
+   // Only the request which makes the transfer receives its duration, joined requests keep it empty.
+   const auto transferTime = std::make_shared<std::optional<std::chrono::microseconds>>();
+   const std::string key = "GET " + normalizeQuery(request);
+   if (!m_flights.Join(key,
+          [handler = std::move(handler), transferTime](const std::string& response)
+          {
+             handler(response, *transferTime);
+          }))
+   {
+      return;
+   }
+
+   schedule(
+      [this, request, key, transferTime]
+      {
+         auto buffers = std::make_shared<TransferBuffers>();
+         auto respond = respondWith(buffers, completeFlight(key));
+         startGet(request, buffers,
+            releaseSlotBefore(
+               [buffers, transferTime, respond = std::move(respond)](bool succeeded)
+               {
+                  if (succeeded)
+                     *transferTime = buffers->transferTime;
+                  respond(succeeded);
+               }));
+      });
+}
+
+void WebClient::PostStreamAsync(const std::string& data, ChunkHandler onChunk, StreamHandler onComplete)
+{
+   auto buffers = std::make_shared<TransferBuffers>();
+   buffers->data = data;
+   buffers->onChunk = std::move(onChunk);
+   schedule(
+      [this, buffers, onComplete = std::move(onComplete)]
+      {
+         startPost(buffers, releaseSlotBefore(onComplete));
+      });
+}
+
+SingleFlightStats WebClient::GetCoalescingStats() const
+{
+   return m_flights.GetStats();
+}
+
+// Returns the transfer handler which passes the buffered response to the handler
+WebClient::StreamHandler WebClient::respondWith(std::shared_ptr<TransferBuffers> buffers, ResponseHandler handler)
+{
+   return [buffers = std::move(buffers), handler = std::move(handler)](bool succeeded)
+   {
+      handler(succeeded ? std::move(buffers->response) : std::string());
+   };
+}
+
+// Returns the handler which passes the response to all callers joined to the flight
+WebClient::ResponseHandler WebClient::completeFlight(const std::string& key)
+{
+   return [this, key](std::string response)
+   {
+      m_flights.Complete(key, response);
+   };
+}
+
+std::size_t WebClient::GetOngoingRequests() const
+{
+   std::lock_guard lock(m_limitMutex);
+   return m_ongoingRequests;
+}
+
+// Starts the request right away if the limit of ongoing requests allows, otherwise queues it
+void WebClient::schedule(std::function<void()> start)
+{
+   {
+      std::lock_guard lock(m_limitMutex);
+      if (m_maxOngoingRequests && m_ongoingRequests >= m_maxOngoingRequests)
+      {
+         m_waitingRequests.push_back(std::move(start));
+         return;
+      }
+      ++m_ongoingRequests;
+   }
+   start();
+}
+
+// Passes the slot of a finished request to the next queued request, or frees it
+void WebClient::releaseSlot()
+{
+   std::function<void()> next;
+   {
+      std::lock_guard lock(m_limitMutex);
+      if (m_waitingRequests.empty())
+      {
+         --m_ongoingRequests;
+         return;
+      }
+      next = std::move(m_waitingRequests.front());
+      m_waitingRequests.pop_front();
+   }
+   next();
+}
+
+// Wraps the handler, so the next queued request is started as soon as the response is received
+WebClient::StreamHandler WebClient::releaseSlotBefore(StreamHandler handler)
+{
+   return [this, handler = std::move(handler)](bool succeeded)
+   {
+      releaseSlot();
+      handler(succeeded);
+   };
+}
+
+void WebClient::startGet(const std::string& request, std::shared_ptr<TransferBuffers> buffers, StreamHandler handler)
 {
    if (request.empty())
    {
       LOG(ERROR) << "Empty request passed.";
-      return "";
+      handler(false);
+      return;
    }
 
-   std::string response;
-   auto curl = createCurl(m_url + "?" + request, m_writeTimeoutMs, &response);
+   auto curl = createCurl(m_url + "?" + request, *buffers);
    if (!curl)
    {
       LOG(ERROR) << "Cannot create cURL instance. Data is not sent.";
-      return "";
+      handler(false);
+      return;
    }
 
 #ifdef NDEBUG
@@ -85,44 +454,60 @@ std::string WebClient::Get(const std::string& request)
    LOG(INFO) << std::format("Starting HTTP GET request to {}, request:\n{}", m_url, request);
 #endif
 
-   if (!perform(curl))
-   {
-      LOG(INFO) << std::format("HTTP GET request to {} finished with error (request = {})", m_url, request);
-      return "";
-   }
+   CURL* handle = curl.get();
+   WebEventLoop::Instance().Start(std::move(curl),
+      [this, handle, buffers, request, handler = std::move(handler)](CURLcode result)
+      {
+         if (!checkResult(handle, result))
+         {
+            LOG(INFO) << std::format("HTTP GET request to {} finished with error (request = {})", m_url, request);
+            handler(false);
+            return;
+         }
+         countConnections(handle);
+
+         // The total time is measured from the start of the transfer, after the request left the queue.
+         curl_off_t transferTime = 0;
+         if (curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &transferTime) == CURLE_OK)
+            buffers->transferTime = std::chrono::microseconds(transferTime);
 
 #ifdef NDEBUG
-   LOG(INFO) << std::format("HTTP GET request to {} finished", m_url);
+         LOG(INFO) << std::format("HTTP GET request to {} finished", m_url);
 #else
-   LOG(INFO) << std::format("HTTP GET request to {} finished, response:\n{}", m_url, response);
+         LOG(INFO) << std::format("HTTP GET request to {} finished, response:\n{}", m_url, buffers->response);
 #endif
-   return response;
+         handler(true);
+      });
 }
 
-std::string WebClient::Post(const std::string& data)
+void WebClient::startPost(std::shared_ptr<TransferBuffers> buffers, StreamHandler handler)
 {
+   const std::string& data = buffers->data;
    if (data.empty())
    {
       LOG(ERROR) << "Empty data passed.";
-      return "";
+      handler(false);
+      return;
    }
 
-   std::string response;
-   auto curl = createCurl(m_url, m_writeTimeoutMs, &response);
+   auto curl = createCurl(m_url, *buffers);
    if (!curl)
    {
       LOG(ERROR) << "Cannot create cURL instance. Data is not sent.";
-      return "";
+      handler(false);
+      return;
    }
 
    if (!safeCall(
           [&]
           {
              setCurlOpt(curl, CURLOPT_POST, 1L);
-             setCurlOpt(curl, CURLOPT_POSTFIELDS, data.c_str());
+             setCurlOpt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(buffers->data.size()));
+             setCurlOpt(curl, CURLOPT_POSTFIELDS, buffers->data.c_str());
           }))
    {
-      return "";
+      handler(false);
+      return;
    }
 
 #ifdef NDEBUG
@@ -131,31 +516,52 @@ std::string WebClient::Post(const std::string& data)
    LOG(INFO) << std::format("Starting HTTP POST request to {}, data:\n{}", m_url, data);
 #endif
 
-   if (!perform(curl))
-   {
-      LOG(INFO) << std::format("HTTP POST request to {} finished with error (data = {})", m_url, data);
-      return "";
-   }
+   CURL* handle = curl.get();
+   WebEventLoop::Instance().Start(std::move(curl),
+      [this, handle, buffers, handler = std::move(handler)](CURLcode result)
+      {
+         if (!checkResult(handle, result))
+         {
+            LOG(INFO) << std::format(
+               "HTTP POST request to {} finished with error (data = {})", m_url, buffers->data);
+            handler(false);
+            return;
+         }
+         countConnections(handle);
 
 #ifdef NDEBUG
-   LOG(INFO) << std::format("HTTP POST request to {} finished", m_url);
+         LOG(INFO) << std::format("HTTP POST request to {} finished", m_url);
 #else
-   LOG(INFO) << std::format("HTTP POST request to {} finished, response:\n{}", m_url, response);
+         LOG(INFO) << std::format("HTTP POST request to {} finished, response:\n{}", m_url,
+            buffers->onChunk ? "(streamed)" : buffers->response);
 #endif
-   return response;
+         handler(true);
+      });
 }
 
-// Creates and configures a CURL instance with specified URL, timeout, and response buffer
-WebClient::CurlPtr WebClient::createCurl(
-   const std::string& url, std::uint64_t writeTimeoutMs, std::string* responseBuffer)
+// Takes a pooled CURL instance (or creates a new one) and configures it with specified URL and response buffers
+WebClient::CurlPtr WebClient::createCurl(const std::string& url, TransferBuffers& buffers)
 {
-   auto curl = CurlPtr(curl_easy_init(),
-      [](auto p)
+   CURL* handle = m_pool->Take();
+   if (handle)
+   {
+      // Options are reset, DNS and TLS session caches are kept in the shared cache
+      curl_easy_reset(handle);
+      ++m_poolHits;
+   }
+   else
+   {
+      handle = curl_easy_init();
+      if (!handle)
+         return nullptr;
+      ++m_poolMisses;
+   }
+
+   auto curl = CurlPtr(handle,
+      [pool = m_pool](auto p)
       {
-         curl_easy_cleanup(p);
+         pool->Release(p);
       });
-   if (!curl)
-      return nullptr;
 
    if (!safeCall(
           [&]
@@ -163,11 +569,26 @@ WebClient::CurlPtr WebClient::createCurl(
              setCurlOpt(curl, CURLOPT_URL, url.c_str());
              setCurlOpt(curl, CURLOPT_SSL_VERIFYPEER, 0L);  // Disable SSL peer verification
              setCurlOpt(curl, CURLOPT_SSL_VERIFYHOST, 0L);  // Disable SSL host verification
-             setCurlOpt(curl, CURLOPT_TIMEOUT_MS, writeTimeoutMs);
-             setCurlOpt(curl, CURLOPT_WRITEFUNCTION, curlWriteFunction);
-             setCurlOpt(curl, CURLOPT_WRITEDATA, responseBuffer);
+             setCurlOpt(curl, CURLOPT_TIMEOUT_MS, m_writeTimeoutMs);
+             if (buffers.onChunk)
+             {
+                setCurlOpt(curl, CURLOPT_WRITEFUNCTION, curlStreamFunction);
+                setCurlOpt(curl, CURLOPT_WRITEDATA, &buffers.onChunk);
+             }
+             else
+             {
+                setCurlOpt(curl, CURLOPT_WRITEFUNCTION, curlWriteFunction);
+                setCurlOpt(curl, CURLOPT_WRITEDATA, &buffers.response);
+             }
              setCurlOpt(curl, CURLOPT_FAILONERROR, 1L);  // Fail on HTTP errors (4xx, 5xx)
              setCurlOpt(curl, CURLOPT_USERAGENT, "geo-service/0.1");
+             setCurlOpt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);  // HTTP/2 over TLS if supported
+             setCurlOpt(curl, CURLOPT_TCP_KEEPALIVE, 1L);  // Keep idle cached connections alive
+             setCurlOpt(curl, CURLOPT_TCP_KEEPIDLE, 60L);
+             setCurlOpt(curl, CURLOPT_TCP_KEEPINTVL, 30L);
+             setCurlOpt(curl, CURLOPT_PIPEWAIT, 1L);  // Prefer waiting for a multiplexed HTTP/2 connection
+             if (m_pool->GetShare())
+                setCurlOpt(curl, CURLOPT_SHARE, m_pool->GetShare());
           }))
    {
       return nullptr;
@@ -176,14 +597,13 @@ WebClient::CurlPtr WebClient::createCurl(
    return curl;
 }
 
-// Executes CURL request and handles potential errors
-bool WebClient::perform(const CurlPtr& curl)
+// Checks result of a finished CURL request and logs potential errors
+bool WebClient::checkResult(CURL* curl, CURLcode res)
 {
-   const auto res = curl_easy_perform(curl.get());
    if (res == CURLE_HTTP_RETURNED_ERROR)
    {
       long httpErrorCode = 0;
-      curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &httpErrorCode);
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpErrorCode);
       LOG(ERROR) << std::format("HTTP error code: {}", httpErrorCode);
       return false;
    }
@@ -195,4 +615,16 @@ bool WebClient::perform(const CurlPtr& curl)
    return true;
 }
 
+// A transfer which opened no connection was sent over one from the connection cache of the multi handle
+void WebClient::countConnections(CURL* curl)
+{
+   long numConnects = 0;
+   if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &numConnects) != CURLE_OK)
+      return;
+   if (numConnects == 0)
+      ++m_reusedConnections;
+   else
+      ++m_newConnections;
+}
+
 }  // namespace geo
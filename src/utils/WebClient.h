@@ -1,9 +1,22 @@
 #pragma once
 
+#include "SingleFlight.h"
+
 #include <curl/curl.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace geo
 {
@@ -11,43 +24,232 @@ namespace geo
 class WebClient
 {
 public:
-   static const int sc_defaultTimeoutMs = 180'000;  // Default timeout in milliseconds (180 seconds)
+   static const int sc_defaultTimeoutMs = 180'000;   // Default timeout in milliseconds (180 seconds)
+   static const std::size_t sc_maxIdleHandles = 16;  // Maximum number of idle cURL handles kept in the pool
+
+   // Counters of cURL handle and connection reuse, see GetPoolStats().
+   // Connections are kept by the connection cache of WebEventLoop, not by the handles, so reuse of a handle
+   // does not mean reuse of a connection, and both are counted.
+   struct PoolStats
+   {
+      std::uint64_t hits = 0;               // Number of requests served by an idle handle of the pool
+      std::uint64_t misses = 0;             // Number of requests which had to create a new handle
+      std::uint64_t reusedConnections = 0;  // Number of successful transfers over an already open connection
+      std::uint64_t newConnections = 0;     // Number of successful transfers which opened a connection
+   };
 
 public:
-   // Constructor taking base URL and optional write timeout in milliseconds
+   // Constructor taking base URL, optional write timeout in milliseconds and optional limit of ongoing requests
    // @param address The base URL for web requests
    // @param writeTimeoutMs Timeout value for write operations in milliseconds (default: sc_defaultTimeoutMs)
-   WebClient(std::string address, std::uint64_t writeTimeoutMs = sc_defaultTimeoutMs);
+   // @param maxOngoingRequests Maximum number of requests in flight to this endpoint, 0 means no limit.
+   //                           Requests above the limit are queued and started as soon as others finish.
+   WebClient(std::string address, std::uint64_t writeTimeoutMs = sc_defaultTimeoutMs,
+      std::size_t maxOngoingRequests = 0);
+
+   // Destructor releases the pool of cURL handles, which is destroyed with the last handle still in use.
+   // All asynchronous requests of the client must be finished before it is destroyed.
+   ~WebClient();
+
+   WebClient(const WebClient&) = delete;
+   WebClient& operator=(const WebClient&) = delete;
+
+   // Handler of an asynchronous request, receives the server response, or empty string on error.
+   // It is called on the I/O thread of WebEventLoop, so it must be short and must not block.
+   // If the request cannot be started, it is called immediately on the calling thread.
+   using ResponseHandler = std::function<void(std::string)>;
+
+   // Handler of an asynchronous request, receives the server response like ResponseHandler, and the duration
+   // of the transfer measured by cURL from its start, so the time the request waited for a free slot is not included.
+   // The duration is given only to the request which made the transfer: it is empty on error, and for requests
+   // which joined an identical request in flight, so every transfer is measured once.
+   using TimedResponseHandler = std::function<void(std::string, std::optional<std::chrono::microseconds>)>;
 
-   // Performs HTTP GET request with provided request string and returns response
+   // Consumer of a streamed response, receives chunks of the response body as they arrive.
+   // It is called on the I/O thread of WebEventLoop, so it must be short and must not block.
+   // @return false to abort the transfer
+   using ChunkHandler = std::function<bool(std::string_view)>;
+
+   // Handler of a streamed request, receives true if the whole response was received and consumed.
+   // It is called on the I/O thread of WebEventLoop after the last chunk.
+   // If the request cannot be started, it is called immediately on the calling thread.
+   using StreamHandler = std::function<void(bool)>;
+
+   // Performs HTTP GET request with provided request string and returns response.
+   // Blocks the calling thread, must not be called from a ResponseHandler.
    // @param request The request string to append to the base URL
    // @return The server response as string, or empty string on error
    std::string Get(const std::string& request);
 
-   // Performs HTTP POST request with provided data and returns response
+   // Performs HTTP POST request with provided data and returns response.
+   // Blocks the calling thread, must not be called from a ResponseHandler.
    // @param data The data to send in the POST request body
    // @return The server response as string, or empty string on error
    std::string Post(const std::string& data);
 
+   // Starts HTTP GET request with provided request string
+   // @param request The request string to append to the base URL
+   // @return Future of the server response as string, or empty string on error
+   std::future<std::string> GetAsync(const std::string& request);
+
+   // Starts HTTP POST request with provided data
+   // @param data The data to send in the POST request body
+   // @return Future of the server response as string, or empty string on error
+   std::future<std::string> PostAsync(const std::string& data);
+
+   // Starts HTTP GET request with provided request string
+   // @param request The request string to append to the base URL
+   // @param handler Handler to call with the server response
+   void GetAsync(const std::string& request, ResponseHandler handler);
+
+   // Starts HTTP POST request with provided data
+   // @param data The data to send in the POST request body
+   // @param handler Handler to call with the server response
+   void PostAsync(const std::string& data, ResponseHandler handler);
+
+   // Starts HTTP GET request with provided request string, and measures its transfer
+   // @param request The request string to append to the base URL
+   // @param handler Handler to call with the server response and the duration of the transfer
+   void GetTimedAsync(const std::string& request, TimedResponseHandler handler);
+
+   // Starts HTTP POST request with provided data and passes the response to a consumer while it arrives,
+   // so the response is never kept in memory as a whole. Streamed requests are not coalesced.
+   // @param data The data to send in the POST request body
+   // @param onChunk Consumer of the response body
+   // @param onComplete Handler to call when the transfer is finished
+   void PostStreamAsync(const std::string& data, ChunkHandler onChunk, StreamHandler onComplete);
+
+   // Returns the base URL of this client
+   const std::string& GetUrl() const { return m_url; }
+
+   // Returns counters of cURL handle and connection reuse
+   PoolStats GetPoolStats() const;
+
+   // Returns number of requests in flight to this endpoint
+   std::size_t GetOngoingRequests() const;
+
+   // Returns maximum number of requests in flight to this endpoint, 0 means no limit
+   std::size_t GetMaxOngoingRequests() const { return m_maxOngoingRequests; }
+
+   // Returns counters of request coalescing.
+   // Concurrent identical requests (same method and same request after normalization) share one transfer,
+   // so "leaders" is the number of requests actually sent, and "followers" is the number of saved ones.
+   SingleFlightStats GetCoalescingStats() const;
+
 private:
    using CurlPtr = std::shared_ptr<CURL>;  // Type alias for shared pointer to CURL handle
 
+   // Buffers which must stay alive until an asynchronous request is finished
+   struct TransferBuffers
+   {
+      std::string data;                           // POST request body
+      std::string response;                       // Server response, unless it is streamed
+      ChunkHandler onChunk;                       // Consumer of the streamed response, empty if it is buffered
+      std::chrono::microseconds transferTime{0};  // Duration of the transfer, set on success
+   };
+
+   // Shared cURL cache (DNS and TLS sessions) of all handles of a single client.
+   // Connections are not shared here, all transfers run on the multi handle of WebEventLoop,
+   // which keeps live connections in its own connection cache.
+   class SharedCache
+   {
+   public:
+      SharedCache();
+      ~SharedCache();
+
+      CURLSH* Get() const { return m_share; }
+
+   private:
+      static void lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+      static void unlock(CURL* handle, curl_lock_data data, void* userptr);
+
+   private:
+      CURLSH* m_share = nullptr;
+      std::array<std::mutex, CURL_LOCK_DATA_LAST> m_locks;  // One lock per shared data type
+   };
+
+   // Idle cURL handles of a single client with the cache they share.
+   // The pool is owned by the client and by every handle taken from it, so a handle released after the client
+   // is destroyed, e.g. by WebEventLoop on shutdown, never calls back into the client.
+   class HandlePool
+   {
+   public:
+      // Destroys idle handles before the shared cache they use
+      ~HandlePool();
+
+      // Takes an idle handle
+      // @return Handle, or nullptr if there are no idle handles
+      CURL* Take();
+
+      // Returns a handle to the pool, or destroys it if the pool is full
+      // @param curl Handle to release
+      void Release(CURL* curl);
+
+      // Returns the shared cache, or nullptr if it is not available
+      CURLSH* GetShare() const { return m_sharedCache.Get(); }
+
+   private:
+      SharedCache m_sharedCache;         // DNS and TLS session cache shared by all handles of the client
+      std::mutex m_mutex;                // Protects m_idleHandles
+      std::vector<CURL*> m_idleHandles;  // Idle handles, reset before reuse
+   };
+
 private:
-   // Creates and configures a CURL instance with given parameters
+   // Starts the request when the limit of ongoing requests allows
+   // @param start Function which starts the request
+   void schedule(std::function<void()> start);
+
+   // Called when a request is finished, starts the next queued request
+   void releaseSlot();
+
+   // Returns the handler which calls releaseSlot() before the given handler
+   StreamHandler releaseSlotBefore(StreamHandler handler);
+
+   // Returns the handler which passes the response to all requests coalesced under the key
+   ResponseHandler completeFlight(const std::string& key);
+
+   // Returns the handler of a transfer which passes its buffered response, or empty string on error
+   static StreamHandler respondWith(std::shared_ptr<TransferBuffers> buffers, ResponseHandler handler);
+
+   // Starts HTTP GET request, see GetAsync()
+   void startGet(const std::string& request, std::shared_ptr<TransferBuffers> buffers, StreamHandler handler);
+
+   // Starts HTTP POST request with the body in buffers, see PostAsync() and PostStreamAsync()
+   void startPost(std::shared_ptr<TransferBuffers> buffers, StreamHandler handler);
+
+   // Takes an idle cURL handle from the pool or creates a new one, configured with given parameters
    // @param url The complete URL for the request
-   // @param writeTimeoutMs Timeout value for write operations in milliseconds
-   // @param responseBuffer Pointer to string where response will be stored
-   // @return Configured CURL handle wrapped in shared_ptr, or nullptr on error
-   static CurlPtr createCurl(const std::string& url, std::uint64_t writeTimeoutMs, std::string* responseBuffer);
+   // @param buffers Buffers which receive the response, or its consumer
+   // @return Configured CURL handle wrapped in shared_ptr which returns it to the pool, or nullptr on error
+   CurlPtr createCurl(const std::string& url, TransferBuffers& buffers);
 
-   // Executes the CURL request and returns success status
-   // @param curl Configured CURL handle to perform
+   // Checks the result of a finished CURL request
+   // @param curl Handle of the finished request
+   // @param res Result code of the request
    // @return true if request succeeded, false otherwise
-   static bool perform(const CurlPtr& curl);
+   static bool checkResult(CURL* curl, CURLcode res);
+
+   // Counts whether a successful transfer reused a connection, see PoolStats
+   // @param curl Handle of the finished request
+   void countConnections(CURL* curl);
 
 private:
    std::string m_url;               // Base URL for web requests
    std::uint64_t m_writeTimeoutMs;  // Timeout value for write operations in milliseconds
+
+   const std::shared_ptr<HandlePool> m_pool;  // Idle handles, shared with the handles in use
+
+   std::atomic<std::uint64_t> m_poolHits = 0;           // See PoolStats::hits
+   std::atomic<std::uint64_t> m_poolMisses = 0;         // See PoolStats::misses
+   std::atomic<std::uint64_t> m_reusedConnections = 0;  // See PoolStats::reusedConnections
+   std::atomic<std::uint64_t> m_newConnections = 0;     // See PoolStats::newConnections
+
+   const std::size_t m_maxOngoingRequests;               // Maximum number of requests in flight, 0 means no limit
+   mutable std::mutex m_limitMutex;                      // Protects fields below
+   std::size_t m_ongoingRequests = 0;                    // Number of requests in flight
+   std::deque<std::function<void()>> m_waitingRequests;  // Requests waiting for a free slot
+
+   SingleFlight<std::string> m_flights;  // Identical requests in flight
 };
 
 }  // namespace geo
@@ -0,0 +1,141 @@
+#include "WebEventLoop.h"
+
+#include <absl/log/log.h>
+
+#include <format>
+#include <stdexcept>
+
+namespace
+{
+
+const int sc_pollTimeoutMs = 1000;  // Upper bound of a single wait for socket activity
+
+}  // namespace
+
+namespace geo
+{
+
+WebEventLoop::WebEventLoop()
+{
+   m_multi = curl_multi_init();
+   if (!m_multi)
+   {
+      LOG(ERROR) << "Cannot create cURL multi instance";
+      throw std::runtime_error("Cannot create cURL multi instance");
+   }
+
+   // Prefer multiplexing transfers over a single HTTP/2 connection to the same host
+   curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+   m_thread = std::thread(&WebEventLoop::run, this);
+}
+
+WebEventLoop::~WebEventLoop()
+{
+   m_stop = true;
+   curl_multi_wakeup(m_multi);
+   m_thread.join();
+
+   // Handles are released by their deleters once they are out of the multi handle, see WebClient::HandlePool.
+   for (auto& [curl, transfer] : m_running)
+      curl_multi_remove_handle(m_multi, curl);
+   m_running.clear();
+   m_pending.clear();
+
+   curl_multi_cleanup(m_multi);
+}
+
+WebEventLoop& WebEventLoop::Instance()
+{
+   static WebEventLoop s_instance;
+   return s_instance;
+}
+
+void WebEventLoop::Start(CurlPtr curl, CompletionHandler handler)
+{
+   {
+      std::lock_guard lock(m_pendingMutex);
+      m_pending.push_back({std::move(curl), std::move(handler)});
+   }
+   ++m_activeTransfers;
+   curl_multi_wakeup(m_multi);
+}
+
+void WebEventLoop::run()
+{
+   while (!m_stop)
+   {
+      addPendingTransfers();
+
+      int runningHandles = 0;
+      const auto res = curl_multi_perform(m_multi, &runningHandles);
+      if (res != CURLM_OK)
+         LOG(ERROR) << std::format("cURL multi error: {}", curl_multi_strerror(res));
+
+      completeFinishedTransfers();
+
+      // Sleeps until socket activity, a timeout or curl_multi_wakeup() from Start() or destructor
+      curl_multi_poll(m_multi, nullptr, 0, sc_pollTimeoutMs, nullptr);
+   }
+}
+
+void WebEventLoop::addPendingTransfers()
+{
+   std::vector<Transfer> pending;
+   {
+      std::lock_guard lock(m_pendingMutex);
+      pending.swap(m_pending);
+   }
+
+   for (auto& transfer : pending)
+   {
+      CURL* curl = transfer.curl.get();
+      const auto res = curl_multi_add_handle(m_multi, curl);
+      if (res != CURLM_OK)
+      {
+         LOG(ERROR) << std::format("cURL multi error: {}", curl_multi_strerror(res));
+         --m_activeTransfers;
+         complete(transfer, CURLE_FAILED_INIT);
+         continue;
+      }
+      m_running.emplace(curl, std::move(transfer));
+   }
+}
+
+void WebEventLoop::completeFinishedTransfers()
+{
+   int messagesInQueue = 0;
+   while (CURLMsg* message = curl_multi_info_read(m_multi, &messagesInQueue))
+   {
+      if (message->msg != CURLMSG_DONE)
+         continue;
+
+      CURL* curl = message->easy_handle;
+      const CURLcode result = message->data.result;
+      curl_multi_remove_handle(m_multi, curl);
+
+      auto it = m_running.find(curl);
+      if (it == m_running.end())
+         continue;
+
+      // Keep the transfer alive during the handler call, as the handler may release the last reference to the buffers
+      Transfer transfer = std::move(it->second);
+      m_running.erase(it);
+      --m_activeTransfers;
+      complete(transfer, result);
+   }
+}
+
+void WebEventLoop::complete(Transfer& transfer, CURLcode result)
+{
+   try
+   {
+      transfer.handler(result);
+   }
+   catch (const std::exception& e)
+   {
+      LOG(ERROR) << std::format("Unhandled exception in HTTP completion handler: {}", e.what());
+   }
+}
+
+}  // namespace geo
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace geo
+{
+
+// WebEventLoop drives all HTTP transfers of the process on a single I/O thread using cURL multi interface.
+// Any number of transfers can be in flight without dedicating a thread to each of them.
+class WebEventLoop
+{
+public:
+   using CurlPtr = std::shared_ptr<CURL>;  // Type alias for shared pointer to CURL handle
+
+   // Called on the I/O thread when a transfer is finished. Must be short and must not block,
+   // otherwise it delays all other transfers of the process.
+   using CompletionHandler = std::function<void(CURLcode)>;
+
+public:
+   // Starts the I/O thread
+   WebEventLoop();
+
+   // Stops the I/O thread. Transfers which are still in flight are aborted without calling their handlers,
+   // As the loop is destroyed after the clients, deleters of their handles must not use the clients.
+   ~WebEventLoop();
+
+   WebEventLoop(const WebEventLoop&) = delete;
+   WebEventLoop& operator=(const WebEventLoop&) = delete;
+
+   // Returns the event loop shared by all WebClient instances
+   static WebEventLoop& Instance();
+
+   // Schedules a transfer. It is safe to call this method from any thread.
+   // @param curl Configured CURL handle, kept alive until the transfer is finished
+   // @param handler Handler to call on the I/O thread with the transfer result
+   void Start(CurlPtr curl, CompletionHandler handler);
+
+   // Returns number of transfers which are scheduled or in flight
+   std::size_t GetActiveTransfers() const { return m_activeTransfers; }
+
+private:
+   struct Transfer
+   {
+      CurlPtr curl;
+      CompletionHandler handler;
+   };
+
+private:
+   // I/O thread main function
+   void run();
+
+   // Moves newly scheduled transfers into the multi handle
+   void addPendingTransfers();
+
+   // Removes finished transfers from the multi handle and calls their handlers
+   void completeFinishedTransfers();
+
+   // Calls transfer handler, logging exceptions which must not leave the I/O thread
+   static void complete(Transfer& transfer, CURLcode result);
+
+private:
+   CURLM* m_multi = nullptr;  // cURL multi handle, only accessed from the I/O thread after construction
+
+   std::mutex m_pendingMutex;                      // Protects m_pending
+   std::vector<Transfer> m_pending;                // Transfers scheduled by Start() and not yet added to m_multi
+   std::unordered_map<CURL*, Transfer> m_running;  // Transfers added to m_multi, only accessed from the I/O thread
+
+   std::atomic<std::size_t> m_activeTransfers = 0;  // See GetActiveTransfers()
+   std::atomic<bool> m_stop = false;                // Set to stop the I/O thread
+   std::thread m_thread;                            // I/O thread, must be the last member to start after others
+};
+
+}  // namespace geo
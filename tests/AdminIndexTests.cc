@@ -0,0 +1,326 @@
+#include "../src/search/AdminIndex.h"
+#include "../src/utils/Crc32.h"
+#include "../src/utils/Snapshot.h"
+#include "../tools/geo-snapshot/AdminIndexBuilder.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+using namespace geo;
+
+// Vertices of a way as longitudes and latitudes
+using Way = std::vector<std::pair<double, double>>;
+
+// Place of the test extract, all of its ways are members of its relation
+struct TestPlace
+{
+   std::int64_t osmId;
+   std::string name;
+   std::vector<Way> ways;
+};
+
+// Returns a closed way around a box
+Way boxWay(double minLongitude, double minLatitude, double maxLongitude, double maxLatitude)
+{
+   return {{minLongitude, minLatitude}, {maxLongitude, minLatitude}, {maxLongitude, maxLatitude},
+      {minLongitude, maxLatitude}, {minLongitude, minLatitude}};
+}
+
+// Returns the places of the test extract:
+// a multipolygon with two outer rings and a hole, whose first outer ring is split into two ways,
+// an island which fills the hole, and four boxes around a common vertex, which share edges with each other.
+std::vector<TestPlace> makePlaces()
+{
+   return {
+      {100, "Holey", {{{1, 1}, {5, 1}, {5, 5}}, {{5, 5}, {1, 5}, {1, 1}}, boxWay(2, 2, 3, 3), boxWay(6, 1, 8, 3)}},
+      {200, "Island", {boxWay(2, 2, 3, 3)}},
+      {301, "South West", {boxWay(1, 6, 3, 7)}},
+      {302, "South East", {boxWay(3, 6, 5, 7)}},
+      {303, "North West", {boxWay(1, 7, 3, 8)}},
+      {304, "North East", {boxWay(3, 7, 5, 8)}},
+   };
+}
+
+// Returns an Overpass API response with "out geom" for the places
+std::string makeOverpassResponse(const std::vector<TestPlace>& places)
+{
+   std::string json = R"({"elements":[)";
+   for (std::size_t i = 0; i < places.size(); ++i)
+   {
+      json += std::format(R"({}{{"type":"relation","id":{},"tags":{{"place":"town","name":"{}"}},"members":[)",
+         i ? "," : "", places[i].osmId, places[i].name);
+      for (std::size_t j = 0; j < places[i].ways.size(); ++j)
+      {
+         json += std::format(R"({}{{"type":"way","role":"outer","geometry":[)", j ? "," : "");
+         const auto& way = places[i].ways[j];
+         for (std::size_t k = 0; k < way.size(); ++k)
+            json += std::format(R"({}{{"lat":{},"lon":{}}})", k ? "," : "", way[k].second, way[k].first);
+         json += "]}";
+      }
+      json += "]}";
+   }
+   return json + "]}";
+}
+
+// Returns the path of a snapshot file of a test
+std::string snapshotPath(const std::string& name)
+{
+   return (std::filesystem::path(testing::TempDir()) / (name + ".snapshot")).string();
+}
+
+// Builds the index of the places and writes it as a snapshot
+void writeSnapshot(const std::vector<TestPlace>& places, const std::string& path)
+{
+   AdminIndexBuilder builder(0, false);
+   ASSERT_TRUE(builder.AddOverpassResponse(makeOverpassResponse(places)));
+   SnapshotWriter snapshot;
+   builder.AddTo(snapshot);
+   ASSERT_TRUE(snapshot.Write(path));
+}
+
+// Opens the index of a snapshot file
+std::unique_ptr<AdminIndex> openIndex(const std::string& path)
+{
+   return std::make_unique<AdminIndex>(std::make_shared<const Snapshot>(path));
+}
+
+// Returns OSM IDs of found places
+std::vector<std::int64_t> idsOf(const std::vector<nominatim::CachedRelation>& places)
+{
+   std::vector<std::int64_t> result;
+   for (const auto& place : places)
+      result.push_back(place.info.osmId);
+   return result;
+}
+
+// Checks if the ways of a place contain a point by the even-odd rule, testing every edge of every way.
+// Unlike AdminIndex, ways are not assembled into rings, and crossings are computed with divisions.
+bool containsPoint(const TestPlace& place, double longitude, double latitude)
+{
+   bool inside = false;
+   for (const auto& way : place.ways)
+   {
+      for (std::size_t i = 0; i + 1 < way.size(); ++i)
+      {
+         const auto [x1, y1] = way[i];
+         const auto [x2, y2] = way[i + 1];
+         if ((y1 > latitude) != (y2 > latitude) && longitude < (x2 - x1) * (latitude - y1) / (y2 - y1) + x1)
+            inside = !inside;
+      }
+   }
+   return inside;
+}
+
+// Finds places which contain a point by checking all of them
+std::vector<std::int64_t> findPlacesByScan(const std::vector<TestPlace>& places, double longitude, double latitude)
+{
+   std::vector<std::int64_t> result;
+   for (const auto& place : places)
+   {
+      if (containsPoint(place, longitude, latitude))
+         result.push_back(place.osmId);
+   }
+   std::sort(result.begin(), result.end());
+   return result;
+}
+
+// Changes records of a section of a snapshot file, and updates the checksums, so only the index can tell
+// that the records are damaged
+// @param path Snapshot file
+// @param name Name of the section
+// @param change Changes the table entry of the section and its records
+void changeSection(
+   const std::string& path, const std::string& name, const std::function<void(SnapshotSection&, char*)>& change)
+{
+   std::ifstream input(path, std::ios::binary);
+   std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+   input.close();
+
+   SnapshotHeader header;
+   std::memcpy(&header, data.data(), sizeof(header));
+   auto* sections = reinterpret_cast<SnapshotSection*>(data.data() + sizeof(header));
+   auto* section = std::find_if(sections, sections + header.numSections,
+      [&name](const SnapshotSection& entry)
+      {
+         return name == entry.name;
+      });
+   ASSERT_NE(section, sections + header.numSections) << name;
+
+   change(*section, data.data() + section->offset);
+   section->crc = Crc32(0, data.data() + section->offset, section->count * section->recordSize);
+   header.tableCrc = Crc32(0, sections, header.numSections * sizeof(SnapshotSection));
+   header.headerCrc = Crc32(0, &header, offsetof(SnapshotHeader, headerCrc));
+   std::memcpy(data.data(), &header, sizeof(header));
+
+   std::ofstream output(path, std::ios::binary | std::ios::trunc);
+   output.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// Writes a snapshot of the test places, changes the first record of a section, and checks that the index
+// is disabled
+// @param name Name of the section
+// @param change Changes the first record of the section
+template <typename T>
+void expectDisabledByChange(const char* name, const std::function<void(T&)>& change)
+{
+   const std::string path = snapshotPath("Changed");
+   writeSnapshot(makePlaces(), path);
+   changeSection(path, name,
+      [&change](SnapshotSection&, char* records)
+      {
+         change(*reinterpret_cast<T*>(records));
+      });
+   EXPECT_FALSE(openIndex(path)->IsOpen()) << name;
+}
+
+}  // namespace
+
+TEST(AdminIndex, CountCrossings)
+{
+   const float longitudes[] = {1, 5, 5, 1, 1};
+   const float latitudes[] = {1, 1, 5, 5, 1};
+   EXPECT_EQ(AdminIndex::CountCrossings(longitudes, latitudes, 5, 3, 3), 1u);
+   EXPECT_EQ(AdminIndex::CountCrossings(longitudes, latitudes, 5, 0, 3), 2u);
+   EXPECT_EQ(AdminIndex::CountCrossings(longitudes, latitudes, 5, 6, 3), 0u);
+   EXPECT_EQ(AdminIndex::CountCrossings(longitudes, latitudes, 5, 3, 6), 0u);
+}
+
+TEST(AdminIndex, PointsOfMultipolygon)
+{
+   const std::string path = snapshotPath("PointsOfMultipolygon");
+   writeSnapshot(makePlaces(), path);
+   const auto index = openIndex(path);
+   ASSERT_TRUE(index->IsOpen());
+
+   using Ids = std::vector<std::int64_t>;
+   EXPECT_EQ(idsOf(index->FindPlaces(1.5, 1.5)), Ids{100});  // Inside of the first outer ring
+   EXPECT_EQ(idsOf(index->FindPlaces(2, 7)), Ids{100});      // Inside of the second outer ring
+   EXPECT_EQ(idsOf(index->FindPlaces(2.5, 2.5)), Ids{200});  // In the hole, inside of the island
+   EXPECT_EQ(idsOf(index->FindPlaces(3, 5.5)), Ids{});       // Between the outer rings
+   EXPECT_EQ(idsOf(index->FindPlaces(0.5, 3)), Ids{});       // Outside of all places
+   EXPECT_EQ(idsOf(index->FindPlaces(-10, -10)), Ids{});     // Outside of the R-tree
+}
+
+TEST(AdminIndex, PointsOnVertices)
+{
+   // Places which share an edge or a vertex split it, so every point on it belongs to exactly one of them.
+   const std::string path = snapshotPath("PointsOnVertices");
+   writeSnapshot(makePlaces(), path);
+   const auto index = openIndex(path);
+   ASSERT_TRUE(index->IsOpen());
+
+   // Points are inside of the union of the places, as points on its outline may belong to none of them.
+   const std::pair<double, double> sharedPoints[] = {
+      {7, 3}, {6.5, 3}, {7.5, 3}, {7, 2}, {7, 4},                              // Boxes around a common vertex
+      {2, 2}, {2, 3}, {3, 2}, {3, 3}, {2, 2.5}, {2.5, 2}, {3, 2.5}, {2.5, 3},  // Vertices and edges of the hole
+   };
+   for (const auto& [latitude, longitude] : sharedPoints)
+      EXPECT_EQ(index->FindPlaces(latitude, longitude).size(), 1u) << latitude << ", " << longitude;
+}
+
+TEST(AdminIndex, SameAsScan)
+{
+   const auto places = makePlaces();
+   const std::string path = snapshotPath("SameAsScan");
+   writeSnapshot(places, path);
+   const auto index = openIndex(path);
+   ASSERT_TRUE(index->IsOpen());
+
+   // Points are between the lines of the vertices, so the brute force scan need not decide points on edges.
+   for (int row = 0; row < 100; ++row)
+   {
+      for (int column = 0; column < 100; ++column)
+      {
+         const double latitude = 0.05 + row * 0.1;
+         const double longitude = 0.05 + column * 0.1;
+         EXPECT_EQ(idsOf(index->FindPlaces(latitude, longitude)), findPlacesByScan(places, longitude, latitude))
+            << latitude << ", " << longitude;
+      }
+   }
+}
+
+TEST(AdminIndex, TruncatedFile)
+{
+   const std::string path = snapshotPath("TruncatedFile");
+   writeSnapshot(makePlaces(), path);
+   std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+   EXPECT_FALSE(openIndex(path)->IsOpen());
+}
+
+TEST(AdminIndex, TruncatedSections)
+{
+   for (const char* name : {sz_adminIndexInfo, sz_adminIndexBoxes, sz_adminIndexChildren, sz_adminIndexStrings,
+           sz_adminIndexFeatureTypes})
+   {
+      const std::string path = snapshotPath("TruncatedSections");
+      writeSnapshot(makePlaces(), path);
+      changeSection(path, name,
+         [](SnapshotSection& section, char*)
+         {
+            --section.count;
+         });
+      EXPECT_TRUE(Snapshot(path).Verify().empty()) << name;
+      EXPECT_FALSE(openIndex(path)->IsOpen()) << name;
+   }
+}
+
+TEST(AdminIndex, CorruptedSections)
+{
+   // The intact snapshot is opened, so the changes below are what disables the index.
+   const std::string path = snapshotPath("CorruptedSections");
+   writeSnapshot(makePlaces(), path);
+   EXPECT_TRUE(openIndex(path)->IsOpen());
+
+   // Every change breaks an invariant of the index, or points outside of another section.
+   expectDisabledByChange<AdminIndexInfo>(sz_adminIndexInfo,
+      [](AdminIndexInfo& info)
+      {
+         info.version = 0;
+      });
+   expectDisabledByChange<std::uint32_t>(sz_adminIndexChildren,
+      [](std::uint32_t& child)
+      {
+         child = 1000;
+      });
+   expectDisabledByChange<AdminIndexPlace>(sz_adminIndexPlaces,
+      [](AdminIndexPlace& place)
+      {
+         place.firstRing = 1000;
+      });
+   expectDisabledByChange<AdminIndexPlace>(sz_adminIndexPlaces,
+      [](AdminIndexPlace& place)
+      {
+         place.name = 100000;
+      });
+   expectDisabledByChange<AdminIndexRing>(sz_adminIndexRings,
+      [](AdminIndexRing& ring)
+      {
+         ring.numVertices = 1000;
+      });
+   expectDisabledByChange<AdminIndexNameEdge>(sz_adminIndexNameEdges,
+      [](AdminIndexNameEdge& edge)
+      {
+         edge.node = 0;
+      });
+   expectDisabledByChange<std::uint32_t>(sz_adminIndexNamePlaces,
+      [](std::uint32_t& place)
+      {
+         place = 1000;
+      });
+}
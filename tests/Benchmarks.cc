@@ -0,0 +1,278 @@
+// geo-benchmarks measures optimized code paths of the service against the implementations they replaced,
+// on synthetic inputs of a given size. Results of both are compared, see geo-tests for the same checks
+// on fixed inputs.
+//
+// Usage:
+//   geo-benchmarks -weatherDays=<days> [-weatherLocations=<locations>]
+//   geo-benchmarks -lookupRelations=<relations>
+//   geo-benchmarks -cityRelations=<relations>
+//   geo-benchmarks -resolutionRounds=<rounds> -config=<file> (-name=<name> | -lat=<lat> -lon=<lon>)
+
+#include "../src/search/NominatimApiUtils.h"
+#include "../src/search/OpenMeteoApiUtils.h"
+#include "../src/search/SearchEngine.h"
+#include "../src/utils/ConfigConstants.h"
+#include "../src/utils/Configuration.h"
+#include "../src/utils/WebClient.h"
+#include "References.h"
+#include "TestData.h"
+
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <absl/log/globals.h>
+#include <absl/log/initialize.h>
+#include <absl/log/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+ABSL_FLAG(std::uint32_t, weatherDays, 0, "Benchmark weather parsers on a response of this many days");
+ABSL_FLAG(std::uint32_t, weatherLocations, 1, "Number of locations in the weather response");
+ABSL_FLAG(std::uint32_t, lookupRelations, 0, "Benchmark Nominatim lookup parsers on a response of this many relations");
+ABSL_FLAG(std::uint32_t, cityRelations, 0, "Benchmark city selection among this many lookup results");
+ABSL_FLAG(std::uint32_t, resolutionRounds, 0, "Benchmark relation resolution modes for this many rounds");
+ABSL_FLAG(std::string, config, "", "Configuration file name with the upstream endpoints");
+ABSL_FLAG(std::string, name, "", "Search for cities by name in the relation resolution benchmark");
+ABSL_FLAG(double, lat, NAN, "Search for cities near this geographical point (lat) if no name is given");
+ABSL_FLAG(double, lon, NAN, "Search for cities near this geographical point (lon) if no name is given");
+
+namespace
+{
+
+using namespace geo;
+
+// Measures the fast path of Open Meteo responses against the DOM parser
+void benchmarkWeatherParser(std::uint32_t numDays, std::uint32_t numLocations)
+{
+   numLocations = std::max(numLocations, 1u);
+   const std::string response = test::MakeWeatherResponse(numDays, numLocations);
+
+   // Repeat parsing until enough days are parsed for a stable measurement.
+   const std::uint64_t totalDays = std::uint64_t{numDays} * numLocations;
+   const std::uint64_t iterations = std::max<std::uint64_t>(3, 2'000'000 / std::max<std::uint64_t>(totalDays, 1));
+   auto measure = [&](const char* name, auto parse)
+   {
+      std::vector<WeatherInfoVector> result;
+      const auto start = std::chrono::steady_clock::now();
+      for (std::uint64_t i = 0; i < iterations; ++i)
+         result = parse(response, numLocations);
+      const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      LOG(INFO) << std::format("{}: {:.3f} ms per response, {:.1f} ns per day", name, ms / iterations,
+         ms * 1e6 / (iterations * std::max<std::uint64_t>(totalDays, 1)));
+      return std::make_pair(ms, result);
+   };
+
+   LOG(INFO) << std::format("Benchmark of {} bytes response with {} locations of {} days, {} iterations",
+      response.size(), numLocations, numDays, iterations);
+   const auto [domMs, domResult] = measure("DOM parser", openmeteo::ParseWeatherResponseWithDom);
+   const auto [fastMs, fastResult] = measure("Fast parser", openmeteo::ParseWeatherResponse);
+
+   const bool same = std::equal(domResult.begin(), domResult.end(), fastResult.begin(), fastResult.end(),
+      [](const WeatherInfoVector& a, const WeatherInfoVector& b)
+      {
+         return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+            [](const WeatherInfo& x, const WeatherInfo& y)
+            {
+               return x.time == y.time && x.temperatureMin == y.temperatureMin &&
+                      x.temperatureMax == y.temperatureMax && x.temperatureAverage == y.temperatureAverage;
+            });
+      });
+   LOG(INFO) << std::format("Speedup {:.1f}x, results are {}", domMs / fastMs, same ? "identical" : "different");
+}
+
+// Measures the arena parser of Nominatim lookup responses against the previous DOM path
+void benchmarkLookupParser(std::uint32_t numRelations)
+{
+   const std::string response = test::MakeLookupResponse(numRelations);
+
+   // Both parsers get a copy of the response, the arena parser modifies it.
+   // Allocations are counted by the arena parser only, the previous path uses the default allocators.
+   const std::uint64_t iterations = std::max<std::uint64_t>(3, 200'000 / std::max(numRelations, 1u));
+   auto measure = [&](const char* name, auto parse)
+   {
+      std::optional<std::vector<nominatim::CachedRelation>> result;
+      const auto allocationsBefore = nominatim::GetParseStats().allocations;
+      const auto start = std::chrono::steady_clock::now();
+      for (std::uint64_t i = 0; i < iterations; ++i)
+      {
+         std::string json = response;
+         result = parse(json);
+      }
+      const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      const double allocations =
+         static_cast<double>(nominatim::GetParseStats().allocations - allocationsBefore) / iterations;
+      LOG(INFO) << std::format("{}: {:.3f} ms per response, {:.1f} arena allocations per response", name,
+         ms / iterations, allocations);
+      return std::make_pair(ms, result);
+   };
+
+   LOG(INFO) << std::format(
+      "Benchmark of {} bytes response with {} relations, {} iterations", response.size(), numRelations, iterations);
+   const auto [domMs, domResult] = measure("DOM parser",
+      [](std::string& json)
+      {
+         return test::ParseLookupResponseWithDom(json);
+      });
+   const auto [arenaMs, arenaResult] = measure("Arena parser",
+      [](std::string& json)
+      {
+         return nominatim::ParseLookupResponse(json);
+      });
+
+   const bool same = domResult && arenaResult &&
+                     std::equal(domResult->begin(), domResult->end(), arenaResult->begin(), arenaResult->end(),
+                        [](const nominatim::CachedRelation& a, const nominatim::CachedRelation& b)
+                        {
+                           return a.addressType == b.addressType && a.info.osmId == b.info.osmId &&
+                                  a.info.name == b.info.name && a.info.nameEn == b.info.nameEn &&
+                                  a.info.country == b.info.country && a.info.countryCode == b.info.countryCode &&
+                                  a.info.latitude == b.info.latitude && a.info.longitude == b.info.longitude;
+                        });
+   LOG(INFO) << std::format("Speedup {:.1f}x, results are {}", domMs / arenaMs, same ? "identical" : "different");
+}
+
+// Measures selection of cities with the spatial hash against the pairwise selection
+void benchmarkCitySelection(std::uint32_t numRelations)
+{
+   const auto relations = test::MakeCityRelations(numRelations);
+   const std::uint64_t iterations = std::max<std::uint64_t>(3, 20'000'000 / (std::uint64_t{numRelations} + 1) /
+                                                                  (std::uint64_t{numRelations} + 1));
+   auto measure = [&](const char* name, auto select, nominatim::Match match)
+   {
+      nominatim::RelationInfos result;
+      const auto start = std::chrono::steady_clock::now();
+      for (std::uint64_t i = 0; i < iterations; ++i)
+         result = select(relations, match);
+      const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      LOG(INFO) << std::format("{}: {:.3f} ms per selection, {} cities", name, ms / iterations, result.size());
+      return std::make_pair(ms, result);
+   };
+
+   LOG(INFO) << std::format("Benchmark of city selection among {} objects, {} iterations", numRelations, iterations);
+   for (const auto match : {nominatim::Match::Any, nominatim::Match::Best})
+   {
+      const auto [pairwiseMs, pairwiseResult] = measure("Pairwise", test::SelectCitiesPairwise, match);
+      const auto [gridMs, gridResult] = measure("Spatial hash", nominatim::SelectCities, match);
+      const bool same =
+         std::equal(pairwiseResult.begin(), pairwiseResult.end(), gridResult.begin(), gridResult.end(),
+            [](const nominatim::RelationInfo& a, const nominatim::RelationInfo& b)
+            {
+               return a.osmId == b.osmId;
+            });
+      LOG(INFO) << std::format("Match::{}: speedup {:.1f}x, results are {}",
+         match == nominatim::Match::Any ? "Any" : "Best", pairwiseMs / gridMs, same ? "identical" : "different");
+   }
+}
+
+// Measures latency of city search with relation details resolved in Nominatim and in Overpass, alternating
+// the modes for given number of rounds. Cities are searched by name, or by position if the name is empty.
+void benchmarkRelationResolution(std::uint32_t rounds, const std::string& name, double latitude, double longitude,
+   const std::string& configFilePath)
+{
+   Configuration configuration(configFilePath.c_str());
+   WebClient overpassApiClient(configuration.GetString(sz_overpassEndpointKey));
+   WebClient nominatimApiClient(configuration.GetString(sz_nominatimEndpointKey));
+   WebClient openMeteoApiClient(configuration.GetString(sz_openMeteoEndpointKey));
+
+   // Caches are disabled, so every search goes upstream.
+   SearchEngineSettings twoStageSettings;
+   SearchEngineSettings oneTripSettings;
+   oneTripSettings.relationResolution = RelationResolution::Overpass;
+   SearchEngine twoStageEngine(overpassApiClient, nominatimApiClient, openMeteoApiClient, twoStageSettings);
+   SearchEngine oneTripEngine(overpassApiClient, nominatimApiClient, openMeteoApiClient, oneTripSettings);
+
+   auto search = [&](SearchEngine& engine)
+   {
+      const auto start = std::chrono::steady_clock::now();
+      const auto cities = name.empty() ? engine.FindCitiesByPosition(latitude, longitude, false)
+                                       : engine.FindCitiesByName(name, false);
+      const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      return std::make_pair(ms, cities);
+   };
+   auto names = [](const GeoProtoPlaces& cities)
+   {
+      std::string result;
+      for (const auto& city : cities)
+         result += std::format("{}{} ({})", result.empty() ? "" : ", ", city.name(), city.country());
+      return result;
+   };
+
+   LOG(INFO) << std::format("Benchmark of relation resolution, {} rounds", rounds);
+   std::vector<double> twoStageMs;
+   std::vector<double> oneTripMs;
+   for (std::uint32_t i = 0; i < rounds; ++i)
+   {
+      const auto [twoStageRoundMs, twoStageCities] = search(twoStageEngine);
+      const auto [oneTripRoundMs, oneTripCities] = search(oneTripEngine);
+      twoStageMs.push_back(twoStageRoundMs);
+      oneTripMs.push_back(oneTripRoundMs);
+      LOG(INFO) << std::format("Round {}: Nominatim {:.0f} ms, {} cities; Overpass {:.0f} ms, {} cities", i + 1,
+         twoStageRoundMs, twoStageCities.size(), oneTripRoundMs, oneTripCities.size());
+      if (i + 1 == rounds)
+      {
+         LOG(INFO) << std::format("Nominatim: {}", names(twoStageCities));
+         LOG(INFO) << std::format("Overpass: {}", names(oneTripCities));
+      }
+   }
+
+   auto median = [](std::vector<double> values)
+   {
+      std::sort(values.begin(), values.end());
+      return values.empty() ? 0 : values[values.size() / 2];
+   };
+   LOG(INFO) << std::format("Median latency: Nominatim {:.0f} ms, Overpass {:.0f} ms", median(twoStageMs),
+      median(oneTripMs));
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+   absl::ParseCommandLine(argc, argv);
+   absl::SetStderrThreshold(absl::LogSeverityAtLeast::kInfo);
+   absl::InitializeLog();
+
+   const std::uint32_t weatherDays = absl::GetFlag(FLAGS_weatherDays);
+   if (weatherDays != 0)
+   {
+      benchmarkWeatherParser(weatherDays, absl::GetFlag(FLAGS_weatherLocations));
+      return 0;
+   }
+
+   const std::uint32_t lookupRelations = absl::GetFlag(FLAGS_lookupRelations);
+   if (lookupRelations != 0)
+   {
+      benchmarkLookupParser(lookupRelations);
+      return 0;
+   }
+
+   const std::uint32_t cityRelations = absl::GetFlag(FLAGS_cityRelations);
+   if (cityRelations != 0)
+   {
+      benchmarkCitySelection(cityRelations);
+      return 0;
+   }
+
+   const std::uint32_t resolutionRounds = absl::GetFlag(FLAGS_resolutionRounds);
+   const std::string configFilePath = absl::GetFlag(FLAGS_config);
+   const std::string name = absl::GetFlag(FLAGS_name);
+   const double lat = absl::GetFlag(FLAGS_lat);
+   const double lon = absl::GetFlag(FLAGS_lon);
+   if (resolutionRounds != 0 && !configFilePath.empty() && (!name.empty() || (!std::isnan(lat) && !std::isnan(lon))))
+   {
+      benchmarkRelationResolution(resolutionRounds, name, lat, lon, configFilePath);
+      return 0;
+   }
+
+   LOG(ERROR) << "Usage: geo-benchmarks -weatherDays=<days> [-weatherLocations=<locations>] | "
+                 "-lookupRelations=<relations> | -cityRelations=<relations> | "
+                 "-resolutionRounds=<rounds> -config=<file> (-name=<name> | -lat=<lat> -lon=<lon>)";
+   return -1;
+}
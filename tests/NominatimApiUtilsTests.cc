@@ -0,0 +1,162 @@
+#include "../src/search/NominatimApiUtils.h"
+#include "References.h"
+#include "TestData.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using namespace geo;
+
+// Parses a response with the arena parser and with the previous DOM path, and checks that they return the same
+void expectSameAsDom(const std::string& response)
+{
+   const auto expected = test::ParseLookupResponseWithDom(response);
+   std::string json = response;
+   const auto actual = nominatim::ParseLookupResponse(json);
+   ASSERT_EQ(actual.has_value(), expected.has_value());
+   if (!expected)
+      return;
+
+   ASSERT_EQ(actual->size(), expected->size());
+   for (std::size_t i = 0; i < expected->size(); ++i)
+   {
+      const auto& a = (*actual)[i];
+      const auto& e = (*expected)[i];
+      EXPECT_EQ(a.addressType, e.addressType) << "relation " << i;
+      EXPECT_EQ(a.info.osmId, e.info.osmId) << "relation " << i;
+      EXPECT_EQ(a.info.name, e.info.name) << "relation " << i;
+      EXPECT_EQ(a.info.nameEn, e.info.nameEn) << "relation " << i;
+      EXPECT_EQ(a.info.country, e.info.country) << "relation " << i;
+      EXPECT_EQ(a.info.countryEn, e.info.countryEn) << "relation " << i;
+      EXPECT_EQ(a.info.countryCode, e.info.countryCode) << "relation " << i;
+      EXPECT_EQ(a.info.latitude, e.info.latitude) << "relation " << i;
+      EXPECT_EQ(a.info.longitude, e.info.longitude) << "relation " << i;
+   }
+}
+
+// Returns a looked up object
+nominatim::CachedRelation makeRelation(const char* addressType, std::int64_t osmId, double latitude, double longitude)
+{
+   nominatim::CachedRelation relation;
+   relation.addressType = addressType;
+   relation.info.osmId = osmId;
+   relation.info.latitude = latitude;
+   relation.info.longitude = longitude;
+   return relation;
+}
+
+// Selects cities with the spatial hash and pairwise, and checks that the same cities are selected in the same order
+void expectSameAsPairwise(const std::vector<nominatim::CachedRelation>& relations)
+{
+   for (const auto match : {nominatim::Match::Best, nominatim::Match::Any})
+   {
+      const auto expected = test::SelectCitiesPairwise(relations, match);
+      const auto actual = nominatim::SelectCities(relations, match);
+      std::vector<std::int64_t> expectedIds;
+      std::vector<std::int64_t> actualIds;
+      for (const auto& city : expected)
+         expectedIds.push_back(city.osmId);
+      for (const auto& city : actual)
+         actualIds.push_back(city.osmId);
+      EXPECT_EQ(actualIds, expectedIds) << (match == nominatim::Match::Any ? "Match::Any" : "Match::Best");
+   }
+}
+
+}  // namespace
+
+TEST(ParseLookupResponse, Places)
+{
+   const std::string response =
+      R"([{"place_id":256068956,"osm_type":"relation","osm_id":146656,"lat":"53.4794892","lon":"-2.2451148",)"
+      R"("addresstype":"city","name":"Manchester","address":{"city":"Manchester","state":"England",)"
+      R"("country":"United Kingdom","country_code":"gb"},"namedetails":{"name":"Manchester"}},)"
+      R"({"place_id":1,"osm_type":"relation","osm_id":62422,"lat":"52.5173885","lon":"13.3951309",)"
+      R"("addresstype":"state","name":"Berlin","address":{"state":"Berlin","country":"Deutschland",)"
+      R"("country_code":"de"},"namedetails":{"name":"Berlin","name:en":"Berlin","name:ru":"Берлин"}},)"
+      R"({"place_id":2,"osm_type":"relation","osm_id":2555133,"lat":"48.8588897","lon":"2.3200410",)"
+      R"("addresstype":"city","address":{"city":"Paris","country":"France"}}])";
+   expectSameAsDom(response);
+}
+
+TEST(ParseLookupResponse, EscapedStrings)
+{
+   const std::string response =
+      R"([{"osm_id":7444,"lat":"48.8566","lon":"2.3522","addresstype":"city","address":{"city":"Saint-Étienne",)"
+      R"("country":"Françe \"FR\"","country_code":"fr"},"namedetails":{"name:en":"Saint\/Étienne\\"}}])";
+   expectSameAsDom(response);
+}
+
+TEST(ParseLookupResponse, ManyPlaces)
+{
+   expectSameAsDom(test::MakeLookupResponse(200));
+}
+
+TEST(ParseLookupResponse, EmptyArray)
+{
+   expectSameAsDom("[]");
+   expectSameAsDom(" [ ] ");
+}
+
+TEST(ParseLookupResponse, NotAnArray)
+{
+   expectSameAsDom(R"({"error":{"code":400,"message":"Bad Request"}})");
+   expectSameAsDom("[{\"osm_id\":");
+   expectSameAsDom("");
+}
+
+TEST(ParseLookupResponse, ResponsesInARow)
+{
+   // The arena of the thread is reused, so a large response is followed by small ones.
+   expectSameAsDom(test::MakeLookupResponse(1000));
+   expectSameAsDom(test::MakeLookupResponse(1));
+   expectSameAsDom(test::MakeLookupResponse(50));
+}
+
+TEST(SelectCities, CityOverState)
+{
+   // Tarragona is a city in Catalonia, and Phnom Penh is a state without a city.
+   expectSameAsPairwise({makeRelation("state", 349053, 41.8523094, 1.5745043),
+      makeRelation("city", 1, 41.1172364, 1.2546057), makeRelation("village", 2, 41.12, 1.25)});
+   expectSameAsPairwise({makeRelation("state", 1, 11.5730391, 104.857807), makeRelation("county", 2, 11.6, 104.9)});
+   expectSameAsPairwise({makeRelation("town", 1, 10, 10), makeRelation("state", 2, 30, 30),
+      makeRelation("town", 3, 10.5, 10.5), makeRelation("city", 4, 50, 50)});
+}
+
+TEST(SelectCities, CloseAcrossCells)
+{
+   // Places which are close, or exactly one degree apart, on both sides of borders of cells.
+   expectSameAsPairwise({makeRelation("city", 1, 0.9, -0.1), makeRelation("town", 2, 1.1, 0.1),
+      makeRelation("state", 3, -0.5, -0.95), makeRelation("city", 4, 2, 2), makeRelation("town", 5, 3, 2),
+      makeRelation("state", 6, 2.999, 1.001), makeRelation("city", 7, -89.5, 179.9),
+      makeRelation("town", 8, -89.9, 179.1)});
+}
+
+TEST(SelectCities, UnusualCoordinates)
+{
+   const double nan = std::numeric_limits<double>::quiet_NaN();
+   const double infinity = std::numeric_limits<double>::infinity();
+   expectSameAsPairwise({makeRelation("city", 1, nan, 0), makeRelation("town", 2, 0, nan),
+      makeRelation("state", 3, infinity, infinity), makeRelation("city", 4, infinity, infinity),
+      makeRelation("town", 5, 1e300, -1e300), makeRelation("state", 6, 1e300 + 0.5, -1e300),
+      makeRelation("city", 7, 9007199254740992.0, 0), makeRelation("town", 8, 9007199254740991.5, 0.5),
+      makeRelation("state", 9, 0, 0)});
+}
+
+TEST(SelectCities, NoCities)
+{
+   expectSameAsPairwise({});
+   expectSameAsPairwise({makeRelation("village", 1, 0, 0), makeRelation("", 2, 0, 0)});
+}
+
+TEST(SelectCities, ManyPlaces)
+{
+   expectSameAsPairwise(test::MakeCityRelations(3000));
+}
@@ -0,0 +1,93 @@
+#include "../src/search/OpenMeteoApiUtils.h"
+#include "TestData.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using namespace geo;
+
+// Parses a response with both parsers and checks that the fast path returns what the DOM parser returns
+void expectSameAsDom(const std::string& response, std::size_t numLocations)
+{
+   const auto expected = openmeteo::ParseWeatherResponseWithDom(response, numLocations);
+   const auto actual = openmeteo::ParseWeatherResponse(response, numLocations);
+   ASSERT_EQ(actual.size(), expected.size());
+   for (std::size_t location = 0; location < expected.size(); ++location)
+   {
+      ASSERT_EQ(actual[location].size(), expected[location].size()) << "location " << location;
+      for (std::size_t day = 0; day < expected[location].size(); ++day)
+      {
+         const auto& a = actual[location][day];
+         const auto& e = expected[location][day];
+         EXPECT_TRUE(a.time == e.time) << "location " << location << ", day " << day;
+         EXPECT_EQ(a.temperatureMin, e.temperatureMin) << "location " << location << ", day " << day;
+         EXPECT_EQ(a.temperatureMax, e.temperatureMax) << "location " << location << ", day " << day;
+         EXPECT_EQ(a.temperatureAverage, e.temperatureAverage) << "location " << location << ", day " << day;
+      }
+   }
+}
+
+}  // namespace
+
+TEST(ParseWeatherResponse, SingleLocation)
+{
+   const std::string response =
+      R"({"latitude":52.52,"longitude":13.41,"daily_units":{"time":"iso8601","temperature_2m_max":"°C"},)"
+      R"("daily":{"time":["2023-02-27","2023-02-28","2023-03-01"],"temperature_2m_max":[3.4,-0.5,12],)"
+      R"("temperature_2m_min":[-2.25,-7.9,0.0]}})";
+   expectSameAsDom(response, 1);
+   EXPECT_EQ(openmeteo::ParseWeatherResponse(response, 1).front().size(), 3u);
+}
+
+TEST(ParseWeatherResponse, DaysWithoutValues)
+{
+   const std::string response = R"({"daily":{"time":["2024-12-30","2024-12-31","2025-01-01"],)"
+                                R"("temperature_2m_max":[1.5,null,2.5],"temperature_2m_min":[null,-1.0,-0.5]}})";
+   expectSameAsDom(response, 1);
+   EXPECT_EQ(openmeteo::ParseWeatherResponse(response, 1).front().size(), 1u);
+}
+
+TEST(ParseWeatherResponse, Whitespace)
+{
+   const std::string response = "{ \"daily\" : {\n \"temperature_2m_min\" : [ -1.1 , 2.0 ] ,\n"
+                                "\t\"time\" : [ \"2000-02-28\" , \"2000-02-29\" ] ,\r\n"
+                                " \"temperature_2m_max\" : [ 10.25 , 1e1 ] } }";
+   expectSameAsDom(response, 1);
+}
+
+TEST(ParseWeatherResponse, SeveralLocations)
+{
+   expectSameAsDom(test::MakeWeatherResponse(400, 3), 3);
+}
+
+TEST(ParseWeatherResponse, ManyDays)
+{
+   expectSameAsDom(test::MakeWeatherResponse(30000, 1), 1);
+}
+
+TEST(ParseWeatherResponse, WrongNumberOfLocations)
+{
+   const auto response = test::MakeWeatherResponse(10, 2);
+   expectSameAsDom(response, 3);
+   for (const auto& weather : openmeteo::ParseWeatherResponse(response, 3))
+      EXPECT_TRUE(weather.empty());
+}
+
+TEST(ParseWeatherResponse, EmptyResponse)
+{
+   expectSameAsDom("", 2);
+   EXPECT_EQ(openmeteo::ParseWeatherResponse("", 2).size(), 2u);
+}
+
+TEST(ParseWeatherResponse, NoDailyValues)
+{
+   expectSameAsDom(R"({"error":true,"reason":"Parameter 'start_date' is out of allowed range"})", 1);
+   expectSameAsDom(R"({"daily":{"time":["2023-02-27"],"temperature_2m_max":[3.4]}})", 1);
+   expectSameAsDom("[{\"daily\":", 1);
+}
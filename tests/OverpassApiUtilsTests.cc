@@ -0,0 +1,77 @@
+#include "../src/search/OverpassApiUtils.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+
+using namespace geo;
+
+const std::uint32_t sc_airports = 1;  // GEOGRAPHICAL_FEATURE_INTERNATIONAL_AIRPORTS
+const std::uint32_t sc_peaks = 2;     // GEOGRAPHICAL_FEATURE_PEAKS
+
+// Returns a region with its bounds
+overpass::RelationDetails makeRegion(overpass::OsmId id, const BoundingBox& bounds)
+{
+   overpass::RelationDetails region;
+   region.id = id;
+   region.hasBounds = true;
+   region.bounds = bounds;
+   return region;
+}
+
+// Returns ids of regions selected from tiles
+std::vector<overpass::OsmId> selectIds(
+   std::vector<overpass::RegionTile> tiles, std::uint32_t kinds, const BoundingBox& bbox)
+{
+   std::vector<overpass::OsmId> ids;
+   for (const auto& region : overpass::SelectTiledRegions(std::move(tiles), kinds, bbox))
+      ids.push_back(region.id);
+   return ids;
+}
+
+}  // namespace
+
+TEST(SelectTiledRegions, RegionsOutsideTheBox)
+{
+   // Tile [50, 0, 52, 2] is searched for the box [50.5, 0.5, 51, 1].
+   const BoundingBox bbox{50.5, 0.5, 51, 1};
+   const std::vector<overpass::RegionTile> tiles{{sc_airports,
+      {makeRegion(1, {50, 0, 51, 1}), makeRegion(2, {51.5, 1.5, 52, 2}), makeRegion(3, {50.9, 0.9, 52, 2})}}};
+   EXPECT_EQ(selectIds(tiles, sc_airports, bbox), (std::vector<overpass::OsmId>{1, 3}));
+}
+
+TEST(SelectTiledRegions, FeaturesOutsideTheBox)
+{
+   // Region 3 reaches the box, but its airport lies at (51.5, 1.5) in the part of the tile outside the box.
+   // A query for the box itself does not return it, tiled results are a superset of such queries.
+   const BoundingBox bbox{50.5, 0.5, 51, 1};
+   const std::vector<overpass::RegionTile> tiles{{sc_airports, {makeRegion(3, {50.9, 0.9, 52, 2})}}};
+   EXPECT_EQ(selectIds(tiles, sc_airports, bbox), (std::vector<overpass::OsmId>{3}));
+}
+
+TEST(SelectTiledRegions, KindsInDifferentTiles)
+{
+   // Region 1 has an airport in the first tile and a peak in the second one, region 2 has only an airport,
+   // region 3 only a peak.
+   const BoundingBox bbox{51, 1, 53, 3};
+   const std::vector<overpass::RegionTile> tiles{
+      {sc_airports, {makeRegion(1, {51, 1, 53, 3}), makeRegion(2, {51, 1, 52, 2})}},
+      {sc_peaks, {makeRegion(3, {51, 1, 52, 2})}},
+      {sc_airports, {}},
+      {sc_peaks, {makeRegion(1, {51, 1, 53, 3})}},
+   };
+   EXPECT_EQ(selectIds(tiles, sc_airports | sc_peaks, bbox), (std::vector<overpass::OsmId>{1, 1}));
+}
+
+TEST(SelectTiledRegions, RegionsWithoutBounds)
+{
+   overpass::RelationDetails region;
+   region.id = 1;
+   const std::vector<overpass::RegionTile> tiles{{sc_peaks, {region}}};
+   EXPECT_EQ(selectIds(tiles, sc_peaks, {10, 10, 11, 11}), (std::vector<overpass::OsmId>{1}));
+   EXPECT_TRUE(selectIds({}, sc_peaks, {10, 10, 11, 11}).empty());
+}
@@ -0,0 +1,113 @@
+#define RAPIDJSON_HAS_STDSTRING 1
+
+#include "References.h"
+
+#include "../src/utils/JsonUtils.h"
+
+#include <rapidjson/document.h>
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <string_view>
+#include <utility>
+
+namespace
+{
+
+using namespace geo;
+using namespace geo::nominatim;
+
+// Converts a string view to a double value, or NAN if parsing fails
+double getDoubleFromString(const std::string_view& s)
+{
+   double value = 0;
+   const auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+   return result.ec == std::errc{} ? value : NAN;
+}
+
+// Returns a string of nested members, or an empty string if there is no such member
+template <typename... TArgs>
+std::string_view getOptionalString(const rapidjson::Value& value, TArgs... args)
+{
+   return json::Has(value, args...) ? json::GetString(json::Get(value, args...)) : "";
+}
+
+// Converts a JSON value to a RelationInfo object, the name is taken from the address part of the address type
+RelationInfo jsonToObject(const rapidjson::Value& value, const std::string& addressType)
+{
+   RelationInfo result;
+   result.osmId = json::GetInt64(json::Get(value, "osm_id"));
+   result.name = json::GetString(json::Get(value, "address", addressType.c_str()));
+   result.nameEn = getOptionalString(value, "namedetails", "name:en");
+   result.country = json::GetString(json::Get(value, "address", "country"));
+   result.countryCode = getOptionalString(value, "address", "country_code");
+   result.latitude = getDoubleFromString(json::GetString(json::Get(value, "lat")));
+   result.longitude = getDoubleFromString(json::GetString(json::Get(value, "lon")));
+   return result;
+}
+
+}  // namespace
+
+namespace geo::test
+{
+
+std::optional<std::vector<CachedRelation>> ParseLookupResponseWithDom(const std::string& response)
+{
+   rapidjson::Document document;
+   document.Parse(response.c_str());
+   if (!document.IsArray())
+      return std::nullopt;
+
+   std::vector<CachedRelation> result;
+   for (const auto& item : document.GetArray())
+   {
+      std::string addressType(json::GetString(json::Get(item, "addresstype")));
+      auto info = jsonToObject(item, addressType);
+      result.push_back(CachedRelation{std::move(addressType), std::move(info)});
+   }
+   return result;
+}
+
+RelationInfos SelectCitiesPairwise(const std::vector<CachedRelation>& relations, Match match)
+{
+   auto areCloseCoordinates = [](const RelationInfo& c1, const RelationInfo& c2)
+   {
+      return std::abs(c1.latitude - c2.latitude) < 1 && std::abs(c1.longitude - c2.longitude) < 1;
+   };
+
+   constexpr std::array<const char*, 3> sc_types = {"city", "town", "state"};
+
+   RelationInfos cities;
+   for (auto type : sc_types)
+   {
+      for (const auto& relation : relations)
+      {
+         if (relation.addressType == type)
+         {
+            bool needAdd = true;
+            if (match == Match::Any)
+            {
+               for (auto& c : cities)
+               {
+                  if (areCloseCoordinates(c, relation.info))
+                  {
+                     needAdd = false;
+                     break;
+                  }
+               }
+            }
+
+            if (needAdd)
+               cities.push_back(relation.info);
+         }
+         if (match == Match::Best && !cities.empty())
+            break;
+      }
+      if (match == Match::Best && !cities.empty())
+         break;
+   }
+   return cities;
+}
+
+}  // namespace geo::test
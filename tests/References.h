@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../src/search/NominatimApiUtils.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace geo::test
+{
+
+// Implementations which were replaced by optimized code paths, kept as references for tests and benchmarks.
+
+// Parses a response of the Nominatim Address Lookup API into a rapidjson::Document with default allocators,
+// and copies its values through JsonUtils, as lookups did before ParseLookupResponse().
+// Values added to lookups since then ("namedetails" and "country_code") are read the same way.
+// @param response: The JSON response, an array of objects.
+// @return: Objects of the response, or std::nullopt if the response is not a JSON array.
+std::optional<std::vector<nominatim::CachedRelation>> ParseLookupResponseWithDom(const std::string& response);
+
+// Selects cities among looked up objects comparing every candidate with all selected ones,
+// as lookups did before nominatim::SelectCities().
+// @param relations: Looked up objects.
+// @param match: Matching strategy (Best or Any).
+// @return: A list of RelationInfo objects of the selected cities.
+nominatim::RelationInfos SelectCitiesPairwise(
+   const std::vector<nominatim::CachedRelation>& relations, nominatim::Match match);
+
+}  // namespace geo::test
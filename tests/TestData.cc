@@ -0,0 +1,89 @@
+#include "TestData.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <random>
+
+namespace geo::test
+{
+
+std::string MakeWeatherResponse(std::uint32_t numDays, std::uint32_t numLocations)
+{
+   std::mt19937 random(42);
+   std::uniform_int_distribution<int> temperature(-300, 350);
+   const std::chrono::sys_days startDate{std::chrono::year{1950} / 1 / 1};
+   numLocations = std::max(numLocations, 1u);
+
+   std::string response = numLocations > 1 ? "[" : "";
+   for (std::uint32_t location = 0; location < numLocations; ++location)
+   {
+      std::string times;
+      std::string maxValues;
+      std::string minValues;
+      for (std::uint32_t day = 0; day < numDays; ++day)
+      {
+         const char* separator = day ? "," : "";
+         const bool missing = day % 97 == 0;
+         const int min = temperature(random);
+         times += std::format("{}\"{:%F}\"", separator, startDate + std::chrono::days{day});
+         maxValues += missing ? std::format("{}null", separator) : std::format("{}{:.1f}", separator, min / 10.0 + 8.5);
+         minValues += missing ? std::format("{}null", separator) : std::format("{}{:.1f}", separator, min / 10.0);
+      }
+      response += std::format("{}{{\"latitude\":55.95,\"longitude\":37.15,\"generationtime_ms\":1.2,"
+                              "\"utc_offset_seconds\":0,\"timezone\":\"GMT\",\"elevation\":200.0,"
+                              "\"daily_units\":{{\"time\":\"iso8601\",\"temperature_2m_max\":\"°C\","
+                              "\"temperature_2m_min\":\"°C\"}},\"daily\":{{\"time\":[{}],"
+                              "\"temperature_2m_max\":[{}],\"temperature_2m_min\":[{}]}}}}",
+         location ? "," : "", times, maxValues, minValues);
+   }
+   response += numLocations > 1 ? "]" : "";
+   return response;
+}
+
+std::string MakeLookupResponse(std::uint32_t numRelations)
+{
+   std::string response = "[";
+   for (std::uint32_t i = 0; i < numRelations; ++i)
+   {
+      response += std::format("{}{{\"place_id\":{},\"licence\":\"Data (c) OpenStreetMap contributors\","
+                              "\"osm_type\":\"relation\",\"osm_id\":{},\"lat\":\"{:.7f}\",\"lon\":\"{:.7f}\",",
+         i ? "," : "", 256068956 + i, 146656 + i, 53.4794892 + i * 0.01, -2.2451148 + i * 0.01);
+      response += std::format("\"class\":\"boundary\",\"type\":\"administrative\",\"place_rank\":16,"
+                              "\"importance\":0.73,\"addresstype\":\"city\",\"name\":\"City {0}\","
+                              "\"display_name\":\"City {0}, Some District, Some State, Some Country\",",
+         i);
+      response += std::format("\"address\":{{\"city\":\"City {}\",\"state_district\":\"Some District\","
+                              "\"state\":\"Some State\",\"country\":\"Some Country\",\"country_code\":\"sc\"}},",
+         i);
+      if (i % 2 == 0)
+         response += std::format("\"namedetails\":{{\"name\":\"City {0}\",\"name:en\":\"City {0} in English\"}},", i);
+      response += "\"boundingbox\":[\"53.3401044\",\"53.5445923\",\"-2.3199185\",\"-2.1468288\"]}";
+   }
+   response += "]";
+   return response;
+}
+
+std::vector<nominatim::CachedRelation> MakeCityRelations(std::uint32_t numRelations)
+{
+   std::mt19937 random(42);
+   std::uniform_real_distribution<double> latitude(-60, 70);
+   std::uniform_real_distribution<double> longitude(-180, 180);
+   std::uniform_real_distribution<double> offset(-1.5, 1.5);
+   const std::array<const char*, 5> types = {"city", "town", "state", "village", "county"};
+   std::vector<nominatim::CachedRelation> relations(numRelations);
+   for (std::uint32_t i = 0; i < numRelations; ++i)
+   {
+      auto& relation = relations[i];
+      relation.addressType = types[random() % types.size()];
+      relation.info.osmId = 146656 + i;
+      relation.info.name = "Springfield";
+      const bool nearPrevious = i && random() % 4 == 0;
+      relation.info.latitude = nearPrevious ? relations[i - 1].info.latitude + offset(random) : latitude(random);
+      relation.info.longitude = nearPrevious ? relations[i - 1].info.longitude + offset(random) : longitude(random);
+   }
+   return relations;
+}
+
+}  // namespace geo::test
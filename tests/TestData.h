@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../src/search/NominatimApiUtils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace geo::test
+{
+
+// Builds a response of the Open Meteo Historical API in its layout, with temperatures of a fixed pseudo-random
+// sequence and with every 97th day without values.
+// @param numDays: Number of days of every location, starting from 1950-01-01.
+// @param numLocations: Number of locations, the response is an array of them if there are several.
+// @return: The response.
+std::string MakeWeatherResponse(std::uint32_t numDays, std::uint32_t numLocations);
+
+// Builds a response of the Nominatim Address Lookup API in its layout, with cities of consecutive OSM IDs,
+// every other one with an English name in "namedetails".
+// @param numRelations: Number of relations.
+// @return: The response, an array of objects.
+std::string MakeLookupResponse(std::uint32_t numRelations);
+
+// Builds looked up objects of a common name spread over the world with a fixed pseudo-random sequence,
+// some of them close to the previous one, and some of types which are not cities.
+// @param numRelations: Number of objects.
+// @return: The objects.
+std::vector<nominatim::CachedRelation> MakeCityRelations(std::uint32_t numRelations);
+
+}  // namespace geo::test
@@ -0,0 +1,143 @@
+#include "../src/search/WeatherStore.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace
+{
+
+using namespace geo;
+
+const double sc_latitude = 48.14;
+const double sc_longitude = 11.58;
+
+// Returns a date of the given year, month and day
+Date dateOf(int year, unsigned month, unsigned day)
+{
+   return Date{std::chrono::year{year}, std::chrono::month{month}, std::chrono::day{day}};
+}
+
+// Returns a store with daily values of all days of the years, except the skipped ones.
+// Values are exactly representable as floats, so they are the same after they are stored.
+std::unique_ptr<WeatherStore> makeStore(int firstYear, int lastYear, const std::vector<Date>& skipped = {})
+{
+   auto store = std::make_unique<WeatherStore>(4, std::size_t{1} << 30, nullptr, std::chrono::seconds(0));
+   WeatherInfoVector weather;
+   const std::chrono::sys_days last{dateOf(lastYear, 12, 31)};
+   for (std::chrono::sys_days day{dateOf(firstYear, 1, 1)}; day <= last; day += std::chrono::days{1})
+   {
+      const Date date{day};
+      if (std::find(skipped.begin(), skipped.end(), date) != skipped.end())
+         continue;
+
+      const auto number = static_cast<std::int64_t>(day.time_since_epoch().count());
+      WeatherInfo& info = weather.emplace_back();
+      info.time = date;
+      info.temperatureMin = -20 + (number * 37 % 160) / 4.0;
+      info.temperatureMax = info.temperatureMin + (number * 13 % 60) / 4.0;
+      info.temperatureAverage = (info.temperatureMin + info.temperatureMax) / 2;
+   }
+   store->Store(sc_latitude, sc_longitude, weather);
+   return store;
+}
+
+// Aggregates loaded days of the ranges, as SearchEngine does when the store cannot aggregate them
+WeatherAggregate aggregateLoaded(WeatherStore& store, const std::vector<DateRange>& dateRanges)
+{
+   WeatherAggregate result;
+   for (const auto& dateRange : dateRanges)
+   {
+      for (const auto& info : store.Load(sc_latitude, sc_longitude, dateRange))
+         result.Add(info);
+   }
+   return result;
+}
+
+// Aggregates the ranges with climatology indexes and checks that the loaded days give the same values
+void expectSameAsLoaded(WeatherStore& store, const std::vector<DateRange>& dateRanges, std::size_t numDays)
+{
+   const auto expected = aggregateLoaded(store, dateRanges);
+   const auto actual = store.Aggregate(sc_latitude, sc_longitude, dateRanges);
+   ASSERT_TRUE(actual.has_value());
+   EXPECT_EQ(expected.numDays, numDays);
+   EXPECT_EQ(actual->numDays, expected.numDays);
+   EXPECT_EQ(actual->temperatureMin, expected.temperatureMin);
+   EXPECT_EQ(actual->temperatureMax, expected.temperatureMax);
+   EXPECT_NEAR(actual->temperatureSum, expected.temperatureSum, 1e-6);
+}
+
+// Returns the same window of days in consecutive years, the window ends in the year after it starts if it wraps
+std::vector<DateRange> windowOfYears(
+   int firstYear, int numYears, unsigned fromMonth, unsigned fromDay, unsigned toMonth, unsigned toDay)
+{
+   const bool wraps = toMonth < fromMonth || (toMonth == fromMonth && toDay < fromDay);
+   std::vector<DateRange> result;
+   for (int year = firstYear; year < firstYear + numYears; ++year)
+      result.emplace_back(dateOf(year, fromMonth, fromDay), dateOf(wraps ? year + 1 : year, toMonth, toDay));
+   return result;
+}
+
+}  // namespace
+
+TEST(WeatherStoreAggregate, NewYearWindow)
+{
+   const auto store = makeStore(2014, 2024);
+   expectSameAsLoaded(*store, windowOfYears(2015, 5, 12, 20, 1, 10), 5 * 22);
+}
+
+TEST(WeatherStoreAggregate, WholeYears)
+{
+   const auto store = makeStore(2014, 2024);
+   expectSameAsLoaded(*store, windowOfYears(2019, 3, 1, 1, 12, 31), 365 + 366 + 365);
+}
+
+TEST(WeatherStoreAggregate, LeapDayInLeapYears)
+{
+   // 2016 and 2020 have February 29.
+   const auto store = makeStore(2014, 2024);
+   expectSameAsLoaded(*store, windowOfYears(2015, 8, 2, 20, 3, 10), 8 * 19 + 2);
+}
+
+TEST(WeatherStoreAggregate, LeapDayInCommonYears)
+{
+   const auto store = makeStore(2014, 2024);
+   expectSameAsLoaded(*store, windowOfYears(2021, 3, 2, 20, 3, 10), 3 * 19);
+   expectSameAsLoaded(*store, windowOfYears(2021, 3, 2, 28, 3, 1), 3 * 2);
+}
+
+TEST(WeatherStoreAggregate, LeapDayAcrossNewYear)
+{
+   // Windows from December to March of 2019 to 2021 include February 29, 2020 only.
+   const auto store = makeStore(2014, 2024);
+   expectSameAsLoaded(*store, windowOfYears(2019, 3, 12, 1, 3, 1), 31 + 29 + 31 + 1 + 2 * (31 + 31 + 28 + 1));
+}
+
+TEST(WeatherStoreAggregate, MissingDays)
+{
+   const auto store = makeStore(2014, 2024, {dateOf(2018, 1, 5), dateOf(2020, 2, 29)});
+
+   const auto newYear = windowOfYears(2015, 5, 12, 20, 1, 10);
+   EXPECT_EQ(aggregateLoaded(*store, newYear).numDays, 5u * 22 - 1);
+   EXPECT_FALSE(store->Aggregate(sc_latitude, sc_longitude, newYear).has_value());
+
+   const auto leapDay = windowOfYears(2019, 3, 2, 20, 3, 10);
+   EXPECT_EQ(aggregateLoaded(*store, leapDay).numDays, 3u * 19);
+   EXPECT_FALSE(store->Aggregate(sc_latitude, sc_longitude, leapDay).has_value());
+
+   // Windows without the missing days are still aggregated.
+   expectSameAsLoaded(*store, windowOfYears(2015, 5, 12, 20, 1, 4), 5 * 16);
+   expectSameAsLoaded(*store, windowOfYears(2021, 3, 2, 20, 3, 10), 3 * 19);
+}
+
+TEST(WeatherStoreAggregate, DaysOutsideOfTheSeries)
+{
+   const auto store = makeStore(2014, 2024);
+   EXPECT_FALSE(store->Aggregate(sc_latitude, sc_longitude, windowOfYears(2022, 5, 6, 1, 6, 30)).has_value());
+}
@@ -0,0 +1,812 @@
+#include "AdminIndexBuilder.h"
+
+#include "../../src/search/AdminIndex.h"
+#include "../../src/utils/GeoUtils.h"
+#include "../../src/utils/TextUtils.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+
+using namespace geo;
+
+// Types of places as in Nominatim, see SearchEngine for the same mapping of Overpass tags
+constexpr std::array<std::string_view, 3> sc_placeTypes = {"city", "town", "state"};
+
+// Returns a member of a JSON object, or nullptr if there is no such member
+const rapidjson::Value* findMember(const rapidjson::Value& object, const char* name)
+{
+   if (!object.IsObject())
+      return nullptr;
+   const auto it = object.FindMember(name);
+   return it != object.MemberEnd() ? &it->value : nullptr;
+}
+
+// Returns a string member of a JSON object, or an empty string if there is no such member
+std::string getString(const rapidjson::Value& object, const char* name)
+{
+   const auto* value = findMember(object, name);
+   return value && value->IsString() ? std::string(value->GetString(), value->GetStringLength()) : std::string();
+}
+
+// Returns a number member of a JSON object, or std::nullopt if there is no such member
+std::optional<double> getNumber(const rapidjson::Value& object, const char* name)
+{
+   const auto* value = findMember(object, name);
+   return value && value->IsNumber() ? std::optional(value->GetDouble()) : std::nullopt;
+}
+
+// Parses a number which is the whole text, as is_number() of Overpass
+std::optional<double> parseNumber(const std::string& text)
+{
+   double value = 0;
+   const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+   return !text.empty() && error == std::errc() && end == text.data() + text.size() ? std::optional(value)
+                                                                                      : std::nullopt;
+}
+
+// Returns the position of a point along the Hilbert curve over the whole globe
+std::uint32_t getHilbertIndex(double longitude, double latitude)
+{
+   return GetHilbertIndex(static_cast<std::uint32_t>((longitude + 180) / 360 * 0xFFFF),
+      static_cast<std::uint32_t>((latitude + 90) / 180 * 0xFFFF));
+}
+
+// Returns the distance from a point to a segment, in degrees as on a plane
+double getDistance(double x, double y, double x1, double y1, double x2, double y2)
+{
+   const double dx = x2 - x1;
+   const double dy = y2 - y1;
+   const double lengthSquared = dx * dx + dy * dy;
+   const double t = lengthSquared > 0 ? std::clamp(((x - x1) * dx + (y - y1) * dy) / lengthSquared, 0.0, 1.0) : 0;
+   return std::hypot(x - x1 - t * dx, y - y1 - t * dy);
+}
+
+// Extends a box to include another box
+void extend(AdminIndexBox& box, const AdminIndexBox& other)
+{
+   box.minLongitude = std::min(box.minLongitude, other.minLongitude);
+   box.minLatitude = std::min(box.minLatitude, other.minLatitude);
+   box.maxLongitude = std::max(box.maxLongitude, other.maxLongitude);
+   box.maxLatitude = std::max(box.maxLatitude, other.maxLatitude);
+}
+
+// Radix tree of folded names, see AdminIndexFormat.h
+struct NameTree
+{
+   std::vector<AdminIndexNameNode> nodes;
+   std::vector<AdminIndexNameEdge> edges;
+   std::vector<char> labels;
+   std::vector<std::uint32_t> places;
+};
+
+// Folded names and indexes of their places, sorted and unique
+using NameKeys = std::vector<std::pair<std::string, std::uint32_t>>;
+
+// Adds a node for keys which share their first bytes, and nodes below it for the rest of the keys
+// @param tree Tree to add the nodes to
+// @param keys All keys
+// @param begin First key of the node
+// @param end Key after the last key of the node
+// @param depth Number of the shared bytes, at the end of a character
+// @return Index of the node
+std::uint32_t addNameNode(NameTree& tree, const NameKeys& keys, std::size_t begin, std::size_t end, std::size_t depth)
+{
+   const auto node = static_cast<std::uint32_t>(tree.nodes.size());
+   tree.nodes.emplace_back();
+
+   // Keys which end at the node are sorted before the longer ones.
+   const auto firstPlace = static_cast<std::uint32_t>(tree.places.size());
+   for (; begin < end && keys[begin].first.size() == depth; ++begin)
+      tree.places.push_back(keys[begin].second);
+
+   // Keys are grouped by their next characters, every group is a child of the node.
+   std::vector<std::pair<std::size_t, std::size_t>> groups;
+   for (std::size_t i = begin; i < end;)
+   {
+      const std::string& key = keys[i].first;
+      std::size_t next = depth;
+      DecodeUtf8(key, next);
+      std::size_t j = i + 1;
+      while (j < end && keys[j].first.compare(depth, next - depth, key, depth, next - depth) == 0)
+         ++j;
+      groups.emplace_back(i, j);
+      i = j;
+   }
+
+   const auto firstEdge = static_cast<std::uint32_t>(tree.edges.size());
+   tree.edges.resize(tree.edges.size() + groups.size());
+   tree.nodes[node] = {firstEdge, static_cast<std::uint32_t>(groups.size()), firstPlace,
+      static_cast<std::uint32_t>(tree.places.size() - firstPlace)};
+
+   for (std::size_t i = 0; i < groups.size(); ++i)
+   {
+      // The label is extended while no key of the group ends, and all of them share the next character.
+      // Keys are sorted, so the first and the last keys share what all keys of the group share.
+      const auto [groupBegin, groupEnd] = groups[i];
+      const std::string& first = keys[groupBegin].first;
+      const std::string& last = keys[groupEnd - 1].first;
+      std::size_t labelEnd = depth;
+      DecodeUtf8(first, labelEnd);
+      while (labelEnd < first.size())
+      {
+         std::size_t next = labelEnd;
+         DecodeUtf8(first, next);
+         if (last.compare(labelEnd, next - labelEnd, first, labelEnd, next - labelEnd) != 0)
+            break;
+         labelEnd = next;
+      }
+
+      const auto label = static_cast<std::uint32_t>(tree.labels.size());
+      tree.labels.insert(tree.labels.end(), first.begin() + depth, first.begin() + labelEnd);
+      const std::uint32_t child = addNameNode(tree, keys, groupBegin, groupEnd, labelEnd);
+      tree.edges[firstEdge + i] = {label, static_cast<std::uint32_t>(labelEnd - depth), child};
+   }
+   return node;
+}
+
+}  // namespace
+
+namespace geo
+{
+
+AdminIndexBuilder::AdminIndexBuilder(double toleranceDegrees, bool coversWorld)
+   : m_tolerance(toleranceDegrees)
+   , m_coversWorld(coversWorld)
+{
+}
+
+bool AdminIndexBuilder::AddOverpassResponse(const std::string& json)
+{
+   rapidjson::Document document;
+   document.Parse(json.c_str(), json.size());
+   const auto* elements = document.HasParseError() ? nullptr : findMember(document, "elements");
+   if (!elements || !elements->IsArray())
+      return false;
+
+   for (const auto& element : elements->GetArray())
+   {
+      if (getString(element, "type") == "relation")
+         addRelation(element);
+      addFeature(element);
+   }
+   return true;
+}
+
+void AdminIndexBuilder::AddTo(SnapshotWriter& snapshot)
+{
+   assignCountries();
+
+   // Places are sorted along the Hilbert curve by the centers of their boxes, scaled to the extent of all boxes.
+   AdminIndexBox extent = m_places.empty() ? AdminIndexBox{} : m_places.front().box;
+   for (const auto& place : m_places)
+      extend(extent, place.box);
+   const double width = std::max(extent.maxLongitude - extent.minLongitude, 1e-9f);
+   const double height = std::max(extent.maxLatitude - extent.minLatitude, 1e-9f);
+   std::vector<std::pair<std::uint32_t, std::size_t>> order;
+   for (std::size_t i = 0; i < m_places.size(); ++i)
+   {
+      const auto& box = m_places[i].box;
+      const double x = ((box.minLongitude + box.maxLongitude) / 2 - extent.minLongitude) / width;
+      const double y = ((box.minLatitude + box.maxLatitude) / 2 - extent.minLatitude) / height;
+      const auto hilbertIndex =
+         GetHilbertIndex(static_cast<std::uint32_t>(x * 0xFFFF), static_cast<std::uint32_t>(y * 0xFFFF));
+      order.emplace_back(hilbertIndex, i);
+   }
+   std::sort(order.begin(), order.end());
+
+   std::vector<Boundary> places;
+   places.reserve(m_places.size());
+   for (const auto& [hilbertIndex, i] : order)
+      places.push_back(std::move(m_places[i]));
+   m_places = std::move(places);
+
+   // Leaves are the boxes of places, every level above has a node for every nodeSize boxes of the level below.
+   std::vector<AdminIndexBox> boxes;
+   std::vector<std::uint32_t> children;
+   std::vector<std::uint64_t> levels;
+   for (const auto& place : m_places)
+      boxes.push_back(place.box);
+   if (!boxes.empty())
+      levels.push_back(boxes.size());
+   for (std::size_t levelBegin = 0; !levels.empty() && levels.back() - levelBegin > 1;)
+   {
+      const std::size_t levelEnd = levels.back();
+      for (std::size_t i = levelBegin; i < levelEnd; i += sc_adminIndexNodeSize)
+      {
+         AdminIndexBox box = boxes[i];
+         for (std::size_t j = i + 1; j < std::min<std::size_t>(i + sc_adminIndexNodeSize, levelEnd); ++j)
+            extend(box, boxes[j]);
+         boxes.push_back(box);
+         children.push_back(static_cast<std::uint32_t>(i));
+      }
+      levelBegin = levelEnd;
+      levels.push_back(boxes.size());
+   }
+
+   // Equal strings, e.g. names of countries, are stored once.
+   std::vector<char> strings(1, '\0');
+   std::unordered_map<std::string, std::uint32_t> stringOffsets{{"", 0}};
+   auto addString = [&strings, &stringOffsets](const std::string& s)
+   {
+      const auto [it, inserted] = stringOffsets.try_emplace(s, static_cast<std::uint32_t>(strings.size()));
+      if (inserted)
+      {
+         strings.insert(strings.end(), s.begin(), s.end());
+         strings.push_back('\0');
+      }
+      return it->second;
+   };
+
+   std::vector<AdminIndexPlace> placeRecords;
+   std::vector<AdminIndexRing> ringRecords;
+   std::vector<float> longitudes;
+   std::vector<float> latitudes;
+   for (const auto& place : m_places)
+   {
+      AdminIndexPlace& record = placeRecords.emplace_back();
+      record.osmId = place.osmId;
+      record.latitude = place.center.latitude;
+      record.longitude = place.center.longitude;
+      record.firstRing = static_cast<std::uint32_t>(ringRecords.size());
+      record.numRings = static_cast<std::uint32_t>(place.rings.size());
+      record.addressType = addString(place.addressType);
+      record.name = addString(place.name);
+      record.nameEn = addString(place.nameEn);
+      record.country = addString(place.country);
+      record.countryEn = addString(place.countryEn);
+      record.countryCode = addString(place.countryCode);
+      for (const auto& ring : place.rings)
+      {
+         ringRecords.push_back(
+            {static_cast<std::uint32_t>(longitudes.size()), static_cast<std::uint32_t>(ring.longitudes.size())});
+         longitudes.insert(longitudes.end(), ring.longitudes.begin(), ring.longitudes.end());
+         latitudes.insert(latitudes.end(), ring.latitudes.begin(), ring.latitudes.end());
+      }
+   }
+
+   // Every place is found by all of its names, the tree has a root even without names.
+   NameKeys nameKeys;
+   for (std::size_t i = 0; i < m_places.size(); ++i)
+   {
+      for (const auto& name : m_places[i].names)
+      {
+         std::string folded = FoldName(name);
+         if (!folded.empty())
+            nameKeys.emplace_back(std::move(folded), static_cast<std::uint32_t>(i));
+      }
+   }
+   std::sort(nameKeys.begin(), nameKeys.end());
+   nameKeys.erase(std::unique(nameKeys.begin(), nameKeys.end()), nameKeys.end());
+   NameTree nameTree;
+   addNameNode(nameTree, nameKeys, 0, nameKeys.size(), 0);
+   for (std::size_t i = 0; i < nameKeys.size(); ++i)
+      m_stats.names += i == 0 || nameKeys[i].first != nameKeys[i - 1].first;
+
+   // Points of every type are sorted along the Hilbert curve, so points of a block are close to each other.
+   std::vector<std::uint32_t> regions;
+   std::vector<AdminIndexFeatureType> featureTypes;
+   std::vector<AdminIndexFeature> features;
+   std::vector<AdminIndexFeatureBlock> featureBlocks;
+   for (auto& typeFeatures : assignRegions(regions))
+   {
+      std::sort(typeFeatures.begin(), typeFeatures.end(),
+         [](const AdminIndexFeature& a, const AdminIndexFeature& b)
+         {
+            return getHilbertIndex(a.longitude, a.latitude) < getHilbertIndex(b.longitude, b.latitude);
+         });
+
+      AdminIndexFeatureType& type = featureTypes.emplace_back();
+      type.firstFeature = static_cast<std::uint32_t>(features.size());
+      type.numFeatures = static_cast<std::uint32_t>(typeFeatures.size());
+      type.firstBlock = static_cast<std::uint32_t>(featureBlocks.size());
+      for (std::size_t i = 0; i < typeFeatures.size(); ++i)
+      {
+         const auto& feature = typeFeatures[i];
+         const AdminIndexBox box{feature.longitude, feature.latitude, feature.longitude, feature.latitude};
+         if (i % sc_adminIndexFeatureBlockSize == 0)
+            featureBlocks.push_back({box, feature.elevation});
+         extend(featureBlocks.back().box, box);
+         featureBlocks.back().maxElevation = std::max(featureBlocks.back().maxElevation, feature.elevation);
+      }
+      type.numBlocks = static_cast<std::uint32_t>(featureBlocks.size()) - type.firstBlock;
+      features.insert(features.end(), typeFeatures.begin(), typeFeatures.end());
+   }
+   m_stats.featurePoints = features.size();
+   m_stats.regions = regions.size();
+
+   const auto coverage = computeCoverage();
+
+   const AdminIndexInfo info{sc_adminIndexVersion, sc_adminIndexNodeSize, m_coversWorld ? 1u : 0u};
+   snapshot.AddSection(sz_adminIndexInfo, std::vector<AdminIndexInfo>{info});
+   snapshot.AddSection(sz_adminIndexLevels, levels);
+   snapshot.AddSection(sz_adminIndexBoxes, boxes);
+   snapshot.AddSection(sz_adminIndexChildren, children);
+   snapshot.AddSection(sz_adminIndexPlaces, placeRecords);
+   snapshot.AddSection(sz_adminIndexRings, ringRecords);
+   snapshot.AddSection(sz_adminIndexLongitudes, longitudes);
+   snapshot.AddSection(sz_adminIndexLatitudes, latitudes);
+   snapshot.AddSection(sz_adminIndexStrings, strings);
+   snapshot.AddSection(sz_adminIndexNameNodes, nameTree.nodes);
+   snapshot.AddSection(sz_adminIndexNameEdges, nameTree.edges);
+   snapshot.AddSection(sz_adminIndexNameLabels, nameTree.labels);
+   snapshot.AddSection(sz_adminIndexNamePlaces, nameTree.places);
+   snapshot.AddSection(sz_adminIndexRegions, regions);
+   snapshot.AddSection(sz_adminIndexFeatureTypes, featureTypes);
+   snapshot.AddSection(sz_adminIndexFeatures, features);
+   snapshot.AddSection(sz_adminIndexFeatureBlocks, featureBlocks);
+   snapshot.AddSection(sz_adminIndexCoverage, coverage);
+}
+
+void AdminIndexBuilder::addRelation(const rapidjson::Value& relation)
+{
+   ++m_stats.relations;
+
+   const auto* tags = findMember(relation, "tags");
+   if (!tags)
+      return;
+
+   int adminLevel = 0;
+   const std::string adminLevelTag = getString(*tags, "admin_level");
+   std::from_chars(adminLevelTag.data(), adminLevelTag.data() + adminLevelTag.size(), adminLevel);
+
+   Boundary boundary;
+   boundary.adminLevel = adminLevel;
+   const auto* id = findMember(relation, "id");
+   boundary.osmId = id && id->IsInt64() ? id->GetInt64() : 0;
+   boundary.name = getString(*tags, "name");
+   boundary.nameEn = getString(*tags, "name:en");
+   boundary.addressType = getString(*tags, "place");
+   if (std::find(sc_placeTypes.begin(), sc_placeTypes.end(), boundary.addressType) == sc_placeTypes.end())
+      boundary.addressType = adminLevel == 4 ? "state" : "";
+
+   const bool isCountry = adminLevel == 2;
+   const bool isPlace = !boundary.addressType.empty();
+   if ((!isCountry && !isPlace) || boundary.name.empty())
+      return;
+
+   // Nominatim names places in English by "name:en", or by the native name if there is none.
+   if (boundary.nameEn.empty())
+      boundary.nameEn = boundary.name;
+
+   // Alternative names are separated by semicolons.
+   for (auto it = tags->MemberBegin(); it != tags->MemberEnd(); ++it)
+   {
+      const std::string_view key(it->name.GetString(), it->name.GetStringLength());
+      if (!it->value.IsString() || (key != "name" && !key.starts_with("name:") && key != "alt_name"))
+         continue;
+      const std::string_view value(it->value.GetString(), it->value.GetStringLength());
+      for (std::size_t begin = 0; begin <= value.size();)
+      {
+         const std::size_t end = key == "alt_name" ? std::min(value.find(';', begin), value.size()) : value.size();
+         if (end > begin)
+            boundary.names.emplace_back(value.substr(begin, end - begin));
+         begin = end + 1;
+      }
+   }
+
+   const auto* members = findMember(relation, "members");
+   if (!members || !members->IsArray())
+      return;
+
+   std::optional<Point> adminCentre;
+   std::optional<Point> label;
+   for (const auto& member : members->GetArray())
+   {
+      const auto latitude = getNumber(member, "lat");
+      const auto longitude = getNumber(member, "lon");
+      if (getString(member, "type") != "node" || !latitude || !longitude)
+         continue;
+      const Point point{*longitude, *latitude};
+      const std::string role = getString(member, "role");
+      if (role == "admin_centre")
+         adminCentre = point;
+      else if (role == "label")
+         label = point;
+   }
+
+   const float infinity = std::numeric_limits<float>::infinity();
+   boundary.box = {infinity, infinity, -infinity, -infinity};
+   for (const auto& path : assembleRings(*members))
+   {
+      m_stats.inputVertices += isPlace ? path.size() : 0;
+      auto& ring = boundary.rings.emplace_back(simplify(path));
+      for (std::size_t i = 0; i < ring.longitudes.size(); ++i)
+         extend(boundary.box, {ring.longitudes[i], ring.latitudes[i], ring.longitudes[i], ring.latitudes[i]});
+   }
+   if (boundary.rings.empty())
+      return;
+
+   boundary.center = adminCentre ? *adminCentre
+                     : label     ? *label
+                                 : Point{(boundary.box.minLongitude + boundary.box.maxLongitude) / 2.0,
+                                     (boundary.box.minLatitude + boundary.box.maxLatitude) / 2.0};
+
+   if (isCountry)
+   {
+      Boundary& country = m_countries.emplace_back(boundary);
+      country.country = country.name;
+      country.countryEn = country.nameEn;
+      country.countryCode = getString(*tags, "ISO3166-1:alpha2");
+      if (country.countryCode.empty())
+         country.countryCode = getString(*tags, "ISO3166-1");
+      std::transform(country.countryCode.begin(), country.countryCode.end(), country.countryCode.begin(),
+         [](unsigned char c)
+         {
+            return static_cast<char>(std::tolower(c));
+         });
+      ++m_stats.countries;
+   }
+
+   if (isPlace)
+   {
+      ++m_stats.places;
+      m_stats.rings += boundary.rings.size();
+      for (const auto& ring : boundary.rings)
+         m_stats.vertices += ring.longitudes.size();
+      m_places.push_back(std::move(boundary));
+   }
+}
+
+void AdminIndexBuilder::addFeature(const rapidjson::Value& element)
+{
+   const auto* tags = findMember(element, "tags");
+   if (!tags)
+      return;
+
+   // Tags of the types are the same as in the Overpass queries of SearchEngine.
+   const std::string natural = getString(*tags, "natural");
+   const bool hasName = !getString(*tags, "name").empty();
+   const auto elevation = parseNumber(getString(*tags, "ele"));
+   Feature feature;
+   if ((getString(*tags, "aeroway") == "aerodrome" && getString(*tags, "aerodrome:type") == "international") ||
+       getString(*tags, "aerodrome") == "international")
+      feature.type = sc_adminIndexAirports;
+   else if (natural == "peak" && hasName && elevation)
+   {
+      feature.type = sc_adminIndexPeaks;
+      feature.elevation = static_cast<float>(*elevation);
+   }
+   else if (natural == "beach")
+      feature.type = sc_adminIndexSeaBeaches;
+   else if (natural == "water" && getString(*tags, "water") == "lake" && getString(*tags, "salt") == "no" && hasName)
+      feature.type = sc_adminIndexSaltLakes;
+   else
+      return;
+
+   // Nodes have their coordinates, ways and relations have geometries of "out geom", or centers of "out center".
+   auto addPoint = [&feature](const rapidjson::Value& point)
+   {
+      const auto latitude = getNumber(point, "lat");
+      const auto longitude = getNumber(point, "lon");
+      if (latitude && longitude)
+         feature.points.push_back({*longitude, *latitude});
+   };
+   addPoint(element);
+   if (const auto* center = findMember(element, "center"))
+      addPoint(*center);
+   std::vector<const rapidjson::Value*> geometries{findMember(element, "geometry")};
+   if (const auto* members = findMember(element, "members"); members && members->IsArray())
+   {
+      for (const auto& member : members->GetArray())
+      {
+         addPoint(member);
+         geometries.push_back(findMember(member, "geometry"));
+      }
+   }
+   for (const auto* geometry : geometries)
+   {
+      if (geometry && geometry->IsArray())
+      {
+         for (const auto& point : geometry->GetArray())
+            addPoint(point);
+      }
+   }
+
+   if (!feature.points.empty())
+   {
+      ++m_stats.features;
+      m_features.push_back(std::move(feature));
+   }
+}
+
+std::vector<std::vector<AdminIndexFeature>> AdminIndexBuilder::assignRegions(std::vector<std::uint32_t>& regions)
+{
+   // Regions are the places of admin level 4, as in the Overpass queries of SearchEngine.
+   std::vector<std::uint32_t> candidates;
+   for (std::size_t i = 0; i < m_places.size(); ++i)
+   {
+      if (m_places[i].adminLevel == 4)
+         candidates.push_back(static_cast<std::uint32_t>(i));
+   }
+
+   // A feature is stored at its first point in every region which it touches, e.g. a lake on a border
+   // belongs to both regions. Consecutive points are usually in the same region, so it is checked first.
+   std::vector<std::vector<AdminIndexFeature>> result(sc_adminIndexFeatureTypes);
+   std::vector<bool> hasFeatures(candidates.size(), false);
+   for (const auto& feature : m_features)
+   {
+      std::vector<std::size_t> featureCandidates;
+      std::size_t last = candidates.size();
+      for (const auto& point : feature.points)
+      {
+         if (last == candidates.size() || !containsPoint(m_places[candidates[last]], point))
+         {
+            const auto it = std::find_if(candidates.begin(), candidates.end(),
+               [this, &point](std::uint32_t place)
+               {
+                  return containsPoint(m_places[place], point);
+               });
+            last = static_cast<std::size_t>(it - candidates.begin());
+         }
+         if (last == candidates.size() ||
+             std::find(featureCandidates.begin(), featureCandidates.end(), last) != featureCandidates.end())
+            continue;
+
+         featureCandidates.push_back(last);
+         hasFeatures[last] = true;
+         result[feature.type].push_back({static_cast<float>(point.longitude), static_cast<float>(point.latitude),
+            feature.elevation, static_cast<std::uint32_t>(last)});
+      }
+   }
+
+   // Only regions with features are stored, so points are renumbered from candidates to stored regions.
+   std::vector<std::uint32_t> regionOfCandidate(candidates.size());
+   for (std::size_t i = 0; i < candidates.size(); ++i)
+   {
+      regionOfCandidate[i] = static_cast<std::uint32_t>(regions.size());
+      if (hasFeatures[i])
+         regions.push_back(candidates[i]);
+   }
+   for (auto& typeFeatures : result)
+   {
+      for (auto& feature : typeFeatures)
+         feature.region = regionOfCandidate[feature.region];
+   }
+   return result;
+}
+
+std::vector<AdminIndexBuilder::Path> AdminIndexBuilder::assembleRings(const rapidjson::Value& members)
+{
+   // Ways of all roles are joined together: the index uses the even-odd rule, so outer and inner rings
+   // need not be distinguished.
+   std::vector<Path> ways;
+   for (const auto& member : members.GetArray())
+   {
+      const auto* geometry = findMember(member, "geometry");
+      if (getString(member, "type") != "way" || !geometry || !geometry->IsArray())
+         continue;
+
+      // Vertices outside of a clipped extract are null, such ways are incomplete.
+      Path way;
+      for (const auto& vertex : geometry->GetArray())
+      {
+         const auto latitude = getNumber(vertex, "lat");
+         const auto longitude = getNumber(vertex, "lon");
+         if (!latitude || !longitude)
+         {
+            way.clear();
+            break;
+         }
+         way.push_back({*longitude, *latitude});
+      }
+      if (way.size() >= 2)
+         ways.push_back(std::move(way));
+      else
+         ++m_stats.droppedRings;
+   }
+
+   std::vector<Path> rings;
+   while (!ways.empty())
+   {
+      Path ring = std::move(ways.back());
+      ways.pop_back();
+      while (ring.front() != ring.back())
+      {
+         // The next way starts or ends where the ring ends.
+         const auto it = std::find_if(ways.begin(), ways.end(),
+            [&ring](const Path& way)
+            {
+               return way.front() == ring.back() || way.back() == ring.back();
+            });
+         if (it == ways.end())
+            break;
+
+         if (it->front() == ring.back())
+            ring.insert(ring.end(), it->begin() + 1, it->end());
+         else
+            ring.insert(ring.end(), it->rbegin() + 1, it->rend());
+         ways.erase(it);
+      }
+
+      if (ring.size() >= 4 && ring.front() == ring.back())
+         rings.push_back(std::move(ring));
+      else
+         ++m_stats.droppedRings;
+   }
+   return rings;
+}
+
+AdminIndexBuilder::Ring AdminIndexBuilder::simplify(const Path& path) const
+{
+   // Douglas-Peucker: the vertex farthest from the segment between two kept vertices is kept
+   // if it is farther than the tolerance, then both halves are simplified the same way.
+   // The first and the last vertex of a closed path are the same, so the first split is by the farthest vertex
+   // from the first one.
+   std::vector<bool> keep(path.size(), false);
+   keep.front() = true;
+   keep.back() = true;
+   std::vector<std::pair<std::size_t, std::size_t>> segments = {{0, path.size() - 1}};
+   while (!segments.empty())
+   {
+      const auto [first, last] = segments.back();
+      segments.pop_back();
+
+      double maxDistance = 0;
+      std::size_t farthest = first;
+      for (std::size_t i = first + 1; i < last; ++i)
+      {
+         const double distance = getDistance(path[i].longitude, path[i].latitude, path[first].longitude,
+            path[first].latitude, path[last].longitude, path[last].latitude);
+         if (distance > maxDistance)
+         {
+            maxDistance = distance;
+            farthest = i;
+         }
+      }
+
+      if (maxDistance > m_tolerance)
+      {
+         keep[farthest] = true;
+         segments.emplace_back(first, farthest);
+         segments.emplace_back(farthest, last);
+      }
+   }
+
+   // Rings smaller than the tolerance would collapse, they are kept as they are.
+   const bool isCollapsed = std::count(keep.begin(), keep.end(), true) < 4;
+   Ring ring;
+   for (std::size_t i = 0; i < path.size(); ++i)
+   {
+      if (keep[i] || isCollapsed)
+      {
+         ring.longitudes.push_back(static_cast<float>(path[i].longitude));
+         ring.latitudes.push_back(static_cast<float>(path[i].latitude));
+      }
+   }
+   return ring;
+}
+
+void AdminIndexBuilder::assignCountries()
+{
+   for (auto& place : m_places)
+   {
+      const auto it = std::find_if(m_countries.begin(), m_countries.end(),
+         [&place](const Boundary& country)
+         {
+            return containsPoint(country, place.center);
+         });
+      if (it == m_countries.end())
+      {
+         ++m_stats.withoutCountry;
+         continue;
+      }
+
+      place.country = it->country;
+      place.countryEn = it->countryEn;
+      place.countryCode = it->countryCode;
+   }
+}
+
+std::vector<AdminIndexCoverageRun> AdminIndexBuilder::computeCoverage()
+{
+   std::vector<AdminIndexCoverageRun> runs;
+   if (m_countries.empty())
+      return runs;
+
+   AdminIndexBox extent = m_countries.front().box;
+   for (const auto& country : m_countries)
+      extend(extent, country.box);
+   const auto getCell = [](double degrees)
+   {
+      return static_cast<std::int32_t>(std::floor(degrees * sc_adminIndexCoverageCellsPerDegree));
+   };
+   const std::int32_t firstRow = getCell(extent.minLatitude);
+   const std::int32_t firstColumn = getCell(extent.minLongitude);
+   const std::int32_t numRows = getCell(extent.maxLatitude) - firstRow + 1;
+   const std::int32_t numColumns = getCell(extent.maxLongitude) - firstColumn + 1;
+
+   // Edges of the outline of the countries cross cells which are partly outside of them. Borders between
+   // countries of the extract are not the outline: points on both sides of the middle of their edges are inside
+   // of countries, if the points are farther than borders shifted by simplification of both countries.
+   // Cells of the box of an outline edge are marked as crossed, which is safe for diagonal edges.
+   const double offset = 2 * m_tolerance + 1e-4;
+   std::vector<bool> crossed(static_cast<std::size_t>(numRows) * numColumns);
+   for (const auto& country : m_countries)
+   {
+      for (const auto& ring : country.rings)
+      {
+         for (std::size_t i = 0; i + 1 < ring.longitudes.size(); ++i)
+         {
+            const Point a{ring.longitudes[i], ring.latitudes[i]};
+            const Point b{ring.longitudes[i + 1], ring.latitudes[i + 1]};
+            const double length = std::hypot(b.longitude - a.longitude, b.latitude - a.latitude);
+            if (length == 0)
+               continue;
+            const Point middle{(a.longitude + b.longitude) / 2, (a.latitude + b.latitude) / 2};
+            const double dx = (a.latitude - b.latitude) / length * offset;
+            const double dy = (b.longitude - a.longitude) / length * offset;
+            if (isInCountries({middle.longitude + dx, middle.latitude + dy}) &&
+                isInCountries({middle.longitude - dx, middle.latitude - dy}))
+               continue;
+
+            for (std::int32_t row = getCell(std::min(a.latitude, b.latitude));
+                 row <= getCell(std::max(a.latitude, b.latitude)); ++row)
+            {
+               for (std::int32_t column = getCell(std::min(a.longitude, b.longitude));
+                    column <= getCell(std::max(a.longitude, b.longitude)); ++column)
+                  crossed[static_cast<std::size_t>(row - firstRow) * numColumns + (column - firstColumn)] = true;
+            }
+         }
+      }
+   }
+
+   // A cell which no edge of the outline crosses is either inside of the countries or outside of them,
+   // as is its center.
+   for (std::int32_t row = firstRow; row < firstRow + numRows; ++row)
+   {
+      for (std::int32_t column = firstColumn; column < firstColumn + numColumns; ++column)
+      {
+         const Point center{(column + 0.5) / sc_adminIndexCoverageCellsPerDegree,
+            (row + 0.5) / sc_adminIndexCoverageCellsPerDegree};
+         if (crossed[static_cast<std::size_t>(row - firstRow) * numColumns + (column - firstColumn)] ||
+             !isInCountries(center))
+            continue;
+
+         ++m_stats.coveredCells;
+         if (!runs.empty() && runs.back().row == row && runs.back().endColumn == column)
+            ++runs.back().endColumn;
+         else
+            runs.push_back({row, column, column + 1});
+      }
+   }
+   return runs;
+}
+
+bool AdminIndexBuilder::isInCountries(const Point& point) const
+{
+   return std::any_of(m_countries.begin(), m_countries.end(),
+      [&point](const Boundary& country)
+      {
+         return containsPoint(country, point);
+      });
+}
+
+bool AdminIndexBuilder::containsPoint(const Boundary& boundary, const Point& point)
+{
+   const float longitude = static_cast<float>(point.longitude);
+   const float latitude = static_cast<float>(point.latitude);
+   if (longitude < boundary.box.minLongitude || longitude > boundary.box.maxLongitude ||
+       latitude < boundary.box.minLatitude || latitude > boundary.box.maxLatitude)
+      return false;
+
+   std::uint32_t crossings = 0;
+   for (const auto& ring : boundary.rings)
+   {
+      crossings += AdminIndex::CountCrossings(
+         ring.longitudes.data(), ring.latitudes.data(), ring.longitudes.size(), longitude, latitude);
+   }
+   return crossings % 2 == 1;
+}
+
+}  // namespace geo
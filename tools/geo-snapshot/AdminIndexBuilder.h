@@ -0,0 +1,150 @@
+#pragma once
+
+#include "../../src/search/AdminIndexFormat.h"
+#include "../../src/utils/Snapshot.h"
+
+#include <rapidjson/document.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace geo
+{
+
+// AdminIndexBuilder builds the sections of the administrative boundary index used by AdminIndex.
+// Boundaries are taken from relations of an OSM extract in the format of Overpass API responses with "out geom",
+// where members have their geometries inline, so rings are assembled without a separate node store.
+// Rings are simplified with the Douglas-Peucker algorithm, and places are sorted along the Hilbert curve
+// by the centers of their bounding boxes, so the packed R-tree groups places which are close to each other.
+// Names of places in all languages are folded and stored in a radix tree for searches by name.
+// Features of the extract (international airports, peaks, sea beaches, salt lakes) are assigned to the regions
+// of admin level 4 which contain them, and the cells of the coverage grid inside of its countries are recorded,
+// so the server searches regions locally only inside of the extract.
+class AdminIndexBuilder
+{
+public:
+   // Counters of the build, see GetStats()
+   struct Stats
+   {
+      std::uint64_t relations = 0;       // Number of relations read
+      std::uint64_t places = 0;          // Number of places added to the index
+      std::uint64_t countries = 0;       // Number of countries used to find countries of places
+      std::uint64_t rings = 0;           // Number of rings of places
+      std::uint64_t inputVertices = 0;   // Number of vertices of rings of places before simplification
+      std::uint64_t vertices = 0;        // Number of vertices of rings of places after simplification
+      std::uint64_t droppedRings = 0;    // Number of rings which could not be closed
+      std::uint64_t withoutCountry = 0;  // Number of places outside of all countries
+      std::uint64_t names = 0;           // Number of distinct folded names of places
+      std::uint64_t features = 0;        // Number of features read
+      std::uint64_t featurePoints = 0;   // Number of points of features in regions
+      std::uint64_t regions = 0;         // Number of regions with features
+      std::uint64_t coveredCells = 0;    // Number of cells of the coverage grid inside of countries
+   };
+
+public:
+   // @param toleranceDegrees Maximum distance of removed vertices from simplified rings, in degrees
+   // @param coversWorld True if the extract covers the whole world, so names missing in it are of no place
+   AdminIndexBuilder(double toleranceDegrees, bool coversWorld);
+
+   // Adds boundaries of places and countries, and features of an Overpass API response.
+   // Relations with a "place" tag of city, town or state, or with admin level 4, are places.
+   // Relations with admin level 2 are countries, their names are assigned to places inside of them.
+   // Places are found by "name", "name:<language>" and "alt_name" tags.
+   // Features are selected by the same tags as in the Overpass queries of SearchEngine, but the extract
+   // must select sea beaches itself, as there is no check of the distance to coastlines.
+   // @param json Response of the Overpass API with "out geom"
+   // @return false if the response is not valid JSON
+   bool AddOverpassResponse(const std::string& json);
+
+   // Adds the sections of the index to a snapshot
+   // @param snapshot Snapshot to add to
+   void AddTo(SnapshotWriter& snapshot);
+
+   // Returns counters of the build
+   Stats GetStats() const { return m_stats; }
+
+private:
+   // Vertex of a ring
+   struct Point
+   {
+      double longitude = 0;
+      double latitude = 0;
+
+      bool operator==(const Point&) const = default;
+   };
+
+   using Path = std::vector<Point>;
+
+   // Closed ring as stored in the index, the last vertex repeats the first one
+   struct Ring
+   {
+      std::vector<float> longitudes;
+      std::vector<float> latitudes;
+   };
+
+   // Boundary relation read from the extract
+   struct Boundary
+   {
+      std::int64_t osmId = 0;
+      std::string addressType;
+      int adminLevel = 0;
+      std::string name;
+      std::string nameEn;
+      std::string countryCode;         // Code of a country, or of the country of a place once it is found
+      std::string country;             // Name of the country of a place
+      std::string countryEn;           // English name of the country of a place
+      std::vector<std::string> names;  // Names to search by: "name", "name:<language>" and "alt_name"
+      Point center;
+      std::vector<Ring> rings;
+      AdminIndexBox box{};
+   };
+
+   // Feature read from the extract
+   struct Feature
+   {
+      std::uint32_t type = 0;     // Type of the feature, see AdminIndexFormat.h
+      float elevation = 0;        // Elevation of a peak
+      std::vector<Point> points;  // Points of the feature, e.g. vertices of the outline of a lake
+   };
+
+   // Reads a relation, adds it to places or to countries
+   void addRelation(const rapidjson::Value& relation);
+
+   // Reads a node, way or relation, adds it to features if its tags match one of the types
+   void addFeature(const rapidjson::Value& element);
+
+   // Assigns features to regions of places, which must be in their final order
+   // @param regions Receives places of regions which features are assigned to
+   // @return Points of features of every type, one for each region of a feature
+   std::vector<std::vector<AdminIndexFeature>> assignRegions(std::vector<std::uint32_t>& regions);
+
+   // Joins ways of a relation into closed paths
+   std::vector<Path> assembleRings(const rapidjson::Value& members);
+
+   // Removes vertices closer than the tolerance to the simplified ring
+   Ring simplify(const Path& path) const;
+
+   // Assigns countries to places by their centers
+   void assignCountries();
+
+   // Finds the cells of the coverage grid which are inside of the countries
+   // @return Runs of covered cells, sorted by rows and columns
+   std::vector<AdminIndexCoverageRun> computeCoverage();
+
+   // Checks if a point is inside of any of the countries
+   bool isInCountries(const Point& point) const;
+
+   // Checks if the rings of a boundary contain a point
+   static bool containsPoint(const Boundary& boundary, const Point& point);
+
+private:
+   const double m_tolerance;           // See the constructor
+   const bool m_coversWorld;           // See the constructor
+   std::vector<Boundary> m_places;     // Places, in the order of the extract until AddTo() sorts them
+   std::vector<Boundary> m_countries;  // Countries
+   std::vector<Feature> m_features;    // Features
+   Stats m_stats;                      // Counters of the build
+};
+
+}  // namespace geo
@@ -0,0 +1,159 @@
+// geo-snapshot creates, inspects and verifies the snapshot of local indexes which the server maps with the
+// "snapshotFile" setting, see SnapshotFormat.h.
+// The administrative boundary index is built from OSM extracts in the format of Overpass API responses with member
+// geometries, e.g. for a country with the features of GetRegions:
+//
+//   [out:json][timeout:900];
+//   area["ISO3166-1"="GB"][admin_level=2] -> .a;
+//   way(area.a)[natural=coastline] -> .coastlines;
+//   (
+//   rel(area.a)["boundary"="administrative"]["admin_level"~"^(2|4)$"];
+//   rel(area.a)["boundary"="administrative"]["place"~"^(city|town|state)$"];
+//   nwr(area.a)["aeroway"="aerodrome"]["aerodrome:type"="international"];
+//   nwr(area.a)["aerodrome"="international"];
+//   node(area.a)[natural=peak][name][ele];
+//   node(around.coastlines:100)[natural=beach];
+//   wr(area.a)[natural=water][water=lake][salt=no][name];
+//   );
+//   out geom;
+//
+// Usage:
+//   geo-snapshot create -input=gb.json,ie.json -output=geo.snapshot [-tolerance=0.0005] [-world]
+//   geo-snapshot inspect geo.snapshot
+//   geo-snapshot verify geo.snapshot
+
+#include "../../src/search/AdminIndex.h"
+#include "../../src/utils/Snapshot.h"
+#include "AdminIndexBuilder.h"
+
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <absl/log/globals.h>
+#include <absl/log/initialize.h>
+#include <absl/log/log.h>
+
+#include <format>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+ABSL_FLAG(std::vector<std::string>, input, {}, "Comma-separated Overpass API responses with \"out geom\"");
+ABSL_FLAG(std::string, output, "", "Snapshot file to write");
+ABSL_FLAG(double, tolerance, 0.0005, "Maximum distance of removed vertices from simplified boundaries in degrees");
+ABSL_FLAG(bool, world, false, "Inputs cover the whole world, so the server searches names only in the snapshot");
+
+namespace
+{
+
+// Builds the indexes from the input files and writes the snapshot
+int create()
+{
+   const auto inputs = absl::GetFlag(FLAGS_input);
+   const std::string output = absl::GetFlag(FLAGS_output);
+   if (inputs.empty() || output.empty())
+   {
+      LOG(ERROR) << "Both -input and -output are required";
+      return -1;
+   }
+
+   geo::AdminIndexBuilder builder(absl::GetFlag(FLAGS_tolerance), absl::GetFlag(FLAGS_world));
+   for (const auto& input : inputs)
+   {
+      std::ifstream file(input);
+      if (!file.is_open())
+      {
+         LOG(ERROR) << std::format("Failed to open input file: {}", input);
+         return -1;
+      }
+
+      std::stringstream buffer;
+      buffer << file.rdbuf();
+      if (!builder.AddOverpassResponse(buffer.str()))
+      {
+         LOG(ERROR) << std::format("Failed to parse input file: {}", input);
+         return -1;
+      }
+      LOG(INFO) << std::format("Read {}", input);
+   }
+
+   geo::SnapshotWriter snapshot;
+   builder.AddTo(snapshot);
+   if (!snapshot.Write(output))
+      return -1;
+
+   const auto stats = builder.GetStats();
+   LOG(INFO) << std::format("Wrote {}: {} places of {} relations, {} countries, {} places outside of countries",
+      output, stats.places, stats.relations, stats.countries, stats.withoutCountry);
+   LOG(INFO) << std::format("{} rings, {} of {} vertices kept, {} rings dropped", stats.rings, stats.vertices,
+      stats.inputVertices, stats.droppedRings);
+   LOG(INFO) << std::format("{} names, {} features in {} points of {} regions, {} covered cells", stats.names,
+      stats.features, stats.featurePoints, stats.regions, stats.coveredCells);
+   return 0;
+}
+
+// Prints the section table of a snapshot and the sizes of its indexes
+int inspect(const std::string& path)
+{
+   const auto snapshot = std::make_shared<const geo::Snapshot>(path);
+   if (!snapshot->IsOpen())
+      return -1;
+
+   for (const auto& section : snapshot->GetSections())
+   {
+      LOG(INFO) << std::format("{:<24} offset {:>12}, {:>10} records of {:>3} bytes, crc {:08x}", section.name,
+         section.offset, section.count, section.recordSize, section.crc);
+   }
+
+   const geo::AdminIndex index(snapshot);
+   if (index.IsOpen())
+   {
+      const auto stats = index.GetStats();
+      LOG(INFO) << std::format("Administrative boundary index: {} places, {} rings, {} vertices, {} name nodes, "
+                               "{} regions with {} features, {} bytes",
+         stats.places, stats.rings, stats.vertices, stats.nameNodes, stats.regions, stats.features, stats.bytes);
+   }
+   return 0;
+}
+
+// Checks the checksums of all sections and validates the indexes of a snapshot
+int verify(const std::string& path)
+{
+   const auto snapshot = std::make_shared<const geo::Snapshot>(path);
+   if (!snapshot->IsOpen())
+      return -1;
+
+   const auto damaged = snapshot->Verify();
+   for (const auto& name : damaged)
+      LOG(ERROR) << std::format("Section {} is damaged", name);
+
+   const geo::AdminIndex index(snapshot);
+   if (!damaged.empty() || !index.IsOpen())
+      return -1;
+
+   LOG(INFO) << std::format("{} is intact: {} sections, {} bytes", path, snapshot->GetSections().size(),
+      snapshot->GetSize());
+   return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+   const std::vector<char*> arguments = absl::ParseCommandLine(argc, argv);
+   absl::SetStderrThreshold(absl::LogSeverityAtLeast::kInfo);
+   absl::InitializeLog();
+
+   const std::string_view command = arguments.size() > 1 ? arguments[1] : "";
+   if (command == "create" && arguments.size() == 2)
+      return create();
+   if (command == "inspect" && arguments.size() == 3)
+      return inspect(arguments[2]);
+   if (command == "verify" && arguments.size() == 3)
+      return verify(arguments[2]);
+
+   LOG(ERROR) << "Usage: geo-snapshot create -input=<files> -output=<file> | inspect <file> | verify <file>";
+   return -1;
+}